@@ -49,6 +49,20 @@ Requires:   %{name} = %{version}-%{release}
 %description plugin-fake
 Fake plugins for ngfd testing.
 
+%package socket-client
+Summary:    Client library for the ngfd local socket interface
+Requires:   %{name} = %{version}-%{release}
+
+%description socket-client
+Client library for sending feedback requests to ngfd over a local socket.
+
+%package socket-client-devel
+Summary:    Development package for the ngfd socket client library
+Requires:   %{name}-socket-client = %{version}-%{release}
+
+%description socket-client-devel
+This package contains header files for the ngfd socket client library.
+
 %package settings-basic
 Summary:    Example settings for ngfd
 Requires:   %{name} = %{version}-%{release}
@@ -84,6 +98,7 @@ make %{?_smp_mflags}
 rm -rf %{buildroot}
 %make_install
 rm -f %{buildroot}/%{_libdir}/ngf/*.la
+rm -f %{buildroot}/%{_libdir}/*.la
 
 install -D -m 644 %{SOURCE1} %{buildroot}%{_userunitdir}/ngfd.service
 mkdir -p %{buildroot}%{_userunitdir}/user-session.target.wants
@@ -91,6 +106,10 @@ ln -s ../ngfd.service %{buildroot}%{_userunitdir}/user-session.target.wants/
 mkdir -p %{buildroot}%{_userunitdir}/actdead-session.target.wants
 ln -s ../ngfd.service %{buildroot}%{_userunitdir}/actdead-session.target.wants/
 
+%post socket-client -p /sbin/ldconfig
+
+%postun socket-client -p /sbin/ldconfig
+
 %files
 %defattr(-,root,root,-)
 %license COPYING
@@ -111,6 +130,7 @@ ln -s ../ngfd.service %{buildroot}%{_userunitdir}/actdead-session.target.wants/
 %{_libdir}/ngf/libngfd_devicelock.so
 %{_libdir}/ngf/libngfd_route.so
 %{_libdir}/ngf/libngfd_null.so
+%{_libdir}/ngf/libngfd_socket.so
 %{_userunitdir}/ngfd.service
 %{_userunitdir}/user-session.target.wants/ngfd.service
 %{_userunitdir}/actdead-session.target.wants/ngfd.service
@@ -120,6 +140,15 @@ ln -s ../ngfd.service %{buildroot}%{_userunitdir}/actdead-session.target.wants/
 %{_includedir}/ngf
 %{_libdir}/pkgconfig/ngf-plugin.pc
 
+%files socket-client
+%defattr(-,root,root,-)
+%{_libdir}/libngf-socket.so.*
+
+%files socket-client-devel
+%defattr(-,root,root,-)
+%{_includedir}/ngf-socket
+%{_libdir}/libngf-socket.so
+
 %files plugin-fake
 %defattr(-,root,root,-)
 %{_libdir}/ngf/libngfd_fake.so
@@ -25,6 +25,9 @@
 /** Internal context structure. */
 typedef struct _NContext NContext;
 
+/** Immutable view of the context values at one generation. */
+typedef struct _NContextSnapshot NContextSnapshot;
+
 #include <ngf/value.h>
 
 /** Context value change callback function */
@@ -44,6 +47,24 @@ typedef void (*NContextValueChangeFunc) (NContext *context,
 void          n_context_set_value                (NContext *context, const char *key,
                                                   NValue *value);
 
+/**
+ * Begin a transaction. Values set until the matching n_context_commit
+ * are stored immediately, but subscribers are notified only on commit,
+ * once per changed key. Transactions may be nested, notifications are
+ * sent when the outermost transaction is committed.
+ *
+ * @param context NContext structure.
+ */
+void          n_context_begin                    (NContext *context);
+
+/**
+ * Commit a transaction started with n_context_begin. Keys whose value
+ * ended up equal to the value before the transaction are not notified.
+ *
+ * @param context NContext structure.
+ */
+void          n_context_commit                   (NContext *context);
+
 /**
  * Get value by key from context.
  *
@@ -54,10 +75,60 @@ void          n_context_set_value                (NContext *context, const char
 const NValue* n_context_get_value                (NContext *context, const char *key);
 
 /**
- * Subscribe callback function to key in context structure
+ * Get generation of the context. Generation is increased each time a
+ * change is committed, either by n_context_set_value outside of a
+ * transaction or by n_context_commit.
+ *
+ * @param context NContext structure.
+ * @return Generation number.
+ */
+guint         n_context_get_generation           (NContext *context);
+
+/**
+ * Get snapshot of the committed context values. Taking a snapshot is
+ * cheap, values are copied only when context is changed while a
+ * snapshot is held. Within a transaction the snapshot contains the
+ * values as they were before the transaction.
  *
  * @param context NContext structure.
+ * @return New reference to snapshot, release with n_context_snapshot_unref.
+ */
+NContextSnapshot* n_context_snapshot             (NContext *context);
+
+/**
+ * Release snapshot reference.
+ *
+ * @param snapshot Snapshot.
+ */
+void          n_context_snapshot_unref           (NContextSnapshot *snapshot);
+
+/**
+ * Get value by key from snapshot.
+ *
+ * @param snapshot Snapshot.
  * @param key Key.
+ * @return Value or NULL if key has no value in the snapshot.
+ */
+const NValue* n_context_snapshot_get_value       (const NContextSnapshot *snapshot,
+                                                  const char *key);
+
+/**
+ * Get context generation the snapshot values belong to.
+ *
+ * @param snapshot Snapshot.
+ * @return Generation number.
+ */
+guint         n_context_snapshot_get_generation  (const NContextSnapshot *snapshot);
+
+/**
+ * Subscribe callback function to key in context structure. Key may be
+ * a pattern of dot separated segments, where "*" matches any single
+ * segment and a trailing "**" matches one or more segments, for example
+ * "profile.*.volume" or "profile.**". If key is NULL, callback is called
+ * for all keys.
+ *
+ * @param context NContext structure.
+ * @param key Key or key pattern.
  * @param callback Callback function.
  * @param userdata Userdata.
  * @return TRUE is successful.
@@ -71,7 +142,7 @@ int           n_context_subscribe_value_change   (NContext *context, const char
  * Unsubscribe value change callback
  *
  * @param context NContext structure.
- * @param key Key.
+ * @param key Key or key pattern used when subscribing.
  * @param callback Callback function, @see NContextValueChangeFunc
  */
 void          n_context_unsubscribe_value_change (NContext *context, const char *key,
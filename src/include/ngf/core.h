@@ -25,6 +25,16 @@
 /** Internal core structure. */
 typedef struct _NCore NCore;
 
+/** Request filter for hook callbacks. Both members are NULL terminated
+ * arrays, and a NULL member matches all requests. */
+typedef struct _NCoreHookFilter
+{
+    /** Names of the events the callback is interested in */
+    const char *const *events;
+    /** Request must have at least one of these property keys */
+    const char *const *keys;
+} NCoreHookFilter;
+
 #include <glib.h>
 
 #include <ngf/core-hooks.h>
@@ -40,6 +50,19 @@ typedef struct _NCore NCore;
  */
 NContext*        n_core_get_context  (NCore *core);
 
+/**
+ * Get context value for a request being resolved. Hooks and sink
+ * can_handle functions that read the context should use this, so that
+ * prepared requests are resolved again when the value changes.
+ *
+ * @param core Core.
+ * @param request Request being resolved.
+ * @param key Context key.
+ * @return Value or NULL if not set.
+ */
+const NValue*    n_core_get_request_context_value (NCore *core, NRequest *request,
+                                                   const char *key);
+
 /**
  * Get list of active requests
  *
@@ -64,6 +87,16 @@ NSinkInterface** n_core_get_sinks    (NCore *core);
  */
 GList*           n_core_get_events   (NCore *core);
 
+/**
+ * Check if initialization is done and N_CORE_HOOK_INIT_DONE has been
+ * fired. Plugins loaded later, on demand or when reloaded, do not get
+ * the hook and should do their setup directly.
+ *
+ * @param core Core.
+ * @return TRUE if initialization is done.
+ */
+int              n_core_is_init_done (NCore *core);
+
 /**
  * Connect callback function to hook
  *
@@ -79,6 +112,64 @@ GList*           n_core_get_events   (NCore *core);
  */
 int              n_core_connect      (NCore *core, NCoreHook hook, int priority, NHookCallback callback, void *userdata);
 
+/**
+ * Connect callback function to request hook, called only for the requests
+ * matching the filter. Filter is evaluated by the core, so callbacks that
+ * are interested in only a few events do not have to be run for every
+ * request. Use n_core_disconnect to disconnect.
+ *
+ * @param core Core.
+ * @param hook Hook to connect callback to, must carry a request.
+ * @param priority Priority of callback function.
+ * @param filter Request filter, copied by the core.
+ * @param callback Callback function.
+ * @param userdata Userdata.
+ * @return TRUE if successful.
+ * @see NCoreHookFilter
+ */
+int              n_core_connect_filtered (NCore *core, NCoreHook hook, int priority,
+                                          const NCoreHookFilter *filter,
+                                          NHookCallback callback, void *userdata);
+
+/**
+ * Reload plugin with its parameters read again from plugins.d. Requests
+ * using sinks of the plugin are stopped, and the plugin is unloaded and
+ * loaded again once they are done. Other plugins are not affected.
+ * Plugins with input interfaces, or plugins other plugins depend on,
+ * cannot be reloaded.
+ *
+ * @param core Core.
+ * @param plugin_name Name of the plugin.
+ * @return TRUE if reload was started.
+ */
+int              n_core_reload_plugin (NCore *core, const char *plugin_name);
+
+/**
+ * Set keys accepted in requests from clients. Properties with other keys
+ * would be dropped before the request is played, so input interfaces can
+ * skip them while parsing with n_core_lookup_request_key. Keys event rules
+ * match requests with are always accepted, so that the event is resolved
+ * as if no key was skipped. May be called while input interfaces look up
+ * keys in other threads.
+ *
+ * @param core Core.
+ * @param keys NULL terminated array of keys, NULL to accept all keys.
+ */
+void             n_core_set_request_keys (NCore *core, const char *const *keys);
+
+/**
+ * Check if key is accepted in requests from clients and get its type.
+ * Safe to call from any thread.
+ *
+ * @param core Core.
+ * @param key Key name.
+ * @param type Set to the value type from keytypes, 0 if not defined or
+ *             if all keys are accepted.
+ * @return TRUE if key is accepted.
+ */
+gboolean         n_core_lookup_request_key (NCore *core, const char *key,
+                                            int *type);
+
 /**
  * Disconnect callback function from hook
  *
@@ -46,6 +46,10 @@ typedef struct _NHook
 /** Hook callback function */
 typedef void (*NHookCallback) (NHook *hook, void *data, void *userdata);
 
+/** Hook filter function, called before the callback of a filtered slot.
+ * Return FALSE to skip the callback for the data. */
+typedef gboolean (*NHookFilter) (NHook *hook, void *data, void *filter_data);
+
 /** Initializes hook structure
  * @param hook Hook.
  */
@@ -62,6 +66,20 @@ void n_hook_init       (NHook *hook);
  */
 int  n_hook_connect    (NHook *hook, int priority, NHookCallback callback, void *userdata);
 
+/** Connect callback function to hook, run only when filter accepts the data
+ * @param hook Hook.
+ * @param priority Priority of the callback function.
+ * @param filter Filter function.
+ * @param filter_data Data passed to the filter function.
+ * @param filter_destroy Called for filter_data when the callback is disconnected. May be NULL.
+ * @param callback Callback function.
+ * @param userdata Userdata.
+ * @return TRUE if success.
+ */
+int  n_hook_connect_filtered (NHook *hook, int priority, NHookFilter filter,
+                              void *filter_data, GDestroyNotify filter_destroy,
+                              NHookCallback callback, void *userdata);
+
 /** Disconnects callback function from hook
  * @param hook Hook.
  * @param callback Callback function.
@@ -73,6 +73,46 @@ NCore* n_input_interface_get_core      (NInputInterface *iface);
  */
 int    n_input_interface_play_request  (NInputInterface *iface, NRequest *request);
 
+/** Start playback of requests as one group. Events of all requests are
+ * resolved and prepared together and playback of all of them starts at the
+ * same time. Replies are sent only for the group, PLAYING once all requests
+ * have been started and COMPLETED or FAILED once all of them are done.
+ * The group can be paused, resumed and stopped like a single request.
+ * @param iface NInputInterface structure
+ * @param group NRequest used as handle for the group
+ * @param requests GList of NRequest structures to play
+ * @return TRUE if success
+ */
+int    n_input_interface_play_group    (NInputInterface *iface, NRequest *group, GList *requests);
+
+/** Prepare request for playing it many times. Event of the request is
+ * resolved, its properties merged and transformed and the capable sinks
+ * queried once, requests created with n_input_interface_new_prepared_request
+ * reuse the results. Results are resolved again on next use when the events,
+ * plugins or sinks change, or a context value read by the rules of the
+ * events of the request name, or by hooks and sinks through
+ * n_core_get_request_context_value, changes.
+ * @param iface NInputInterface structure
+ * @param request NRequest structure used as template, ownership is taken
+ * @return Prepared request or NULL if event cannot be resolved. Release
+ *         with n_input_interface_release_prepared.
+ */
+NPreparedRequest* n_input_interface_prepare_request (NInputInterface *iface, NRequest *request);
+
+/** Create new request from prepared request. The request has its own id
+ * and is started with n_input_interface_play_request like any other.
+ * @param iface NInputInterface structure
+ * @param prepared NPreparedRequest structure
+ * @return New request
+ */
+NRequest* n_input_interface_new_prepared_request (NInputInterface *iface, NPreparedRequest *prepared);
+
+/** Release prepared request. Requests created from it are not affected.
+ * @param iface NInputInterface structure
+ * @param prepared NPreparedRequest structure
+ */
+void   n_input_interface_release_prepared (NInputInterface *iface, NPreparedRequest *prepared);
+
 /** Pauses playback of the request
  * @param iface NInputInterface structure
  * @param request NRequest structure
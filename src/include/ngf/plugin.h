@@ -85,6 +85,14 @@ void             n_plugin_register_input (NPlugin *plugin, const NInputInterface
         return p_version;                       \
     }
 
+/** Macro to define plugins that must be loaded before this plugin. Optional.
+ * Plugin names are separated with ';'. Inputs of the plugin are started as
+ * soon as the sinks of these plugins have been initialized. */
+#define N_PLUGIN_DEPENDS(p_depends)             \
+    const char* n_plugin__get_depends () {      \
+        return p_depends;                       \
+    }
+
 /** Plugin loading function. Plugin declaration structure should be initialized here. */
 #define N_PLUGIN_LOAD(p_plugin)                 \
     int n_plugin__load (NPlugin* p_plugin)
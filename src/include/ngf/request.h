@@ -25,6 +25,9 @@
 /** Internal request structure. */
 typedef struct _NRequest NRequest;
 
+/** Internal prepared request structure. */
+typedef struct _NPreparedRequest NPreparedRequest;
+
 #include <ngf/proplist.h>
 #include <ngf/event.h>
 
@@ -120,6 +123,14 @@ int              n_request_is_paused      (NRequest *request);
  */
 NRequest*        n_request_new_with_event_and_properties (const char *event, const NProplist *properties);
 
+/** Create new request with event, taking ownership of properties instead
+ * of copying them. Properties are freed also if creating the request fails.
+ * @param event Event
+ * @param properties Properties as NProplist, owned by the request after the call
+ * @return Newly allocated request
+ */
+NRequest*        n_request_new_with_event_take_properties (const char *event, NProplist *properties);
+
 /** Request is a fallback request
  * @param request Request
  * @return TRUE if fallback, FALSE if normal.
@@ -32,6 +32,10 @@ typedef struct _NSinkInterface NSinkInterface;
 #define N_SINK_INTERFACE_TYPE_VIBRATOR  "vibra"
 #define N_SINK_INTERFACE_TYPE_LEDS      "leds"
 
+/** Return value of initialize function when the sink completes its
+ * initialization later with n_sink_interface_initialized. */
+#define N_SINK_INTERFACE_INIT_PENDING   2
+
 /** Interface declaration structure. */
 typedef struct _NSinkInterfaceDecl
 {
@@ -43,8 +47,11 @@ typedef struct _NSinkInterfaceDecl
     const char *type;
 
     /** Initialization function. Called when interface is loaded.
+     * Slow initialization should be done asynchronously, returning
+     * N_SINK_INTERFACE_INIT_PENDING. Sink is not used before it has
+     * reported the result with n_sink_interface_initialized.
      * @param iface NSinkInterface structure
-     * @return TRUE if success
+     * @return TRUE if success, N_SINK_INTERFACE_INIT_PENDING if initialization continues asynchronously
      */
     int  (*initialize) (NSinkInterface *iface);
     
@@ -87,8 +94,45 @@ typedef struct _NSinkInterfaceDecl
      * @return TRUE if playback is stopped
      */
     void (*stop)       (NSinkInterface *iface, NRequest *request);
+
+    /** Latency function. Optional. Called after all sinks have synchronized
+     * the request, just before play. Core delays play of the sinks with lower
+     * latency so that output of all sinks starts at the same time.
+     * @param iface NSinkInterface structure
+     * @param request Request
+     * @return Expected delay in milliseconds from play until output starts
+     */
+    guint (*latency)   (NSinkInterface *iface, NRequest *request);
+
+    /** Probe function. Optional. Called periodically in the background after
+     * the sink has failed too many requests in a row and is being skipped.
+     * Without a probe function the sink is retried with the next request.
+     * @param iface NSinkInterface structure
+     * @return TRUE if the sink is usable again
+     */
+    int  (*probe)      (NSinkInterface *iface);
+
+    /** Trim function. Optional. Called when ngfd has been idle for a while.
+     * Sink should release memory it can recreate, such as caches and
+     * connections. Sink must still be able to play after trimming.
+     * @param iface NSinkInterface structure
+     * @return TRUE if something was released
+     */
+    int  (*trim)       (NSinkInterface *iface);
+
+    /** Rewarm function. Optional. Called in the background on the first
+     * activity after trim has returned TRUE, to recreate what was released.
+     * @param iface NSinkInterface structure
+     */
+    void (*rewarm)     (NSinkInterface *iface);
 } NSinkInterfaceDecl;
 
+/** Report result of asynchronous initialization.
+ * @param iface NSinkInterface structure
+ * @param success TRUE if the sink is ready for use
+ */
+void    n_sink_interface_initialized  (NSinkInterface *iface, int success);
+
 /** Stores userdata for the sink interface
  * @param iface NSinkInterface structure
  * @param userdata Interface userdata to store
@@ -151,4 +195,13 @@ void n_sink_interface_complete             (NSinkInterface *iface, NRequest *req
  */
 void n_sink_interface_fail                 (NSinkInterface *iface, NRequest *request);
 
+/**
+ * Report request has failed because of the request itself, such as a
+ * missing or unreadable file. Unlike n_sink_interface_fail this is not
+ * counted against the circuit breaker of the sink.
+ * @param iface NSinkInterface structure
+ * @param request Request
+ */
+void n_sink_interface_fail_request         (NSinkInterface *iface, NRequest *request);
+
 #endif /* N_SINK_INTERFACE_H */
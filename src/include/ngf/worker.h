@@ -0,0 +1,69 @@
+/*
+ * ngfd - Non-graphic feedback daemon
+ * Worker threads for blocking operations
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef N_WORKER_H
+#define N_WORKER_H
+
+#include <glib.h>
+#include <ngf/core.h>
+
+/** Work function. Called in a worker thread, so it must only touch data
+ * owned by the work item and must not call any core functions.
+ * @param userdata Userdata given to n_core_push_work
+ * @return Result passed to the completion function
+ */
+typedef gboolean (*NWorkFunc)     (gpointer userdata);
+
+/** Completion function. Called from the main loop after the work function
+ * has returned. Not called if the work has been cancelled.
+ * @param result Return value of the work function
+ * @param userdata Userdata given to n_core_push_work
+ */
+typedef void     (*NWorkDoneFunc) (gboolean result, gpointer userdata);
+
+/**
+ * Run blocking work in a worker thread and get the completion in the
+ * main loop. Work items pushed with the same non-NULL queue are run one
+ * after another in the order they were pushed, items of different queues
+ * run in parallel.
+ *
+ * @param core Core.
+ * @param queue Key for work that needs to be serialized, or NULL.
+ * @param work Work function, called in a worker thread.
+ * @param done Completion function, called in main loop. May be NULL.
+ * @param userdata Userdata passed to work and completion functions.
+ * @param destroy Called in main loop for userdata after completion or cancel. May be NULL.
+ * @return Work id. 0 if the work was run immediately because worker
+ *         threads have already been shut down.
+ */
+guint n_core_push_work   (NCore *core, gconstpointer queue, NWorkFunc work,
+                          NWorkDoneFunc done, gpointer userdata,
+                          GDestroyNotify destroy);
+
+/**
+ * Cancel work. If the work function has not started yet it is not run.
+ * The completion function is not called, but destroy function of the
+ * userdata is called once the work function is no longer running.
+ *
+ * @param core Core.
+ * @param work_id Work id returned by n_core_push_work.
+ */
+void  n_core_cancel_work (NCore *core, guint work_id);
+
+#endif /* N_WORKER_H */
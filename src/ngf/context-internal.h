@@ -27,4 +27,9 @@
 NContext* n_context_new  ();
 void      n_context_free (NContext *context);
 
+/* TRUE if change of the key is notified to the callback, either through
+   the key itself or a matching pattern. */
+gboolean  n_context_is_subscribed (NContext *context, const char *key,
+                                   NContextValueChangeFunc callback);
+
 #endif /* N_CONTEXT_H */
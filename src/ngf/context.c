@@ -19,6 +19,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
  */
 
+#include <string.h>
+
 #include <ngf/log.h>
 #include <ngf/proplist.h>
 
@@ -26,6 +28,10 @@
 
 #define LOG_CAT "context: "
 
+#define KEY_SEPARATOR   "."
+#define MATCH_SEGMENT   "*"     /* matches exactly one key segment */
+#define MATCH_REST      "**"    /* matches one or more trailing segments */
+
 typedef struct _NContextSubscriber
 {
     gpointer  userdata;
@@ -37,11 +43,38 @@ typedef struct _NContextKey
     GList      *subscribers;    /* value:NContextSubscriber     */
 } NContextKey;
 
-struct _NContext
+/* node of the pattern trie, one level per key segment */
+typedef struct _NContextNode
+{
+    GHashTable *children;       /* key:gchar segment value:NContextNode */
+    GList      *subscribers;    /* value:NContextSubscriber, pattern ends here */
+} NContextNode;
+
+typedef struct _NContextChange
 {
+    gchar      *key;
+    NValue     *old_value;      /* value before the transaction */
+} NContextChange;
+
+struct _NContextSnapshot
+{
+    gint        ref;
+    guint       generation;     /* context generation of the values */
     NProplist  *values;
+};
+
+struct _NContext
+{
+    NContextSnapshot *current;  /* latest values, copied on write when shared */
+    NContextSnapshot *committed;/* values before the open transaction */
+    guint       generation;     /* increased for each committed change */
     GHashTable *keys;           /* key:gchar value:NContextKey  */
     GList      *all_keys;       /* value:NContextSubscriber     */
+    NContextNode *patterns;     /* root of wildcard subscriptions */
+
+    guint       depth;          /* nesting level of open transactions */
+    GHashTable *pending;        /* key:gchar value:NContextChange */
+    GQueue     *pending_order;  /* value:NContextChange, in order of first change */
 };
 
 static void
@@ -57,51 +90,312 @@ broadcast_list (NContext *context, GList *list, const char *key,
     }
 }
 
+static gboolean
+is_pattern (const char *key)
+{
+    return strchr (key, '*') != NULL;
+}
+
+static NContextNode*
+node_new ()
+{
+    NContextNode *node = NULL;
+
+    node = g_new0 (NContextNode, 1);
+    node->children = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                            g_free, NULL);
+    return node;
+}
+
+static void
+node_free (NContextNode *node)
+{
+    GHashTableIter  iter;
+    gpointer        child = NULL;
+
+    if (!node)
+        return;
+
+    g_hash_table_iter_init (&iter, node->children);
+    while (g_hash_table_iter_next (&iter, NULL, &child))
+        node_free ((NContextNode*) child);
+
+    g_hash_table_destroy (node->children);
+    g_list_free_full (node->subscribers, g_free);
+    g_free (node);
+}
+
+static void
+broadcast_pattern (NContext *context, NContextNode *node, gchar **segments,
+                   const char *key, const NValue *old_value,
+                   const NValue *new_value)
+{
+    NContextNode *child = NULL;
+
+    if (!*segments) {
+        broadcast_list (context, node->subscribers, key, old_value, new_value);
+        return;
+    }
+
+    if ((child = g_hash_table_lookup (node->children, *segments)))
+        broadcast_pattern (context, child, segments + 1, key, old_value, new_value);
+
+    if ((child = g_hash_table_lookup (node->children, MATCH_SEGMENT)))
+        broadcast_pattern (context, child, segments + 1, key, old_value, new_value);
+
+    if ((child = g_hash_table_lookup (node->children, MATCH_REST)))
+        broadcast_list (context, child->subscribers, key, old_value, new_value);
+}
+
+static gboolean
+list_has_callback (GList *list, NContextValueChangeFunc callback)
+{
+    GList *iter = NULL;
+
+    for (iter = g_list_first (list); iter; iter = g_list_next (iter)) {
+        if (((NContextSubscriber*) iter->data)->callback == callback)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* same walk as broadcast_pattern, but only looks for the callback. */
+static gboolean
+pattern_has_callback (NContextNode *node, gchar **segments,
+                      NContextValueChangeFunc callback)
+{
+    NContextNode *child = NULL;
+
+    if (!*segments)
+        return list_has_callback (node->subscribers, callback);
+
+    if ((child = g_hash_table_lookup (node->children, *segments)) &&
+        pattern_has_callback (child, segments + 1, callback))
+        return TRUE;
+
+    if ((child = g_hash_table_lookup (node->children, MATCH_SEGMENT)) &&
+        pattern_has_callback (child, segments + 1, callback))
+        return TRUE;
+
+    if ((child = g_hash_table_lookup (node->children, MATCH_REST)))
+        return list_has_callback (child->subscribers, callback);
+
+    return FALSE;
+}
+
 static void
 n_context_broadcast_change (NContext *context, const char *key,
                             const NValue *old_value, const NValue *new_value)
 {
+    gchar             **segments   = NULL;
     NContextKey        *context_key= NULL;
     gchar              *old_str    = NULL;
     gchar              *new_str    = NULL;
 
-    old_str = n_value_to_string ((NValue*) old_value);
-    new_str = n_value_to_string ((NValue*) new_value);
+    if (n_log_get_level () <= N_LOG_LEVEL_DEBUG) {
+        old_str = n_value_to_string ((NValue*) old_value);
+        new_str = n_value_to_string ((NValue*) new_value);
 
-    N_DEBUG (LOG_CAT "broadcasting value change for '%s': %s -> %s", key,
-        old_str, new_str);
+        N_DEBUG (LOG_CAT "broadcasting value change for '%s': %s -> %s", key,
+            old_str, new_str);
 
-    g_free (new_str);
-    g_free (old_str);
+        g_free (new_str);
+        g_free (old_str);
+    }
 
     if ((context_key = g_hash_table_lookup (context->keys, key)))
         broadcast_list (context, context_key->subscribers, key, old_value, new_value);
 
+    if (g_hash_table_size (context->patterns->children) > 0) {
+        segments = g_strsplit (key, KEY_SEPARATOR, -1);
+        broadcast_pattern (context, context->patterns, segments, key, old_value, new_value);
+        g_strfreev (segments);
+    }
+
     broadcast_list (context, context->all_keys, key, old_value, new_value);
 }
 
+static void
+n_context_change_free (NContextChange *change)
+{
+    g_free       (change->key);
+    n_value_free (change->old_value);
+    g_free       (change);
+}
+
+static NContextSnapshot*
+snapshot_new (NProplist *values, guint generation)
+{
+    NContextSnapshot *snapshot = NULL;
+
+    snapshot = g_slice_new0 (NContextSnapshot);
+    snapshot->ref        = 1;
+    snapshot->generation = generation;
+    snapshot->values     = values;
+    return snapshot;
+}
+
+/* values of the current snapshot may only be modified when nobody else
+   holds a reference to it. */
+static NProplist*
+writable_values (NContext *context)
+{
+    NContextSnapshot *copy = NULL;
+
+    if (context->current->ref > 1) {
+        copy = snapshot_new (n_proplist_copy (context->current->values),
+                             context->current->generation);
+        n_context_snapshot_unref (context->current);
+        context->current = copy;
+    }
+
+    return context->current->values;
+}
+
 void
 n_context_set_value (NContext *context, const char *key,
                      NValue *value)
 {
-    NValue *old_value = NULL;
+    NValue         *old_value = NULL;
+    NContextChange *change    = NULL;
 
     if (!context || !key)
         return;
 
-    old_value = n_value_copy (n_proplist_get (context->values, key));
-    n_proplist_set (context->values, key, value);
+    if (context->depth > 0) {
+        /* only the value before the first change within transaction is
+           needed for the notification on commit. */
+
+        if (!g_hash_table_lookup (context->pending, key)) {
+            change = g_new0 (NContextChange, 1);
+            change->key       = g_strdup (key);
+            change->old_value = n_value_copy (n_proplist_get (context->current->values, key));
+            g_hash_table_insert (context->pending, change->key, change);
+            g_queue_push_tail (context->pending_order, change);
+        }
+
+        n_proplist_set (writable_values (context), key, value);
+        return;
+    }
+
+    old_value = n_value_copy (n_proplist_get (context->current->values, key));
+    n_proplist_set (writable_values (context), key, value);
+    context->current->generation = ++context->generation;
     n_context_broadcast_change (context, key, old_value, value);
     n_value_free (old_value);
 }
 
+void
+n_context_begin (NContext *context)
+{
+    if (!context)
+        return;
+
+    /* snapshots taken during the transaction see the values as they were
+       before it. */
+
+    if (context->depth++ == 0)
+        context->committed = n_context_snapshot (context);
+}
+
+void
+n_context_commit (NContext *context)
+{
+    NContextChange *change    = NULL;
+    const NValue   *new_value = NULL;
+    GQueue         *changes   = NULL;
+
+    if (!context || context->depth == 0)
+        return;
+
+    if (--context->depth > 0)
+        return;
+
+    n_context_snapshot_unref (context->committed);
+    context->committed = NULL;
+
+    if (g_queue_get_length (context->pending_order) > 0)
+        context->current->generation = ++context->generation;
+
+    /* take the pending changes so that subscribers may set values
+       or open a new transaction while being notified. */
+
+    changes = context->pending_order;
+    context->pending_order = g_queue_new ();
+    g_hash_table_remove_all (context->pending);
+
+    while ((change = g_queue_pop_head (changes))) {
+        new_value = n_proplist_get (context->current->values, change->key);
+
+        if (change->old_value && new_value && n_value_equals (change->old_value, new_value))
+            N_DEBUG (LOG_CAT "value of '%s' did not change in transaction", change->key);
+        else
+            n_context_broadcast_change (context, change->key, change->old_value, new_value);
+
+        n_context_change_free (change);
+    }
+
+    g_queue_free (changes);
+}
+
 const NValue*
 n_context_get_value (NContext *context, const char *key)
 {
     if (!context || !key)
         return NULL;
 
-    return (const NValue*) n_proplist_get (context->values, key);
+    return (const NValue*) n_proplist_get (context->current->values, key);
+}
+
+guint
+n_context_get_generation (NContext *context)
+{
+    if (!context)
+        return 0;
+
+    return context->generation;
+}
+
+NContextSnapshot*
+n_context_snapshot (NContext *context)
+{
+    NContextSnapshot *snapshot = NULL;
+
+    if (!context)
+        return NULL;
+
+    snapshot = context->committed ? context->committed : context->current;
+    snapshot->ref++;
+    return snapshot;
+}
+
+void
+n_context_snapshot_unref (NContextSnapshot *snapshot)
+{
+    if (!snapshot)
+        return;
+
+    if (--snapshot->ref > 0)
+        return;
+
+    n_proplist_free (snapshot->values);
+    g_slice_free (NContextSnapshot, snapshot);
+}
+
+const NValue*
+n_context_snapshot_get_value (const NContextSnapshot *snapshot, const char *key)
+{
+    if (!snapshot || !key)
+        return NULL;
+
+    return (const NValue*) n_proplist_get (snapshot->values, key);
+}
+
+guint
+n_context_snapshot_get_generation (const NContextSnapshot *snapshot)
+{
+    return snapshot ? snapshot->generation : 0;
 }
 
 int
@@ -111,6 +405,10 @@ n_context_subscribe_value_change (NContext *context, const char *key,
 {
     NContextKey        *context_key = NULL;
     NContextSubscriber *subscriber  = NULL;
+    NContextNode       *node        = NULL;
+    NContextNode       *child       = NULL;
+    gchar             **segments    = NULL;
+    gchar             **iter        = NULL;
 
     if (!context || !callback)
         return FALSE;
@@ -119,7 +417,19 @@ n_context_subscribe_value_change (NContext *context, const char *key,
     subscriber->callback = callback;
     subscriber->userdata = userdata;
 
-    if (key) {
+    if (key && is_pattern (key)) {
+        segments = g_strsplit (key, KEY_SEPARATOR, -1);
+        node = context->patterns;
+        for (iter = segments; *iter; ++iter) {
+            if (!(child = g_hash_table_lookup (node->children, *iter))) {
+                child = node_new ();
+                g_hash_table_insert (node->children, g_strdup (*iter), child);
+            }
+            node = child;
+        }
+        g_strfreev (segments);
+        node->subscribers = g_list_append (node->subscribers, subscriber);
+    } else if (key) {
         if (!(context_key = g_hash_table_lookup (context->keys, key))) {
             context_key = g_new0 (NContextKey, 1);
             g_hash_table_insert (context->keys, g_strdup (key), context_key);
@@ -150,16 +460,40 @@ remove_from_list (GList **list, NContextValueChangeFunc callback)
     }
 }
 
+/* remove callback from the pattern node, and prune nodes left empty. */
+static gboolean
+remove_from_pattern (NContextNode *node, gchar **segments,
+                     NContextValueChangeFunc callback)
+{
+    NContextNode *child = NULL;
+
+    if (!*segments)
+        remove_from_list (&node->subscribers, callback);
+    else if ((child = g_hash_table_lookup (node->children, *segments))) {
+        if (remove_from_pattern (child, segments + 1, callback)) {
+            g_hash_table_remove (node->children, *segments);
+            node_free (child);
+        }
+    }
+
+    return !node->subscribers && g_hash_table_size (node->children) == 0;
+}
+
 void
 n_context_unsubscribe_value_change (NContext *context, const char *key,
                                     NContextValueChangeFunc callback)
 {
     NContextKey *context_key  = NULL;
+    gchar      **segments     = NULL;
 
     if (!context || !callback)
         return;
 
-    if (key) {
+    if (key && is_pattern (key)) {
+        segments = g_strsplit (key, KEY_SEPARATOR, -1);
+        (void) remove_from_pattern (context->patterns, segments, callback);
+        g_strfreev (segments);
+    } else if (key) {
         if ((context_key = g_hash_table_lookup (context->keys, key))) {
             remove_from_list (&context_key->subscribers, callback);
             if (!context_key->subscribers)
@@ -169,23 +503,57 @@ n_context_unsubscribe_value_change (NContext *context, const char *key,
         remove_from_list (&context->all_keys, callback);
 }
 
+gboolean
+n_context_is_subscribed (NContext *context, const char *key,
+                         NContextValueChangeFunc callback)
+{
+    NContextKey  *context_key = NULL;
+    gchar       **segments    = NULL;
+    gboolean      result      = FALSE;
+
+    if (!context || !key || !callback)
+        return FALSE;
+
+    if (list_has_callback (context->all_keys, callback))
+        return TRUE;
+
+    if ((context_key = g_hash_table_lookup (context->keys, key)) &&
+        list_has_callback (context_key->subscribers, callback))
+        return TRUE;
+
+    if (g_hash_table_size (context->patterns->children) > 0) {
+        segments = g_strsplit (key, KEY_SEPARATOR, -1);
+        result = pattern_has_callback (context->patterns, segments, callback);
+        g_strfreev (segments);
+    }
+
+    return result;
+}
+
 NContext*
 n_context_new ()
 {
     NContext *context = NULL;
 
     context = g_new0 (NContext, 1);
-    context->values = n_proplist_new ();
+    context->current = snapshot_new (n_proplist_new (), 0);
     context->keys = g_hash_table_new_full (g_str_hash, g_str_equal,
                                            g_free, g_free);
+    context->patterns = node_new ();
+    context->pending = g_hash_table_new (g_str_hash, g_str_equal);
+    context->pending_order = g_queue_new ();
     return context;
 }
 
 void
 n_context_free (NContext *context)
 {
+    g_queue_free_full (context->pending_order, (GDestroyNotify) n_context_change_free);
+    g_hash_table_destroy (context->pending);
+    node_free (context->patterns);
     g_list_free_full (context->all_keys, g_free);
     g_hash_table_destroy (context->keys);
-    n_proplist_free (context->values);
+    n_context_snapshot_unref (context->committed);
+    n_context_snapshot_unref (context->current);
     g_free (context);
 }
@@ -0,0 +1,377 @@
+/*
+ * ngfd - Non-graphic feedback daemon
+ * Persistent storage for context values
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "core-internal.h"
+#include "contextstore-internal.h"
+
+#define LOG_CAT "context-store: "
+
+/* values are stored in a group per value type */
+#define GROUP_STRING    "string"
+#define GROUP_INT       "int"
+#define GROUP_UINT      "uint"
+#define GROUP_BOOL      "bool"
+#define GROUP_STATE     "state"
+
+#define KEY_SAVED       "saved"         /* wall clock seconds of the write */
+#define KEY_BOOT_ID     "boot-id"
+
+#define BOOT_ID_FILE    "/proc/sys/kernel/random/boot_id"
+
+struct NContextStore {
+    NCore      *core;
+    gchar      *path;           /* state file, NULL disables */
+    gchar     **keys;           /* keys or key patterns to persist */
+    guint       write_delay;    /* ms to collect changes before writing */
+    guint       max_age;        /* s stored values are valid, 0 for no limit */
+    GHashTable *values;         /* key -> NValue, last known values */
+    guint       write_id;       /* pending write */
+    gboolean    subscribed;
+    gboolean    restoring;      /* restored values are already stored */
+};
+
+static void     value_changed_cb (NContext *context, const char *key,
+                                  const NValue *old_value, const NValue *new_value,
+                                  void *userdata);
+static gboolean write_cb         (gpointer userdata);
+
+static void
+subscribe (NContextStore *store, gboolean enable)
+{
+    NContext  *context = n_core_get_context (store->core);
+    gchar    **pattern = NULL;
+
+    if (store->subscribed == enable)
+        return;
+
+    for (pattern = store->keys; pattern && *pattern; ++pattern) {
+        if (enable)
+            n_context_subscribe_value_change (context, *pattern, value_changed_cb, store);
+        else
+            n_context_unsubscribe_value_change (context, *pattern, value_changed_cb);
+    }
+
+    store->subscribed = enable;
+}
+
+static void
+schedule_write (NContextStore *store)
+{
+    if (store->write_id > 0 || !store->path)
+        return;
+
+    /* changes often come in bursts, write once they have settled. */
+
+    store->write_id = g_timeout_add (store->write_delay, write_cb, store);
+}
+
+static void
+value_changed_cb (NContext *context, const char *key,
+                  const NValue *old_value, const NValue *new_value,
+                  void *userdata)
+{
+    NContextStore *store = userdata;
+
+    (void) context;
+    (void) old_value;
+
+    if (store->restoring)
+        return;
+
+    if (new_value && n_value_type (new_value) != N_VALUE_TYPE_POINTER)
+        g_hash_table_replace (store->values, g_strdup (key), n_value_copy (new_value));
+    else if (!g_hash_table_remove (store->values, key))
+        return;
+
+    schedule_write (store);
+}
+
+static void
+store_value_cb (gpointer in_key, gpointer in_value, gpointer userdata)
+{
+    const char   *key     = in_key;
+    const NValue *value   = in_value;
+    GKeyFile     *keyfile = userdata;
+
+    switch (n_value_type (value)) {
+        case N_VALUE_TYPE_STRING:
+            g_key_file_set_string (keyfile, GROUP_STRING, key, n_value_get_string (value));
+            break;
+        case N_VALUE_TYPE_INT:
+            g_key_file_set_integer (keyfile, GROUP_INT, key, n_value_get_int (value));
+            break;
+        case N_VALUE_TYPE_UINT:
+            g_key_file_set_uint64 (keyfile, GROUP_UINT, key, n_value_get_uint (value));
+            break;
+        case N_VALUE_TYPE_BOOL:
+            g_key_file_set_boolean (keyfile, GROUP_BOOL, key, n_value_get_bool (value));
+            break;
+        default:
+            break;
+    }
+}
+
+static gchar*
+read_boot_id ()
+{
+    gchar *boot_id = NULL;
+
+    if (!g_file_get_contents (BOOT_ID_FILE, &boot_id, NULL, NULL))
+        return NULL;
+
+    return g_strstrip (boot_id);
+}
+
+static void
+write_state (NContextStore *store)
+{
+    GKeyFile *keyfile = NULL;
+    GError   *error   = NULL;
+    gchar    *data    = NULL;
+    gchar    *dir     = NULL;
+    gchar    *boot_id = NULL;
+    gsize     length  = 0;
+
+    keyfile = g_key_file_new ();
+    g_hash_table_foreach (store->values, store_value_cb, keyfile);
+
+    g_key_file_set_int64 (keyfile, GROUP_STATE, KEY_SAVED,
+        g_get_real_time () / G_USEC_PER_SEC);
+    if ((boot_id = read_boot_id ()))
+        g_key_file_set_string (keyfile, GROUP_STATE, KEY_BOOT_ID, boot_id);
+
+    data = g_key_file_to_data (keyfile, &length, NULL);
+
+    dir = g_path_get_dirname (store->path);
+    (void) g_mkdir_with_parents (dir, 0700);
+
+    if (!g_file_set_contents (store->path, data, length, &error)) {
+        N_WARNING (LOG_CAT "failed to write '%s': %s", store->path, error->message);
+        g_error_free (error);
+    } else
+        N_DEBUG (LOG_CAT "stored %u values to '%s'",
+            g_hash_table_size (store->values), store->path);
+
+    g_free (boot_id);
+    g_free (dir);
+    g_free (data);
+    g_key_file_free (keyfile);
+}
+
+/* stored values describe the state of the device when they were written,
+   they are not valid after a reboot or once too old. */
+static gboolean
+state_is_valid (NContextStore *store, GKeyFile *keyfile)
+{
+    gchar   *stored_id = NULL;
+    gchar   *boot_id   = NULL;
+    gint64   saved     = 0;
+    gint64   age       = 0;
+    gboolean result    = TRUE;
+
+    stored_id = g_key_file_get_string (keyfile, GROUP_STATE, KEY_BOOT_ID, NULL);
+    boot_id   = read_boot_id ();
+
+    if (stored_id && boot_id && !g_str_equal (stored_id, boot_id)) {
+        N_DEBUG (LOG_CAT "stored context is from previous boot, ignored");
+        result = FALSE;
+        goto done;
+    }
+
+    if (store->max_age > 0) {
+        saved = g_key_file_get_int64 (keyfile, GROUP_STATE, KEY_SAVED, NULL);
+        age   = g_get_real_time () / G_USEC_PER_SEC - saved;
+
+        if (saved <= 0 || age < 0 || age > (gint64) store->max_age) {
+            N_DEBUG (LOG_CAT "stored context is %" G_GINT64_FORMAT " s old, ignored", age);
+            result = FALSE;
+        }
+    }
+
+done:
+    g_free (boot_id);
+    g_free (stored_id);
+
+    return result;
+}
+
+static gboolean
+write_cb (gpointer userdata)
+{
+    NContextStore *store = userdata;
+
+    store->write_id = 0;
+    write_state (store);
+
+    return FALSE;
+}
+
+static void
+restore_group (NContextStore *store, GKeyFile *keyfile, const char *group,
+               NValueType type)
+{
+    NContext  *context = n_core_get_context (store->core);
+    gchar    **keys    = NULL;
+    gchar    **key     = NULL;
+    NValue    *value   = NULL;
+    GError    *error   = NULL;
+
+    if (!(keys = g_key_file_get_keys (keyfile, group, NULL, NULL)))
+        return;
+
+    for (key = keys; *key; ++key) {
+        /* values already received from their source are newer. */
+
+        if (!n_context_is_subscribed (context, *key, value_changed_cb) ||
+            n_context_get_value (context, *key))
+            continue;
+
+        value = n_value_new ();
+
+        switch (type) {
+            case N_VALUE_TYPE_STRING: {
+                gchar *str = g_key_file_get_string (keyfile, group, *key, &error);
+                n_value_set_string (value, str);
+                g_free (str);
+                break;
+            }
+            case N_VALUE_TYPE_INT:
+                n_value_set_int (value, g_key_file_get_integer (keyfile, group, *key, &error));
+                break;
+            case N_VALUE_TYPE_UINT:
+                n_value_set_uint (value, (guint) g_key_file_get_uint64 (keyfile, group, *key, &error));
+                break;
+            case N_VALUE_TYPE_BOOL:
+                n_value_set_bool (value, g_key_file_get_boolean (keyfile, group, *key, &error));
+                break;
+            default:
+                break;
+        }
+
+        if (error) {
+            N_WARNING (LOG_CAT "invalid stored value for '%s': %s", *key, error->message);
+            g_clear_error (&error);
+            n_value_free (value);
+            continue;
+        }
+
+        N_DEBUG (LOG_CAT "restored value for '%s'", *key);
+        g_hash_table_replace (store->values, g_strdup (*key), n_value_copy (value));
+        n_context_set_value (context, *key, value);
+    }
+
+    g_strfreev (keys);
+}
+
+NContextStore*
+n_context_store_new (NCore *core)
+{
+    NContextStore *store;
+
+    store = g_new0 (NContextStore, 1);
+    store->core   = core;
+    store->values = g_hash_table_new_full (g_str_hash, g_str_equal,
+        g_free, (GDestroyNotify) n_value_free);
+
+    return store;
+}
+
+void
+n_context_store_free (NContextStore *store)
+{
+    g_assert (store != NULL);
+
+    n_context_store_flush (store);
+    subscribe (store, FALSE);
+
+    g_hash_table_destroy (store->values);
+    g_strfreev (store->keys);
+    g_free (store->path);
+    g_free (store);
+}
+
+void
+n_context_store_configure (NContextStore *store, const char *path,
+                           gchar **keys, guint write_delay, guint max_age)
+{
+    g_assert (store != NULL);
+
+    subscribe (store, FALSE);
+
+    g_free (store->path);
+    g_strfreev (store->keys);
+
+    store->path        = g_strdup (path);
+    store->keys        = g_strdupv (keys);
+    store->write_delay = write_delay;
+    store->max_age     = max_age;
+}
+
+void
+n_context_store_restore (NContextStore *store)
+{
+    NContext *context = NULL;
+    GKeyFile *keyfile = NULL;
+    GError   *error   = NULL;
+
+    g_assert (store != NULL);
+
+    if (!store->path || !store->keys)
+        return;
+
+    keyfile = g_key_file_new ();
+    context = n_core_get_context (store->core);
+
+    /* the subscriptions tell which stored keys are persisted. */
+
+    subscribe (store, TRUE);
+
+    if (!g_key_file_load_from_file (keyfile, store->path, G_KEY_FILE_NONE, &error)) {
+        N_DEBUG (LOG_CAT "no stored context: %s", error->message);
+        g_error_free (error);
+    } else if (state_is_valid (store, keyfile)) {
+        N_DEBUG (LOG_CAT "restoring context from '%s'", store->path);
+
+        store->restoring = TRUE;
+        n_context_begin (context);
+        restore_group (store, keyfile, GROUP_STRING, N_VALUE_TYPE_STRING);
+        restore_group (store, keyfile, GROUP_INT,    N_VALUE_TYPE_INT);
+        restore_group (store, keyfile, GROUP_UINT,   N_VALUE_TYPE_UINT);
+        restore_group (store, keyfile, GROUP_BOOL,   N_VALUE_TYPE_BOOL);
+        n_context_commit (context);
+        store->restoring = FALSE;
+    }
+
+    g_key_file_free (keyfile);
+}
+
+void
+n_context_store_flush (NContextStore *store)
+{
+    g_assert (store != NULL);
+
+    if (store->write_id == 0)
+        return;
+
+    g_source_remove (store->write_id);
+    store->write_id = 0;
+    write_state (store);
+}
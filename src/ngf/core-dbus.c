@@ -35,13 +35,14 @@ typedef struct n_dbus_bus {
     int             ref;
     DBusConnection *connection;
     gboolean        filter_set;
+    GHashTable     *signals;    /* interface -> member -> path -> n_dbus_match */
 } n_dbus_bus;
 
 struct NDBusHelper {
     NCore          *core;
     guint           id_counter;
     n_dbus_bus      bus[2];
-    GHashTable     *matches;
+    GList          *matches;
 };
 
 typedef struct n_dbus_cb {
@@ -53,6 +54,9 @@ typedef struct n_dbus_cb {
 typedef struct n_dbus_match {
     NDBusHelper    *dbus;
     DBusBusType     type;
+    GQuark          iface;
+    GQuark          member;
+    GQuark          path;
     char           *match_str;
     GSList         *callbacks;
 } n_dbus_match;
@@ -64,6 +68,11 @@ typedef struct n_dbus_call {
     void           *userdata;
 } n_dbus_call;
 
+/* Signal index keys are quarks of interned strings, quark 0 stands for a
+ * component left out of the match (any value matches). At most two keys
+ * are tried per level, so a signal touches at most 2 * 2 * 2 matches. */
+#define MAX_SIGNAL_MATCHES (8)
+
 static char*
 build_match_string (const char *iface, const char *path, const char *member)
 {
@@ -88,39 +97,136 @@ bus_str (DBusBusType type)
     return "session";
 }
 
+static GHashTable*
+signal_table_new (GDestroyNotify value_destroy)
+{
+    return g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, value_destroy);
+}
+
+static n_dbus_match*
+signal_index_lookup (n_dbus_bus *bus, GQuark iface, GQuark member, GQuark path)
+{
+    GHashTable *members;
+    GHashTable *paths;
+
+    if (!(members = g_hash_table_lookup (bus->signals, GUINT_TO_POINTER (iface))))
+        return NULL;
+
+    if (!(paths = g_hash_table_lookup (members, GUINT_TO_POINTER (member))))
+        return NULL;
+
+    return g_hash_table_lookup (paths, GUINT_TO_POINTER (path));
+}
+
+static void
+signal_index_add (n_dbus_bus *bus, n_dbus_match *match)
+{
+    GHashTable *members;
+    GHashTable *paths;
+
+    if (!(members = g_hash_table_lookup (bus->signals, GUINT_TO_POINTER (match->iface)))) {
+        members = signal_table_new ((GDestroyNotify) g_hash_table_destroy);
+        g_hash_table_insert (bus->signals, GUINT_TO_POINTER (match->iface), members);
+    }
+
+    if (!(paths = g_hash_table_lookup (members, GUINT_TO_POINTER (match->member)))) {
+        paths = signal_table_new (NULL);
+        g_hash_table_insert (members, GUINT_TO_POINTER (match->member), paths);
+    }
+
+    g_hash_table_insert (paths, GUINT_TO_POINTER (match->path), match);
+}
+
+static void
+signal_index_remove (n_dbus_bus *bus, n_dbus_match *match)
+{
+    GHashTable *members;
+    GHashTable *paths;
+
+    if (!(members = g_hash_table_lookup (bus->signals, GUINT_TO_POINTER (match->iface))))
+        return;
+
+    if (!(paths = g_hash_table_lookup (members, GUINT_TO_POINTER (match->member))))
+        return;
+
+    g_hash_table_remove (paths, GUINT_TO_POINTER (match->path));
+
+    if (g_hash_table_size (paths) == 0)
+        g_hash_table_remove (members, GUINT_TO_POINTER (match->member));
+
+    if (g_hash_table_size (members) == 0)
+        g_hash_table_remove (bus->signals, GUINT_TO_POINTER (match->iface));
+}
+
+/* Collect tables or matches stored under the exact key and under the
+ * wildcard key. Strings never interned can only match the wildcard, so
+ * g_quark_try_string () rejects them without allocating. */
+static guint
+signal_level_lookup (GHashTable *table, const char *str, gpointer *found)
+{
+    GQuark   quark;
+    gpointer value;
+    guint    count = 0;
+
+    if ((quark = g_quark_try_string (str)) &&
+        (value = g_hash_table_lookup (table, GUINT_TO_POINTER (quark))))
+        found[count++] = value;
+
+    if ((value = g_hash_table_lookup (table, GUINT_TO_POINTER (0))))
+        found[count++] = value;
+
+    return count;
+}
+
 static DBusHandlerResult
 filter_cb (DBusConnection *connection, DBusMessage *msg, void *userdata)
 {
     NDBusHelper    *dbus = userdata;
-    n_dbus_match   *match;
-    char           *match_str = NULL;
-    const char     *iface;
-    const char     *path;
-    const char     *member;
-    GSList         *i;
+    n_dbus_bus     *bus  = NULL;
+    gpointer        members[2];
+    gpointer        paths[2];
+    gpointer        found[2];
+    n_dbus_match   *matches[MAX_SIGNAL_MATCHES];
+    guint           num_members;
+    guint           num_paths;
+    guint           num_found;
+    guint           num_matches = 0;
+    guint           i, j, k;
+    GSList         *l;
     int             ret = DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 
-    iface  = dbus_message_get_interface (msg);
-    path   = dbus_message_get_path (msg);
-    member = dbus_message_get_member (msg);
+    if (dbus_message_get_type (msg) != DBUS_MESSAGE_TYPE_SIGNAL)
+        return ret;
 
-    if ((!iface && !path && !member) || dbus_message_get_type (msg) != DBUS_MESSAGE_TYPE_SIGNAL)
-        goto done;
+    if (connection == dbus->bus[DBUS_BUS_SYSTEM].connection)
+        bus = &dbus->bus[DBUS_BUS_SYSTEM];
+    else if (connection == dbus->bus[DBUS_BUS_SESSION].connection)
+        bus = &dbus->bus[DBUS_BUS_SESSION];
+    else
+        return ret;
 
-    match_str = build_match_string (iface, path, member);
+    num_members = signal_level_lookup (bus->signals, dbus_message_get_interface (msg), members);
 
-    if (!(match = g_hash_table_lookup (dbus->matches, match_str)))
-        goto done;
+    for (i = 0; i < num_members; i++) {
+        num_paths = signal_level_lookup (members[i], dbus_message_get_member (msg), paths);
+
+        for (j = 0; j < num_paths; j++) {
+            num_found = signal_level_lookup (paths[j], dbus_message_get_path (msg), found);
 
-    for (i = match->callbacks; i; i = i->next) {
-        n_dbus_cb *cb = i->data;
-        int r;
-        if ((r = cb->cb (dbus->core, connection, msg, cb->userdata)) != DBUS_HANDLER_RESULT_NOT_YET_HANDLED)
-            ret = r;
+            for (k = 0; k < num_found; k++)
+                matches[num_matches++] = found[k];
+        }
+    }
+
+    for (i = 0; i < num_matches; i++) {
+        for (l = matches[i]->callbacks; l; l = l->next) {
+            n_dbus_cb *cb = l->data;
+            int r;
+            if ((r = cb->cb (dbus->core, connection, msg, cb->userdata)) != DBUS_HANDLER_RESULT_NOT_YET_HANDLED)
+                ret = r;
+        }
     }
 
-done:
-    g_free (match_str);
     return ret;
 }
 
@@ -221,9 +327,8 @@ match_remove_callback (n_dbus_match *match, n_dbus_cb *cb)
 }
 
 static void
-match_remove_full (gpointer userdata)
+match_remove_full (n_dbus_match *match)
 {
-    n_dbus_match    *match = userdata;
     n_dbus_cb       *cb;
     GSList          *i;
 
@@ -233,6 +338,9 @@ match_remove_full (gpointer userdata)
         match_remove_callback (match, cb);
     }
 
+    signal_index_remove (&match->dbus->bus[match->type], match);
+    match->dbus->matches = g_list_remove (match->dbus->matches, match);
+
     g_assert (match->dbus->bus[match->type].connection);
 
     dbus_bus_remove_match (match->dbus->bus[match->type].connection,
@@ -251,8 +359,8 @@ n_dbus_helper_new (NCore *core)
 
     dbus            = g_new0 (NDBusHelper, 1);
     dbus->core      = core;
-    dbus->matches   = g_hash_table_new_full (g_str_hash, g_str_equal,
-                                             NULL, match_remove_full);
+    dbus->bus[DBUS_BUS_SYSTEM].signals  = signal_table_new ((GDestroyNotify) g_hash_table_destroy);
+    dbus->bus[DBUS_BUS_SESSION].signals = signal_table_new ((GDestroyNotify) g_hash_table_destroy);
 
     return dbus;
 }
@@ -262,7 +370,11 @@ n_dbus_helper_free (NDBusHelper *dbus)
 {
     g_assert (dbus);
 
-    g_hash_table_destroy (dbus->matches);
+    while (dbus->matches)
+        match_remove_full (dbus->matches->data);
+
+    g_hash_table_destroy (dbus->bus[DBUS_BUS_SYSTEM].signals);
+    g_hash_table_destroy (dbus->bus[DBUS_BUS_SESSION].signals);
     g_assert (dbus->bus[DBUS_BUS_SYSTEM].ref == 0);
     g_assert (!dbus->bus[DBUS_BUS_SYSTEM].connection);
     g_assert (dbus->bus[DBUS_BUS_SESSION].ref == 0);
@@ -281,7 +393,9 @@ n_dbus_add_match (NCore            *core,
 {
     n_dbus_match   *match;
     DBusConnection *connection;
-    char           *match_str;
+    GQuark          iface_quark;
+    GQuark          member_quark;
+    GQuark          path_quark;
     int             id;
 
     g_assert (core);
@@ -292,18 +406,25 @@ n_dbus_add_match (NCore            *core,
         return 0;
     }
 
-    match_str = build_match_string (iface, path, member);
+    iface_quark  = iface  ? g_quark_from_string (iface)  : 0;
+    member_quark = member ? g_quark_from_string (member) : 0;
+    path_quark   = path   ? g_quark_from_string (path)   : 0;
 
-    if (!(match = g_hash_table_lookup (core->dbus->matches, match_str))) {
-        N_DEBUG (LOG_CAT "new match '%s'", match_str);
+    if (!(match = signal_index_lookup (&core->dbus->bus[type],
+                                       iface_quark, member_quark, path_quark))) {
         match           = g_new0 (n_dbus_match, 1);
         match->type     = type;
         match->dbus     = core->dbus;
-        match->match_str= match_str;
+        match->iface    = iface_quark;
+        match->member   = member_quark;
+        match->path     = path_quark;
+        match->match_str= build_match_string (iface, path, member);
+        N_DEBUG (LOG_CAT "new match '%s'", match->match_str);
         dbus_bus_add_match (connection, match->match_str, NULL);
-        g_hash_table_insert (core->dbus->matches, match->match_str, match);
+        signal_index_add (&core->dbus->bus[type], match);
+        core->dbus->matches = g_list_prepend (core->dbus->matches, match);
     } else
-        g_free (match_str);
+        connection_unref (core->dbus, type);
 
     id = ++core->dbus->id_counter;
     match_add_callback (match, id, cb, userdata);
@@ -314,38 +435,29 @@ n_dbus_add_match (NCore            *core,
 static gboolean
 dbus_remove_match (NCore *core, guint match_id, NDBusFilterFunc match_cb)
 {
-    GHashTableIter  iter;
-    gpointer        key, value;
+    GList          *m;
     GSList         *i;
     n_dbus_match   *match   = NULL;
-    gboolean        removed = FALSE;
 
     g_assert (core);
     g_assert (core->dbus);
 
-    g_hash_table_iter_init (&iter, core->dbus->matches);
-
-    while (g_hash_table_iter_next (&iter, &key, &value)) {
-        match = value;
+    for (m = core->dbus->matches; m; m = m->next) {
+        match = m->data;
         for (i = match->callbacks; i; i = i->next) {
             n_dbus_cb *cb = i->data;
 
             if ((match_id && cb->id == match_id) ||
                 (match_cb && cb->cb == match_cb)) {
                 match_remove_callback (match, cb);
-                removed = TRUE;
-                break;
+                if (!match->callbacks)
+                    match_remove_full (match);
+                return TRUE;
             }
         }
-
-        if (removed)
-            break;
     }
 
-    if (match && !match->callbacks)
-        g_hash_table_remove (core->dbus->matches, match->match_str);
-
-    return removed;
+    return FALSE;
 }
 
 void n_dbus_remove_match_by_id (NCore *core, guint match_id)
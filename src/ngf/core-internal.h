@@ -36,6 +36,45 @@
 #include "context-internal.h"
 #include "core-dbus-internal.h"
 #include "haptic-internal.h"
+#include "loadmonitor-internal.h"
+#include "worker-internal.h"
+#include "contextstore-internal.h"
+#include "startupprofile-internal.h"
+#include "idletrim-internal.h"
+
+/* request filter of a hook slot, see n_core_connect_filtered */
+typedef struct _NCoreFilter
+{
+    NCoreHook         hook;
+    GHashTable       *events;               /* event names, NULL for any */
+    gchar           **keys;                 /* property keys, NULL for any */
+} NCoreFilter;
+
+/* configuration of a plugin from plugins.d */
+typedef struct _NPluginConf
+{
+    NProplist        *params;               /* merged parameters */
+    NProplist        *keytypes;             /* key -> type name */
+} NPluginConf;
+
+/* plugin loaded the first time a request has one of its keys */
+typedef struct _NLazyPlugin
+{
+    gchar            *name;
+    gchar           **keys;                 /* property keys handled by the sinks of the plugin */
+    NProplist        *params;               /* plugin parameters, read at startup for keytypes */
+    gboolean          required;
+    NPlugin          *plugin;               /* set once loaded */
+} NLazyPlugin;
+
+/* plugin waiting for its requests to be done before it is reloaded */
+typedef struct _NPluginReload
+{
+    NCore            *core;
+    NPlugin          *plugin;
+    guint             source_id;
+    gboolean          unloaded;             /* unload called, module still open */
+} NPluginReload;
 
 struct _NCore
 {
@@ -46,25 +85,50 @@ struct _NCore
     GList            *required_plugins;     /* plugins to load (required) */
     GList            *optional_plugins;     /* plugins to load (loading may fail, and won't disturb operation) */
     GList            *plugins;              /* NPlugin* */
+    GList            *lazy_plugins;         /* NLazyPlugin*, plugins not loaded yet */
+    GList            *lazy_starting;        /* NLazyPlugin*, loaded on demand, sinks initializing */
+    GHashTable       *plugin_conf;          /* plugin name -> NPluginConf, only while loading or reloading */
+    GList            *reloads;              /* NPluginReload*, pending plugin reloads */
 
     NSinkInterface  **sinks;                /* sink interfaces registered */
     unsigned int      num_sinks;
     GList            *sink_order;           /* order of sinks */
+    guint             sink_failure_limit;   /* consecutive failures before sink is skipped */
+    guint             sink_probe_interval;  /* interval in ms for probing skipped sinks */
 
     NInputInterface **inputs;               /* input interfaces registered */
     unsigned int      num_inputs;
 
     NContext         *context;              /* global context for broadcasting and sharing values */
+    NContextStore    *context_store;        /* last known context values over restarts */
     NEventList       *eventlist;
 
     NHaptic          *haptic;               /* haptic helper */
     NDBusHelper      *dbus;                 /* dbus helper */
+    NWorkerPool      *workers;              /* threads for blocking sink operations */
 
     GHashTable       *key_types;
+    gchar           **request_key_names;    /* keys set by n_core_set_request_keys, NULL if all */
+    GHashTable       *request_keys;         /* key -> value type, with keys of event rules */
+    GRWLock           request_keys_lock;    /* request_keys is looked up by input threads */
     GList            *requests;             /* active requests */
+    guint             prepare_generation;   /* increased when values cached by prepared requests may be stale */
+    guint             context_serial;       /* increased for each changed context value */
+    GHashTable       *context_changes;      /* key -> serial of the latest change of the key */
+
+    NLoadMonitor     *load_monitor;         /* main loop lag monitor */
+    GList            *deferred_requests;    /* requests waiting for main loop lag to drop */
+    gint              protected_priority;   /* requests of this priority or higher are never deferred or dropped */
+    guint             max_defer;            /* ms a request may stay deferred before it is dropped */
+
+    NIdleTrim        *idle_trim;            /* memory release when idle */
 
     NHook             hooks[N_CORE_HOOK_LAST];
 
+    NStartupProfile  *startup_profile;      /* startup phase timing, NULL if disabled */
+
+    gboolean          sinks_started;        /* initialize of all sinks has been called */
+    gboolean          init_done;            /* all sinks and inputs initialized */
     gboolean          shutdown_done;        /* shutdown has been run. */
 };
 
@@ -76,8 +140,14 @@ void      n_core_shutdown         (NCore *core);
 
 void      n_core_register_sink    (NCore *core, const NSinkInterfaceDecl *iface);
 void      n_core_register_input   (NCore *core, const NInputInterfaceDecl *iface);
+void      n_core_sink_initialized (NCore *core, NSinkInterface *sink, int success);
+int       n_core_load_lazy_plugins (NCore *core, NRequest *request);
+gboolean  n_core_lazy_sinks_pending (NCore *core, NRequest *request);
+void      n_core_reload_changed_plugins (NCore *core);
 void      n_core_add_event        (NCore *core, NEvent *event);
 NEvent*   n_core_evaluate_request (NCore *core, NRequest *request);
+void      n_core_invalidate_prepared (NCore *core);
+gboolean  n_core_context_changed_since (NCore *core, gchar **keys, guint serial);
 
 void      n_core_fire_hook        (NCore *core, NCoreHook hook, void *data);
 
@@ -26,6 +26,18 @@
 #define FALLBACK_SUFFIX ".fallback"
 #define MAX_TIMEOUT_KEY "core.max_timeout"
 #define POLICY_TIMEOUT_KEY "play.timeout"
+#define PRIORITY_KEY    "core.priority"
+#define MAX_SINK_LATENCY_MS (1000)
+#define MAX_SINK_WAIT_MS    (3000)  /* waiting for sinks loaded on demand */
+
+typedef struct _NCorePlayDelay
+{
+    NRequest       *request;
+    NSinkInterface *sink;
+    gint64          target;         /* monotonic time when play is due */
+    gint64          remaining;      /* time left when held by pause, in us */
+    guint           source_id;      /* 0 while held */
+} NCorePlayDelay;
 
 static gboolean n_core_max_timeout_reached_cb         (gpointer userdata);
 static void     n_core_setup_max_timeout              (NRequest *request);
@@ -35,13 +47,40 @@ static void     n_core_fire_transform_properties_hook (NRequest *request);
 static GList*   n_core_fire_filter_sinks_hook         (NRequest *request, GList *sinks);
 static GList*   n_core_query_capable_sinks            (NRequest *request);
 static void     n_core_merge_request_properties       (NRequest *request, NEvent *event);
+static gboolean n_core_prepared_is_valid              (NCore *core, NPreparedRequest *prepared);
 
 static void     n_core_send_reply               (NRequest *request, NCorePlayerState status);
 static void     n_core_send_error               (NRequest *request, const char *err_msg);
 static int      n_core_sink_in_list             (GList *sinks, NSinkInterface *sink);
 static int      n_core_sink_priority_cmp        (gconstpointer in_a, gconstpointer in_b);
+static const char* n_core_breaker_state_name    (NSinkBreakerState state);
+static void     n_core_set_sink_breaker         (NSinkInterface *sink, NSinkBreakerState state);
+static gboolean n_core_sink_probe_cb            (gpointer userdata);
+static void     n_core_sink_failed              (NSinkInterface *sink);
+static void     n_core_sink_succeeded           (NSinkInterface *sink);
+static void     n_core_fail_request_by_sink     (NSinkInterface *sink, NRequest *request,
+                                                 gboolean sink_fault);
+static guint    n_core_query_sink_latency       (NSinkInterface *sink, NRequest *request);
+static int      n_core_play_sink                (NCore *core, NSinkInterface *sink, NRequest *request);
+static gboolean n_core_delayed_play_cb          (gpointer userdata);
+static void     n_core_delay_play               (NRequest *request, NSinkInterface *sink, guint delay_ms);
+static void     n_core_clear_play_delays        (NRequest *request);
+static void     n_core_hold_play_delays         (NRequest *request);
+static void     n_core_release_play_delays      (NRequest *request);
+static gboolean n_core_sink_play_delayed        (NRequest *request, NSinkInterface *sink);
 static gboolean n_core_sink_synchronize_done_cb (gpointer userdata);
 static gboolean n_core_request_done_cb          (gpointer userdata);
+static gint     n_core_request_priority         (NRequest *request);
+static int      n_core_start_request            (NRequest *request);
+static void     n_core_shed_request             (NRequest *request);
+static void     n_core_defer_request            (NRequest *request);
+static void     n_core_undefer_request          (NRequest *request);
+static gboolean n_core_deferred_timeout_cb      (gpointer userdata);
+static void     n_core_wait_for_sinks           (NRequest *request);
+static gboolean n_core_sink_wait_timeout_cb     (gpointer userdata);
+static void     n_core_group_synchronized       (NRequest *group);
+static gboolean n_core_group_start_cb           (gpointer userdata);
+static void     n_core_group_member_done        (NRequest *request, gboolean failed);
 static void     n_core_stop_sinks               (GList *sinks, NRequest *request);
 static int      n_core_prepare_sinks            (GList *sinks, NRequest *request);
 
@@ -135,7 +174,22 @@ n_core_query_capable_sinks (NRequest *request)
     GList           *sinks = NULL;
     NSinkInterface **iter  = NULL;
 
+    /* load the plugins whose sinks handle the request. */
+
+    (void) n_core_load_lazy_plugins (core, request);
+
     for (iter = core->sinks; *iter; ++iter) {
+        if ((*iter)->init_state != N_SINK_INIT_READY) {
+            N_DEBUG (LOG_CAT "sink '%s' skipped, not initialized", (*iter)->name);
+            continue;
+        }
+
+        if ((*iter)->breaker == N_SINK_BREAKER_OPEN) {
+            N_DEBUG (LOG_CAT "sink '%s' skipped, circuit breaker open (%u failures)",
+                (*iter)->name, (*iter)->failures);
+            continue;
+        }
+
         if ((*iter)->funcs.can_handle && !(*iter)->funcs.can_handle (*iter, request))
             continue;
 
@@ -160,10 +214,106 @@ n_core_merge_request_properties (NRequest *request, NEvent *event)
     request->properties = copy;
 }
 
+static gboolean
+n_core_prepared_is_valid (NCore *core, NPreparedRequest *prepared)
+{
+    return prepared->event && prepared->generation == core->prepare_generation &&
+        !n_core_context_changed_since (core, prepared->context_keys, prepared->context_serial);
+}
+
+gboolean
+n_core_update_prepared (NCore *core, NPreparedRequest *prepared)
+{
+    g_assert (core != NULL);
+    g_assert (prepared != NULL);
+
+    NRequest *request = NULL;
+    GList    *sinks   = NULL;
+
+    if (n_core_prepared_is_valid (core, prepared))
+        return TRUE;
+
+    n_prepared_request_clear (prepared);
+
+    /* resolve a copy, the template keeps the properties as given so that
+       the request can be resolved again after context changes. */
+
+    request       = n_request_copy (prepared->template);
+    request->core = core;
+
+    prepared->context_serial = core->context_serial;
+
+    if (!(request->event = n_core_evaluate_request (core, request))) {
+        N_WARNING (LOG_CAT "unable to resolve event for prepared request '%s'",
+            request->name);
+        n_request_free (request);
+        return FALSE;
+    }
+
+    n_core_fire_new_request_hook (request);
+    n_core_merge_request_properties (request, request->event);
+    n_core_fire_transform_properties_hook (request);
+
+    sinks = n_core_query_capable_sinks (request);
+    sinks = n_core_fire_filter_sinks_hook (request, sinks);
+
+    N_DEBUG (LOG_CAT "prepared request '%s' resolved to event '%s' with %u sink(s)",
+        request->name, request->event->name, g_list_length (sinks));
+
+    /* keys read by the hooks and sinks while resolving, and by the rules
+       of all events of the name, since other rules may match later. */
+
+    if (!request->context_keys)
+        request->context_keys = g_ptr_array_new_with_free_func (g_free);
+    n_event_list_add_context_keys (core->eventlist, request->name, request->context_keys);
+    g_ptr_array_add (request->context_keys, NULL);
+    prepared->context_keys = (gchar**) g_ptr_array_free (request->context_keys, FALSE);
+    request->context_keys  = NULL;
+
+    /* lazy plugins loaded while querying the sinks increase the generation,
+       so it is stored only now. */
+
+    prepared->event      = request->event;
+    prepared->properties = request->properties;
+    prepared->sinks      = sinks;
+    prepared->generation = core->prepare_generation;
+
+    request->properties = NULL;
+    n_request_free (request);
+
+    return TRUE;
+}
+
+NRequest*
+n_core_new_prepared_request (NCore *core, NPreparedRequest *prepared)
+{
+    g_assert (core != NULL);
+    g_assert (prepared != NULL);
+
+    NRequest *request = NULL;
+
+    request              = n_request_new ();
+    request->name        = g_strdup (prepared->template->name);
+    request->properties  = n_proplist_copy (prepared->template->properties);
+    request->input_iface = prepared->template->input_iface;
+    request->prepared    = n_prepared_request_ref (prepared);
+
+    return request;
+}
+
 static void
 n_core_send_reply (NRequest *request, NCorePlayerState status)
 {
     g_assert (request != NULL);
+
+    /* group members report only through the group. */
+
+    if (request->group) {
+        if (status == N_CORE_EVENT_COMPLETED)
+            n_core_group_member_done (request, FALSE);
+        return;
+    }
+
     g_assert (request->input_iface != NULL);
 
     if (request->input_iface->funcs.send_reply) {
@@ -176,6 +326,13 @@ static void
 n_core_send_error (NRequest *request, const char *err_msg)
 {
     g_assert (request != NULL);
+
+    if (request->group) {
+        N_DEBUG (LOG_CAT "group member '%s' failed: %s", request->name, err_msg);
+        n_core_group_member_done (request, TRUE);
+        return;
+    }
+
     g_assert (request->input_iface != NULL);
 
     if (request->input_iface->funcs.send_error) {
@@ -207,41 +364,284 @@ n_core_sink_priority_cmp (gconstpointer in_a, gconstpointer in_b)
     return 0;
 }
 
+static const char*
+n_core_breaker_state_name (NSinkBreakerState state)
+{
+    switch (state) {
+        case N_SINK_BREAKER_CLOSED:
+            return "closed";
+        case N_SINK_BREAKER_OPEN:
+            return "open";
+        case N_SINK_BREAKER_HALF_OPEN:
+            return "half-open";
+    }
+
+    return "unknown";
+}
+
+static void
+n_core_set_sink_breaker (NSinkInterface *sink, NSinkBreakerState state)
+{
+    g_assert (sink != NULL);
+    g_assert (sink->core != NULL);
+
+    if (sink->breaker != state) {
+        N_INFO (LOG_CAT "sink '%s' circuit breaker %s -> %s (%u failures)",
+            sink->name, n_core_breaker_state_name (sink->breaker),
+            n_core_breaker_state_name (state), sink->failures);
+        sink->breaker = state;
+        n_core_invalidate_prepared (sink->core);
+    }
+
+    if (state == N_SINK_BREAKER_OPEN) {
+        if (sink->probe_source == 0)
+            sink->probe_source = g_timeout_add (sink->core->sink_probe_interval,
+                n_core_sink_probe_cb, sink);
+    }
+    else if (sink->probe_source > 0) {
+        g_source_remove (sink->probe_source);
+        sink->probe_source = 0;
+    }
+}
+
+static gboolean
+n_core_sink_probe_cb (gpointer userdata)
+{
+    NSinkInterface *sink = (NSinkInterface*) userdata;
+
+    if (sink->funcs.probe && !sink->funcs.probe (sink)) {
+        N_DEBUG (LOG_CAT "sink '%s' probe failed, circuit breaker stays open",
+            sink->name);
+        return TRUE;
+    }
+
+    sink->probe_source = 0;
+
+    /* without a probe function let the next request try the sink. */
+
+    if (sink->funcs.probe) {
+        sink->failures = 0;
+        n_core_set_sink_breaker (sink, N_SINK_BREAKER_CLOSED);
+    }
+    else
+        n_core_set_sink_breaker (sink, N_SINK_BREAKER_HALF_OPEN);
+
+    return FALSE;
+}
+
+static void
+n_core_sink_failed (NSinkInterface *sink)
+{
+    sink->failures++;
+
+    if (sink->breaker == N_SINK_BREAKER_HALF_OPEN ||
+        sink->failures >= sink->core->sink_failure_limit) {
+        n_core_set_sink_breaker (sink, N_SINK_BREAKER_OPEN);
+        return;
+    }
+
+    N_DEBUG (LOG_CAT "sink '%s' failure %u/%u, circuit breaker %s",
+        sink->name, sink->failures, sink->core->sink_failure_limit,
+        n_core_breaker_state_name (sink->breaker));
+}
+
+static void
+n_core_sink_succeeded (NSinkInterface *sink)
+{
+    if (sink->failures == 0 && sink->breaker == N_SINK_BREAKER_CLOSED)
+        return;
+
+    sink->failures = 0;
+    n_core_set_sink_breaker (sink, N_SINK_BREAKER_CLOSED);
+}
+
+static guint
+n_core_query_sink_latency (NSinkInterface *sink, NRequest *request)
+{
+    guint latency = 0;
+
+    if (!sink->funcs.latency)
+        return 0;
+
+    latency = sink->funcs.latency (sink, request);
+    if (latency > MAX_SINK_LATENCY_MS) {
+        N_WARNING (LOG_CAT "sink '%s' latency %u ms too high, limiting to %d ms",
+            sink->name, latency, MAX_SINK_LATENCY_MS);
+        latency = MAX_SINK_LATENCY_MS;
+    }
+
+    return latency;
+}
+
+static int
+n_core_play_sink (NCore *core, NSinkInterface *sink, NRequest *request)
+{
+    if (!sink->funcs.play (sink, request)) {
+        N_WARNING (LOG_CAT "sink '%s' failed play request '%s'",
+            sink->name, request->name);
+
+        n_core_fail_sink (core, sink, request);
+        return FALSE;
+    }
+
+    if (!sink->funcs.prepare) {
+        if (n_core_sink_in_list (request->stop_list, sink))
+            request->stop_list = g_list_append (request->stop_list, sink);
+    }
+
+    return TRUE;
+}
+
+static gboolean
+n_core_delayed_play_cb (gpointer userdata)
+{
+    NCorePlayDelay *delay   = (NCorePlayDelay*) userdata;
+    NRequest       *request = delay->request;
+    NSinkInterface *sink    = delay->sink;
+
+    N_DEBUG (LOG_CAT "delayed play for sink '%s' (%+" G_GINT64_FORMAT " us from target)",
+        sink->name, g_get_monotonic_time () - delay->target);
+
+    request->play_delays = g_list_remove (request->play_delays, delay);
+    g_slice_free (NCorePlayDelay, delay);
+
+    (void) n_core_play_sink (request->core, sink, request);
+
+    return FALSE;
+}
+
+static void
+n_core_delay_play (NRequest *request, NSinkInterface *sink, guint delay_ms)
+{
+    NCorePlayDelay *delay = NULL;
+
+    delay            = g_slice_new0 (NCorePlayDelay);
+    delay->request   = request;
+    delay->sink      = sink;
+    delay->target    = g_get_monotonic_time () + (gint64) delay_ms * 1000;
+    delay->source_id = g_timeout_add (delay_ms, n_core_delayed_play_cb, delay);
+
+    request->play_delays = g_list_append (request->play_delays, delay);
+}
+
+static void
+n_core_clear_play_delays (NRequest *request)
+{
+    GList          *iter  = NULL;
+    NCorePlayDelay *delay = NULL;
+
+    for (iter = g_list_first (request->play_delays); iter; iter = g_list_next (iter)) {
+        delay = (NCorePlayDelay*) iter->data;
+        if (delay->source_id > 0)
+            g_source_remove (delay->source_id);
+        g_slice_free (NCorePlayDelay, delay);
+    }
+
+    g_list_free (request->play_delays);
+    request->play_delays = NULL;
+}
+
+/* sinks with a pending delayed play have not started yet, pausing keeps
+   the time left until their play and resuming continues from there. */
+
+static void
+n_core_hold_play_delays (NRequest *request)
+{
+    GList          *iter  = NULL;
+    NCorePlayDelay *delay = NULL;
+    gint64          now   = g_get_monotonic_time ();
+
+    for (iter = g_list_first (request->play_delays); iter; iter = g_list_next (iter)) {
+        delay = (NCorePlayDelay*) iter->data;
+        if (delay->source_id == 0)
+            continue;
+
+        g_source_remove (delay->source_id);
+        delay->source_id = 0;
+        delay->remaining = MAX (delay->target - now, 0);
+
+        N_DEBUG (LOG_CAT "holding delayed play for sink '%s', %" G_GINT64_FORMAT " us left",
+            delay->sink->name, delay->remaining);
+    }
+}
+
+static void
+n_core_release_play_delays (NRequest *request)
+{
+    GList          *iter  = NULL;
+    NCorePlayDelay *delay = NULL;
+    gint64          now   = g_get_monotonic_time ();
+
+    for (iter = g_list_first (request->play_delays); iter; iter = g_list_next (iter)) {
+        delay = (NCorePlayDelay*) iter->data;
+        if (delay->source_id > 0)
+            continue;
+
+        delay->target    = now + delay->remaining;
+        delay->source_id = g_timeout_add ((guint) (delay->remaining / 1000),
+            n_core_delayed_play_cb, delay);
+    }
+}
+
+static gboolean
+n_core_sink_play_delayed (NRequest *request, NSinkInterface *sink)
+{
+    GList *iter = NULL;
+
+    for (iter = g_list_first (request->play_delays); iter; iter = g_list_next (iter)) {
+        if (((NCorePlayDelay*) iter->data)->sink == sink)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
 static gboolean
 n_core_sink_synchronize_done_cb (gpointer userdata)
 {
-    NRequest       *request   = (NRequest*) userdata;
-    NCore          *core      = request->core;
-    GList          *iter      = NULL;
-    NSinkInterface *sink      = NULL;
+    NRequest       *request     = (NRequest*) userdata;
+    NCore          *core        = request->core;
+    GList          *iter        = NULL;
+    NSinkInterface *sink        = NULL;
+    guint          *latency     = NULL;
+    guint           max_latency = 0;
+    guint           i           = 0;
 
     /* setup the maximum timeout callback. */
     n_core_setup_max_timeout (request);
 
-    /* all sinks have been synchronized for the request. call play for every
-       prepared sink. */
+    /* all sinks have been synchronized for the request. query the output
+       latency of every prepared sink, the sink with the highest latency is
+       played first and the rest are delayed so that output of all sinks
+       starts at the same time. */
 
     request->play_source_id = 0;
-    for (iter = g_list_first (request->sinks_prepared); iter; iter = g_list_next (iter)) {
-        sink = (NSinkInterface*) iter->data;
 
-        if (!sink->funcs.play (sink, request)) {
-            N_WARNING (LOG_CAT "sink '%s' failed play request '%s'",
-                sink->name, request->name);
+    latency = g_new0 (guint, g_list_length (request->sinks_prepared));
+    for (iter = g_list_first (request->sinks_prepared), i = 0; iter; iter = g_list_next (iter), ++i) {
+        latency[i] = n_core_query_sink_latency ((NSinkInterface*) iter->data, request);
+        if (latency[i] > max_latency)
+            max_latency = latency[i];
+    }
 
-            n_core_fail_sink (core, sink, request);
-            return FALSE;
-        }
+    for (iter = g_list_first (request->sinks_prepared), i = 0; iter; iter = g_list_next (iter), ++i) {
+        sink = (NSinkInterface*) iter->data;
 
-        if (!sink->funcs.prepare) {
-            if (n_core_sink_in_list (request->stop_list, sink))
-                request->stop_list = g_list_append (request->stop_list, sink);
+        if (latency[i] < max_latency) {
+            N_DEBUG (LOG_CAT "sink '%s' latency %u ms, delaying play by %u ms",
+                sink->name, latency[i], max_latency - latency[i]);
+            n_core_delay_play (request, sink, max_latency - latency[i]);
+        } else if (!n_core_play_sink (core, sink, request)) {
+            g_free (latency);
+            return FALSE;
         }
 
         request->sinks_playing = g_list_append (request->sinks_playing,
             sink);
     }
 
+    g_free (latency);
+
     g_list_free (request->sinks_prepared);
     request->sinks_prepared = NULL;
 
@@ -321,10 +721,12 @@ n_find_fallback_cb (const char *key, const NValue *value, gpointer userdata)
 static gboolean
 n_core_request_done_cb (gpointer userdata)
 {
-    NRequest  *request       = (NRequest*) userdata;
-    NRequest  *fallback      = NULL;
-    NCore     *core          = request->core;
-    gboolean   has_fallbacks = FALSE;
+    NRequest       *request       = (NRequest*) userdata;
+    NRequest       *fallback      = NULL;
+    NCore          *core          = request->core;
+    GList          *iter          = NULL;
+    NSinkInterface *sink          = NULL;
+    gboolean        has_fallbacks = FALSE;
 
     /* ensure that maximum timeout is removed. */
     n_core_clear_max_timeout (request);
@@ -334,6 +736,19 @@ n_core_request_done_cb (gpointer userdata)
 
     request->stop_source_id = 0;
     core->requests = g_list_remove (core->requests, request);
+    n_core_undefer_request (request);
+    n_core_clear_play_delays (request);
+
+    /* sinks that got to play a request that did not fail are healthy. */
+
+    if (!request->has_failed) {
+        for (iter = g_list_first (request->all_sinks); iter; iter = g_list_next (iter)) {
+            sink = (NSinkInterface*) iter->data;
+            if (!n_core_sink_in_list (request->sinks_preparing, sink) &&
+                !n_core_sink_in_list (request->sinks_prepared, sink))
+                n_core_sink_succeeded (sink);
+        }
+    }
 
     N_DEBUG (LOG_CAT "stopping all sinks for request '%s'", request->name);
     n_core_stop_sinks (request->stop_list, request);
@@ -345,7 +760,12 @@ n_core_request_done_cb (gpointer userdata)
     g_list_free (request->sinks_preparing);
     g_list_free (request->all_sinks);
 
-    if (request->has_failed && request->is_fallback) {
+    if (request->is_shed) {
+        /* dropped under overload, fallbacks would only add to the load. */
+        n_core_send_error (request, "dropped, main loop overloaded");
+        goto done;
+    }
+    else if (request->has_failed && request->is_fallback) {
         /* if the fallback failed, bail out. */
         n_core_send_error (request, "request failed!");
         goto done;
@@ -379,6 +799,11 @@ n_core_request_done_cb (gpointer userdata)
     fallback              = n_request_copy (request);
     fallback->is_fallback = TRUE;
 
+    if (request->group) {
+        fallback->group = request->group;
+        g_list_find (request->group->members, request)->data = fallback;
+    }
+
     n_request_free (request);
 
     n_core_play_request (core, fallback);
@@ -401,14 +826,31 @@ n_core_play_request (NCore *core, NRequest *request)
     g_assert (core != NULL);
     g_assert (request != NULL);
 
-    GList  *all_sinks = NULL;
-
     /* store the original request properties and default timeout */
 
     request->original_properties = n_proplist_copy (request->properties);
     request->timeout_ms = n_proplist_get_uint (request->properties, POLICY_TIMEOUT_KEY);
     request->core = core;
 
+    n_idle_trim_activity (core->idle_trim);
+
+    /* prepared request reuses the resolved event, properties and sinks. */
+
+    if (request->prepared) {
+        if (!n_core_update_prepared (core, request->prepared)) {
+            request->no_event = TRUE;
+            goto fail_request;
+        }
+
+        request->event = request->prepared->event;
+        n_proplist_free (request->properties);
+        request->properties = n_proplist_copy (request->prepared->properties);
+
+        N_DEBUG (LOG_CAT "request '%s' played from prepared event '%s'",
+            request->name, request->event->name);
+        goto schedule;
+    }
+
     /* evaluate the request and context to resolve the correct event for
        this specific request. if no event, then there is no default event
        defined and we are done here. */
@@ -443,10 +885,64 @@ n_core_play_request (NCore *core, NRequest *request)
 
     n_core_fire_transform_properties_hook (request);
 
-    /* query and filter capable sinks */
+schedule:
+    /* when the main loop is lagging, low priority requests are deferred or
+       dropped so that high priority feedback is still delivered in time. */
+
+    n_load_monitor_wake (core->load_monitor);
+
+    if (n_core_request_priority (request) < core->protected_priority) {
+        switch (n_load_monitor_get_level (core->load_monitor)) {
+            case N_LOAD_LEVEL_SHED:
+                n_core_shed_request (request);
+                return TRUE;
+
+            case N_LOAD_LEVEL_DEFER:
+                n_core_defer_request (request);
+                return TRUE;
+
+            default:
+                break;
+        }
+    }
+
+    return n_core_start_request (request);
+
+fail_request:
+    request->has_failed     = TRUE;
+    request->stop_source_id = g_idle_add (n_core_request_done_cb, request);
+
+    return TRUE;
+}
+
+static int
+n_core_start_request (NRequest *request)
+{
+    NCore *core      = request->core;
+    GList *all_sinks = NULL;
+
+    /* query and filter capable sinks, unless still known from preparing. */
+
+    if (request->prepared && n_core_prepared_is_valid (core, request->prepared)) {
+        all_sinks = g_list_copy (request->prepared->sinks);
+    } else {
+        if (!n_core_load_lazy_plugins (core, request)) {
+            N_WARNING (LOG_CAT "required plugin for request '%s' failed to load",
+                request->name);
+            goto fail_request;
+        }
+
+        /* sinks loaded on demand may still be initializing, the request
+           is started once they are ready. */
+
+        if (!request->sinks_waited && n_core_lazy_sinks_pending (core, request)) {
+            n_core_wait_for_sinks (request);
+            return TRUE;
+        }
 
-    all_sinks = n_core_query_capable_sinks (request);
-    all_sinks = n_core_fire_filter_sinks_hook (request, all_sinks);
+        all_sinks = n_core_query_capable_sinks (request);
+        all_sinks = n_core_fire_filter_sinks_hook (request, all_sinks);
+    }
 
     /* if no sinks left, then nothing to do. */
 
@@ -484,6 +980,223 @@ fail_request:
     return TRUE;
 }
 
+static gint
+n_core_request_priority (NRequest *request)
+{
+    if (!n_proplist_has_key (request->properties, PRIORITY_KEY))
+        return N_CORE_DEFAULT_PRIORITY;
+
+    return n_proplist_get_int (request->properties, PRIORITY_KEY);
+}
+
+static void
+n_core_shed_request (NRequest *request)
+{
+    N_INFO (LOG_CAT "dropping request '%s', main loop lag %u ms",
+        request->name, n_load_monitor_get_lag (request->core->load_monitor));
+
+    request->is_shed        = TRUE;
+    request->has_failed     = TRUE;
+    request->stop_source_id = g_idle_add (n_core_request_done_cb, request);
+}
+
+static void
+n_core_defer_request (NRequest *request)
+{
+    NCore *core = request->core;
+
+    if (core->max_defer == 0) {
+        n_core_shed_request (request);
+        return;
+    }
+
+    N_DEBUG (LOG_CAT "deferring request '%s', main loop lag %u ms",
+        request->name, n_load_monitor_get_lag (core->load_monitor));
+
+    core->deferred_requests  = g_list_append (core->deferred_requests, request);
+    request->defer_source_id = g_timeout_add (core->max_defer,
+        n_core_deferred_timeout_cb, request);
+}
+
+static void
+n_core_undefer_request (NRequest *request)
+{
+    NCore *core = request->core;
+
+    if (request->defer_source_id > 0) {
+        g_source_remove (request->defer_source_id);
+        request->defer_source_id = 0;
+    }
+
+    core->deferred_requests = g_list_remove (core->deferred_requests, request);
+}
+
+static gboolean
+n_core_deferred_timeout_cb (gpointer userdata)
+{
+    NRequest *request = (NRequest*) userdata;
+
+    request->defer_source_id = 0;
+    n_core_undefer_request (request);
+    n_core_shed_request (request);
+
+    return FALSE;
+}
+
+static void
+n_core_wait_for_sinks (NRequest *request)
+{
+    NCore *core = request->core;
+
+    N_DEBUG (LOG_CAT "request '%s' waiting for sinks to initialize",
+        request->name);
+
+    /* waiting requests are kept with the deferred ones, so that stopping
+       and shutdown handle them the same way. */
+
+    request->waits_for_sinks = TRUE;
+    core->deferred_requests  = g_list_append (core->deferred_requests, request);
+    request->defer_source_id = g_timeout_add (MAX_SINK_WAIT_MS,
+        n_core_sink_wait_timeout_cb, request);
+}
+
+static gboolean
+n_core_sink_wait_timeout_cb (gpointer userdata)
+{
+    NRequest *request = (NRequest*) userdata;
+
+    N_WARNING (LOG_CAT "sinks for request '%s' not ready in time, starting without them",
+        request->name);
+
+    request->defer_source_id = 0;
+    n_core_undefer_request (request);
+    request->waits_for_sinks = FALSE;
+    request->sinks_waited    = TRUE;
+
+    (void) n_core_start_request (request);
+
+    return FALSE;
+}
+
+static void
+n_core_group_synchronized (NRequest *group)
+{
+    GList    *iter   = NULL;
+    NRequest *member = NULL;
+
+    if (group->play_source_id > 0)
+        return;
+
+    for (iter = g_list_first (group->members); iter; iter = g_list_next (iter)) {
+        member = (NRequest*) iter->data;
+        if (member->sinks_preparing || !member->sinks_prepared)
+            return;
+    }
+
+    N_DEBUG (LOG_CAT "all requests of group '%s' have been synchronized",
+        group->name);
+
+    group->play_source_id = g_idle_add (n_core_group_start_cb, group);
+}
+
+static gboolean
+n_core_group_start_cb (gpointer userdata)
+{
+    NRequest *group   = (NRequest*) userdata;
+    GList    *members = NULL;
+    GList    *iter    = NULL;
+    NRequest *member  = NULL;
+
+    group->play_source_id  = 0;
+    group->members_started = TRUE;
+
+    /* all members are synchronized and start now. reply before starting
+       them, a member failing to start may complete the group. */
+
+    n_core_send_reply (group, N_CORE_EVENT_PLAYING);
+
+    /* starting a member may fail and remove it from the group. */
+
+    members = g_list_copy (group->members);
+    for (iter = g_list_first (members); iter; iter = g_list_next (iter)) {
+        member = (NRequest*) iter->data;
+        if (member->stop_source_id == 0)
+            n_core_sink_synchronize_done_cb (member);
+    }
+    g_list_free (members);
+
+    return FALSE;
+}
+
+static void
+n_core_group_member_done (NRequest *request, gboolean failed)
+{
+    NRequest *group = request->group;
+    NCore    *core  = group->core;
+    GList    *iter  = NULL;
+
+    request->group = NULL;
+    group->members = g_list_remove (group->members, request);
+
+    if (failed) {
+        group->has_failed = TRUE;
+
+        /* group starts as a whole or not at all. */
+
+        if (!group->members_started) {
+            for (iter = g_list_first (group->members); iter; iter = g_list_next (iter))
+                n_core_stop_request (core, (NRequest*) iter->data, 0);
+        }
+    }
+
+    if (group->members)
+        return;
+
+    if (group->play_source_id > 0) {
+        g_source_remove (group->play_source_id);
+        group->play_source_id = 0;
+    }
+
+    core->requests = g_list_remove (core->requests, group);
+
+    if (group->has_failed)
+        n_core_send_error (group, "group request failed!");
+    else
+        n_core_send_reply (group, N_CORE_EVENT_COMPLETED);
+
+    N_DEBUG (LOG_CAT "group '%s' done", group->name);
+    n_request_free (group);
+}
+
+int
+n_core_play_group (NCore *core, NRequest *group, GList *requests)
+{
+    g_assert (core != NULL);
+    g_assert (group != NULL);
+
+    GList    *iter    = NULL;
+    NRequest *request = NULL;
+
+    if (!requests)
+        return FALSE;
+
+    group->core    = core;
+    group->members = g_list_copy (requests);
+    core->requests = g_list_append (core->requests, group);
+
+    N_DEBUG (LOG_CAT "starting group '%s' with %u requests", group->name,
+        g_list_length (requests));
+
+    for (iter = g_list_first (requests); iter; iter = g_list_next (iter)) {
+        request              = (NRequest*) iter->data;
+        request->group       = group;
+        request->input_iface = group->input_iface;
+        n_core_play_request (core, request);
+    }
+
+    return TRUE;
+}
+
 int
 n_core_pause_request (NCore *core, NRequest *request)
 {
@@ -500,9 +1213,17 @@ n_core_pause_request (NCore *core, NRequest *request)
         return TRUE;
     }
 
+    for (iter = g_list_first (request->members); iter; iter = g_list_next (iter))
+        n_core_pause_request (core, (NRequest*) iter->data);
+
+    n_core_hold_play_delays (request);
+
     for (iter = g_list_first (request->all_sinks); iter; iter = g_list_next (iter)) {
         sink = (NSinkInterface*) iter->data;
 
+        if (n_core_sink_play_delayed (request, sink))
+            continue;
+
         if (sink->funcs.pause && !sink->funcs.pause (sink, request)) {
             N_WARNING (LOG_CAT "sink '%s' failed to pause request '%s'",
                 sink->name, request->name);
@@ -533,9 +1254,16 @@ n_core_resume_request (NCore *core, NRequest *request)
         return TRUE;
     }
 
+    for (iter = g_list_first (request->members); iter; iter = g_list_next (iter))
+        n_core_resume_request (core, (NRequest*) iter->data);
+
     for (iter = g_list_first (request->all_sinks); iter; iter = g_list_next (iter)) {
         sink = (NSinkInterface*) iter->data;
 
+        /* not started yet, played when the held delay runs out */
+        if (n_core_sink_play_delayed (request, sink))
+            continue;
+
         if (sink->funcs.play && !sink->funcs.play (sink, request)) {
             N_WARNING (LOG_CAT "sink '%s' failed to resume (play) request '%s'",
                 sink->name, request->name);
@@ -543,6 +1271,8 @@ n_core_resume_request (NCore *core, NRequest *request)
         }
     }
 
+    n_core_release_play_delays (request);
+
     if (all_resumed)
         n_core_send_reply (request, N_CORE_EVENT_PLAYING);
 
@@ -556,6 +1286,16 @@ n_core_stop_request (NCore *core, NRequest *request, guint timeout)
     g_assert (core != NULL);
     g_assert (request != NULL);
 
+    GList *iter = NULL;
+
+    /* group is done once all of its members are done. */
+
+    if (request->members) {
+        for (iter = g_list_first (request->members); iter; iter = g_list_next (iter))
+            n_core_stop_request (core, (NRequest*) iter->data, timeout);
+        return;
+    }
+
     if (request->stop_source_id > 0) {
         N_DEBUG (LOG_CAT "already stopping request '%s'", request->name);
         return;
@@ -566,6 +1306,9 @@ n_core_stop_request (NCore *core, NRequest *request, guint timeout)
         request->play_source_id = 0;
     }
 
+    n_core_clear_play_delays (request);
+    n_core_undefer_request (request);
+
     if (timeout > 0)
         request->stop_source_id = g_timeout_add (timeout, n_core_request_done_cb, request);
     else
@@ -699,6 +1442,14 @@ n_core_synchronize_sink (NCore *core, NSinkInterface *sink, NRequest *request)
 
     if (!request->sinks_preparing) {
         N_DEBUG (LOG_CAT "all sinks have been synchronized");
+
+        /* group members wait for each other before starting playback. */
+
+        if (request->group && !request->group->members_started) {
+            n_core_group_synchronized (request->group);
+            return;
+        }
+
         request->play_source_id = g_idle_add (n_core_sink_synchronize_done_cb,
             request);
     }
@@ -730,6 +1481,27 @@ n_core_complete_sink (NCore *core, NSinkInterface *sink, NRequest *request)
     }
 }
 
+static void
+n_core_fail_request_by_sink (NSinkInterface *sink, NRequest *request,
+                             gboolean sink_fault)
+{
+    N_WARNING (LOG_CAT "sink '%s' failed request '%s'%s",
+        sink->name, request->name, sink_fault ? "" : " (request error)");
+
+    if (request->stop_source_id > 0)
+        return;
+
+    /* errors caused by the request do not tell anything about the sink. */
+
+    if (sink_fault)
+        n_core_sink_failed (sink);
+
+    /* sink failed, so request failed */
+
+    request->has_failed     = TRUE;
+    request->stop_source_id = g_idle_add (n_core_request_done_cb, request);
+}
+
 void
 n_core_fail_sink (NCore *core, NSinkInterface *sink, NRequest *request)
 {
@@ -737,14 +1509,98 @@ n_core_fail_sink (NCore *core, NSinkInterface *sink, NRequest *request)
     g_assert (sink != NULL);
     g_assert (request != NULL);
 
-    N_WARNING (LOG_CAT "sink '%s' failed request '%s'",
-        sink->name, request->name);
+    n_core_fail_request_by_sink (sink, request, TRUE);
+}
 
-    if (request->stop_source_id > 0)
+void
+n_core_fail_sink_request (NCore *core, NSinkInterface *sink, NRequest *request)
+{
+    g_assert (core != NULL);
+    g_assert (sink != NULL);
+    g_assert (request != NULL);
+
+    n_core_fail_request_by_sink (sink, request, FALSE);
+}
+
+void
+n_core_load_level_changed (NCore *core, NLoadLevel level)
+{
+    g_assert (core != NULL);
+
+    NRequest *request  = NULL;
+    GList    *deferred = NULL;
+    GList    *iter     = NULL;
+
+    if (level == N_LOAD_LEVEL_DEFER)
         return;
 
-    /* sink failed, so request failed */
+    /* main loop has either recovered or is so far behind that deferred
+       requests would be too late anyway. requests waiting for sinks keep
+       waiting. */
 
-    request->has_failed     = TRUE;
-    request->stop_source_id = g_idle_add (n_core_request_done_cb, request);
+    deferred = g_list_copy (core->deferred_requests);
+    for (iter = g_list_first (deferred); iter; iter = g_list_next (iter)) {
+        request = (NRequest*) iter->data;
+        if (request->waits_for_sinks)
+            continue;
+
+        n_core_undefer_request (request);
+
+        if (level == N_LOAD_LEVEL_NORMAL) {
+            N_DEBUG (LOG_CAT "resuming deferred request '%s'", request->name);
+            if (!n_core_start_request (request)) {
+                request->has_failed     = TRUE;
+                request->stop_source_id = g_idle_add (n_core_request_done_cb, request);
+            }
+        }
+        else
+            n_core_shed_request (request);
+    }
+    g_list_free (deferred);
+}
+
+void
+n_core_resume_sink_waiting_requests (NCore *core)
+{
+    g_assert (core != NULL);
+
+    NRequest *request  = NULL;
+    GList    *deferred = NULL;
+    GList    *iter     = NULL;
+
+    /* requests still waiting for other sinks go back to waiting. */
+
+    deferred = g_list_copy (core->deferred_requests);
+    for (iter = g_list_first (deferred); iter; iter = g_list_next (iter)) {
+        request = (NRequest*) iter->data;
+        if (!request->waits_for_sinks)
+            continue;
+
+        n_core_undefer_request (request);
+        request->waits_for_sinks = FALSE;
+
+        N_DEBUG (LOG_CAT "resuming request '%s' waiting for sinks", request->name);
+        (void) n_core_start_request (request);
+    }
+    g_list_free (deferred);
+}
+
+void
+n_core_drop_deferred_requests (NCore *core)
+{
+    g_assert (core != NULL);
+
+    NRequest *request = NULL;
+
+    /* requests still waiting for the main loop to recover never started,
+       fail them while the inputs are still there to tell the clients. */
+
+    while (core->deferred_requests) {
+        request = (NRequest*) core->deferred_requests->data;
+        n_core_undefer_request (request);
+
+        request->is_shed    = TRUE;
+        request->has_failed = TRUE;
+        (void) n_core_request_done_cb (request);
+    }
 }
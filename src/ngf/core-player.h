@@ -25,6 +25,10 @@
 #include "request-internal.h"
 #include "core-internal.h"
 #include "sinkinterface-internal.h"
+#include "loadmonitor-internal.h"
+
+/* priority of requests that do not define core.priority */
+#define N_CORE_DEFAULT_PRIORITY (50)
 
 typedef enum _NCorePlayerState
 {
@@ -38,11 +42,20 @@ int  n_core_play_request     (NCore *core, NRequest *request);
 int  n_core_pause_request    (NCore *core, NRequest *request);
 int  n_core_resume_request   (NCore *core, NRequest *request);
 void n_core_stop_request     (NCore *core, NRequest *request, guint timeout);
+int  n_core_play_group       (NCore *core, NRequest *group, GList *requests);
+
+gboolean  n_core_update_prepared      (NCore *core, NPreparedRequest *prepared);
+NRequest* n_core_new_prepared_request (NCore *core, NPreparedRequest *prepared);
 
 void n_core_set_resync_on_master (NCore *core, NSinkInterface *sink, NRequest *request);
 void n_core_resynchronize_sinks  (NCore *core, NSinkInterface *sink, NRequest *request);
 void n_core_synchronize_sink     (NCore *core, NSinkInterface *sink, NRequest *request);
 void n_core_complete_sink        (NCore *core, NSinkInterface *sink, NRequest *request);
 void n_core_fail_sink            (NCore *core, NSinkInterface *sink, NRequest *request);
+void n_core_fail_sink_request    (NCore *core, NSinkInterface *sink, NRequest *request);
+
+void n_core_load_level_changed   (NCore *core, NLoadLevel level);
+void n_core_drop_deferred_requests (NCore *core);
+void n_core_resume_sink_waiting_requests (NCore *core);
 
 #endif /* N_CORE_PLAYER_ H */
@@ -30,10 +30,13 @@
 #include "core-internal.h"
 #include "event-internal.h"
 #include "eventlist-internal.h"
+#include "eventrule-internal.h"
 #include "request-internal.h"
 #include "context-internal.h"
 #include "core-dbus-internal.h"
 #include "haptic-internal.h"
+#include "loadmonitor-internal.h"
+#include "worker-internal.h"
 #include "core-player.h"
 
 #define LOG_CAT  "core: "
@@ -45,20 +48,66 @@
 #define EVENT_CONF_PATH         "events.d"
 
 #define CORE_CONF_KEYTYPES      "keytypes"
+#define CORE_CONF_LAZY_PLUGINS  "lazy-plugins"
+
+#define DEFAULT_SINK_FAILURE_LIMIT      (3)
+#define DEFAULT_SINK_PROBE_INTERVAL_MS  (10000)
+
+#define DEFAULT_LAG_INTERVAL_MS         (50)
+#define DEFAULT_LAG_DEFER_THRESHOLD_MS  (50)
+#define DEFAULT_LAG_SHED_THRESHOLD_MS   (250)
+#define DEFAULT_LAG_MAX_DEFER_MS        (500)
+#define DEFAULT_PROTECTED_PRIORITY      N_CORE_DEFAULT_PRIORITY
+
+#define DEFAULT_WORKER_THREADS          (2)
+
+#define DEFAULT_CONTEXT_STATE_FILE      "context.ini"
+#define DEFAULT_CONTEXT_WRITE_DELAY_MS  (2000)
+
+#define DEFAULT_IDLE_TRIM_MS            (0)
+
+#define PLUGIN_RELOAD_POLL_MS           (50)
 
 static gchar*     n_core_get_path               (const char *key, const char *default_path);
+static GHashTable* n_core_build_plugin_conf_index (NCore *core, const char *only_plugin);
+static void       n_core_reload_plugin_conf     (NCore *core);
+static void       n_core_release_plugin_conf    (NCore *core);
 static NProplist* n_core_load_params            (NCore *core, const char *plugin_name);
-static NPlugin*   n_core_open_plugin            (NCore *core, const char *plugin_name);
+static NPlugin*   n_core_open_plugin            (NCore *core, const char *plugin_name, NProplist *params);
 static int        n_core_init_plugin            (NPlugin *plugin, gboolean required);
+static NPlugin*   n_core_find_plugin            (GList *plugins, const char *plugin_name);
+static int        n_core_init_plugins           (NCore *core, GList *required_plugins, GList *optional_plugins);
+static gboolean   n_core_input_sinks_settled    (NCore *core, NInputInterface *input);
+static int        n_core_start_inputs           (NCore *core, gboolean fatal);
+static int        n_core_init_sink              (NSinkInterface *sink);
+static NLazyPlugin* n_core_take_lazy_plugin     (NCore *core, const char *plugin_name);
+static int        n_core_start_plugin           (NCore *core, NPlugin *plugin, gboolean required);
+static int        n_core_load_lazy_plugin       (NCore *core, NLazyPlugin *lazy);
+static void       n_core_lazy_plugin_free       (NLazyPlugin *lazy);
+static gboolean   n_core_plugin_sinks_pending   (NCore *core, NPlugin *plugin);
+static void       n_core_prune_lazy_starting    (NCore *core);
+static guint      n_core_stop_plugin_requests   (NCore *core, NPlugin *plugin);
+static void       n_core_remove_plugin_sinks    (NCore *core, NPlugin *plugin);
+static gboolean   n_core_plugin_reload_cb       (gpointer userdata);
 static void       n_core_unload_plugin          (NCore *core, NPlugin *plugin);
+static void       n_core_context_changed_cb     (NContext *context, const char *key,
+                                                 const NValue *old_value,
+                                                 const NValue *new_value,
+                                                 void *userdata);
 static void       n_core_parse_events_from_file (NEventList *eventlist, const char *filename);
 static int        n_core_parse_events           (NEventList *eventlist, const char *conf_path);
+static void       n_core_add_keytype            (NCore *core, const char *key, const char *value);
+static void       n_core_build_request_keys     (NCore *core);
 static void       n_core_parse_keytypes         (NCore *core, GKeyFile *keyfile);
 static void       n_core_parse_sink_order       (NCore *core, GKeyFile *keyfile);
+static void       n_core_parse_sink_breaker     (NCore *core, GKeyFile *keyfile);
+static void       n_core_parse_load_monitor     (NCore *core, GKeyFile *keyfile);
+static void       n_core_parse_context_store    (NCore *core, GKeyFile *keyfile);
+static void       n_core_take_plugin_name       (GList **list, const char *plugin_name, gboolean *found);
+static void       n_core_parse_lazy_plugins     (NCore *core, GKeyFile *keyfile);
+static gboolean   n_core_get_conf_uint          (GKeyFile *keyfile, const char *key, guint *value);
 static int        n_core_parse_configuration    (NCore *core);
 
-static GSList*    tmp_plugin_conf_files;
-
 
 static gchar*
 n_core_get_path (const char *key, const char *default_path)
@@ -124,114 +173,209 @@ done:
     return conf_files;
 }
 
-static GSList*
-n_core_plugin_conf_files (NCore *core)
+static NPluginConf*
+n_core_plugin_conf_new ()
 {
-    if (tmp_plugin_conf_files)
-        return tmp_plugin_conf_files;
+    NPluginConf *conf = NULL;
 
-    tmp_plugin_conf_files = n_core_conf_files_from_path (core->conf_path, PLUGIN_CONF_PATH);
+    conf = g_new0 (NPluginConf, 1);
+    conf->params   = n_proplist_new ();
+    conf->keytypes = n_proplist_new ();
 
-    return tmp_plugin_conf_files;
+    return conf;
 }
 
 static void
-n_core_plugin_conf_files_done ()
+n_core_plugin_conf_free (NPluginConf *conf)
 {
-    if (tmp_plugin_conf_files) {
-        g_slist_free_full (tmp_plugin_conf_files, g_free);
-        tmp_plugin_conf_files = NULL;
-    }
+    n_proplist_free (conf->params);
+    n_proplist_free (conf->keytypes);
+    g_free (conf);
 }
 
-/* Returns new GSList with filenames for plugin_name. The list should be freed
- * after use, but the list element data not. */
-static GSList*
-n_core_plugin_conf_files_for_plugin (NCore *core, const char *plugin_name)
+static void
+n_core_merge_conf_group (GKeyFile *keyfile, const char *group, NProplist *proplist,
+                         const char *plugin_name)
 {
-    GSList *plugin = NULL;
-    GSList *i      = NULL;
-    gchar  *suffix = NULL;
+    gchar **keys  = NULL;
+    gchar **iter  = NULL;
+    gchar  *value = NULL;
 
-    if (n_core_plugin_conf_files (core)) {
-        suffix = g_strdup_printf ("%s.ini", plugin_name);
+    if (!(keys = g_key_file_get_keys (keyfile, group, NULL, NULL)))
+        return;
 
-        for (i = n_core_plugin_conf_files (core); i; i = g_slist_next (i)) {
-            if (g_str_has_suffix (i->data, suffix))
-                plugin = g_slist_append (plugin, i->data);
-        }
+    for (iter = keys; *iter; ++iter) {
+        if ((value = g_key_file_get_string (keyfile, group, *iter, NULL)) == NULL)
+            continue;
 
-        g_free (suffix);
+        N_DEBUG (LOG_CAT "+ plugin %s (%s): %s = %s%s",
+            g_str_equal (group, CORE_CONF_KEYTYPES) ? "keytype" : "parameter",
+            plugin_name, *iter, value,
+            n_proplist_has_key (proplist, *iter) ? " (override previous)" : "");
+        n_proplist_set_string (proplist, *iter, value);
+        g_free (value);
     }
 
-    return plugin;
+    g_strfreev (keys);
 }
 
-static NProplist*
-n_core_load_params (NCore *core, const char *plugin_name)
+/* Parses every plugins.d file once. A group is configuration of the plugin
+ * with the same name if the file name ends with <plugin>.ini, keytypes of
+ * such file belong to that plugin. Later files override earlier ones.
+ * If only_plugin is given, only its files are parsed. */
+static GHashTable*
+n_core_build_plugin_conf_index (NCore *core, const char *only_plugin)
 {
-    g_assert (core != NULL);
-    g_assert (plugin_name != NULL);
-
-    NProplist      *proplist    = NULL;
+    GHashTable     *index       = NULL;
+    GSList         *conf_files  = NULL;
+    GSList         *i           = NULL;
     GKeyFile       *keyfile     = NULL;
-    gchar         **keys        = NULL;
-    gchar         **iter        = NULL;
     GError         *error       = NULL;
-    gchar          *value       = NULL;
-    GSList         *plugin_conf = NULL;
-    GSList         *i           = NULL;
+    gchar         **groups      = NULL;
+    gchar         **group       = NULL;
+    gchar          *basename    = NULL;
+    gchar          *suffix      = NULL;
+    gchar          *only_suffix = NULL;
+    NPluginConf    *conf        = NULL;
     const gchar    *filename    = NULL;
 
-    proplist = n_proplist_new ();
+    n_startup_profile_begin (core->startup_profile, "plugin-conf-index", NULL);
+
+    index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        (GDestroyNotify) n_core_plugin_conf_free);
+    conf_files = n_core_conf_files_from_path (core->conf_path, PLUGIN_CONF_PATH);
     keyfile = g_key_file_new ();
-    plugin_conf = n_core_plugin_conf_files_for_plugin (core, plugin_name);
 
-    for (i = plugin_conf; i; i = g_slist_next (i)) {
+    if (only_plugin)
+        only_suffix = g_strdup_printf ("%s.ini", only_plugin);
+
+    for (i = conf_files; i; i = g_slist_next (i)) {
         filename = (const gchar*) i->data;
 
+        if (only_suffix && !g_str_has_suffix (filename, only_suffix))
+            continue;
+
         if (!g_key_file_load_from_file (keyfile, filename, G_KEY_FILE_NONE, &error)) {
             N_WARNING (LOG_CAT "problem with configuration file '%s': %s",
                 filename, error->message);
             g_error_free (error);
+            error = NULL;
             continue;
         }
 
-        keys = g_key_file_get_keys (keyfile, plugin_name, NULL, NULL);
-        if (!keys) {
-            N_WARNING (LOG_CAT "no group '%s' within configuration file '%s'",
-                plugin_name, filename);
-            continue;
-        }
+        basename = g_path_get_basename (filename);
+        groups   = g_key_file_get_groups (keyfile, NULL);
 
-        /* Extend known keytypes from plugin configuration. */
-        n_core_parse_keytypes (core, keyfile);
+        for (group = groups; *group; ++group) {
+            if (g_str_equal (*group, CORE_CONF_KEYTYPES))
+                continue;
 
-        for (iter = keys; *iter; ++iter) {
-            if ((value = g_key_file_get_string (keyfile, plugin_name, *iter, NULL)) == NULL)
+            if (only_plugin && !g_str_equal (*group, only_plugin))
                 continue;
 
-            N_DEBUG (LOG_CAT "+ plugin parameter (%s): %s = %s%s",
-                plugin_name, *iter, value,
-                n_proplist_has_key (proplist, *iter) ? " (override previous)" : "");
-            n_proplist_set_string (proplist, *iter, value);
-            g_free (value);
+            suffix = g_strdup_printf ("%s.ini", *group);
+            if (g_str_has_suffix (basename, suffix)) {
+                if (!(conf = g_hash_table_lookup (index, *group))) {
+                    conf = n_core_plugin_conf_new ();
+                    g_hash_table_insert (index, g_strdup (*group), conf);
+                }
+
+                n_core_merge_conf_group (keyfile, *group, conf->params, *group);
+                n_core_merge_conf_group (keyfile, CORE_CONF_KEYTYPES, conf->keytypes, *group);
+            }
+            g_free (suffix);
         }
 
-        g_strfreev (keys);
-        g_key_file_remove_group (keyfile, plugin_name, NULL);
-        g_key_file_remove_group (keyfile, CORE_CONF_KEYTYPES, NULL);
+        g_strfreev (groups);
+        g_free (basename);
     }
 
     g_key_file_free (keyfile);
-    /* Only remove the list, not the element data. */
-    g_slist_free (plugin_conf);
+    g_slist_free_full (conf_files, g_free);
+    g_free (only_suffix);
+
+    N_DEBUG (LOG_CAT "configuration found for %u plugin(s)", g_hash_table_size (index));
+    n_startup_profile_end (core->startup_profile, "plugin-conf-index", NULL);
+
+    return index;
+}
+
+static void
+n_core_apply_keytype_cb (const char *key, const NValue *value, gpointer userdata)
+{
+    n_core_add_keytype ((NCore*) userdata, key, n_value_get_string ((NValue*) value));
+}
+
+/* Parses plugins.d again, keytypes of the plugins may have changed. The
+ * index is kept until the caller releases it. */
+static void
+n_core_reload_plugin_conf (NCore *core)
+{
+    NPluginConf *conf = NULL;
+    NLazyPlugin *lazy = NULL;
+    GList       *iter = NULL;
+
+    if (core->plugin_conf)
+        g_hash_table_destroy (core->plugin_conf);
+
+    core->plugin_conf = n_core_build_plugin_conf_index (core, NULL);
+
+    for (iter = g_list_first (core->plugins); iter; iter = g_list_next (iter)) {
+        conf = g_hash_table_lookup (core->plugin_conf, ((NPlugin*) iter->data)->get_name ());
+        if (conf)
+            n_proplist_foreach (conf->keytypes, n_core_apply_keytype_cb, core);
+    }
+
+    for (iter = g_list_first (core->lazy_plugins); iter; iter = g_list_next (iter)) {
+        lazy = (NLazyPlugin*) iter->data;
+        if (lazy->params)
+            n_proplist_free (lazy->params);
+        lazy->params = n_core_load_params (core, lazy->name);
+    }
+}
+
+/* The index is only needed while plugins are opened or configuration is
+ * reloaded. Parameters of a plugin opened later, e.g. when reloaded, are
+ * read from its own files. */
+static void
+n_core_release_plugin_conf (NCore *core)
+{
+    if (core->plugin_conf) {
+        g_hash_table_destroy (core->plugin_conf);
+        core->plugin_conf = NULL;
+    }
+}
+
+static NProplist*
+n_core_load_params (NCore *core, const char *plugin_name)
+{
+    g_assert (core != NULL);
+    g_assert (plugin_name != NULL);
 
-    return proplist;
+    NPluginConf *conf   = NULL;
+    GHashTable  *index  = NULL;
+    NProplist   *params = NULL;
+
+    if (!(index = core->plugin_conf))
+        index = n_core_build_plugin_conf_index (core, plugin_name);
+
+    if ((conf = g_hash_table_lookup (index, plugin_name))) {
+        /* Extend known keytypes from plugin configuration. */
+        n_proplist_foreach (conf->keytypes, n_core_apply_keytype_cb, core);
+        params = n_proplist_copy (conf->params);
+    } else {
+        params = n_proplist_new ();
+    }
+
+    if (index != core->plugin_conf)
+        g_hash_table_destroy (index);
+
+    return params;
 }
 
+/* takes the ownership of params, parameters are loaded if NULL */
 static NPlugin*
-n_core_open_plugin (NCore *core, const char *plugin_name)
+n_core_open_plugin (NCore *core, const char *plugin_name, NProplist *params)
 {
     g_assert (core != NULL);
     g_assert (plugin_name != NULL);
@@ -240,6 +384,8 @@ n_core_open_plugin (NCore *core, const char *plugin_name)
     gchar   *filename  = NULL;
     gchar   *full_path = NULL;
 
+    n_startup_profile_begin (core->startup_profile, "open-plugin", plugin_name);
+
     filename  = g_strdup_printf ("libngfd_%s.so", plugin_name);
     full_path = g_build_filename (core->plugin_path, filename, NULL);
 
@@ -247,9 +393,10 @@ n_core_open_plugin (NCore *core, const char *plugin_name)
         goto done;
 
     plugin->core   = core;
-    plugin->params = n_core_load_params (core, plugin_name);
+    plugin->params = params ? params : n_core_load_params (core, plugin_name);
 
     N_DEBUG (LOG_CAT "opened plugin '%s' (%s)", plugin->get_name (), filename);
+    n_startup_profile_end (core->startup_profile, "open-plugin", plugin_name);
 
     g_free (full_path);
     g_free (filename);
@@ -258,10 +405,14 @@ n_core_open_plugin (NCore *core, const char *plugin_name)
 
 done:
     N_ERROR (LOG_CAT "unable to open plugin '%s'", plugin_name);
+    n_startup_profile_end (core->startup_profile, "open-plugin", plugin_name);
 
     if (plugin)
         n_plugin_unload (plugin);
 
+    if (params)
+        n_proplist_free (params);
+
     g_free (full_path);
     g_free (filename);
 
@@ -271,22 +422,151 @@ done:
 static int
 n_core_init_plugin (NPlugin *plugin, gboolean required)
 {
-    int ret = FALSE;
+    NCore       *core       = NULL;
+    unsigned int num_sinks  = 0;
+    unsigned int num_inputs = 0;
+    int          ret        = FALSE;
 
     g_assert (plugin != NULL);
 
-    if (!(ret = n_plugin_init (plugin))) {
+    core       = plugin->core;
+    num_sinks  = core->num_sinks;
+    num_inputs = core->num_inputs;
+
+    n_startup_profile_begin (core->startup_profile, "plugin-init", plugin->get_name ());
+    ret = n_plugin_init (plugin);
+    n_startup_profile_end (core->startup_profile, "plugin-init", plugin->get_name ());
+
+    if (!ret) {
         if (required)
             N_ERROR (LOG_CAT "unable to init required plugin '%s'", plugin->get_name());
         else
             N_INFO (LOG_CAT "unable to init optional plugin '%s'", plugin->get_name());
 
         n_plugin_unload (plugin);
+        return ret;
     }
 
+    /* remember which plugin registered the interfaces, inputs are
+       started when the sinks of the plugins they depend on are ready. */
+
+    for (; num_sinks < core->num_sinks; ++num_sinks)
+        core->sinks[num_sinks]->plugin = plugin;
+
+    for (; num_inputs < core->num_inputs; ++num_inputs)
+        core->inputs[num_inputs]->plugin = plugin;
+
     return ret;
 }
 
+static NPlugin*
+n_core_find_plugin (GList *plugins, const char *plugin_name)
+{
+    GList   *iter   = NULL;
+    NPlugin *plugin = NULL;
+
+    for (iter = g_list_first (plugins); iter; iter = g_list_next (iter)) {
+        plugin = (NPlugin*) iter->data;
+        if (g_str_equal (plugin->get_name (), plugin_name))
+            return plugin;
+    }
+
+    return NULL;
+}
+
+static int
+n_core_init_plugins (NCore *core, GList *required_plugins, GList *optional_plugins)
+{
+    GList    *pending  = NULL;
+    GList    *iter     = NULL;
+    GList    *next     = NULL;
+    NPlugin  *plugin   = NULL;
+    gchar   **dep      = NULL;
+    gboolean  required = FALSE;
+    gboolean  waiting  = FALSE;
+    gboolean  progress = TRUE;
+
+    /* required plugins first, otherwise in configuration order. a plugin
+       is initialized after all the plugins it depends on. */
+
+    pending = g_list_concat (g_list_copy (required_plugins),
+                             g_list_copy (optional_plugins));
+
+    while (pending && progress) {
+        progress = FALSE;
+
+        for (iter = pending; iter; iter = next) {
+            next     = g_list_next (iter);
+            plugin   = (NPlugin*) iter->data;
+            required = g_list_find (required_plugins, plugin) != NULL;
+            waiting  = FALSE;
+
+            for (dep = plugin->depends; dep && *dep; ++dep) {
+                if (n_core_find_plugin (core->plugins, *dep))
+                    continue;
+
+                if (n_core_find_plugin (pending, *dep)) {
+                    waiting = TRUE;
+                    continue;
+                }
+
+                break;
+            }
+
+            if (dep && *dep) {
+                if (required) {
+                    N_ERROR (LOG_CAT "required plugin '%s' depends on '%s' which is not available",
+                        plugin->get_name (), *dep);
+                    goto failed;
+                }
+
+                N_INFO (LOG_CAT "optional plugin '%s' depends on '%s' which is not available",
+                    plugin->get_name (), *dep);
+
+                pending  = g_list_delete_link (pending, iter);
+                progress = TRUE;
+                n_plugin_unload (plugin);
+                continue;
+            }
+
+            if (waiting)
+                continue;
+
+            pending  = g_list_delete_link (pending, iter);
+            progress = TRUE;
+
+            if (n_core_init_plugin (plugin, required))
+                core->plugins = g_list_append (core->plugins, plugin);
+            else if (required)
+                goto failed;
+        }
+    }
+
+    /* whatever is left depends on itself through other plugins. */
+
+    for (iter = pending; iter; iter = g_list_next (iter)) {
+        plugin = (NPlugin*) iter->data;
+
+        if (g_list_find (required_plugins, plugin)) {
+            N_ERROR (LOG_CAT "required plugin '%s' has circular dependencies",
+                plugin->get_name ());
+            goto failed;
+        }
+
+        N_INFO (LOG_CAT "optional plugin '%s' has circular dependencies",
+            plugin->get_name ());
+    }
+
+    g_list_free_full (pending, (GDestroyNotify) n_plugin_unload);
+
+    return TRUE;
+
+failed:
+    g_list_free_full (pending, (GDestroyNotify) n_plugin_unload);
+
+    return FALSE;
+}
+
 static void
 n_core_unload_plugin (NCore *core, NPlugin *plugin)
 {
@@ -296,6 +576,26 @@ n_core_unload_plugin (NCore *core, NPlugin *plugin)
     N_DEBUG (LOG_CAT "unloading plugin '%s'", plugin->get_name ());
     plugin->unload (plugin);
     n_plugin_unload (plugin);
+    n_core_invalidate_prepared (core);
+}
+
+/* prepared requests are resolved again only when a context key read by
+   the rules of their events, or by hooks and sinks through
+   n_core_get_request_context_value, changes. see n_core_context_changed_since. */
+static void
+n_core_context_changed_cb (NContext *context, const char *key,
+                           const NValue *old_value, const NValue *new_value,
+                           void *userdata)
+{
+    NCore *core = (NCore*) userdata;
+
+    (void) context;
+
+    if (old_value && new_value && n_value_equals (old_value, new_value))
+        return;
+
+    g_hash_table_replace (core->context_changes, g_strdup (key),
+        GUINT_TO_POINTER (++core->context_serial));
 }
 
 NCore*
@@ -317,10 +617,30 @@ n_core_new (int *argc, char **argv)
     core->dbus              = n_dbus_helper_new (core);
     core->haptic            = n_haptic_new (core);
     core->eventlist         = n_event_list_new (core);
+    core->load_monitor      = n_load_monitor_new (core);
+    core->workers           = n_worker_pool_new (DEFAULT_WORKER_THREADS);
+    core->context_store     = n_context_store_new (core);
+    core->idle_trim         = n_idle_trim_new (core);
+
+    core->sink_failure_limit  = DEFAULT_SINK_FAILURE_LIMIT;
+    core->sink_probe_interval = DEFAULT_SINK_PROBE_INTERVAL_MS;
+    core->protected_priority  = DEFAULT_PROTECTED_PRIORITY;
+    core->max_defer           = DEFAULT_LAG_MAX_DEFER_MS;
+
+    n_load_monitor_configure (core->load_monitor, DEFAULT_LAG_INTERVAL_MS,
+        DEFAULT_LAG_DEFER_THRESHOLD_MS, DEFAULT_LAG_SHED_THRESHOLD_MS);
 
     core->key_types = g_hash_table_new_full (g_str_hash, g_str_equal,
         g_free, NULL);
 
+    g_rw_lock_init (&core->request_keys_lock);
+
+    core->context_changes = g_hash_table_new_full (g_str_hash, g_str_equal,
+        g_free, NULL);
+
+    n_context_subscribe_value_change (core->context, NULL,
+        n_core_context_changed_cb, core);
+
     return core;
 }
 
@@ -336,9 +656,26 @@ n_core_free (NCore *core)
 
     g_hash_table_destroy (core->key_types);
 
+    if (core->request_keys)
+        g_hash_table_destroy (core->request_keys);
+    g_strfreev (core->request_key_names);
+    g_rw_lock_clear (&core->request_keys_lock);
+
+    g_hash_table_destroy (core->context_changes);
+
+    if (core->plugin_conf)
+        g_hash_table_destroy (core->plugin_conf);
+
     n_event_list_free (core->eventlist);
+    n_idle_trim_free (core->idle_trim);
+    n_context_store_free (core->context_store);
+    n_startup_profile_free (core->startup_profile);
+    n_load_monitor_free (core->load_monitor);
+    n_worker_pool_free (core->workers);
     n_haptic_free (core->haptic);
     n_dbus_helper_free (core->dbus);
+    n_context_unsubscribe_value_change (core->context, NULL,
+        n_core_context_changed_cb);
     n_context_free (core->context);
     g_free (core->plugin_path);
     g_free (core->conf_path);
@@ -387,11 +724,10 @@ n_core_initialize (NCore *core)
     GList            *required_plugins = NULL;
     GList            *optional_plugins = NULL;
     NSinkInterface  **sink   = NULL;
-    NInputInterface **input  = NULL;
     NPlugin          *plugin = NULL;
+    NLazyPlugin      *lazy   = NULL;
     GList            *p      = NULL;
-
-    tmp_plugin_conf_files    = NULL;
+    int               ret    = FALSE;
 
     /* setup hooks */
 
@@ -401,12 +737,22 @@ n_core_initialize (NCore *core)
 
     /* load the default configuration. */
 
-    if (!n_core_parse_configuration (core))
+    n_startup_profile_begin (core->startup_profile, "configuration", NULL);
+    ret = n_core_parse_configuration (core);
+    n_startup_profile_end (core->startup_profile, "configuration", NULL);
+
+    if (!ret)
         goto failed_init;
 
+    /* restore the last known context values, so that requests arriving
+       before plugins have queried the actual values resolve correctly.
+       plugins overwrite them with live values. */
+
+    n_context_store_restore (core->context_store);
+
     /* check for required plugins. */
 
-    if (!core->required_plugins && !core->optional_plugins) {
+    if (!core->required_plugins && !core->optional_plugins && !core->lazy_plugins) {
         N_ERROR (LOG_CAT "no plugins to load defined in configuration");
         goto failed_init;
     }
@@ -415,7 +761,7 @@ n_core_initialize (NCore *core)
 
     /* first mandatory plugins */
     for (p = g_list_first (core->required_plugins); p; p = g_list_next (p)) {
-        if (!(plugin = n_core_open_plugin (core, (const char*) p->data)))
+        if (!(plugin = n_core_open_plugin (core, (const char*) p->data, NULL)))
             goto failed_init;
 
         required_plugins = g_list_append (required_plugins, plugin);
@@ -423,44 +769,49 @@ n_core_initialize (NCore *core)
 
     /* then optional plugins */
     for (p = g_list_first (core->optional_plugins); p; p = g_list_next (p)) {
-        if ((plugin = n_core_open_plugin (core, (const char*) p->data)))
+        if ((plugin = n_core_open_plugin (core, (const char*) p->data, NULL)))
             optional_plugins = g_list_append (optional_plugins, plugin);
 
         if (!plugin)
             N_INFO (LOG_CAT "optional plugin %s not opened.", p->data);
     }
 
-    /* Clear temporary conf file list. */
-    n_core_plugin_conf_files_done ();
+    /* plugins loaded on demand only need their parameters for the
+       keytypes used in events. */
+    for (p = g_list_first (core->lazy_plugins); p; p = g_list_next (p)) {
+        lazy = (NLazyPlugin*) p->data;
+        lazy->params = n_core_load_params (core, lazy->name);
+    }
+
+    /* every plugin has its parameters now. */
+
+    n_core_release_plugin_conf (core);
 
     /* load events from the given event path. */
 
-    if (!n_core_parse_events (core->eventlist, core->conf_path)) {
+    n_startup_profile_begin (core->startup_profile, "events", core->conf_path);
+    ret = n_core_parse_events (core->eventlist, core->conf_path);
+    n_startup_profile_end (core->startup_profile, "events", core->conf_path);
+
+    if (!ret) {
         N_ERROR (LOG_CAT "no events defined.");
         goto failed_init;
     }
 
     /* load user defined events, failure to load doesn't
      * prevent startup. */
+    n_startup_profile_begin (core->startup_profile, "events", core->user_conf_path);
     n_core_parse_events (core->eventlist, core->user_conf_path);
+    n_startup_profile_end (core->startup_profile, "events", core->user_conf_path);
 
-    /* initialize required plugins */
-    for (p = required_plugins; p; p = g_list_next (p)) {
-        if (!n_core_init_plugin ((NPlugin *) p->data, TRUE))
-            goto failed_init;
+    /* initialize plugins in dependency order */
 
-        core->plugins = g_list_append (core->plugins, p->data);
-    }
+    if (!n_core_init_plugins (core, required_plugins, optional_plugins))
+        goto failed_init;
 
     g_list_free (required_plugins);
     required_plugins = NULL;
 
-    /* initialize optional plugins */
-    for (p = optional_plugins; p; p = g_list_next (p)) {
-        if (n_core_init_plugin ((NPlugin *) p->data, FALSE))
-            core->plugins = g_list_append (core->plugins, p->data);
-    }
-
     g_list_free (optional_plugins);
     optional_plugins = NULL;
 
@@ -475,30 +826,29 @@ n_core_initialize (NCore *core)
 
     n_core_set_sink_priorities (core->sinks, core->sink_order);
 
-    for (sink = core->sinks; *sink; ++sink) {
-        if ((*sink)->funcs.initialize && !(*sink)->funcs.initialize (*sink)) {
-            N_ERROR (LOG_CAT "sink '%s' failed to initialize", (*sink)->name);
-            goto failed_init;
-        }
-    }
-
-    /* initialize all inputs. */
-
     if (!core->inputs) {
         N_ERROR (LOG_CAT "no plugin has registered input interface");
         goto failed_init;
     }
 
-    for (input = core->inputs; *input; ++input) {
-        if ((*input)->funcs.initialize && !(*input)->funcs.initialize (*input)) {
-            N_ERROR (LOG_CAT "input '%s' failed to initialize", (*input)->name);
+    /* sinks with slow setup finish their initialization asynchronously
+       and are not used before they report the result. */
+
+    for (sink = core->sinks; *sink; ++sink) {
+        if (!n_core_init_sink (*sink)) {
+            N_ERROR (LOG_CAT "sink '%s' failed to initialize", (*sink)->name);
             goto failed_init;
         }
     }
 
-    /* fire the init done hook. */
+    core->sinks_started = TRUE;
 
-    n_core_fire_hook (core, N_CORE_HOOK_INIT_DONE, NULL);
+    /* initialize inputs whose sinks are ready, the rest are initialized
+       as their sinks complete. init done hook is fired when everything
+       has been initialized. */
+
+    if (!n_core_start_inputs (core, TRUE))
+        goto failed_init;
 
     return TRUE;
 
@@ -515,6 +865,9 @@ n_core_reload_events (NCore *core)
     GList       *iter           = NULL;
     NEventList  *new_eventlist  = n_event_list_new (core);
 
+    n_core_reload_plugin_conf (core);
+    n_core_release_plugin_conf (core);
+
     if (!n_core_parse_events (new_eventlist, core->conf_path))
         goto fail;
 
@@ -526,6 +879,8 @@ n_core_reload_events (NCore *core)
 
     n_event_list_free (core->eventlist);
     core->eventlist = new_eventlist;
+    n_core_build_request_keys (core);
+    n_core_invalidate_prepared (core);
     N_INFO (LOG_CAT "reloaded events (%d).", n_event_list_size (core->eventlist));
     return TRUE;
 
@@ -548,15 +903,35 @@ n_core_shutdown (NCore *core)
 {
     g_assert (core != NULL);
 
-    NInputInterface **input = NULL;
-    NSinkInterface  **sink  = NULL;
-    GList            *iter  = NULL;
+    NInputInterface **input    = NULL;
+    NSinkInterface  **sink     = NULL;
+    NPluginReload    *reload   = NULL;
+    GList            *unloaded = NULL;
+    GList            *iter     = NULL;
+
+    /* store pending context changes */
+
+    n_context_store_flush (core->context_store);
+
+    /* plugins waiting for reload are unloaded with the rest, ones that
+       have been unloaded already are closed once work is done. */
+
+    for (iter = g_list_first (core->reloads); iter; iter = g_list_next (iter)) {
+        reload = (NPluginReload*) iter->data;
+        g_source_remove (reload->source_id);
+        if (reload->unloaded)
+            unloaded = g_list_append (unloaded, reload->plugin);
+    }
+    g_list_free_full (core->reloads, g_free);
+    core->reloads = NULL;
+
+    n_core_drop_deferred_requests (core);
 
     /* shutdown all inputs */
 
     if (core->inputs) {
         for (input = core->inputs; *input; ++input) {
-            if ((*input)->funcs.shutdown)
+            if ((*input)->initialized && (*input)->funcs.shutdown)
                 (*input)->funcs.shutdown (*input);
             g_free (*input);
         }
@@ -564,10 +939,19 @@ n_core_shutdown (NCore *core)
         core->inputs = NULL;
     }
 
+    /* wait for running work before sinks release the resources it uses. */
+
+    n_worker_pool_shutdown (core->workers);
+
+    g_list_free_full (unloaded, (GDestroyNotify) n_plugin_unload);
+    unloaded = NULL;
+
     /* shutdown all sinks */
 
     if (core->sinks) {
         for (sink = core->sinks; *sink; ++sink) {
+            if ((*sink)->probe_source > 0)
+                g_source_remove ((*sink)->probe_source);
             if ((*sink)->funcs.shutdown)
                 (*sink)->funcs.shutdown (*sink);
             g_free (*sink);
@@ -588,6 +972,12 @@ n_core_shutdown (NCore *core)
     g_list_free_full (core->optional_plugins, g_free);
     core->optional_plugins = NULL;
 
+    g_list_free_full (core->lazy_plugins, (GDestroyNotify) n_core_lazy_plugin_free);
+    core->lazy_plugins = NULL;
+
+    g_list_free_full (core->lazy_starting, (GDestroyNotify) n_core_lazy_plugin_free);
+    core->lazy_starting = NULL;
+
     if (n_core_get_requests (core)) {
         N_WARNING (LOG_CAT "%u request(s) not stopped:", g_list_length (n_core_get_requests (core)));
         for (iter = g_list_first (n_core_get_requests (core)); iter; iter = g_list_next (iter)) {
@@ -647,111 +1037,688 @@ n_core_register_input (NCore *core, const NInputInterfaceDecl *iface)
     N_DEBUG (LOG_CAT "input interface '%s' registered", input->name);
 }
 
-static void
-n_core_parse_events_from_file (NEventList *eventlist, const char *filename)
+static gboolean
+n_core_input_sinks_settled (NCore *core, NInputInterface *input)
 {
-    g_assert (eventlist != NULL);
-    g_assert (filename != NULL);
+    NSinkInterface **sink        = NULL;
+    gboolean         has_depends = FALSE;
 
-    GKeyFile  *keyfile    = NULL;
-    GError    *error      = NULL;
+    has_depends = input->plugin && input->plugin->depends && *input->plugin->depends;
 
-    keyfile = g_key_file_new ();
-    if (!g_key_file_load_from_file (keyfile, filename, G_KEY_FILE_NONE, &error)) {
-        N_WARNING (LOG_CAT "failed to load event file: %s", error->message);
-        g_error_free    (error);
-        g_key_file_free (keyfile);
-        return;
-    }
+    for (sink = core->sinks; *sink; ++sink) {
+        if ((*sink)->init_state != N_SINK_INIT_PENDING)
+            continue;
 
-    N_DEBUG (LOG_CAT "processing event file '%s'", filename);
+        /* without dependencies input waits for all sinks. */
 
-    n_event_list_parse_keyfile (eventlist, keyfile);
+        if (!has_depends)
+            return FALSE;
 
-    g_key_file_free (keyfile);
+        if ((*sink)->plugin && n_plugin_depends_on (input->plugin, (*sink)->plugin->get_name ()))
+            return FALSE;
+    }
+
+    return TRUE;
 }
 
 static int
-n_core_parse_events (NEventList *eventlist, const char *conf_path)
+n_core_start_inputs (NCore *core, gboolean fatal)
 {
-    GSList        *conf_files = NULL;
-    GSList        *i          = NULL;
-    gchar         *filename   = NULL;
+    NInputInterface **input   = NULL;
+    NSinkInterface  **sink    = NULL;
+    gboolean          waiting = FALSE;
+    int               ret     = FALSE;
 
-    /* find all the events within the given path */
-    conf_files = n_core_conf_files_from_path (conf_path, EVENT_CONF_PATH);
+    for (input = core->inputs; *input; ++input) {
+        if ((*input)->initialized)
+            continue;
 
-    if (!conf_files)
-        return FALSE;
+        if (!n_core_input_sinks_settled (core, *input)) {
+            waiting = TRUE;
+            continue;
+        }
 
-    for (i = conf_files; i; i = g_slist_next (i)) {
-        filename = i->data;
-        n_core_parse_events_from_file (eventlist, filename);
+        (*input)->initialized = TRUE;
+
+        if (!(*input)->funcs.initialize)
+            continue;
+
+        n_startup_profile_begin (core->startup_profile, "input-init", (*input)->name);
+        ret = (*input)->funcs.initialize (*input);
+        n_startup_profile_end (core->startup_profile, "input-init", (*input)->name);
+
+        if (!ret) {
+            N_ERROR (LOG_CAT "input '%s' failed to initialize", (*input)->name);
+            if (fatal)
+                return FALSE;
+        }
     }
 
-    g_slist_free_full (conf_files, g_free);
+    if (waiting || core->init_done)
+        return TRUE;
 
-    if (n_event_list_size (eventlist) == 0) {
-        N_ERROR (LOG_CAT "no valid events defined.");
-        return FALSE;
+    for (sink = core->sinks; *sink; ++sink) {
+        if ((*sink)->init_state == N_SINK_INIT_PENDING)
+            return TRUE;
     }
 
+    /* fire the init done hook. */
+
+    core->init_done = TRUE;
+    n_core_fire_hook (core, N_CORE_HOOK_INIT_DONE, NULL);
+
+    n_startup_profile_mark (core->startup_profile, "init-done", NULL);
+    n_startup_profile_report (core->startup_profile);
+    n_startup_profile_free (core->startup_profile);
+    core->startup_profile = NULL;
+
     return TRUE;
 }
 
-static void
-n_core_parse_keytypes (NCore *core, GKeyFile *keyfile)
+static int
+n_core_init_sink (NSinkInterface *sink)
 {
-    g_assert (core != NULL);
-    g_assert (keyfile != NULL);
+    int ret = FALSE;
 
-    gchar **conf_keys = NULL;
-    gchar **key       = NULL;
-    gchar  *value     = NULL;
-    int     key_type  = 0;
+    if (!sink->funcs.initialize) {
+        sink->init_state = N_SINK_INIT_READY;
+        return TRUE;
+    }
 
-    /* load all the event configuration key entries. */
+    /* sinks with slow setup finish their initialization asynchronously
+       and are not used before they report the result. */
 
-    conf_keys = g_key_file_get_keys (keyfile, CORE_CONF_KEYTYPES, NULL, NULL);
-    if (!conf_keys)
-        return;
+    n_startup_profile_begin (sink->core->startup_profile, "sink-init", sink->name);
 
-    for (key = conf_keys; *key; ++key) {
-        value = g_key_file_get_string (keyfile, CORE_CONF_KEYTYPES, *key, NULL);
-        if (!value) {
-            N_WARNING (LOG_CAT "no datatype defined for key '%s'", *key);
-            continue;
-        }
+    if (!(ret = sink->funcs.initialize (sink))) {
+        n_startup_profile_end (sink->core->startup_profile, "sink-init", sink->name);
+        return FALSE;
+    }
 
-        if (strncmp (value, "INTEGER", 7) == 0)
-            key_type = N_VALUE_TYPE_INT;
-        else if (strncmp (value, "STRING", 6) == 0)
-            key_type = N_VALUE_TYPE_STRING;
-        else if (strncmp (value, "BOOLEAN", 7) == 0)
-            key_type = N_VALUE_TYPE_BOOL;
-
-        if (!key_type) {
-            N_WARNING (LOG_CAT "unrecognized datatype '%s' for key '%s'",
-                value, *key);
-            g_free (value);
-            continue;
-        }
+    /* asynchronous initialization is timed until the sink reports. */
 
-        N_DEBUG (LOG_CAT "new key type '%s' = %s", *key, value);
-        g_hash_table_replace (core->key_types, g_strdup (*key), GINT_TO_POINTER(key_type));
-        g_free (value);
+    if (ret == N_SINK_INTERFACE_INIT_PENDING) {
+        N_DEBUG (LOG_CAT "sink '%s' initializing asynchronously", sink->name);
+    } else {
+        n_startup_profile_end (sink->core->startup_profile, "sink-init", sink->name);
+        sink->init_state = N_SINK_INIT_READY;
     }
 
-    g_strfreev (conf_keys);
+    return TRUE;
 }
 
 static void
-n_core_parse_sink_order (NCore *core, GKeyFile *keyfile)
+n_core_lazy_plugin_free (NLazyPlugin *lazy)
 {
-    g_assert (core != NULL);
-    g_assert (keyfile != NULL);
+    if (lazy->params)
+        n_proplist_free (lazy->params);
 
-    gchar **sink_list = NULL;
+    g_strfreev (lazy->keys);
+    g_free (lazy->name);
+    g_free (lazy);
+}
+
+static NLazyPlugin*
+n_core_take_lazy_plugin (NCore *core, const char *plugin_name)
+{
+    GList       *iter = NULL;
+    NLazyPlugin *lazy = NULL;
+
+    for (iter = g_list_first (core->lazy_plugins); iter; iter = g_list_next (iter)) {
+        lazy = (NLazyPlugin*) iter->data;
+        if (g_str_equal (lazy->name, plugin_name)) {
+            core->lazy_plugins = g_list_delete_link (core->lazy_plugins, iter);
+            return lazy;
+        }
+    }
+
+    return NULL;
+}
+
+/* initializes plugin opened after startup and the interfaces it registers */
+static int
+n_core_start_plugin (NCore *core, NPlugin *plugin, gboolean required)
+{
+    unsigned int num_sinks  = 0;
+    unsigned int num_inputs = 0;
+    unsigned int i          = 0;
+
+    num_sinks  = core->num_sinks;
+    num_inputs = core->num_inputs;
+
+    if (!n_core_init_plugin (plugin, required))
+        return FALSE;
+
+    core->plugins = g_list_append (core->plugins, plugin);
+    n_core_invalidate_prepared (core);
+
+    if (core->sinks) {
+        n_core_set_sink_priorities (core->sinks, core->sink_order);
+
+        for (i = num_sinks; i < core->num_sinks; ++i) {
+            if (!n_core_init_sink (core->sinks[i])) {
+                N_WARNING (LOG_CAT "sink '%s' failed to initialize, not used",
+                    core->sinks[i]->name);
+                core->sinks[i]->init_state = N_SINK_INIT_FAILED;
+            }
+        }
+    }
+
+    if (num_inputs < core->num_inputs)
+        (void) n_core_start_inputs (core, FALSE);
+
+    return TRUE;
+}
+
+static int
+n_core_load_lazy_plugin (NCore *core, NLazyPlugin *lazy)
+{
+    NPlugin          *plugin     = NULL;
+    NLazyPlugin      *dep_lazy   = NULL;
+    gchar           **dep        = NULL;
+    int               ret        = FALSE;
+
+    N_INFO (LOG_CAT "loading plugin '%s' on demand", lazy->name);
+
+    plugin = n_core_open_plugin (core, lazy->name, lazy->params);
+    lazy->params = NULL;
+
+    if (!plugin)
+        return FALSE;
+
+    /* plugins it depends on may be loaded on demand as well. lazy plugin
+       is taken off the list before loading, so a cycle ends up here as a
+       missing dependency. */
+
+    for (dep = plugin->depends; dep && *dep; ++dep) {
+        if (n_core_find_plugin (core->plugins, *dep))
+            continue;
+
+        if ((dep_lazy = n_core_take_lazy_plugin (core, *dep)) != NULL) {
+            ret = n_core_load_lazy_plugin (core, dep_lazy);
+            n_core_lazy_plugin_free (dep_lazy);
+            if (ret)
+                continue;
+        }
+
+        N_WARNING (LOG_CAT "plugin '%s' depends on '%s' which is not available",
+            lazy->name, *dep);
+        n_plugin_unload (plugin);
+        return FALSE;
+    }
+
+    return n_core_start_plugin (core, plugin, lazy->required);
+}
+
+static gboolean
+n_core_plugin_sinks_pending (NCore *core, NPlugin *plugin)
+{
+    NSinkInterface **sink = NULL;
+
+    for (sink = core->sinks; sink && *sink; ++sink) {
+        if ((*sink)->plugin == plugin && (*sink)->init_state == N_SINK_INIT_PENDING)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* forget plugins loaded on demand once their sinks have settled. */
+static void
+n_core_prune_lazy_starting (NCore *core)
+{
+    GList       *iter = NULL;
+    GList       *next = NULL;
+    NLazyPlugin *lazy = NULL;
+
+    for (iter = g_list_first (core->lazy_starting); iter; iter = next) {
+        next = g_list_next (iter);
+        lazy = (NLazyPlugin*) iter->data;
+
+        if (!n_core_find_plugin (core->plugins, lazy->name) ||
+            !n_core_plugin_sinks_pending (core, lazy->plugin)) {
+            core->lazy_starting = g_list_delete_link (core->lazy_starting, iter);
+            n_core_lazy_plugin_free (lazy);
+        }
+    }
+}
+
+int
+n_core_load_lazy_plugins (NCore *core, NRequest *request)
+{
+    GList        *iter  = NULL;
+    NLazyPlugin  *lazy  = NULL;
+    gchar       **key   = NULL;
+    int           ret   = TRUE;
+
+    g_assert (core != NULL);
+    g_assert (request != NULL);
+
+    if (!core->lazy_plugins || !core->sinks_started)
+        return TRUE;
+
+    iter = core->lazy_plugins;
+    while (iter) {
+        lazy = (NLazyPlugin*) iter->data;
+
+        for (key = lazy->keys; *key; ++key) {
+            if (n_proplist_has_key (request->properties, *key))
+                break;
+        }
+
+        if (!*key) {
+            iter = g_list_next (iter);
+            continue;
+        }
+
+        /* plugin stays loaded, or is not tried again if it fails. loading
+           may take other plugins off the list, so start over. */
+
+        core->lazy_plugins = g_list_delete_link (core->lazy_plugins, iter);
+
+        if (!n_core_load_lazy_plugin (core, lazy)) {
+            if (lazy->required) {
+                N_ERROR (LOG_CAT "unable to load required plugin '%s' on demand", lazy->name);
+                ret = FALSE;
+            } else
+                N_INFO (LOG_CAT "unable to load optional plugin '%s' on demand", lazy->name);
+        } else {
+            /* requests with the keys of the plugin wait for its sinks
+               to finish initialization. */
+
+            lazy->plugin = n_core_find_plugin (core->plugins, lazy->name);
+            if (n_core_plugin_sinks_pending (core, lazy->plugin)) {
+                core->lazy_starting = g_list_append (core->lazy_starting, lazy);
+                lazy = NULL;
+            }
+        }
+
+        if (lazy)
+            n_core_lazy_plugin_free (lazy);
+        iter = core->lazy_plugins;
+    }
+
+    return ret;
+}
+
+gboolean
+n_core_lazy_sinks_pending (NCore *core, NRequest *request)
+{
+    GList        *iter = NULL;
+    gchar       **key  = NULL;
+
+    g_assert (core != NULL);
+    g_assert (request != NULL);
+
+    for (iter = g_list_first (core->lazy_starting); iter; iter = g_list_next (iter)) {
+        for (key = ((NLazyPlugin*) iter->data)->keys; *key; ++key) {
+            if (n_proplist_has_key (request->properties, *key))
+                return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/* stops requests that use sinks of the plugin, returns the number of
+   requests still active. */
+static guint
+n_core_stop_plugin_requests (NCore *core, NPlugin *plugin)
+{
+    GList    *iter    = NULL;
+    GList    *s       = NULL;
+    NRequest *request = NULL;
+    guint     active  = 0;
+
+    for (iter = g_list_first (core->requests); iter; iter = g_list_next (iter)) {
+        request = (NRequest*) iter->data;
+
+        for (s = g_list_first (request->all_sinks); s; s = g_list_next (s)) {
+            if (((NSinkInterface*) s->data)->plugin == plugin)
+                break;
+        }
+
+        if (!s)
+            continue;
+
+        n_core_stop_request (core, request, 0);
+        ++active;
+    }
+
+    return active;
+}
+
+static void
+n_core_remove_plugin_sinks (NCore *core, NPlugin *plugin)
+{
+    NSinkInterface *sink = NULL;
+    unsigned int    i    = 0;
+    unsigned int    n    = 0;
+
+    for (i = 0; i < core->num_sinks; ++i) {
+        sink = core->sinks[i];
+
+        if (sink->plugin != plugin) {
+            core->sinks[n++] = sink;
+            continue;
+        }
+
+        N_DEBUG (LOG_CAT "removing sink '%s'", sink->name);
+
+        if (sink->probe_source > 0)
+            g_source_remove (sink->probe_source);
+        if (sink->funcs.shutdown)
+            sink->funcs.shutdown (sink);
+        g_free (sink);
+    }
+
+    core->num_sinks = n;
+    core->sinks[n]  = NULL;
+}
+
+static gboolean
+n_core_plugin_reload_cb (gpointer userdata)
+{
+    NPluginReload *reload = (NPluginReload*) userdata;
+    NCore         *core   = reload->core;
+    NPlugin       *plugin = reload->plugin;
+    gchar         *name   = NULL;
+
+    /* wait for the requests to be done, and for the work pushed to
+       worker threads. completion of the work runs code of the plugin and
+       uses its data. work is not tracked per plugin, so all of it is
+       waited for. */
+
+    if (!reload->unloaded) {
+        if (n_core_stop_plugin_requests (core, plugin) > 0 ||
+            n_worker_pool_pending (core->workers) > 0)
+            return TRUE;
+
+        N_DEBUG (LOG_CAT "unloading plugin '%s'", plugin->get_name ());
+        n_core_remove_plugin_sinks (core, plugin);
+        core->plugins = g_list_remove (core->plugins, plugin);
+        plugin->unload (plugin);
+        reload->unloaded = TRUE;
+    }
+
+    /* shutting down the sinks may have pushed work of its own. */
+
+    if (n_worker_pool_pending (core->workers) > 0)
+        return TRUE;
+
+    core->reloads = g_list_remove (core->reloads, reload);
+    g_free (reload);
+
+    name = g_strdup (plugin->get_name ());
+
+    n_plugin_unload (plugin);
+    n_core_invalidate_prepared (core);
+
+    if ((plugin = n_core_open_plugin (core, name, NULL)) && n_core_start_plugin (core, plugin, TRUE))
+        N_INFO (LOG_CAT "plugin '%s' reloaded", name);
+    else
+        N_ERROR (LOG_CAT "unable to reload plugin '%s', plugin not available", name);
+
+    g_free (name);
+
+    return FALSE;
+}
+
+int
+n_core_reload_plugin (NCore *core, const char *plugin_name)
+{
+    NPlugin          *plugin = NULL;
+    NPluginReload    *reload = NULL;
+    NLazyPlugin      *lazy   = NULL;
+    NInputInterface **input  = NULL;
+    NSinkInterface  **sink   = NULL;
+    GList            *iter   = NULL;
+
+    g_assert (core != NULL);
+    g_assert (plugin_name != NULL);
+
+    if (!(plugin = n_core_find_plugin (core->plugins, plugin_name))) {
+        for (iter = g_list_first (core->lazy_plugins); iter; iter = g_list_next (iter)) {
+            lazy = (NLazyPlugin*) iter->data;
+            if (!g_str_equal (lazy->name, plugin_name))
+                continue;
+
+            /* not loaded yet, new parameters are used when it is. */
+
+            if (lazy->params)
+                n_proplist_free (lazy->params);
+            lazy->params = n_core_load_params (core, plugin_name);
+
+            N_INFO (LOG_CAT "parameters of plugin '%s' reloaded", plugin_name);
+            return TRUE;
+        }
+
+        N_WARNING (LOG_CAT "cannot reload plugin '%s', not loaded", plugin_name);
+        return FALSE;
+    }
+
+    for (iter = g_list_first (core->reloads); iter; iter = g_list_next (iter)) {
+        if (((NPluginReload*) iter->data)->plugin == plugin)
+            return TRUE;
+    }
+
+    /* inputs own the requests and plugins depending on the plugin may
+       hold on to it, so those are not reloaded. */
+
+    for (input = core->inputs; input && *input; ++input) {
+        if ((*input)->plugin == plugin) {
+            N_WARNING (LOG_CAT "cannot reload plugin '%s', it has input '%s'",
+                plugin_name, (*input)->name);
+            return FALSE;
+        }
+    }
+
+    for (iter = g_list_first (core->plugins); iter; iter = g_list_next (iter)) {
+        if (n_plugin_depends_on ((NPlugin*) iter->data, plugin_name)) {
+            N_WARNING (LOG_CAT "cannot reload plugin '%s', plugin '%s' depends on it",
+                plugin_name, ((NPlugin*) iter->data)->get_name ());
+            return FALSE;
+        }
+    }
+
+    /* sinks of the plugin are not used for new requests, and the plugin
+       is reloaded once the requests using them are done. */
+
+    for (sink = core->sinks; sink && *sink; ++sink) {
+        if ((*sink)->plugin == plugin)
+            (*sink)->init_state = N_SINK_INIT_PENDING;
+    }
+
+    N_INFO (LOG_CAT "reloading plugin '%s', stopping %u request(s)", plugin_name,
+        n_core_stop_plugin_requests (core, plugin));
+
+    reload = g_new0 (NPluginReload, 1);
+    reload->core      = core;
+    reload->plugin    = plugin;
+    reload->source_id = g_timeout_add (PLUGIN_RELOAD_POLL_MS, n_core_plugin_reload_cb, reload);
+    core->reloads     = g_list_append (core->reloads, reload);
+
+    return TRUE;
+}
+
+void
+n_core_reload_changed_plugins (NCore *core)
+{
+    NPluginConf *conf    = NULL;
+    NProplist   *empty   = NULL;
+    NPlugin     *plugin  = NULL;
+    GList       *plugins = NULL;
+    GList       *iter    = NULL;
+
+    g_assert (core != NULL);
+
+    n_core_reload_plugin_conf (core);
+
+    empty   = n_proplist_new ();
+    plugins = g_list_copy (core->plugins);
+
+    for (iter = plugins; iter; iter = g_list_next (iter)) {
+        plugin = (NPlugin*) iter->data;
+        conf   = g_hash_table_lookup (core->plugin_conf, plugin->get_name ());
+
+        if (!n_proplist_match_exact (plugin->params, conf ? conf->params : empty))
+            (void) n_core_reload_plugin (core, plugin->get_name ());
+    }
+
+    g_list_free (plugins);
+    n_proplist_free (empty);
+    n_core_release_plugin_conf (core);
+}
+
+void
+n_core_sink_initialized (NCore *core, NSinkInterface *sink, int success)
+{
+    g_assert (core != NULL);
+    g_assert (sink != NULL);
+
+    if (core->shutdown_done || sink->init_state != N_SINK_INIT_PENDING)
+        return;
+
+    n_startup_profile_end (core->startup_profile, "sink-init", sink->name);
+
+    if (success) {
+        N_DEBUG (LOG_CAT "sink '%s' initialized", sink->name);
+        sink->init_state = N_SINK_INIT_READY;
+        n_core_invalidate_prepared (core);
+    } else {
+        N_WARNING (LOG_CAT "sink '%s' failed to initialize, not used", sink->name);
+        sink->init_state = N_SINK_INIT_FAILED;
+    }
+
+    /* requests waiting for sinks loaded on demand may continue. */
+
+    if (core->lazy_starting) {
+        n_core_prune_lazy_starting (core);
+        n_core_resume_sink_waiting_requests (core);
+    }
+
+    /* sinks may complete while the rest are still being initialized. */
+
+    if (core->sinks_started)
+        (void) n_core_start_inputs (core, FALSE);
+}
+
+static void
+n_core_parse_events_from_file (NEventList *eventlist, const char *filename)
+{
+    g_assert (eventlist != NULL);
+    g_assert (filename != NULL);
+
+    GKeyFile  *keyfile    = NULL;
+    GError    *error      = NULL;
+
+    keyfile = g_key_file_new ();
+    if (!g_key_file_load_from_file (keyfile, filename, G_KEY_FILE_NONE, &error)) {
+        N_WARNING (LOG_CAT "failed to load event file: %s", error->message);
+        g_error_free    (error);
+        g_key_file_free (keyfile);
+        return;
+    }
+
+    N_DEBUG (LOG_CAT "processing event file '%s'", filename);
+
+    n_event_list_parse_keyfile (eventlist, keyfile);
+
+    g_key_file_free (keyfile);
+}
+
+static int
+n_core_parse_events (NEventList *eventlist, const char *conf_path)
+{
+    GSList        *conf_files = NULL;
+    GSList        *i          = NULL;
+    gchar         *filename   = NULL;
+
+    /* find all the events within the given path */
+    conf_files = n_core_conf_files_from_path (conf_path, EVENT_CONF_PATH);
+
+    if (!conf_files)
+        return FALSE;
+
+    for (i = conf_files; i; i = g_slist_next (i)) {
+        filename = i->data;
+        n_core_parse_events_from_file (eventlist, filename);
+    }
+
+    g_slist_free_full (conf_files, g_free);
+
+    if (n_event_list_size (eventlist) == 0) {
+        N_ERROR (LOG_CAT "no valid events defined.");
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+n_core_add_keytype (NCore *core, const char *key, const char *value)
+{
+    int key_type = 0;
+
+    if (!value) {
+        N_WARNING (LOG_CAT "no datatype defined for key '%s'", key);
+        return;
+    }
+
+    if (strncmp (value, "INTEGER", 7) == 0)
+        key_type = N_VALUE_TYPE_INT;
+    else if (strncmp (value, "STRING", 6) == 0)
+        key_type = N_VALUE_TYPE_STRING;
+    else if (strncmp (value, "BOOLEAN", 7) == 0)
+        key_type = N_VALUE_TYPE_BOOL;
+
+    if (!key_type) {
+        N_WARNING (LOG_CAT "unrecognized datatype '%s' for key '%s'",
+            value, key);
+        return;
+    }
+
+    N_DEBUG (LOG_CAT "new key type '%s' = %s", key, value);
+    g_hash_table_replace (core->key_types, g_strdup (key), GINT_TO_POINTER(key_type));
+
+    g_rw_lock_writer_lock (&core->request_keys_lock);
+    if (core->request_keys && g_hash_table_contains (core->request_keys, key))
+        g_hash_table_replace (core->request_keys, g_strdup (key), GINT_TO_POINTER (key_type));
+    g_rw_lock_writer_unlock (&core->request_keys_lock);
+}
+
+static void
+n_core_parse_keytypes (NCore *core, GKeyFile *keyfile)
+{
+    g_assert (core != NULL);
+    g_assert (keyfile != NULL);
+
+    gchar **conf_keys = NULL;
+    gchar **key       = NULL;
+    gchar  *value     = NULL;
+
+    /* load all the event configuration key entries. */
+
+    conf_keys = g_key_file_get_keys (keyfile, CORE_CONF_KEYTYPES, NULL, NULL);
+    if (!conf_keys)
+        return;
+
+    for (key = conf_keys; *key; ++key) {
+        value = g_key_file_get_string (keyfile, CORE_CONF_KEYTYPES, *key, NULL);
+        n_core_add_keytype (core, *key, value);
+        g_free (value);
+    }
+
+    g_strfreev (conf_keys);
+}
+
+static void
+n_core_parse_sink_order (NCore *core, GKeyFile *keyfile)
+{
+    g_assert (core != NULL);
+    g_assert (keyfile != NULL);
+
+    gchar **sink_list = NULL;
     gchar **item      = NULL;
     gsize   num_items = 0;
 
@@ -769,6 +1736,70 @@ n_core_parse_sink_order (NCore *core, GKeyFile *keyfile)
     g_strfreev (sink_list);
 }
 
+static gboolean
+n_core_get_conf_uint (GKeyFile *keyfile, const char *key, guint *value)
+{
+    GError *error  = NULL;
+    gint    result = 0;
+
+    result = g_key_file_get_integer (keyfile, "general", key, &error);
+    if (error) {
+        g_error_free (error);
+        return FALSE;
+    }
+
+    if (result < 0) {
+        N_WARNING (LOG_CAT "invalid %s %d, using %u", key, result, *value);
+        return FALSE;
+    }
+
+    *value = (guint) result;
+    return TRUE;
+}
+
+static void
+n_core_parse_sink_breaker (NCore *core, GKeyFile *keyfile)
+{
+    g_assert (core != NULL);
+    g_assert (keyfile != NULL);
+
+    n_core_get_conf_uint (keyfile, "sink-failure-limit", &core->sink_failure_limit);
+    n_core_get_conf_uint (keyfile, "sink-probe-interval", &core->sink_probe_interval);
+
+    if (core->sink_failure_limit == 0)
+        core->sink_failure_limit = DEFAULT_SINK_FAILURE_LIMIT;
+    if (core->sink_probe_interval == 0)
+        core->sink_probe_interval = DEFAULT_SINK_PROBE_INTERVAL_MS;
+
+    N_DEBUG (LOG_CAT "sink failure limit %u, probe interval %u ms",
+        core->sink_failure_limit, core->sink_probe_interval);
+}
+
+static void
+n_core_parse_load_monitor (NCore *core, GKeyFile *keyfile)
+{
+    g_assert (core != NULL);
+    g_assert (keyfile != NULL);
+
+    guint interval        = DEFAULT_LAG_INTERVAL_MS;
+    guint defer_threshold = DEFAULT_LAG_DEFER_THRESHOLD_MS;
+    guint shed_threshold  = DEFAULT_LAG_SHED_THRESHOLD_MS;
+    guint priority        = DEFAULT_PROTECTED_PRIORITY;
+
+    /* interval or threshold of 0 disables the feature. */
+
+    n_core_get_conf_uint (keyfile, "lag-interval", &interval);
+    n_core_get_conf_uint (keyfile, "lag-defer-threshold", &defer_threshold);
+    n_core_get_conf_uint (keyfile, "lag-shed-threshold", &shed_threshold);
+    n_core_get_conf_uint (keyfile, "lag-max-defer", &core->max_defer);
+
+    if (n_core_get_conf_uint (keyfile, "lag-protected-priority", &priority))
+        core->protected_priority = (gint) priority;
+
+    n_load_monitor_configure (core->load_monitor, interval, defer_threshold,
+        shed_threshold);
+}
+
 static void
 parse_plugins (gchar **plugins, GList **list)
 {
@@ -780,6 +1811,96 @@ parse_plugins (gchar **plugins, GList **list)
         *list = g_list_append (*list, g_strdup (*item));
 }
 
+static void
+n_core_parse_context_store (NCore *core, GKeyFile *keyfile)
+{
+    g_assert (core != NULL);
+    g_assert (keyfile != NULL);
+
+    gchar  **keys  = NULL;
+    gchar   *path  = NULL;
+    guint    delay = DEFAULT_CONTEXT_WRITE_DELAY_MS;
+    guint    age   = 0;
+
+    if (!(keys = g_key_file_get_string_list (keyfile, "general", "persist-context", NULL, NULL)))
+        return;
+
+    if (!(path = g_key_file_get_string (keyfile, "general", "persist-context-file", NULL)))
+        path = g_build_filename (g_get_user_cache_dir (), "ngfd", DEFAULT_CONTEXT_STATE_FILE, NULL);
+
+    (void) n_core_get_conf_uint (keyfile, "persist-context-delay", &delay);
+    (void) n_core_get_conf_uint (keyfile, "persist-context-max-age", &age);
+
+    N_DEBUG (LOG_CAT "persisting %u context keys to '%s'", g_strv_length (keys), path);
+    n_context_store_configure (core->context_store, path, keys, delay, age);
+
+    g_free (path);
+    g_strfreev (keys);
+}
+
+static void
+n_core_take_plugin_name (GList **list, const char *plugin_name, gboolean *found)
+{
+    GList *iter = NULL;
+
+    if ((iter = g_list_find_custom (*list, plugin_name, (GCompareFunc) g_strcmp0)) != NULL) {
+        g_free (iter->data);
+        *list  = g_list_delete_link (*list, iter);
+        *found = TRUE;
+    }
+}
+
+static void
+n_core_parse_lazy_plugins (NCore *core, GKeyFile *keyfile)
+{
+    g_assert (core != NULL);
+    g_assert (keyfile != NULL);
+
+    NLazyPlugin  *lazy     = NULL;
+    gchar       **names    = NULL;
+    gchar       **name     = NULL;
+    gchar       **keys     = NULL;
+    gboolean      required = FALSE;
+    gboolean      optional = FALSE;
+
+    /* plugins listed in the lazy group are not loaded at startup, but the
+       first time a request has one of the keys their sinks handle. */
+
+    if (!(names = g_key_file_get_keys (keyfile, CORE_CONF_LAZY_PLUGINS, NULL, NULL)))
+        return;
+
+    for (name = names; *name; ++name) {
+        keys = g_key_file_get_string_list (keyfile, CORE_CONF_LAZY_PLUGINS, *name, NULL, NULL);
+
+        if (!keys || !*keys) {
+            N_WARNING (LOG_CAT "no keys for lazy plugin '%s', loading at startup", *name);
+            g_strfreev (keys);
+            continue;
+        }
+
+        required = FALSE;
+        optional = FALSE;
+        n_core_take_plugin_name (&core->required_plugins, *name, &required);
+        n_core_take_plugin_name (&core->optional_plugins, *name, &optional);
+
+        if (!required && !optional) {
+            N_WARNING (LOG_CAT "lazy plugin '%s' is not in plugins or plugins-optional, ignored", *name);
+            g_strfreev (keys);
+            continue;
+        }
+
+        N_DEBUG (LOG_CAT "plugin '%s' loaded on demand", *name);
+
+        lazy = g_new0 (NLazyPlugin, 1);
+        lazy->name     = g_strdup (*name);
+        lazy->keys     = keys;
+        lazy->required = required;
+        core->lazy_plugins = g_list_append (core->lazy_plugins, lazy);
+    }
+
+    g_strfreev (names);
+}
+
 static int
 n_core_parse_configuration (NCore *core)
 {
@@ -790,6 +1911,8 @@ n_core_parse_configuration (NCore *core)
     GError    *error      = NULL;
     gchar     *filename   = NULL;
     gchar    **plugins    = NULL;
+    guint      threads    = DEFAULT_WORKER_THREADS;
+    guint      idle_trim  = DEFAULT_IDLE_TRIM_MS;
 
     filename = g_build_filename (core->conf_path, DEFAULT_CONF_FILENAME, NULL);
     keyfile  = g_key_file_new ();
@@ -816,6 +1939,10 @@ n_core_parse_configuration (NCore *core)
         g_strfreev (plugins);
     }
 
+    /* plugins loaded when first needed. */
+
+    n_core_parse_lazy_plugins (core, keyfile);
+
     /* load all the event configuration key entries. */
 
     n_core_parse_keytypes (core, keyfile);
@@ -824,6 +1951,28 @@ n_core_parse_configuration (NCore *core)
 
     n_core_parse_sink_order (core, keyfile);
 
+    /* load the limits for skipping failing sinks. */
+
+    n_core_parse_sink_breaker (core, keyfile);
+
+    /* load the main loop lag thresholds. */
+
+    n_core_parse_load_monitor (core, keyfile);
+
+    /* number of threads for blocking sink operations. */
+
+    if (n_core_get_conf_uint (keyfile, "worker-threads", &threads))
+        n_worker_pool_set_threads (core->workers, threads);
+
+    /* context keys kept over restarts. */
+
+    n_core_parse_context_store (core, keyfile);
+
+    /* idle time before releasing memory. */
+
+    (void) n_core_get_conf_uint (keyfile, "idle-trim", &idle_trim);
+    n_idle_trim_configure (core->idle_trim, idle_trim);
+
     g_key_file_free (keyfile);
     g_free          (filename);
 
@@ -842,6 +1991,12 @@ n_core_evaluate_request (NCore *core, NRequest *request)
     N_DEBUG (LOG_CAT "evaluating events for request '%s'",
         request->name);
 
+    /* pin the context, so that the whole evaluation sees the same values
+       even if a change is being applied. */
+
+    if (!request->snapshot)
+        request->snapshot = n_context_snapshot (core->context);
+
     if ((event = n_event_list_match_request (core->eventlist, request))) {
         N_DEBUG (LOG_CAT "evaluated to '%s'", event->name);
         n_event_rules_dump (event, LOG_CAT);
@@ -850,6 +2005,52 @@ n_core_evaluate_request (NCore *core, NRequest *request)
     return event;
 }
 
+void
+n_core_invalidate_prepared (NCore *core)
+{
+    g_assert (core != NULL);
+
+    core->prepare_generation++;
+}
+
+const NValue*
+n_core_get_request_context_value (NCore *core, NRequest *request,
+                                  const char *key)
+{
+    guint i;
+
+    g_assert (core != NULL);
+    g_assert (request != NULL);
+    g_assert (key != NULL);
+
+    if (!request->context_keys)
+        request->context_keys = g_ptr_array_new_with_free_func (g_free);
+
+    for (i = 0; i < request->context_keys->len; i++) {
+        if (g_str_equal (g_ptr_array_index (request->context_keys, i), key))
+            break;
+    }
+    if (i == request->context_keys->len)
+        g_ptr_array_add (request->context_keys, g_strdup (key));
+
+    return n_context_get_value (core->context, key);
+}
+
+gboolean
+n_core_context_changed_since (NCore *core, gchar **keys, guint serial)
+{
+    gchar **key = NULL;
+
+    g_assert (core != NULL);
+
+    for (key = keys; key && *key; ++key) {
+        if (GPOINTER_TO_UINT (g_hash_table_lookup (core->context_changes, *key)) > serial)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
 NContext*
 n_core_get_context (NCore *core)
 {
@@ -883,6 +2084,15 @@ n_core_get_events (NCore *core)
     return n_event_list_get_events (core->eventlist);
 }
 
+int
+n_core_is_init_done (NCore *core)
+{
+    if (!core)
+        return FALSE;
+
+    return core->init_done;
+}
+
 int
 n_core_connect (NCore *core, NCoreHook hook, int priority,
                 NHookCallback callback, void *userdata)
@@ -901,6 +2111,99 @@ n_core_connect (NCore *core, NCoreHook hook, int priority,
     return TRUE;
 }
 
+static NRequest*
+n_core_hook_request (NCoreHook hook, void *data)
+{
+    if (!data)
+        return NULL;
+
+    switch (hook) {
+        case N_CORE_HOOK_NEW_REQUEST:
+            return ((NCoreHookNewRequestData*) data)->request;
+        case N_CORE_HOOK_TRANSFORM_PROPERTIES:
+            return ((NCoreHookTransformPropertiesData*) data)->request;
+        case N_CORE_HOOK_FILTER_SINKS:
+            return ((NCoreHookFilterSinksData*) data)->request;
+        default:
+            return NULL;
+    }
+}
+
+static gboolean
+n_core_hook_filter_cb (NHook *hook, void *data, void *filter_data)
+{
+    NCoreFilter      *filter  = (NCoreFilter*) filter_data;
+    NRequest         *request = NULL;
+    const NProplist  *props   = NULL;
+    gchar           **key     = NULL;
+
+    (void) hook;
+
+    if (!(request = n_core_hook_request (filter->hook, data)))
+        return FALSE;
+
+    if (filter->events && !g_hash_table_contains (filter->events, n_request_get_name (request)))
+        return FALSE;
+
+    if (!filter->keys)
+        return TRUE;
+
+    props = n_request_get_properties (request);
+    for (key = filter->keys; *key; ++key) {
+        if (n_proplist_has_key (props, *key))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void
+n_core_filter_free (NCoreFilter *filter)
+{
+    if (filter->events)
+        g_hash_table_destroy (filter->events);
+    g_strfreev (filter->keys);
+    g_slice_free (NCoreFilter, filter);
+}
+
+int
+n_core_connect_filtered (NCore *core, NCoreHook hook, int priority,
+                         const NCoreHookFilter *filter,
+                         NHookCallback callback, void *userdata)
+{
+    NCoreFilter        *core_filter = NULL;
+    const char *const  *event       = NULL;
+
+    if (!core || !callback)
+        return FALSE;
+
+    if (!filter)
+        return n_core_connect (core, hook, priority, callback, userdata);
+
+    if (hook >= N_CORE_HOOK_LAST || hook == N_CORE_HOOK_INIT_DONE) {
+        N_WARNING (LOG_CAT "hook '%s' cannot be filtered", n_core_hook_to_string (hook));
+        return FALSE;
+    }
+
+    core_filter = g_slice_new0 (NCoreFilter);
+    core_filter->hook = hook;
+    core_filter->keys = g_strdupv ((gchar**) filter->keys);
+
+    if (filter->events) {
+        core_filter->events = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                     g_free, NULL);
+        for (event = filter->events; *event; ++event)
+            g_hash_table_add (core_filter->events, g_strdup (*event));
+    }
+
+    N_DEBUG (LOG_CAT "0x%p connected to hook '%s' with filter", callback,
+        n_core_hook_to_string (hook));
+
+    return n_hook_connect_filtered (&core->hooks[hook], priority,
+        n_core_hook_filter_cb, core_filter, (GDestroyNotify) n_core_filter_free,
+        callback, userdata);
+}
+
 void
 n_core_disconnect (NCore *core, NCoreHook hook, NHookCallback callback,
                    void *userdata)
@@ -914,6 +2217,90 @@ n_core_disconnect (NCore *core, NCoreHook hook, NHookCallback callback,
     n_hook_disconnect (&core->hooks[hook], callback, userdata);
 }
 
+static gboolean
+n_core_add_request_key (NCore *core, GHashTable *keys, const char *key)
+{
+    if (g_hash_table_contains (keys, key))
+        return FALSE;
+
+    g_hash_table_insert (keys, g_strdup (key),
+        g_hash_table_lookup (core->key_types, key));
+
+    return TRUE;
+}
+
+/* keys event rules match requests with are accepted as well, they are
+   needed to resolve the event even if the request drops them later. the
+   table is built aside and swapped in, so that lookups from input threads
+   wait only for the swap. */
+static void
+n_core_build_request_keys (NCore *core)
+{
+    GHashTable  *keys       = NULL;
+    GHashTable  *old_keys   = NULL;
+    NEventRule  *rule       = NULL;
+    GSList      *iter       = NULL;
+    gchar      **key        = NULL;
+    guint        rule_keys  = 0;
+
+    if (core->request_key_names) {
+        keys = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+        for (key = core->request_key_names; *key; ++key)
+            (void) n_core_add_request_key (core, keys, *key);
+
+        for (iter = core->eventlist->rule_list; iter; iter = g_slist_next (iter)) {
+            rule = (NEventRule*) iter->data;
+
+            if (rule->target == N_EVENT_RULE_REQUEST && n_core_add_request_key (core, keys, rule->key))
+                ++rule_keys;
+        }
+
+        N_DEBUG (LOG_CAT "%u keys accepted in requests, %u of them for event rules",
+            g_hash_table_size (keys), rule_keys);
+    } else {
+        N_DEBUG (LOG_CAT "all keys accepted in requests");
+    }
+
+    g_rw_lock_writer_lock (&core->request_keys_lock);
+    old_keys = core->request_keys;
+    core->request_keys = keys;
+    g_rw_lock_writer_unlock (&core->request_keys_lock);
+
+    if (old_keys)
+        g_hash_table_destroy (old_keys);
+}
+
+void
+n_core_set_request_keys (NCore *core, const char *const *keys)
+{
+    g_assert (core != NULL);
+
+    g_strfreev (core->request_key_names);
+    core->request_key_names = g_strdupv ((gchar**) keys);
+
+    n_core_build_request_keys (core);
+}
+
+gboolean
+n_core_lookup_request_key (NCore *core, const char *key, int *type)
+{
+    gpointer value    = NULL;
+    gboolean accepted = TRUE;
+
+    g_assert (core != NULL);
+    g_assert (key != NULL);
+    g_assert (type != NULL);
+
+    g_rw_lock_reader_lock (&core->request_keys_lock);
+    if (core->request_keys)
+        accepted = g_hash_table_lookup_extended (core->request_keys, key, NULL, &value);
+    g_rw_lock_reader_unlock (&core->request_keys_lock);
+
+    *type = GPOINTER_TO_INT (value);
+    return accepted;
+}
+
 void
 n_core_fire_hook (NCore *core, NCoreHook hook, void *data)
 {
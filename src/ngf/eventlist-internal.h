@@ -42,5 +42,6 @@ GList*      n_event_list_get_events     (NEventList *eventlist);
 guint       n_event_list_size           (const NEventList *eventlist);
 
 NEvent*     n_event_list_match_request  (NEventList *eventlist, NRequest *request);
+void        n_event_list_add_context_keys (NEventList *eventlist, const char *name, GPtrArray *keys);
 
 #endif
@@ -38,22 +38,18 @@ static void         parse_defines               (NCore *core, GKeyFile *keyfile,
 static void         event_list_free_cb          (gpointer in_key, gpointer in_data,
                                                  gpointer userdata);
 static void         event_rule_free_cb          (gpointer data);
-static void         cache_rule_context_cb       (NContext *context, const char *key,
-                                                 const NValue *old_value, const NValue *new_value,
-                                                 void *userdata);
 static void         match_event_rule_cb         (gpointer data, gpointer userdata);
 static void         event_dump_value_cb         (const char *key, const NValue *value,
                                                  gpointer userdata);
 static gint         sort_event_cb               (gconstpointer a, gconstpointer b);
 static const char*  strip_prefix                (const char *group, const char *prefix);
-static void         subscribe_event_rules_cb    (gpointer data, gpointer userdata);
-static void         unsubscribe_event_rules_cb  (gpointer data, gpointer userdata);
 
 typedef struct _NEventMatchResult
 {
-    NRequest *request;
-    NContext *context;
-    gboolean  has_match;
+    NRequest         *request;
+    NContextSnapshot *snapshot;
+    guint             generation;
+    gboolean          has_match;
 } NEventMatchResult;
 
 NEventList*
@@ -296,10 +292,7 @@ n_event_list_parse_keyfile (NEventList *eventlist, GKeyFile *keyfile)
         event = n_event_new_from_group (&eventlist->rule_list, keyfile, *group,
                                         eventlist->core->key_types, defines);
         if (event) {
-            event = event_list_add_event (eventlist, event);
-            if (event)
-                g_slist_foreach (event->rules, subscribe_event_rules_cb,
-                                 n_core_get_context (eventlist->core));
+            (void) event_list_add_event (eventlist, event);
             parsed++;
         }
     }
@@ -357,9 +350,6 @@ n_event_list_free (NEventList *eventlist)
 {
     g_assert (eventlist);
 
-    g_slist_foreach (eventlist->rule_list, unsubscribe_event_rules_cb,
-                     n_core_get_context (eventlist->core));
-
     g_slist_free_full    (eventlist->rule_list, event_rule_free_cb);
     g_list_free          (eventlist->event_list);
     g_hash_table_foreach (eventlist->event_table, event_list_free_cb, NULL);
@@ -367,41 +357,6 @@ n_event_list_free (NEventList *eventlist)
     g_free (eventlist);
 }
 
-static void
-cache_rule_context_cb (NContext *context,
-                       const char *key,
-                       const NValue *old_value,
-                       const NValue *new_value,
-                       void *userdata)
-{
-    NEventRule *rule = userdata;
-
-    (void) context;
-
-    g_assert (rule->target == N_EVENT_RULE_CONTEXT);
-
-    if (n_event_rule_cached_value_set (rule, n_event_rule_match (rule, new_value)) &&
-
-        n_log_get_level() <= N_LOG_LEVEL_DEBUG) {
-
-        char *old_value_str;
-        char *new_value_str;
-        char *rule_value_str;
-
-        rule_value_str = n_value_to_string (rule->value);
-        old_value_str = n_value_to_string (old_value);
-        new_value_str = n_value_to_string (new_value);
-
-        N_DEBUG (LOG_CAT "cache " N_EVENT_RULE_CONTEXT_PREFIX "%s(%s): %s -> %s: %s",
-                         key, rule_value_str,
-                         old_value_str, new_value_str,
-                         n_event_rule_cached_value (rule) ? "true" : "false");
-        g_free (rule_value_str);
-        g_free (old_value_str);
-        g_free (new_value_str);
-    }
-}
-
 static void
 match_event_rule_cb (gpointer data, gpointer userdata)
 {
@@ -413,7 +368,9 @@ match_event_rule_cb (gpointer data, gpointer userdata)
     if (!result->has_match)
         return;
 
-    if (n_event_rule_cached (rule)) {
+    /* cached context rule is valid only for the same context generation. */
+
+    if (n_event_rule_cached (rule, result->generation)) {
         if (!n_event_rule_cached_value (rule))
             result->has_match = FALSE;
         N_DEBUG (LOG_CAT "-> (cached) " N_EVENT_RULE_CONTEXT_PREFIX "'%s'-> %s",
@@ -423,13 +380,13 @@ match_event_rule_cb (gpointer data, gpointer userdata)
     }
 
     switch (rule->target) {
-        case N_EVENT_RULE_CONTEXT:  match_value = n_context_get_value (result->context, rule->key); break;
+        case N_EVENT_RULE_CONTEXT:  match_value = n_context_snapshot_get_value (result->snapshot, rule->key); break;
         case N_EVENT_RULE_REQUEST:  match_value = n_proplist_get (request->properties, rule->key);  break;
     };
 
     result->has_match = n_event_rule_match (rule, match_value);
 
-    n_event_rule_cached_value_set (rule, result->has_match);
+    n_event_rule_cached_value_set (rule, result->has_match, result->generation);
 
     if (n_log_get_level() <= N_LOG_LEVEL_DEBUG) {
         gchar      *value_str       = NULL;
@@ -451,6 +408,38 @@ match_event_rule_cb (gpointer data, gpointer userdata)
     }
 }
 
+/* add context keys of the rules of all events with the name to keys. */
+void
+n_event_list_add_context_keys (NEventList *eventlist, const char *name, GPtrArray *keys)
+{
+    GList      *iter = NULL;
+    GSList     *r    = NULL;
+    NEventRule *rule = NULL;
+    guint       i;
+
+    g_assert (eventlist);
+    g_assert (keys);
+
+    if (!name)
+        return;
+
+    iter = g_hash_table_lookup (eventlist->event_table, name);
+    for (iter = g_list_first (iter); iter; iter = g_list_next (iter)) {
+        for (r = ((NEvent*) iter->data)->rules; r; r = g_slist_next (r)) {
+            rule = r->data;
+            if (rule->target != N_EVENT_RULE_CONTEXT)
+                continue;
+
+            for (i = 0; i < keys->len; i++) {
+                if (g_str_equal (g_ptr_array_index (keys, i), rule->key))
+                    break;
+            }
+            if (i == keys->len)
+                g_ptr_array_add (keys, g_strdup (rule->key));
+        }
+    }
+}
+
 NEvent*
 n_event_list_match_request (NEventList *eventlist, NRequest *request)
 {
@@ -459,6 +448,8 @@ n_event_list_match_request (NEventList *eventlist, NRequest *request)
     GList  *event_list = NULL;
     GList  *iter       = NULL;
 
+    NContextSnapshot *snapshot = NULL;
+
     NEventMatchResult result;
 
     g_assert (eventlist);
@@ -470,6 +461,9 @@ n_event_list_match_request (NEventList *eventlist, NRequest *request)
     if (!event_list)
         return NULL;
 
+    snapshot = request->snapshot ? request->snapshot
+                                 : n_context_snapshot (n_core_get_context (eventlist->core));
+
     /* for each event, match the properties. */
 
     for (iter = g_list_first (event_list); iter; iter = g_list_next (iter)) {
@@ -483,7 +477,8 @@ n_event_list_match_request (NEventList *eventlist, NRequest *request)
         }
 
         result.request    = request;
-        result.context    = n_core_get_context (eventlist->core);
+        result.snapshot   = snapshot;
+        result.generation = n_context_snapshot_get_generation (snapshot);
         result.has_match  = TRUE;
 
         N_DEBUG (LOG_CAT "consider event '%s' (priority %d)", event->name, event->priority);
@@ -495,31 +490,8 @@ n_event_list_match_request (NEventList *eventlist, NRequest *request)
         }
     }
 
-    return found;
-}
+    if (snapshot != request->snapshot)
+        n_context_snapshot_unref (snapshot);
 
-static void
-subscribe_event_rules_cb (gpointer data, gpointer userdata)
-{
-    NEventRule *rule    = data;
-    NContext   *context = userdata;
-
-    if (rule->target == N_EVENT_RULE_CONTEXT &&
-        rule->cache == N_EVENT_RULE_CACHE_INACTIVE) {
-        n_context_subscribe_value_change (context, rule->key, cache_rule_context_cb, rule);
-        rule->cache = N_EVENT_RULE_CACHE_UNSET;
-    }
-}
-
-static void
-unsubscribe_event_rules_cb (gpointer data, gpointer userdata)
-{
-    NEventRule *rule    = data;
-    NContext   *context = userdata;
-
-    if (rule->target == N_EVENT_RULE_CONTEXT &&
-        rule->cache != N_EVENT_RULE_CACHE_INACTIVE) {
-        n_context_unsubscribe_value_change (context, rule->key, cache_rule_context_cb);
-        rule->cache = N_EVENT_RULE_CACHE_INACTIVE;
-    }
+    return found;
 }
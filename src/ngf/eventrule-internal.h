@@ -59,6 +59,7 @@ typedef struct _NEventRule
     NValue             *value;
     NEventRuleOp        op;
     NEventRuleCache     cache;
+    guint               cache_generation;   /* context generation of cached value */
 } NEventRule;
 
 NEventRule* n_event_rule_parse            (const char *rule_str);
@@ -67,9 +68,9 @@ void        n_event_rule_unref            (NEventRule *rule);
 gboolean    n_event_rule_equal            (const NEventRule *a, const NEventRule *b);
 void        n_event_rule_dump             (const NEventRule *rule, const char *debug_prefix);
 gboolean    n_event_rule_match            (const NEventRule *rule, const NValue *match_value);
-gboolean    n_event_rule_cached           (const NEventRule *rule);
+gboolean    n_event_rule_cached           (const NEventRule *rule, guint generation);
 gboolean    n_event_rule_cached_value     (const NEventRule *rule);
-gboolean    n_event_rule_cached_value_set (NEventRule *rule, gboolean value);
+gboolean    n_event_rule_cached_value_set (NEventRule *rule, gboolean value, guint generation);
 const char* n_event_rule_op_string        (const NEventRule *rule);
 
 gboolean    n_parse_number                (const char *str, gint64 *value);
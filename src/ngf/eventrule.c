@@ -307,12 +307,13 @@ done:
 #undef MATCH_VALUES
 
 gboolean
-n_event_rule_cached (const NEventRule *rule)
+n_event_rule_cached (const NEventRule *rule, guint generation)
 {
     g_assert (rule);
 
     return rule->target == N_EVENT_RULE_CONTEXT &&
-           rule->cache > N_EVENT_RULE_CACHE_UNSET;
+           rule->cache > N_EVENT_RULE_CACHE_UNSET &&
+           rule->cache_generation == generation;
 }
 
 gboolean
@@ -324,7 +325,7 @@ n_event_rule_cached_value (const NEventRule *rule)
 }
 
 gboolean
-n_event_rule_cached_value_set (NEventRule *rule, gboolean value)
+n_event_rule_cached_value_set (NEventRule *rule, gboolean value, guint generation)
 {
     gboolean changed = FALSE;
 
@@ -333,6 +334,7 @@ n_event_rule_cached_value_set (NEventRule *rule, gboolean value)
     if (rule->target == N_EVENT_RULE_CONTEXT) {
         changed = (rule->cache == N_EVENT_RULE_CACHE_TRUE) != value;
         rule->cache = value ? N_EVENT_RULE_CACHE_TRUE : N_EVENT_RULE_CACHE_FALSE;
+        rule->cache_generation = generation;
     }
 
     return changed;
@@ -29,6 +29,9 @@ typedef struct _NHookSlot
     int            priority;
     NHookCallback  callback;
     void          *userdata;
+    NHookFilter    filter;
+    void          *filter_data;
+    GDestroyNotify filter_destroy;
 } NHookSlot;
 
 static void
@@ -37,6 +40,9 @@ n_hook_slot_free (NHookSlot *slot)
     if (!slot)
         return;
 
+    if (slot->filter_destroy)
+        slot->filter_destroy (slot->filter_data);
+
     g_slice_free (NHookSlot, slot);
 }
 
@@ -62,6 +68,15 @@ n_hook_sort_slot_cb (gconstpointer in_a, gconstpointer in_b)
 int
 n_hook_connect (NHook *hook, int priority, NHookCallback callback,
                 void *userdata)
+{
+    return n_hook_connect_filtered (hook, priority, NULL, NULL, NULL,
+                                    callback, userdata);
+}
+
+int
+n_hook_connect_filtered (NHook *hook, int priority, NHookFilter filter,
+                         void *filter_data, GDestroyNotify filter_destroy,
+                         NHookCallback callback, void *userdata)
 {
     NHookSlot *slot = NULL;
 
@@ -69,10 +84,13 @@ n_hook_connect (NHook *hook, int priority, NHookCallback callback,
         return FALSE;
 
     slot = g_slice_new0 (NHookSlot);
-    slot->hook     = hook;
-    slot->callback = callback;
-    slot->userdata = userdata;
-    slot->priority = priority;
+    slot->hook           = hook;
+    slot->callback       = callback;
+    slot->userdata       = userdata;
+    slot->priority       = priority;
+    slot->filter         = filter;
+    slot->filter_data    = filter_data;
+    slot->filter_destroy = filter_destroy;
 
     hook->slots = g_list_append (hook->slots, slot);
     hook->slots = g_list_sort (hook->slots, n_hook_sort_slot_cb);
@@ -108,6 +126,8 @@ n_hook_fire (NHook *hook, void *data)
 
     for (iter = g_list_first (hook->slots); iter; iter = g_list_next (iter)) {
         NHookSlot *slot = (NHookSlot*) iter->data;
+        if (slot->filter && !slot->filter (hook, data, slot->filter_data))
+            continue;
         slot->callback (hook, data, slot->userdata);
     }
 
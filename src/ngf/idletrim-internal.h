@@ -0,0 +1,33 @@
+/*
+ * ngfd - Non-graphic feedback daemon
+ * Releasing memory when idle
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef N_CORE_IDLE_TRIM_INTERNAL_H_
+#define N_CORE_IDLE_TRIM_INTERNAL_H_
+
+#include <glib.h>
+#include <ngf/core.h>
+
+typedef struct NIdleTrim NIdleTrim;
+
+NIdleTrim* n_idle_trim_new       (NCore *core);
+void       n_idle_trim_free      (NIdleTrim *trim);
+void       n_idle_trim_configure (NIdleTrim *trim, guint idle_period);
+void       n_idle_trim_activity  (NIdleTrim *trim);
+
+#endif
@@ -0,0 +1,228 @@
+/*
+ * ngfd - Non-graphic feedback daemon
+ * Releasing memory when idle
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#ifdef HAVE_MALLOC_TRIM
+#include <malloc.h>
+#endif
+
+#include "core-internal.h"
+#include "idletrim-internal.h"
+
+#define LOG_CAT "idle-trim: "
+
+struct NIdleTrim {
+    NCore      *core;
+    guint       idle_period;        /* ms without requests before trimming, 0 disables */
+    gint64      last_activity;      /* monotonic time of the latest request */
+    guint       timeout_id;         /* idle check */
+    guint       rewarm_id;          /* pending rewarm of trimmed sinks */
+    gboolean    trimmed;            /* memory released since the latest request */
+};
+
+static gboolean idle_timeout_cb (gpointer userdata);
+static gboolean rewarm_cb       (gpointer userdata);
+
+/* resident set size in kB, 0 if not known. */
+static gulong
+read_rss (void)
+{
+    FILE   *fp       = NULL;
+    gulong  size     = 0;
+    gulong  resident = 0;
+
+    if (!(fp = fopen ("/proc/self/statm", "r")))
+        return 0;
+
+    if (fscanf (fp, "%lu %lu", &size, &resident) != 2)
+        resident = 0;
+
+    fclose (fp);
+
+    return resident * (sysconf (_SC_PAGESIZE) / 1024);
+}
+
+static void
+schedule_check (NIdleTrim *trim, guint delay)
+{
+    if (trim->timeout_id > 0)
+        g_source_remove (trim->timeout_id);
+
+    trim->timeout_id = g_timeout_add (delay, idle_timeout_cb, trim);
+}
+
+static void
+trim_memory (NIdleTrim *trim)
+{
+    NSinkInterface **sink    = NULL;
+    GString         *trimmed = NULL;
+    gulong           before  = 0;
+    gulong           after   = 0;
+
+    before  = read_rss ();
+    trimmed = g_string_new (NULL);
+
+    /* sinks remember that they released memory, so that they can be
+       warmed up again in the background on the next request. */
+
+    for (sink = n_core_get_sinks (trim->core); sink && *sink; ++sink) {
+        if ((*sink)->init_state != N_SINK_INIT_READY || !(*sink)->funcs.trim)
+            continue;
+
+        if ((*sink)->funcs.trim (*sink)) {
+            (*sink)->trimmed = TRUE;
+            g_string_append_printf (trimmed, "%s%s", trimmed->len ? ", " : "",
+                (*sink)->name);
+        }
+    }
+
+#ifdef HAVE_MALLOC_TRIM
+    (void) malloc_trim (0);
+#endif
+
+    after = read_rss ();
+    trim->trimmed = TRUE;
+
+    N_INFO (LOG_CAT "idle for %u ms, RSS %lu kB -> %lu kB, sinks trimmed: %s",
+        trim->idle_period, before, after, trimmed->len ? trimmed->str : "none");
+
+    g_string_free (trimmed, TRUE);
+}
+
+static gboolean
+idle_timeout_cb (gpointer userdata)
+{
+    NIdleTrim *trim    = (NIdleTrim*) userdata;
+    gint64     elapsed = 0;
+
+    trim->timeout_id = 0;
+
+    /* requests are not tracked with a timer each, instead the check is
+       postponed until the idle period since the latest one has passed. */
+
+    elapsed = (g_get_monotonic_time () - trim->last_activity) / 1000;
+    if (elapsed < trim->idle_period) {
+        schedule_check (trim, trim->idle_period - elapsed);
+        return FALSE;
+    }
+
+    if (n_core_get_requests (trim->core)) {
+        schedule_check (trim, trim->idle_period);
+        return FALSE;
+    }
+
+    trim_memory (trim);
+
+    return FALSE;
+}
+
+static gboolean
+rewarm_cb (gpointer userdata)
+{
+    NIdleTrim       *trim = (NIdleTrim*) userdata;
+    NSinkInterface **sink = NULL;
+
+    trim->rewarm_id = 0;
+
+    for (sink = n_core_get_sinks (trim->core); sink && *sink; ++sink) {
+        if (!(*sink)->trimmed)
+            continue;
+
+        (*sink)->trimmed = FALSE;
+
+        if ((*sink)->funcs.rewarm) {
+            N_DEBUG (LOG_CAT "rewarming sink '%s'", (*sink)->name);
+            (*sink)->funcs.rewarm (*sink);
+        }
+    }
+
+    return FALSE;
+}
+
+NIdleTrim*
+n_idle_trim_new (NCore *core)
+{
+    NIdleTrim *trim = NULL;
+
+    g_assert (core != NULL);
+
+    trim = g_new0 (NIdleTrim, 1);
+    trim->core = core;
+
+    return trim;
+}
+
+void
+n_idle_trim_free (NIdleTrim *trim)
+{
+    if (!trim)
+        return;
+
+    if (trim->timeout_id > 0)
+        g_source_remove (trim->timeout_id);
+
+    if (trim->rewarm_id > 0)
+        g_source_remove (trim->rewarm_id);
+
+    g_free (trim);
+}
+
+void
+n_idle_trim_configure (NIdleTrim *trim, guint idle_period)
+{
+    g_assert (trim != NULL);
+
+    trim->idle_period   = idle_period;
+    trim->last_activity = g_get_monotonic_time ();
+
+    if (trim->timeout_id > 0) {
+        g_source_remove (trim->timeout_id);
+        trim->timeout_id = 0;
+    }
+
+    if (idle_period > 0) {
+        N_DEBUG (LOG_CAT "trimming memory after %u ms idle", idle_period);
+        schedule_check (trim, idle_period);
+    }
+}
+
+void
+n_idle_trim_activity (NIdleTrim *trim)
+{
+    if (!trim || trim->idle_period == 0)
+        return;
+
+    trim->last_activity = g_get_monotonic_time ();
+
+    if (!trim->trimmed)
+        return;
+
+    /* rewarm at low priority, so that the request that woke us up is
+       not delayed by it. */
+
+    trim->trimmed = FALSE;
+
+    if (trim->rewarm_id == 0)
+        trim->rewarm_id = g_idle_add_full (G_PRIORITY_LOW, rewarm_cb, trim, NULL);
+
+    schedule_check (trim, trim->idle_period);
+}
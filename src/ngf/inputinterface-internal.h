@@ -23,6 +23,7 @@
 #define N_INPUT_INTERFACE_INTERNAL_H
 
 #include <ngf/inputinterface.h>
+#include <ngf/plugin.h>
 
 #include "request-internal.h"
 #include "core-internal.h"
@@ -35,6 +36,8 @@ struct _NInputInterface
     NInputInterfaceDecl  funcs;     /* interface functions */
     NCore               *core;
     void                *userdata;
+    NPlugin             *plugin;    /* plugin that registered the input */
+    gboolean             initialized;
 };
 
 #endif /* N_INPUT_INTERFACE_INTERNAL_H */
@@ -36,13 +36,64 @@ n_input_interface_play_request (NInputInterface *iface, NRequest *request)
     if (!iface || !request)
         return FALSE;
 
-    if (n_request_is_paused (request))
+    if (n_request_is_paused (request) || request->members)
         return n_core_resume_request (iface->core, request);
 
     request->input_iface = iface;
     return n_core_play_request (iface->core, request);
 }
 
+int
+n_input_interface_play_group (NInputInterface *iface, NRequest *group,
+                              GList *requests)
+{
+    if (!iface || !group || !requests)
+        return FALSE;
+
+    group->input_iface = iface;
+    return n_core_play_group (iface->core, group, requests);
+}
+
+NPreparedRequest*
+n_input_interface_prepare_request (NInputInterface *iface, NRequest *request)
+{
+    NPreparedRequest *prepared = NULL;
+
+    if (!iface || !request)
+        return NULL;
+
+    request->input_iface = iface;
+    request->core        = iface->core;
+
+    prepared = n_prepared_request_new (request);
+
+    if (!n_core_update_prepared (iface->core, prepared)) {
+        n_prepared_request_unref (prepared);
+        return NULL;
+    }
+
+    return prepared;
+}
+
+NRequest*
+n_input_interface_new_prepared_request (NInputInterface *iface,
+                                        NPreparedRequest *prepared)
+{
+    if (!iface || !prepared)
+        return NULL;
+
+    return n_core_new_prepared_request (iface->core, prepared);
+}
+
+void
+n_input_interface_release_prepared (NInputInterface *iface,
+                                    NPreparedRequest *prepared)
+{
+    (void) iface;
+
+    n_prepared_request_unref (prepared);
+}
+
 int
 n_input_interface_pause_request (NInputInterface *iface, NRequest *request)
 {
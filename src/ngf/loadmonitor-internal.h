@@ -0,0 +1,43 @@
+/*
+ * ngfd - Non-graphic feedback daemon
+ * Main loop lag monitor
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef N_CORE_LOAD_MONITOR_INTERNAL_H_
+#define N_CORE_LOAD_MONITOR_INTERNAL_H_
+
+#include <glib.h>
+#include <ngf/core.h>
+
+typedef struct NLoadMonitor NLoadMonitor;
+
+typedef enum _NLoadLevel
+{
+    N_LOAD_LEVEL_NORMAL = 0,    /* main loop dispatches in time */
+    N_LOAD_LEVEL_DEFER,         /* low priority requests are deferred */
+    N_LOAD_LEVEL_SHED           /* low priority requests are dropped */
+} NLoadLevel;
+
+NLoadMonitor* n_load_monitor_new       (NCore *core);
+void          n_load_monitor_free      (NLoadMonitor *monitor);
+void          n_load_monitor_configure (NLoadMonitor *monitor, guint interval,
+                                        guint defer_threshold, guint shed_threshold);
+void          n_load_monitor_wake      (NLoadMonitor *monitor);
+guint         n_load_monitor_get_lag   (NLoadMonitor *monitor);
+NLoadLevel    n_load_monitor_get_level (NLoadMonitor *monitor);
+
+#endif
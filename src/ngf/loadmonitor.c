@@ -0,0 +1,179 @@
+/*
+ * ngfd - Non-graphic feedback daemon
+ * Main loop lag monitor
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "core-internal.h"
+#include "loadmonitor-internal.h"
+
+#define LOG_CAT "load: "
+
+/* only the level is published, every context write invalidates the rule
+   cache and prepared requests, lag is available from the monitor. */
+#define CONTEXT_MAINLOOP_LOAD   "core.mainloop.load"
+
+struct NLoadMonitor {
+    NCore      *core;
+    guint       interval;           /* heartbeat interval in ms, 0 disables */
+    guint       defer_threshold;    /* lag in ms to start deferring */
+    guint       shed_threshold;     /* lag in ms to start dropping */
+    guint       source_id;          /* heartbeat source */
+    gint64      last_beat;          /* monotonic time of previous heartbeat */
+    guint       lag;                /* smoothed dispatch delay in ms */
+    NLoadLevel  level;
+};
+
+static const char*
+load_level_name (NLoadLevel level)
+{
+    switch (level) {
+        case N_LOAD_LEVEL_NORMAL:
+            return "normal";
+        case N_LOAD_LEVEL_DEFER:
+            return "defer";
+        case N_LOAD_LEVEL_SHED:
+            return "shed";
+    }
+
+    return "unknown";
+}
+
+static void
+set_level (NLoadMonitor *monitor, NLoadLevel level)
+{
+    NValue *v;
+
+    if (monitor->level == level)
+        return;
+
+    N_INFO (LOG_CAT "main loop lag %u ms, load level %s -> %s", monitor->lag,
+        load_level_name (monitor->level), load_level_name (level));
+
+    monitor->level = level;
+
+    v = n_value_new ();
+    n_value_set_string (v, load_level_name (level));
+    n_context_set_value (n_core_get_context (monitor->core), CONTEXT_MAINLOOP_LOAD, v);
+
+    n_core_load_level_changed (monitor->core, level);
+}
+
+static gboolean
+heartbeat_cb (gpointer userdata)
+{
+    NLoadMonitor *monitor = userdata;
+    gint64        now;
+    gint64        sample;
+
+    /* the heartbeat is expected exactly one interval after the previous
+       one, anything beyond that is time spent waiting for other sources. */
+
+    now    = g_get_monotonic_time ();
+    sample = (now - monitor->last_beat) / 1000 - monitor->interval;
+    monitor->last_beat = now;
+
+    if (sample < 0)
+        sample = 0;
+
+    /* single long dispatch raises the lag immediately, recovery is gradual. */
+
+    monitor->lag = MAX ((guint) sample, monitor->lag / 2);
+
+    if (monitor->shed_threshold && monitor->lag >= monitor->shed_threshold)
+        set_level (monitor, N_LOAD_LEVEL_SHED);
+    else if (monitor->defer_threshold && monitor->lag >= monitor->defer_threshold)
+        set_level (monitor, N_LOAD_LEVEL_DEFER);
+    else
+        set_level (monitor, N_LOAD_LEVEL_NORMAL);
+
+    /* keep beating only while there is something to deliver. */
+
+    if (monitor->lag == 0 && !monitor->core->requests &&
+        !monitor->core->deferred_requests) {
+        N_DEBUG (LOG_CAT "no active requests, heartbeat stopped");
+        monitor->source_id = 0;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+NLoadMonitor*
+n_load_monitor_new (NCore *core)
+{
+    NLoadMonitor *monitor;
+
+    monitor = g_new0 (NLoadMonitor, 1);
+    monitor->core = core;
+
+    return monitor;
+}
+
+void
+n_load_monitor_free (NLoadMonitor *monitor)
+{
+    if (!monitor)
+        return;
+
+    if (monitor->source_id > 0)
+        g_source_remove (monitor->source_id);
+
+    g_free (monitor);
+}
+
+void
+n_load_monitor_configure (NLoadMonitor *monitor, guint interval,
+                          guint defer_threshold, guint shed_threshold)
+{
+    g_assert (monitor != NULL);
+
+    monitor->interval        = interval;
+    monitor->defer_threshold = defer_threshold;
+    monitor->shed_threshold  = shed_threshold;
+
+    N_DEBUG (LOG_CAT "heartbeat %u ms, defer at %u ms, shed at %u ms lag",
+        interval, defer_threshold, shed_threshold);
+}
+
+void
+n_load_monitor_wake (NLoadMonitor *monitor)
+{
+    g_assert (monitor != NULL);
+
+    if (monitor->source_id > 0 || monitor->interval == 0)
+        return;
+
+    monitor->last_beat = g_get_monotonic_time ();
+    monitor->source_id = g_timeout_add_full (G_PRIORITY_HIGH, monitor->interval,
+        heartbeat_cb, monitor, NULL);
+}
+
+guint
+n_load_monitor_get_lag (NLoadMonitor *monitor)
+{
+    g_assert (monitor != NULL);
+
+    return monitor->lag;
+}
+
+NLoadLevel
+n_load_monitor_get_level (NLoadMonitor *monitor)
+{
+    g_assert (monitor != NULL);
+
+    return monitor->level;
+}
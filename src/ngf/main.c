@@ -24,6 +24,7 @@
 #include <glib-unix.h>
 #include <getopt.h>
 #include <unistd.h>
+#include <stdlib.h>
 #include <signal.h>
 #include <string.h>
 
@@ -38,6 +39,9 @@
 
 #define EVENT_RELOAD_TIME_LIMIT_US (2 * G_USEC_PER_SEC)
 
+#define PROFILE_STARTUP_ENV      "NGF_PROFILE_STARTUP"
+#define PROFILE_STARTUP_FILENAME "ngfd-startup.json"
+
 typedef struct _AppData
 {
     GMainLoop *loop;
@@ -45,10 +49,12 @@ typedef struct _AppData
     gint       default_loglevel;
     guint      sigusr1_source;
     guint      sigusr2_source;
+    guint      sighup_source;
     guint      sigint_source;
     guint      sigterm_source;
     gint64     last_event_reload;
     gboolean   use_default_loglevel;
+    gchar     *profile_path;        /* startup profile output, NULL if disabled */
 } AppData;
 
 static gboolean
@@ -56,10 +62,12 @@ parse_cmdline (int argc, char **argv, AppData *app)
 {
     int opt, opt_index;
     int level = app->default_loglevel;
+    const char *env = NULL;
 
     static struct option long_opts[] = {
         { "verbose",        no_argument,        0, 'v' },
         { "quiet",          no_argument,        0, 'q' },
+        { "profile-startup", optional_argument, 0, 'p' },
         { 0, 0, 0, 0 }
     };
 
@@ -74,11 +82,28 @@ parse_cmdline (int argc, char **argv, AppData *app)
                 level = N_LOG_LEVEL_NONE;
                 break;
 
+            case 'p':
+                g_free (app->profile_path);
+                app->profile_path = g_strdup (optarg ? optarg : "");
+                break;
+
             default:
                 break;
         }
     }
 
+    /* environment enables profiling when the command line can't be changed,
+       value is the output file. */
+
+    if (!app->profile_path && (env = getenv (PROFILE_STARTUP_ENV)) != NULL)
+        app->profile_path = g_strdup (env);
+
+    if (app->profile_path && *app->profile_path == '\0') {
+        g_free (app->profile_path);
+        app->profile_path = g_build_filename (g_get_tmp_dir (),
+            PROFILE_STARTUP_FILENAME, NULL);
+    }
+
     app->default_loglevel = level;
     n_log_set_level (level);
 
@@ -140,6 +165,18 @@ handle_sigusr2 (gpointer userdata)
     return TRUE;
 }
 
+/* Reload plugins whose parameters have changed */
+static gboolean
+handle_sighup (gpointer userdata)
+{
+    AppData *app = userdata;
+
+    N_INFO ("daemon: plugin reload requested.");
+    n_core_reload_changed_plugins (app->core);
+
+    return TRUE;
+}
+
 static void
 install_signal_handlers (AppData *app)
 {
@@ -149,6 +186,9 @@ install_signal_handlers (AppData *app)
     app->sigusr2_source = g_unix_signal_add (SIGUSR2,
                                              handle_sigusr2,
                                              app);
+    app->sighup_source  = g_unix_signal_add (SIGHUP,
+                                             handle_sighup,
+                                             app);
     app->sigterm_source = g_unix_signal_add (SIGTERM,
                                              handle_sigterm,
                                              app);
@@ -166,6 +206,9 @@ remove_signal_handlers (AppData *app)
     if (app->sigusr2_source)
         g_source_remove (app->sigusr2_source), app->sigusr2_source = 0;
 
+    if (app->sighup_source)
+        g_source_remove (app->sighup_source), app->sighup_source = 0;
+
     if (app->sigterm_source)
         g_source_remove (app->sigterm_source), app->sigterm_source = 0;
 
@@ -176,7 +219,8 @@ remove_signal_handlers (AppData *app)
 int
 main (int argc, char *argv[])
 {
-    AppData app;
+    AppData          app;
+    NStartupProfile *profile = NULL;
 
     memset (&app, 0, sizeof (app));
     app.default_loglevel = N_LOG_LEVEL_ERROR;
@@ -187,8 +231,18 @@ main (int argc, char *argv[])
         return 1;
 
     N_DEBUG ("daemon: Starting.");
+
+    /* profile is reported and freed by the core when initialization
+       is done. */
+    if (app.profile_path)
+        profile = n_startup_profile_new (app.profile_path);
+
     app.loop = g_main_loop_new (NULL, 0);
+
+    n_startup_profile_begin (profile, "core-new", NULL);
     app.core = n_core_new (&argc, argv);
+    n_startup_profile_end (profile, "core-new", NULL);
+    app.core->startup_profile = profile;
 
     if (!n_core_initialize (app.core)) {
         N_ERROR ("daemon: Initialization failed.");
@@ -210,6 +264,7 @@ main (int argc, char *argv[])
     n_core_shutdown   (app.core);
     n_core_free       (app.core);
     g_main_loop_unref (app.loop);
+    g_free            (app.profile_path);
     N_DEBUG ("daemon: Terminated.");
 
     return 0;
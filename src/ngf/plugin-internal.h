@@ -37,6 +37,7 @@ struct _NPlugin
     GModule     *module;            /* plugin module handle */
     gpointer     userdata;          /* plugin implementor internal data */
     NProplist   *params;            /* plugin parameters */
+    gchar      **depends;           /* names of plugins this plugin depends on */
 
     const char* (*get_name)    ();
     const char* (*get_desc)    ();
@@ -47,6 +48,7 @@ struct _NPlugin
 
 NPlugin* n_plugin_open   (const char *plugin_name);
 int      n_plugin_init   (NPlugin *plugin);
+gboolean n_plugin_depends_on (NPlugin *plugin, const char *plugin_name);
 void     n_plugin_unload (NPlugin *plugin);
 
 #endif /* N_PLUGIN_INTERNAL_H */
@@ -25,12 +25,36 @@
 
 #define LOG_CAT "plugin: "
 
+static gchar**
+n_plugin_parse_depends (const char *value)
+{
+    GPtrArray  *depends = NULL;
+    gchar     **names   = NULL;
+    gchar     **name    = NULL;
+
+    depends = g_ptr_array_new ();
+    names   = g_strsplit (value ? value : "", ";", -1);
+
+    for (name = names; *name; ++name) {
+        g_strstrip (*name);
+        if (**name != '\0')
+            g_ptr_array_add (depends, g_strdup (*name));
+    }
+
+    g_strfreev (names);
+    g_ptr_array_add (depends, NULL);
+
+    return (gchar**) g_ptr_array_free (depends, FALSE);
+}
+
 NPlugin*
 n_plugin_open (const char *filename)
 {
     g_assert (filename != NULL);
 
     NPlugin *plugin = NULL;
+    const char* (*get_depends) () = NULL;
+
     plugin = g_new0 (NPlugin, 1);
     plugin->module = g_module_open (filename,
         G_MODULE_BIND_LAZY | G_MODULE_BIND_LOCAL);
@@ -55,6 +79,11 @@ n_plugin_open (const char *filename)
 
 #undef LOAD_SYMBOL
 
+    /* dependencies are optional */
+
+    if (g_module_symbol (plugin->module, "n_plugin__get_depends", (gpointer*) &get_depends))
+        plugin->depends = n_plugin_parse_depends (get_depends ());
+
     return plugin;
 
 fail_load:
@@ -85,9 +114,25 @@ n_plugin_unload (NPlugin *plugin)
         plugin->params = NULL;
     }
 
+    g_strfreev (plugin->depends);
     g_free (plugin);
 }
 
+gboolean
+n_plugin_depends_on (NPlugin *plugin, const char *plugin_name)
+{
+    gchar **dep = NULL;
+
+    g_assert (plugin != NULL);
+
+    for (dep = plugin->depends; dep && *dep; ++dep) {
+        if (g_str_equal (*dep, plugin_name))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
 NCore*
 n_plugin_get_core (NPlugin *plugin)
 {
@@ -31,6 +31,20 @@
 
 /* typedef struct _NRequest NRequest; */
 
+/* typedef struct _NPreparedRequest NPreparedRequest; */
+
+struct _NPreparedRequest
+{
+    guint            ref;
+    NRequest        *template;      /* request as given by the input interface */
+    NEvent          *event;         /* resolved event, NULL if not resolved */
+    NProplist       *properties;    /* merged and transformed properties */
+    GList           *sinks;         /* capable sinks after filtering */
+    guint            generation;    /* core prepare generation of the cached values */
+    gchar          **context_keys;  /* context keys read by the event rules, hooks and sinks */
+    guint            context_serial;/* core context serial of the cached values */
+};
+
 struct _NRequest
 {
     gchar           *name;          /* request name */
@@ -39,16 +53,23 @@ struct _NRequest
 
     guint            id;                    /* unique request identifier */
     NEvent          *event;
+    NContextSnapshot *snapshot;             /* context the event was resolved against */
     NCore           *core;
     NInputInterface *input_iface;
+    NPreparedRequest *prepared;             /* set if created from prepared request */
+    GPtrArray       *context_keys;          /* context keys read by hooks and sinks */
 
     gboolean         is_paused;
     gboolean         is_fallback;
     gboolean         has_failed;
     gboolean         no_event;
+    gboolean         is_shed;               /* dropped because main loop is overloaded */
+    gboolean         waits_for_sinks;       /* deferred until sinks loaded on demand are ready */
+    gboolean         sinks_waited;          /* has waited, sinks not ready are skipped */
 
     guint            play_source_id;        /* source id for play */
     guint            stop_source_id;        /* source id for stop */
+    guint            defer_source_id;       /* source id for dropping deferred request */
 
     GList           *all_sinks;             /* all sinks available for the request */
     GList           *sinks_preparing;       /* sinks not yet synchronized and still preparing */
@@ -56,8 +77,13 @@ struct _NRequest
     GList           *sinks_playing;         /* sinks currently playing */
     GList           *sinks_resync;
     GList           *stop_list;
+    GList           *play_delays;           /* plays postponed to align sink latencies */
     NSinkInterface  *master_sink;
 
+    NRequest        *group;                 /* group the request was started in */
+    GList           *members;               /* requests of the group, set for group only */
+    gboolean         members_started;       /* all group members have started playback */
+
     guint            max_timeout_id;
     guint            timeout_ms;
 };
@@ -66,4 +92,9 @@ NRequest* n_request_new          ();
 void      n_request_free         (NRequest *request);
 int       n_request_has_fallback (NRequest *request);
 
+NPreparedRequest* n_prepared_request_new   (NRequest *template);
+NPreparedRequest* n_prepared_request_ref   (NPreparedRequest *prepared);
+void              n_prepared_request_unref (NPreparedRequest *prepared);
+void              n_prepared_request_clear (NPreparedRequest *prepared);
+
 #endif /* N_REQUEST_INTERNAL_H */
@@ -21,7 +21,7 @@
 
 #include "request-internal.h"
 
-static guint id_counter = 0;
+static gint id_counter = 0;      /* requests are created by input threads */
 
 NRequest*
 n_request_new ()
@@ -30,7 +30,9 @@ n_request_new ()
 
     request = g_slice_new0 (NRequest);
     /* skip 0 */
-    request->id = ++id_counter ? id_counter : ++id_counter;
+    do {
+        request->id = (guint) g_atomic_int_add (&id_counter, 1) + 1;
+    } while (request->id == 0);
     return request;
 }
 
@@ -75,6 +77,21 @@ n_request_new_with_event_and_properties (const char *event, const NProplist *pro
     return request;
 }
 
+NRequest*
+n_request_new_with_event_take_properties (const char *event, NProplist *properties)
+{
+    if (!event) {
+        n_proplist_free (properties);
+        return NULL;
+    }
+
+    NRequest *request   = n_request_new ();
+    request->name       = g_strdup (event);
+    request->properties = properties;
+
+    return request;
+}
+
 void
 n_request_free (NRequest *request)
 {
@@ -91,6 +108,17 @@ n_request_free (NRequest *request)
     g_free (request->name);
     request->name = NULL;
 
+    n_context_snapshot_unref (request->snapshot);
+    request->snapshot = NULL;
+
+    n_prepared_request_unref (request->prepared);
+    request->prepared = NULL;
+
+    if (request->context_keys) {
+        g_ptr_array_free (request->context_keys, TRUE);
+        request->context_keys = NULL;
+    }
+
     g_slice_free (NRequest, request);
 }
 
@@ -179,4 +207,56 @@ n_request_get_timeout (NRequest *request)
     return (request != NULL) ? request->timeout_ms : 0;
 }
 
+NPreparedRequest*
+n_prepared_request_new (NRequest *template)
+{
+    NPreparedRequest *prepared = NULL;
+
+    g_assert (template != NULL);
+
+    prepared           = g_slice_new0 (NPreparedRequest);
+    prepared->ref      = 1;
+    prepared->template = template;
+
+    return prepared;
+}
+
+NPreparedRequest*
+n_prepared_request_ref (NPreparedRequest *prepared)
+{
+    g_assert (prepared != NULL);
+
+    prepared->ref++;
+    return prepared;
+}
+
+void
+n_prepared_request_unref (NPreparedRequest *prepared)
+{
+    if (!prepared)
+        return;
 
+    if (--prepared->ref > 0)
+        return;
+
+    n_prepared_request_clear (prepared);
+    n_request_free (prepared->template);
+    g_slice_free (NPreparedRequest, prepared);
+}
+
+void
+n_prepared_request_clear (NPreparedRequest *prepared)
+{
+    g_assert (prepared != NULL);
+
+    if (prepared->properties)
+        n_proplist_free (prepared->properties);
+
+    g_list_free (prepared->sinks);
+    g_strfreev (prepared->context_keys);
+
+    prepared->event        = NULL;
+    prepared->properties   = NULL;
+    prepared->sinks        = NULL;
+    prepared->context_keys = NULL;
+}
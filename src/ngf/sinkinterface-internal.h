@@ -23,11 +23,26 @@
 #define N_SINK_INTERFACE_INTERNAL_H
 
 #include <ngf/sinkinterface.h>
+#include <ngf/plugin.h>
 
 #include "core-internal.h"
 
 /* typedef struct _NSinkInterface NSinkInterface; */
 
+typedef enum _NSinkInitState
+{
+    N_SINK_INIT_PENDING = 0,            /* initialization not done yet */
+    N_SINK_INIT_READY,                  /* sink can be used */
+    N_SINK_INIT_FAILED                  /* asynchronous initialization failed */
+} NSinkInitState;
+
+typedef enum _NSinkBreakerState
+{
+    N_SINK_BREAKER_CLOSED = 0,          /* sink is healthy and used normally */
+    N_SINK_BREAKER_OPEN,                /* sink failed too often and is skipped */
+    N_SINK_BREAKER_HALF_OPEN            /* next request is allowed as a trial */
+} NSinkBreakerState;
+
 struct _NSinkInterface
 {
     const char         *name;           /* sink interface name */
@@ -36,6 +51,13 @@ struct _NSinkInterface
     NCore              *core;
     void               *userdata;
     int                 priority;       /* priority */
+    NPlugin            *plugin;         /* plugin that registered the sink */
+    NSinkInitState      init_state;
+    gboolean            trimmed;        /* memory released while idle */
+
+    NSinkBreakerState   breaker;        /* circuit breaker state */
+    guint               failures;       /* consecutive failures */
+    guint               probe_source;   /* background probe while breaker is open */
 };
 
 #endif /* N_SINK_INTERFACE_INTERNAL_H */
@@ -76,6 +76,15 @@ n_sink_interface_complete (NSinkInterface *iface, NRequest *request)
     n_core_complete_sink (iface->core, iface, request);
 }
 
+void
+n_sink_interface_initialized (NSinkInterface *iface, int success)
+{
+    if (!iface)
+        return;
+
+    n_core_sink_initialized (iface->core, iface, success);
+}
+
 void
 n_sink_interface_fail (NSinkInterface *iface, NRequest *request)
 {
@@ -85,6 +94,15 @@ n_sink_interface_fail (NSinkInterface *iface, NRequest *request)
     n_core_fail_sink (iface->core, iface, request);
 }
 
+void
+n_sink_interface_fail_request (NSinkInterface *iface, NRequest *request)
+{
+    if (!iface || !request)
+        return;
+
+    n_core_fail_sink_request (iface->core, iface, request);
+}
+
 void
 n_sink_interface_set_userdata (NSinkInterface *iface, void *userdata)
 {
@@ -0,0 +1,37 @@
+/*
+ * ngfd - Non-graphic feedback daemon
+ * Timing of the startup phases
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef N_CORE_STARTUP_PROFILE_INTERNAL_H_
+#define N_CORE_STARTUP_PROFILE_INTERNAL_H_
+
+#include <glib.h>
+
+typedef struct NStartupProfile NStartupProfile;
+
+/* all functions accept NULL profile, so that call sites do not need to
+   check whether profiling is enabled. name may be NULL. */
+
+NStartupProfile* n_startup_profile_new    (const char *path);
+void             n_startup_profile_free   (NStartupProfile *profile);
+void             n_startup_profile_begin  (NStartupProfile *profile, const char *phase, const char *name);
+void             n_startup_profile_end    (NStartupProfile *profile, const char *phase, const char *name);
+void             n_startup_profile_mark   (NStartupProfile *profile, const char *phase, const char *name);
+void             n_startup_profile_report (NStartupProfile *profile);
+
+#endif
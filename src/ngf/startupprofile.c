@@ -0,0 +1,231 @@
+/*
+ * ngfd - Non-graphic feedback daemon
+ * Timing of the startup phases
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <string.h>
+
+#include <ngf/log.h>
+#include "startupprofile-internal.h"
+
+#define LOG_CAT "startup-profile: "
+
+typedef struct _NStartupPhase
+{
+    gchar   *phase;
+    gchar   *name;
+    gint64   start;             /* us since profile was created */
+    gint64   end;               /* -1 while running */
+} NStartupPhase;
+
+struct NStartupProfile {
+    gchar      *path;           /* JSON output file */
+    gint64      created;        /* monotonic time of creation */
+    GPtrArray  *phases;         /* NStartupPhase* in start order */
+};
+
+static void
+phase_free (gpointer data)
+{
+    NStartupPhase *phase = data;
+
+    g_free (phase->phase);
+    g_free (phase->name);
+    g_free (phase);
+}
+
+static gint
+phase_duration_cmp (gconstpointer a, gconstpointer b)
+{
+    const NStartupPhase *pa = *(const NStartupPhase**) a;
+    const NStartupPhase *pb = *(const NStartupPhase**) b;
+    gint64 da = pa->end - pa->start;
+    gint64 db = pb->end - pb->start;
+
+    return da < db ? 1 : (da > db ? -1 : 0);
+}
+
+static void
+append_json_string (GString *out, const char *str)
+{
+    const char *c = NULL;
+
+    if (!str) {
+        g_string_append (out, "null");
+        return;
+    }
+
+    g_string_append_c (out, '"');
+    for (c = str; *c; ++c) {
+        if (*c == '"' || *c == '\\')
+            g_string_append_printf (out, "\\%c", *c);
+        else if ((guchar) *c < 0x20)
+            g_string_append_printf (out, "\\u%04x", (guchar) *c);
+        else
+            g_string_append_c (out, *c);
+    }
+    g_string_append_c (out, '"');
+}
+
+NStartupProfile*
+n_startup_profile_new (const char *path)
+{
+    NStartupProfile *profile = NULL;
+
+    g_assert (path != NULL);
+
+    profile = g_new0 (NStartupProfile, 1);
+    profile->path    = g_strdup (path);
+    profile->created = g_get_monotonic_time ();
+    profile->phases  = g_ptr_array_new_with_free_func (phase_free);
+
+    return profile;
+}
+
+void
+n_startup_profile_free (NStartupProfile *profile)
+{
+    if (!profile)
+        return;
+
+    g_ptr_array_free (profile->phases, TRUE);
+    g_free (profile->path);
+    g_free (profile);
+}
+
+void
+n_startup_profile_begin (NStartupProfile *profile, const char *phase, const char *name)
+{
+    NStartupPhase *p = NULL;
+
+    if (!profile)
+        return;
+
+    g_assert (phase != NULL);
+
+    p = g_new0 (NStartupPhase, 1);
+    p->phase = g_strdup (phase);
+    p->name  = g_strdup (name);
+    p->start = g_get_monotonic_time () - profile->created;
+    p->end   = -1;
+
+    g_ptr_array_add (profile->phases, p);
+}
+
+void
+n_startup_profile_end (NStartupProfile *profile, const char *phase, const char *name)
+{
+    NStartupPhase *p = NULL;
+    guint          i = 0;
+
+    if (!profile)
+        return;
+
+    /* latest running phase of the same kind */
+
+    for (i = profile->phases->len; i > 0; --i) {
+        p = g_ptr_array_index (profile->phases, i - 1);
+
+        if (p->end < 0 && g_str_equal (p->phase, phase) && g_strcmp0 (p->name, name) == 0) {
+            p->end = g_get_monotonic_time () - profile->created;
+            return;
+        }
+    }
+
+    N_WARNING (LOG_CAT "phase '%s' (%s) ended but not started", phase, name ? name : "");
+}
+
+void
+n_startup_profile_mark (NStartupProfile *profile, const char *phase, const char *name)
+{
+    NStartupPhase *p = NULL;
+
+    if (!profile)
+        return;
+
+    n_startup_profile_begin (profile, phase, name);
+    p = g_ptr_array_index (profile->phases, profile->phases->len - 1);
+    p->end = p->start;
+}
+
+void
+n_startup_profile_report (NStartupProfile *profile)
+{
+    GPtrArray     *sorted = NULL;
+    GString       *json   = NULL;
+    GError        *error  = NULL;
+    NStartupPhase *p      = NULL;
+    gint64         total  = 0;
+    guint          i      = 0;
+
+    if (!profile)
+        return;
+
+    total = g_get_monotonic_time () - profile->created;
+
+    /* phases that never completed, e.g. sink that has not reported
+       the result of asynchronous initialization, end now. */
+
+    for (i = 0; i < profile->phases->len; ++i) {
+        p = g_ptr_array_index (profile->phases, i);
+        if (p->end < 0)
+            p->end = total;
+    }
+
+    sorted = g_ptr_array_sized_new (profile->phases->len);
+    for (i = 0; i < profile->phases->len; ++i)
+        g_ptr_array_add (sorted, g_ptr_array_index (profile->phases, i));
+    g_ptr_array_sort (sorted, phase_duration_cmp);
+
+    g_print ("ngfd startup: %.2f ms total\n", total / 1000.0);
+    for (i = 0; i < sorted->len; ++i) {
+        p = g_ptr_array_index (sorted, i);
+        g_print ("%10.2f ms  at %10.2f ms  %-16s %s\n",
+            (p->end - p->start) / 1000.0, p->start / 1000.0,
+            p->phase, p->name ? p->name : "");
+    }
+
+    g_ptr_array_free (sorted, TRUE);
+
+    /* phases in start order, nested phases are inside their parent. */
+
+    json = g_string_new (NULL);
+    g_string_append_printf (json, "{\n  \"total_us\": %" G_GINT64_FORMAT ",\n  \"phases\": [", total);
+
+    for (i = 0; i < profile->phases->len; ++i) {
+        p = g_ptr_array_index (profile->phases, i);
+
+        g_string_append (json, i > 0 ? ",\n    { \"phase\": " : "\n    { \"phase\": ");
+        append_json_string (json, p->phase);
+        g_string_append (json, ", \"name\": ");
+        append_json_string (json, p->name);
+        g_string_append_printf (json, ", \"start_us\": %" G_GINT64_FORMAT
+                                      ", \"duration_us\": %" G_GINT64_FORMAT " }",
+            p->start, p->end - p->start);
+    }
+
+    g_string_append (json, "\n  ]\n}\n");
+
+    if (!g_file_set_contents (profile->path, json->str, json->len, &error)) {
+        N_WARNING (LOG_CAT "failed to write '%s': %s", profile->path, error->message);
+        g_error_free (error);
+    } else {
+        g_print ("ngfd startup: profile written to '%s'\n", profile->path);
+    }
+
+    g_string_free (json, TRUE);
+}
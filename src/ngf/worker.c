@@ -0,0 +1,250 @@
+/*
+ * ngfd - Non-graphic feedback daemon
+ * Worker threads for blocking operations
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "core-internal.h"
+#include "worker-internal.h"
+
+#define LOG_CAT "worker: "
+
+typedef struct NWorkerTask
+{
+    NWorkerPool    *pool;
+    guint           id;
+    gconstpointer   queue;          /* serialization key */
+    NWorkFunc       work;
+    NWorkDoneFunc   done;
+    gpointer        userdata;
+    GDestroyNotify  destroy;
+    gint            cancelled;      /* accessed atomically */
+    gint            completing;     /* completion is pending in main loop */
+    gboolean        result;
+    gboolean        orphaned;       /* pool was shut down before completion */
+} NWorkerTask;
+
+struct NWorkerPool {
+    GThreadPool *threads;
+    GHashTable  *tasks;             /* id -> NWorkerTask, main thread only */
+    GHashTable  *queues;            /* queue key -> GQueue of waiting tasks */
+    guint        next_id;
+};
+
+static gboolean
+complete_cb (gpointer userdata)
+{
+    NWorkerTask *task = userdata;
+    NWorkerPool *pool = task->pool;
+    NWorkerTask *next = NULL;
+    GQueue      *wait = NULL;
+
+    if (task->orphaned) {
+        g_free (task);
+        return FALSE;
+    }
+
+    g_hash_table_remove (pool->tasks, GUINT_TO_POINTER (task->id));
+
+    if (!g_atomic_int_get (&task->cancelled) && task->done)
+        task->done (task->result, task->userdata);
+
+    if (task->destroy)
+        task->destroy (task->userdata);
+
+    /* start the next work of the same queue only after the previous one has
+       completed, so that completion may still push work in order. */
+
+    if (task->queue && (wait = g_hash_table_lookup (pool->queues, task->queue))) {
+        if ((next = g_queue_pop_head (wait)))
+            g_thread_pool_push (pool->threads, next, NULL);
+        else
+            g_hash_table_remove (pool->queues, task->queue);
+    }
+
+    g_free (task);
+
+    return FALSE;
+}
+
+static void
+worker_thread (gpointer data, gpointer userdata)
+{
+    NWorkerTask *task = data;
+
+    (void) userdata;
+
+    if (!g_atomic_int_get (&task->cancelled))
+        task->result = task->work (task->userdata);
+
+    g_atomic_int_set (&task->completing, 1);
+    g_idle_add (complete_cb, task);
+}
+
+NWorkerPool*
+n_worker_pool_new (guint max_threads)
+{
+    NWorkerPool *pool;
+
+    pool = g_new0 (NWorkerPool, 1);
+    pool->threads = g_thread_pool_new (worker_thread, pool,
+        max_threads > 0 ? (gint) max_threads : 1, FALSE, NULL);
+    pool->tasks   = g_hash_table_new (g_direct_hash, g_direct_equal);
+    pool->queues  = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+        NULL, (GDestroyNotify) g_queue_free);
+
+    return pool;
+}
+
+void
+n_worker_pool_set_threads (NWorkerPool *pool, guint max_threads)
+{
+    g_assert (pool != NULL);
+
+    if (pool->threads)
+        g_thread_pool_set_max_threads (pool->threads,
+            max_threads > 0 ? (gint) max_threads : 1, NULL);
+}
+
+void
+n_worker_pool_shutdown (NWorkerPool *pool)
+{
+    GHashTableIter  iter;
+    NWorkerTask    *task = NULL;
+
+    if (!pool || !pool->threads)
+        return;
+
+    /* drop work that has not started yet and wait for the running work. */
+
+    g_thread_pool_free (pool->threads, TRUE, TRUE);
+    pool->threads = NULL;
+
+    if (g_hash_table_size (pool->tasks) > 0)
+        N_DEBUG (LOG_CAT "dropping %u unfinished work item(s)",
+            g_hash_table_size (pool->tasks));
+
+    g_hash_table_iter_init (&iter, pool->tasks);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer*) &task)) {
+        if (task->destroy)
+            task->destroy (task->userdata);
+
+        /* task with completion pending is freed by the completion. */
+
+        if (g_atomic_int_get (&task->completing))
+            task->orphaned = TRUE;
+        else
+            g_free (task);
+    }
+
+    g_hash_table_remove_all (pool->tasks);
+    g_hash_table_remove_all (pool->queues);
+}
+
+/* work not completed yet, including work waiting for its queue and
+   completions pending in the main loop. */
+guint
+n_worker_pool_pending (NWorkerPool *pool)
+{
+    g_assert (pool != NULL);
+
+    return g_hash_table_size (pool->tasks);
+}
+
+void
+n_worker_pool_free (NWorkerPool *pool)
+{
+    if (!pool)
+        return;
+
+    n_worker_pool_shutdown (pool);
+
+    g_hash_table_destroy (pool->queues);
+    g_hash_table_destroy (pool->tasks);
+    g_free (pool);
+}
+
+guint
+n_core_push_work (NCore *core, gconstpointer queue, NWorkFunc work,
+                  NWorkDoneFunc done, gpointer userdata,
+                  GDestroyNotify destroy)
+{
+    NWorkerPool *pool = NULL;
+    NWorkerTask *task = NULL;
+    GQueue      *wait = NULL;
+    gboolean     result;
+
+    g_assert (core != NULL);
+    g_assert (work != NULL);
+
+    pool = core->workers;
+
+    /* no threads after shutdown, run the work directly. */
+
+    if (!pool->threads) {
+        N_DEBUG (LOG_CAT "work pushed after shutdown, running in main thread");
+        result = work (userdata);
+        if (done)
+            done (result, userdata);
+        if (destroy)
+            destroy (userdata);
+        return 0;
+    }
+
+    task           = g_new0 (NWorkerTask, 1);
+    task->pool     = pool;
+    task->queue    = queue;
+    task->work     = work;
+    task->done     = done;
+    task->userdata = userdata;
+    task->destroy  = destroy;
+
+    /* skip 0 and ids still in use */
+    do {
+        task->id = ++pool->next_id;
+    } while (task->id == 0 ||
+             g_hash_table_contains (pool->tasks, GUINT_TO_POINTER (task->id)));
+
+    g_hash_table_insert (pool->tasks, GUINT_TO_POINTER (task->id), task);
+
+    if (queue) {
+        if ((wait = g_hash_table_lookup (pool->queues, queue))) {
+            g_queue_push_tail (wait, task);
+            return task->id;
+        }
+
+        /* empty queue marks that work of the queue is running. */
+        g_hash_table_insert (pool->queues, (gpointer) queue, g_queue_new ());
+    }
+
+    g_thread_pool_push (pool->threads, task, NULL);
+
+    return task->id;
+}
+
+void
+n_core_cancel_work (NCore *core, guint work_id)
+{
+    NWorkerTask *task = NULL;
+
+    g_assert (core != NULL);
+
+    if (work_id == 0)
+        return;
+
+    if ((task = g_hash_table_lookup (core->workers->tasks, GUINT_TO_POINTER (work_id))))
+        g_atomic_int_set (&task->cancelled, 1);
+}
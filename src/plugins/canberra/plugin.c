@@ -19,6 +19,7 @@
  */
 
 #include <ngf/plugin.h>
+#include <ngf/worker.h>
 #include <canberra.h>
 
 #include <string.h>
@@ -46,6 +47,9 @@ typedef struct sink_userdata {
     ca_context *c_context;
     GHashTable *cached_samples;
     gboolean    support_cached_samples;
+    gboolean    connecting;         /* connection attempt running in a worker */
+    gboolean    closing;            /* shut down while connecting */
+    GList      *waiting;            /* CanberraData waiting for the connection */
 } sink_userdata;
 
 
@@ -55,6 +59,8 @@ static void canberra_disconnect (sink_userdata *u)
         ca_context_destroy (u->c_context);
         u->c_context = NULL;
     }
+
+    g_hash_table_remove_all (u->cached_samples);
 }
 
 static int canberra_connect (sink_userdata *u)
@@ -64,7 +70,6 @@ static int canberra_connect (sink_userdata *u)
     if (u->c_context)
         return TRUE;
 
-    g_hash_table_remove_all (u->cached_samples);
     ca_context_create (&u->c_context);
     error = ca_context_open (u->c_context);
     if (error) {
@@ -77,6 +82,93 @@ static int canberra_connect (sink_userdata *u)
     return TRUE;
 }
 
+static void
+canberra_userdata_free (sink_userdata *u)
+{
+    canberra_disconnect (u);
+    g_hash_table_destroy (u->cached_samples);
+    g_list_free (u->waiting);
+    g_free (u);
+}
+
+/* connecting to the sound server may block, so it is done in a worker
+   thread. the context is not touched from the main loop while a
+   connection attempt is running, requests played meanwhile wait for
+   it to finish. */
+
+typedef struct _CanberraConnect
+{
+    NSinkInterface *iface;
+    sink_userdata  *u;
+    gboolean        initial;
+} CanberraConnect;
+
+static gboolean canberra_play_sample (sink_userdata *u, CanberraData *data);
+static gboolean canberra_complete_cb (gpointer userdata);
+
+static gboolean
+canberra_connect_work (gpointer userdata)
+{
+    CanberraConnect *op = (CanberraConnect*) userdata;
+
+    return canberra_connect (op->u);
+}
+
+static void
+canberra_connect_done (gboolean result, gpointer userdata)
+{
+    CanberraConnect *op   = (CanberraConnect*) userdata;
+    sink_userdata   *u    = op->u;
+    CanberraData    *data = NULL;
+
+    u->connecting = FALSE;
+
+    if (u->closing) {
+        canberra_userdata_free (u);
+        return;
+    }
+
+    if (!result)
+        N_DEBUG (LOG_CAT "connection failed, retrying on next play");
+
+    if (op->initial)
+        n_sink_interface_initialized (op->iface, TRUE);
+
+    /* failing a request stops it, which removes it from the waiting
+       list, so take the requests one at a time. */
+
+    while (u->waiting) {
+        data = (CanberraData*) u->waiting->data;
+        u->waiting = g_list_delete_link (u->waiting, u->waiting);
+
+        if (!canberra_play_sample (u, data)) {
+            n_sink_interface_fail (data->iface, data->request);
+            continue;
+        }
+
+        data->complete_cb_id = g_timeout_add (200, canberra_complete_cb, data);
+    }
+}
+
+static void
+canberra_start_connect (NSinkInterface *iface, sink_userdata *u, gboolean initial)
+{
+    CanberraConnect *op = NULL;
+
+    if (u->connecting)
+        return;
+
+    op = g_new0 (CanberraConnect, 1);
+    op->iface   = iface;
+    op->u       = u;
+    op->initial = initial;
+
+    u->connecting = TRUE;
+    n_core_push_work (n_sink_interface_get_core (iface), u,
+                      canberra_connect_work, canberra_connect_done,
+                      op, g_free);
+}
+
 static int
 canberra_sink_initialize (NSinkInterface *iface)
 {
@@ -90,9 +182,11 @@ canberra_sink_initialize (NSinkInterface *iface)
      * string. */
     u->cached_samples = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
     u->support_cached_samples = TRUE;
-    canberra_connect (u);
     n_sink_interface_set_userdata (iface, u);
-    return TRUE;
+
+    canberra_start_connect (iface, u, TRUE);
+
+    return N_SINK_INTERFACE_INIT_PENDING;
 }
 
 static void
@@ -102,11 +196,47 @@ canberra_sink_shutdown (NSinkInterface *iface)
 
     N_DEBUG (LOG_CAT "sink shutdown");
 
-    if (u) {
-        canberra_disconnect (u);
-        if (u->cached_samples)
-            g_hash_table_destroy (u->cached_samples);
-        g_free (u);
+    if (!u)
+        return;
+
+    n_sink_interface_set_userdata (iface, NULL);
+
+    /* connection attempt still owns the userdata, it is freed once the
+       attempt has finished. */
+
+    if (u->connecting) {
+        u->closing = TRUE;
+        return;
+    }
+
+    canberra_userdata_free (u);
+}
+
+static int
+canberra_sink_trim (NSinkInterface *iface)
+{
+    sink_userdata *u = n_sink_interface_get_userdata (iface);
+
+    if (!u || u->connecting || !u->c_context)
+        return FALSE;
+
+    N_DEBUG (LOG_CAT "sink trim, disconnecting");
+
+    canberra_disconnect (u);
+
+    return TRUE;
+}
+
+static void
+canberra_sink_rewarm (NSinkInterface *iface)
+{
+    sink_userdata *u = n_sink_interface_get_userdata (iface);
+
+    /* play may have connected already. */
+
+    if (u && !u->connecting && !u->c_context) {
+        N_DEBUG (LOG_CAT "sink rewarm, connecting");
+        canberra_start_connect (iface, u, FALSE);
     }
 }
 
@@ -177,30 +307,17 @@ canberra_complete_cb (gpointer userdata) {
     return FALSE;
 }
 
-static int
-canberra_sink_play (NSinkInterface *iface, NRequest *request)
+static gboolean
+canberra_play_sample (sink_userdata *u, CanberraData *data)
 {
-    sink_userdata   *u;
-    CanberraData    *data;
     const NProplist *props;
     ca_proplist     *ca_props = 0;
     int              error;
 
-    N_DEBUG (LOG_CAT "sink play");
-
-    u = n_sink_interface_get_userdata (iface);
-    data = n_request_get_data (request, CANBERRA_KEY);
-
-    g_assert (u);
-    g_assert (data);
-
-    if (!data->sound_enabled)
-        goto complete;
-
-    if (canberra_connect (u) == FALSE)
+    if (!u->c_context)
         return FALSE;
 
-    props = n_request_get_properties (request);
+    props = n_request_get_properties (data->request);
     ca_proplist_create (&ca_props);
 
     /* TODO: don't hardcode */
@@ -237,6 +354,39 @@ canberra_sink_play (NSinkInterface *iface, NRequest *request)
         return FALSE;
     }
 
+    return TRUE;
+}
+
+static int
+canberra_sink_play (NSinkInterface *iface, NRequest *request)
+{
+    sink_userdata   *u;
+    CanberraData    *data;
+
+    N_DEBUG (LOG_CAT "sink play");
+
+    u = n_sink_interface_get_userdata (iface);
+    data = n_request_get_data (request, CANBERRA_KEY);
+
+    g_assert (u);
+    g_assert (data);
+
+    if (!data->sound_enabled)
+        goto complete;
+
+    /* not connected, play once the connection attempt in progress, or
+       a new one, has finished. */
+
+    if (u->connecting || !u->c_context) {
+        N_DEBUG (LOG_CAT "waiting for connection");
+        u->waiting = g_list_append (u->waiting, data);
+        canberra_start_connect (iface, u, FALSE);
+        return TRUE;
+    }
+
+    if (!canberra_play_sample (u, data))
+        return FALSE;
+
 complete:
     /* We do not know how long our samples play, but let's guess we
      * are done in 200ms. */
@@ -250,11 +400,13 @@ canberra_sink_stop (NSinkInterface *iface, NRequest *request)
 {
     N_DEBUG (LOG_CAT "sink stop");
 
-    (void) iface;
-
-    CanberraData *data = (CanberraData*) n_request_get_data (request, CANBERRA_KEY);
+    sink_userdata *u    = n_sink_interface_get_userdata (iface);
+    CanberraData  *data = (CanberraData*) n_request_get_data (request, CANBERRA_KEY);
     g_assert (data != NULL);
 
+    if (u)
+        u->waiting = g_list_remove (u->waiting, data);
+
     if (data->complete_cb_id > 0)
         g_source_remove (data->complete_cb_id);
 
@@ -274,7 +426,9 @@ N_PLUGIN_LOAD (plugin)
         .prepare    = canberra_sink_prepare,
         .play       = canberra_sink_play,
         .pause      = NULL,
-        .stop       = canberra_sink_stop
+        .stop       = canberra_sink_stop,
+        .trim       = canberra_sink_trim,
+        .rewarm     = canberra_sink_rewarm
     };
 
     n_plugin_register_sink (plugin, &decl);
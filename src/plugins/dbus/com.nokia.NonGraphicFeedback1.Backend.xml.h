@@ -1 +1 @@
-const char *dbus_plugin_introspect_string = "<!DOCTYPE node PUBLIC \"-//freedesktop//DTD D-BUS Object Introspection 1.0//EN\" \"http://www.freedesktop.org/standards/dbus/1.0/introspect.dtd\">\n<node>\n    <interface name=\"com.nokia.NonGraphicFeedback1.Backend\">\n        <method name=\"Play\">\n            <arg name=\"event\" type=\"s\" direction=\"in\"/>\n            <arg name=\"properties\" type=\"a(sv)\"/>\n            <arg name=\"\" type=\"u\" direction=\"out\"/>\n        </method>\n        <method name=\"Pause\">\n            <arg name=\"event_id\" type=\"u\" direction=\"in\"/>\n            <arg name=\"pause\" type=\"b\" direction=\"in\"/>\n            <arg name=\"\" type=\"u\" direction=\"out\"/>\n        </method>\n        <method name=\"Stop\">\n            <arg name=\"event_id\" type=\"u\" direction=\"in\"/>\n            <arg name=\"\" type=\"u\" direction=\"out\"/>\n        </method>\n        <signal name=\"Status\">\n            <arg name=\"\" type=\"u\" direction=\"out\"/>\n            <arg name=\"\" type=\"u\" direction=\"out\"/>\n        </signal>\n    </interface>\n</node>\n\n";
+const char *dbus_plugin_introspect_string = "<!DOCTYPE node PUBLIC \"-//freedesktop//DTD D-BUS Object Introspection 1.0//EN\" \"http://www.freedesktop.org/standards/dbus/1.0/introspect.dtd\">\n<node>\n    <interface name=\"com.nokia.NonGraphicFeedback1.Backend\">\n        <method name=\"Play\">\n            <arg name=\"event\" type=\"s\" direction=\"in\"/>\n            <arg name=\"properties\" type=\"a(sv)\"/>\n            <arg name=\"\" type=\"u\" direction=\"out\"/>\n        </method>\n        <method name=\"PlayNoReply\">\n            <arg name=\"event\" type=\"s\" direction=\"in\"/>\n            <arg name=\"properties\" type=\"a(sv)\"/>\n            <annotation name=\"org.freedesktop.DBus.Method.NoReply\" value=\"true\"/>\n        </method>\n        <method name=\"PlayGroup\">\n            <arg name=\"events\" type=\"a(sa{sv})\" direction=\"in\"/>\n            <arg name=\"\" type=\"u\" direction=\"out\"/>\n        </method>\n        <method name=\"Prepare\">\n            <arg name=\"event\" type=\"s\" direction=\"in\"/>\n            <arg name=\"properties\" type=\"a{sv}\" direction=\"in\"/>\n            <arg name=\"handle\" type=\"u\" direction=\"out\"/>\n        </method>\n        <method name=\"PlayPrepared\">\n            <arg name=\"handle\" type=\"u\" direction=\"in\"/>\n            <arg name=\"\" type=\"u\" direction=\"out\"/>\n        </method>\n        <method name=\"Release\">\n            <arg name=\"handle\" type=\"u\" direction=\"in\"/>\n        </method>\n        <method name=\"Pause\">\n            <arg name=\"event_id\" type=\"u\" direction=\"in\"/>\n            <arg name=\"pause\" type=\"b\" direction=\"in\"/>\n            <arg name=\"\" type=\"u\" direction=\"out\"/>\n        </method>\n        <method name=\"Stop\">\n            <arg name=\"event_id\" type=\"u\" direction=\"in\"/>\n            <arg name=\"\" type=\"u\" direction=\"out\"/>\n        </method>\n        <method name=\"ReloadPlugin\">\n            <arg name=\"plugin\" type=\"s\" direction=\"in\"/>\n        </method>\n        <method name=\"GetRateLimitStats\">\n            <arg name=\"classes\" type=\"a(suut)\" direction=\"out\"/>\n            <arg name=\"throttled\" type=\"u\" direction=\"out\"/>\n        </method>\n        <signal name=\"Status\">\n            <arg name=\"\" type=\"u\" direction=\"out\"/>\n            <arg name=\"\" type=\"u\" direction=\"out\"/>\n        </signal>\n    </interface>\n</node>\n\n";
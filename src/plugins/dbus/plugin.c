@@ -23,7 +23,9 @@
 #include <dbus/dbus.h>
 #include <dbus-gmain/dbus-gmain.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <ngf/log.h>
 #include <ngf/value.h>
@@ -36,7 +38,12 @@ N_PLUGIN_NAME        ("dbus")
 N_PLUGIN_VERSION     ("0.1")
 N_PLUGIN_DESCRIPTION ("D-Bus interface")
 
+/* request keys come from transform. the input starts without waiting for
+   sinks that initialize asynchronously, they are used once ready. */
+N_PLUGIN_DEPENDS     ("transform")
+
 #include "com.nokia.NonGraphicFeedback1.Backend.xml.h"
+#include "ratelimit.h"
 
 #define LOG_CAT "dbus: "
 
@@ -47,11 +54,23 @@ N_PLUGIN_DESCRIPTION ("D-Bus interface")
 
 #define NGF_DBUS_STATUS       "Status"
 #define NGF_DBUS_METHOD_PLAY  "Play"
+#define NGF_DBUS_METHOD_PLAY_NO_REPLY "PlayNoReply"
+#define NGF_DBUS_METHOD_PLAY_GROUP "PlayGroup"
 #define NGF_DBUS_METHOD_STOP  "Stop"
 #define NGF_DBUS_METHOD_PAUSE "Pause"
 #define NGF_DBUS_METHOD_DEBUG "internal_debug"
+#define NGF_DBUS_METHOD_RELOAD_PLUGIN "ReloadPlugin"
+#define NGF_DBUS_METHOD_PREPARE "Prepare"
+#define NGF_DBUS_METHOD_PLAY_PREPARED "PlayPrepared"
+#define NGF_DBUS_METHOD_RELEASE "Release"
+#define NGF_DBUS_METHOD_RATE_LIMIT_STATS "GetRateLimitStats"
 
 #define NGF_DBUS_PROPERTY_NAME "dbus.event.client"
+/* boolean set by client in Play properties, if TRUE only FAILED and COMPLETED
+ * Status is sent for the request */
+#define NGF_DBUS_PROPERTY_FINAL_STATUS "dbus.status.final_only"
+/* set by PlayNoReply, no method return or Status is sent for the request */
+#define NGF_DBUS_PROPERTY_NO_REPLY "dbus.event.no_reply"
 
 #define DBUS_CLIENT_MATCH "type='signal',sender='org.freedesktop.DBus',member='NameOwnerChanged'"
 
@@ -59,26 +78,48 @@ N_PLUGIN_DESCRIPTION ("D-Bus interface")
 
 #define DBUSIF_REQUEST_LIMIT    "request_limit"
 #define DBUSIF_CLIENT_LIMIT     "client_limit"
+#define DBUSIF_PREPARED_LIMIT   "prepared_limit"
 #define DEFAULT_REQUEST_LIMIT   (16)
 #define DEFAULT_CLIENT_LIMIT    (64)
+#define DEFAULT_PREPARED_LIMIT  (16)
+
+/* forwarded calls handled per main loop iteration */
+#define DBUSIF_QUEUE_BATCH      (32)
+
+/* rate_limit = RATE[/BURST] for events not matching any class,
+ * rate_limit.PATTERN = RATE[/BURST] for events matching the glob PATTERN.
+ * RATE is requests per second, BURST the bucket size (defaults to RATE),
+ * RATE 0 disables the limit for the class. */
+#define DBUSIF_RATE_LIMIT        "rate_limit"
+#define DBUSIF_RATE_LIMIT_PREFIX "rate_limit."
 
 /* from ngf/core-player.h */
 #define N_DBUS_EVENT_FAILED     (0)
 #define N_DBUS_EVENT_COMPLETED  (1)
+#define N_DBUS_EVENT_PLAYING    (2)
+#define N_DBUS_EVENT_PAUSED     (3)
 
 static uint32_t          dbusif_max_requests;
 static uint32_t          dbusif_max_clients;
+static uint32_t          dbusif_max_prepared;
+static DBusRateLimit    *dbusif_rate_limit;
 
+static gboolean          msg_type_accepted       (int key_type, int arg_type);
 static gboolean          msg_parse_variant       (DBusMessageIter *iter,
                                                   NProplist *proplist,
-                                                  const char *key);
+                                                  const char *key,
+                                                  int key_type);
 static gboolean          msg_parse_dict          (DBusMessageIter *iter,
+                                                  NCore *core,
                                                   NProplist *proplist);
 static gboolean          msg_get_properties      (DBusMessageIter *iter,
+                                                  NCore *core,
                                                   NProplist **properties);
 static DBusHandlerResult dbusif_message_function (DBusConnection *connection,
                                                   DBusMessage *msg,
                                                   void *userdata);
+static void              dbusif_handle_message   (NInputInterface *iface,
+                                                  DBusMessage *msg);
 
 static NRequest*         dbusif_lookup_request   (NInputInterface *iface,
                                                   uint32_t event_id);
@@ -91,23 +132,74 @@ static void              dbusif_send_reply       (NInputInterface *iface,
                                                   NRequest *request,
                                                   int code);
 
+/* Messages are read, parsed and acked in a dispatch thread with its own
+ * connection and context. Requests and calls that need the core are
+ * passed to the main loop through the queue, in the order received.
+ * Clients, requests and prepared handles are shared, lock protects them. */
 typedef struct _DBusInterfaceData
 {
     DBusConnection  *connection;
     NInputInterface *iface;
-    GSList *clients; // Internal cache of all clients currently connected
-    uint32_t client_count;
+    GHashTable      *clients;   /* unique bus name -> DBusInterfaceClient* */
+    GHashTable      *requests;  /* request id -> NRequest* of all clients */
+    GHashTable      *prepared;  /* handle -> DBusPrepared* of all clients */
+    uint32_t         handle_counter;
+    GRecMutex        lock;
+    GMainContext    *context;   /* dispatch thread context */
+    GMainLoop       *loop;
+    GThread         *thread;
+    GAsyncQueue     *queue;     /* DBusQueued* to the main loop */
+    GSource         *queue_source;
 } DBusInterfaceData;
 
+/* request or group to start, or a message to handle in the main loop */
+typedef struct _DBusQueued
+{
+    NRequest    *request;
+    GList       *requests;      /* members of a group request */
+    DBusMessage *msg;
+} DBusQueued;
+
 typedef struct _DBusInterfaceClient
 {
-    uint32_t    ref;
-    uint32_t    active_requests;
-    char        name[1];
+    uint32_t        ref;
+    uint32_t        active_requests;
+    GList          *requests;   /* ids of active requests of the client */
+    DBusRateBucket *buckets;    /* one for each rate class */
+    uint32_t        throttled;
+    GList          *handles;    /* handles of prepared requests of the client */
+    char            name[1];
 } DBusInterfaceClient;
 
+typedef struct _DBusPrepared
+{
+    NInputInterface     *iface;
+    DBusInterfaceClient *client;    /* owner, releases handles when it goes away */
+    NPreparedRequest    *prepared;
+    char                *event;
+} DBusPrepared;
+
+/* values of keys with a keytype must have a matching D-Bus type */
+static gboolean
+msg_type_accepted (int key_type, int arg_type)
+{
+    switch (key_type) {
+        case N_VALUE_TYPE_STRING:
+            return arg_type == DBUS_TYPE_STRING;
+        case N_VALUE_TYPE_INT:
+            return arg_type == DBUS_TYPE_INT32 || arg_type == DBUS_TYPE_UINT32;
+        case N_VALUE_TYPE_BOOL:
+            return arg_type == DBUS_TYPE_BOOLEAN;
+        default:
+            break;
+    }
+
+    return TRUE;
+}
+
 static gboolean
-msg_parse_variant (DBusMessageIter *iter, NProplist *proplist, const char *key)
+msg_parse_variant (DBusMessageIter *iter, NProplist *proplist, const char *key,
+                   int key_type)
 {
     DBusMessageIter variant;
 
@@ -124,6 +216,14 @@ msg_parse_variant (DBusMessageIter *iter, NProplist *proplist, const char *key)
 
     dbus_message_iter_recurse (iter, &variant);
 
+    if (!msg_type_accepted (key_type, dbus_message_iter_get_arg_type (&variant))) {
+        N_DEBUG (LOG_CAT "skipping key '%s' with wrong value type", key);
+        return FALSE;
+    }
+
+    /* basic values point to the message, they are copied only when set
+     * to the proplist that is then owned by the request. */
+
     switch (dbus_message_iter_get_arg_type (&variant)) {
         case DBUS_TYPE_STRING:
             dbus_message_iter_get_basic (&variant, &str_value);
@@ -153,9 +253,10 @@ msg_parse_variant (DBusMessageIter *iter, NProplist *proplist, const char *key)
 }
 
 static gboolean
-msg_parse_dict (DBusMessageIter *iter, NProplist *proplist)
+msg_parse_dict (DBusMessageIter *iter, NCore *core, NProplist *proplist)
 {
-    const char      *key = NULL;
+    const char      *key      = NULL;
+    int              key_type = 0;
     DBusMessageIter  dict;
 
     /* Recurse to the dict entry */
@@ -173,15 +274,20 @@ msg_parse_dict (DBusMessageIter *iter, NProplist *proplist)
     dbus_message_iter_get_basic (&dict, &key);
     dbus_message_iter_next (&dict);
 
+    /* Skip keys that would be dropped before playing anyway, without
+     * copying anything from the message. */
+    if (!n_core_lookup_request_key (core, key, &key_type))
+        return FALSE;
+
     /* Parse the variant contents */
-    if (!msg_parse_variant (&dict, proplist, key))
+    if (!msg_parse_variant (&dict, proplist, key, key_type))
         return FALSE;
 
     return TRUE;
 }
 
 static gboolean
-msg_get_properties (DBusMessageIter *iter, NProplist **properties)
+msg_get_properties (DBusMessageIter *iter, NCore *core, NProplist **properties)
 {
     NProplist       *p = NULL;
     DBusMessageIter  array;
@@ -193,7 +299,7 @@ msg_get_properties (DBusMessageIter *iter, NProplist **properties)
 
     dbus_message_iter_recurse (iter, &array);
     while (dbus_message_iter_get_arg_type (&array) != DBUS_TYPE_INVALID) {
-        (void) msg_parse_dict (&array, p);
+        (void) msg_parse_dict (&array, core, p);
         dbus_message_iter_next (&array);
     }
 
@@ -241,6 +347,12 @@ client_new (const char *client_name)
     c = g_malloc (sizeof (*c) + strlen (client_name));
     c->ref = 1;
     c->active_requests = 0;
+    c->requests = NULL;
+    c->buckets = NULL;
+    c->throttled = 0;
+    c->handles = NULL;
+    if (rate_limit_num_classes (dbusif_rate_limit) > 0)
+        c->buckets = g_new0 (DBusRateBucket, rate_limit_num_classes (dbusif_rate_limit));
     strcpy(c->name, client_name);
     N_DEBUG (LOG_CAT ">> new client (%s)", c->name);
 
@@ -257,6 +369,9 @@ client_ref (DBusInterfaceClient *client)
 static void
 client_free (DBusInterfaceClient *client)
 {
+    g_list_free (client->requests);
+    g_list_free (client->handles);
+    g_free (client->buckets);
     g_free (client);
 }
 
@@ -269,58 +384,203 @@ client_unref (DBusInterfaceClient *client)
         client_free (client);
 }
 
+static gboolean
+client_rate_take (DBusInterfaceClient *client, const char *event)
+{
+    const DBusRateClass *cls = NULL;
+
+    if (rate_limit_take (dbusif_rate_limit, client->buckets, event,
+                         g_get_monotonic_time ()))
+        return TRUE;
+
+    cls = rate_limit_get_class (dbusif_rate_limit,
+                                rate_limit_class_for_event (dbusif_rate_limit, event));
+    client->throttled++;
+    N_DEBUG (LOG_CAT "client %s throttled for event '%s' (class '%s')",
+                     client->name, event, cls->pattern ? cls->pattern : "default");
+
+    return FALSE;
+}
+
 static inline void
-client_request_new (DBusInterfaceClient *client)
+client_request_new (DBusInterfaceData *idata, DBusInterfaceClient *client,
+                    NRequest *request)
 {
+    uint32_t id = n_request_get_id (request);
+
+    client->requests = g_list_prepend (client->requests, GUINT_TO_POINTER (id));
     client->active_requests++;
+    g_hash_table_insert (idata->requests, GUINT_TO_POINTER (id), request);
 }
 
 static inline void
-client_request_done (DBusInterfaceClient *client)
+client_request_done (DBusInterfaceData *idata, DBusInterfaceClient *client,
+                     NRequest *request)
 {
-    if (client->active_requests == 0)
+    uint32_t id = n_request_get_id (request);
+
+    g_hash_table_remove (idata->requests, GUINT_TO_POINTER (id));
+
+    if (client->active_requests == 0) {
         N_ERROR (LOG_CAT "client '%s' active requests 0", client->name);
-    else
-        client->active_requests--;
+        return;
+    }
+
+    client->requests = g_list_remove (client->requests, GUINT_TO_POINTER (id));
+    client->active_requests--;
 }
 
 static DBusInterfaceClient*
 client_list_find (DBusInterfaceData *idata, const char *client_name)
 {
-    GSList              *search;
-    DBusInterfaceClient *c;
-
-    for (search = idata->clients; search; search = g_slist_next(search)) {
-        c = search->data;
-        if (g_str_equal (client_name, c->name))
-            return c;
-    }
-
-    return NULL;
+    return g_hash_table_lookup (idata->clients, client_name);
 }
 
 static void
 client_list_remove (DBusInterfaceData *idata, DBusInterfaceClient *client)
 {
-    GSList *search;
-
-    if ((search = g_slist_find (idata->clients, client))) {
-        idata->clients = g_slist_delete_link (idata->clients, search);
-        idata->client_count--;
-    } else
+    if (!g_hash_table_remove (idata->clients, client->name))
         N_ERROR (LOG_CAT "cannot find client %s from client list.", client->name);
 }
 
 static void
 client_list_add (DBusInterfaceData *idata, DBusInterfaceClient *client)
 {
-    idata->clients = g_slist_append (idata->clients, client);
-    idata->client_count++;
+    g_hash_table_insert (idata->clients, client->name, client);
+}
+
+/* drop a client added for a call that failed, unless it got requests
+   or handles meanwhile. */
+static void
+client_list_discard (DBusInterfaceData *idata, DBusInterfaceClient *client)
+{
+    if (client->active_requests > 0 || client->handles)
+        return;
+
+    N_DEBUG (LOG_CAT "discarding client %s, call failed", client->name);
+    client_list_remove (idata, client);
+    client_unref (client);
+}
+
+static gboolean
+client_list_has (DBusInterfaceData *idata, const char *client_name)
+{
+    gboolean found = FALSE;
+
+    g_rec_mutex_lock (&idata->lock);
+    found = client_list_find (idata, client_name) != NULL;
+    g_rec_mutex_unlock (&idata->lock);
+
+    return found;
+}
+
+static void
+prepared_free (DBusPrepared *p)
+{
+    n_input_interface_release_prepared (p->iface, p->prepared);
+    g_free (p->event);
+    g_free (p);
+}
+
+static void
+client_release_prepared (DBusInterfaceData *idata, DBusInterfaceClient *client)
+{
+    GList *iter = NULL;
+
+    for (iter = client->handles; iter; iter = g_list_next (iter))
+        g_hash_table_remove (idata->prepared, iter->data);
+
+    g_list_free (client->handles);
+    client->handles = NULL;
+}
+
+static void
+queued_free (DBusInterfaceData *idata, DBusQueued *item)
+{
+    DBusInterfaceClient *client = NULL;
+
+    /* request that never reached the core, undo the bookkeeping */
+    if (item->request) {
+        client = n_proplist_get_pointer (n_request_get_properties (item->request),
+                                         NGF_DBUS_PROPERTY_NAME);
+        client_request_done (idata, client, item->request);
+        client_unref (client);
+        n_request_free (item->request);
+    }
+
+    g_list_free_full (item->requests, (GDestroyNotify) n_request_free);
+    if (item->msg)
+        dbus_message_unref (item->msg);
+    g_free (item);
+}
+
+/* called from the dispatch thread */
+static void
+dbusif_queue_push (DBusInterfaceData *idata, NRequest *request, GList *requests,
+                   DBusMessage *msg)
+{
+    DBusQueued *item = NULL;
+
+    item = g_new0 (DBusQueued, 1);
+    item->request  = request;
+    item->requests = requests;
+    item->msg      = msg ? dbus_message_ref (msg) : NULL;
+
+    g_async_queue_push (idata->queue, item);
+    g_source_set_ready_time (idata->queue_source, 0);
+}
+
+static DBusHandlerResult
+dbusif_queue_message (NInputInterface *iface, DBusMessage *msg)
+{
+    dbusif_queue_push (n_input_interface_get_userdata (iface), NULL, NULL, msg);
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+static gboolean
+queue_source_dispatch (GSource *source, GSourceFunc callback, gpointer userdata)
+{
+    g_source_set_ready_time (source, -1);
+    return callback (userdata);
+}
+
+static GSourceFuncs queue_source_funcs = {
+    .dispatch = queue_source_dispatch
+};
+
+static gboolean
+dbusif_queue_drain_cb (gpointer userdata)
+{
+    DBusInterfaceData *idata = (DBusInterfaceData*) userdata;
+    DBusQueued        *item  = NULL;
+    guint              count = 0;
+
+    while (count++ < DBUSIF_QUEUE_BATCH &&
+           (item = g_async_queue_try_pop (idata->queue))) {
+        if (item->msg)
+            dbusif_handle_message (idata->iface, item->msg);
+        else if (item->requests)
+            n_input_interface_play_group (idata->iface, item->request, item->requests);
+        else
+            n_input_interface_play_request (idata->iface, item->request);
+
+        /* the core owns the requests now */
+        item->request = NULL;
+        g_list_free (item->requests);
+        item->requests = NULL;
+        queued_free (idata, item);
+    }
+
+    /* let other sources run before the rest of a burst */
+    if (g_async_queue_length (idata->queue) > 0)
+        g_source_set_ready_time (idata->queue_source, 0);
+
+    return TRUE;
 }
 
 static DBusHandlerResult
 dbusif_play_handler (DBusConnection *connection, DBusMessage *msg,
-                     NInputInterface *iface)
+                     NInputInterface *iface, gboolean no_reply)
 {
     DBusInterfaceData   *idata      = NULL;
     const char          *event      = NULL;
@@ -329,21 +589,25 @@ dbusif_play_handler (DBusConnection *connection, DBusMessage *msg,
     DBusMessageIter      iter;
     const char          *sender     = NULL;
     DBusInterfaceClient *client     = NULL;
+    gboolean             created    = FALSE;
     const char          *error      = NULL;
 
     idata = n_input_interface_get_userdata (iface);
 
+    g_rec_mutex_lock (&idata->lock);
+
     // We won't launch events without proper sender
     if ((sender = dbus_message_get_sender (msg)) == NULL)
         goto fail;
 
     if (!(client = client_list_find(idata, sender))) {
-        if (idata->client_count >= dbusif_max_clients) {
+        if (g_hash_table_size (idata->clients) >= dbusif_max_clients) {
             error = "Too many simultaneous clients.";
             goto limits;
         }
         client = client_new (sender);
         client_list_add (idata, client);
+        created = TRUE;
     } else if (client->active_requests >= dbusif_max_requests) {
         error = "Too many simultaneous requests.";
         goto limits;
@@ -356,48 +620,459 @@ dbusif_play_handler (DBusConnection *connection, DBusMessage *msg,
     dbus_message_iter_get_basic (&iter, &event);
     dbus_message_iter_next (&iter);
 
-    if (!msg_get_properties (&iter, &properties))
+    if (!client_rate_take (client, event)) {
+        error = "Rate limit exceeded.";
+        goto limits;
+    }
+
+    if (!msg_get_properties (&iter, n_input_interface_get_core (iface), &properties))
+        goto fail;
+
+    n_proplist_set_pointer (properties, NGF_DBUS_PROPERTY_NAME, client);
+    n_proplist_set_bool (properties, NGF_DBUS_PROPERTY_NO_REPLY, no_reply);
+    request = n_request_new_with_event_take_properties (event, properties);
+
+    client_ref (client);
+    client_request_new (idata, client, request);
+
+    N_INFO (LOG_CAT ">> play%s received for event '%s' with id '%u' (client %s : %u active request(s))",
+                    no_reply ? " (no reply)" : "", event, n_request_get_id (request),
+                    client->name, client->active_requests);
+
+    g_rec_mutex_unlock (&idata->lock);
+
+    // Reply internal event_id immediately, the main loop starts the request
+    if (!no_reply)
+        dbusif_ack (connection, msg, n_request_get_id (request));
+
+    dbusif_queue_push (idata, request, NULL, NULL);
+
+    return DBUS_HANDLER_RESULT_HANDLED;
+
+limits:
+    if (created)
+        client_list_discard (idata, client);
+    g_rec_mutex_unlock (&idata->lock);
+    if (no_reply)
+        N_DEBUG (LOG_CAT "play (no reply) from %s rejected: %s", sender, error);
+    else
+        dbusif_reply_error (connection, msg, DBUS_ERROR_LIMITS_EXCEEDED, error);
+    return DBUS_HANDLER_RESULT_HANDLED;
+
+fail:
+    if (created)
+        client_list_discard (idata, client);
+    g_rec_mutex_unlock (&idata->lock);
+    if (no_reply)
+        N_DEBUG (LOG_CAT "malformed play (no reply) from %s", sender ? sender : "unknown");
+    else
+        dbusif_reply_error (connection, msg, DBUS_ERROR_INVALID_ARGS, "Malformed method call.");
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+static DBusHandlerResult
+dbusif_play_group_handler (DBusConnection *connection, DBusMessage *msg,
+                           NInputInterface *iface)
+{
+    DBusInterfaceData   *idata      = NULL;
+    const char          *event      = NULL;
+    NProplist           *properties = NULL;
+    NRequest            *group      = NULL;
+    GList               *requests   = NULL;
+    guint                n_requests = 0;
+    GString             *name       = NULL;
+    DBusMessageIter      iter;
+    DBusMessageIter      array;
+    DBusMessageIter      item;
+    const char          *sender     = NULL;
+    DBusInterfaceClient *client     = NULL;
+    gboolean             created    = FALSE;
+    const char          *error      = NULL;
+
+    idata = n_input_interface_get_userdata (iface);
+
+    g_rec_mutex_lock (&idata->lock);
+
+    if ((sender = dbus_message_get_sender (msg)) == NULL)
         goto fail;
 
+    if (!(client = client_list_find(idata, sender))) {
+        if (g_hash_table_size (idata->clients) >= dbusif_max_clients) {
+            error = "Too many simultaneous clients.";
+            goto limits;
+        }
+        client = client_new (sender);
+        client_list_add (idata, client);
+        created = TRUE;
+    } else if (client->active_requests >= dbusif_max_requests) {
+        error = "Too many simultaneous requests.";
+        goto limits;
+    }
+
+    dbus_message_iter_init (msg, &iter);
+    if (dbus_message_iter_get_arg_type (&iter) != DBUS_TYPE_ARRAY)
+        goto fail;
+
+    /* array of (event, properties) pairs, started together as one group. */
+
+    name = g_string_new (NULL);
+
+    dbus_message_iter_recurse (&iter, &array);
+    while (dbus_message_iter_get_arg_type (&array) == DBUS_TYPE_STRUCT) {
+        if (n_requests >= dbusif_max_requests) {
+            error = "Too many events in group.";
+            goto group_limits;
+        }
+
+        dbus_message_iter_recurse (&array, &item);
+        if (dbus_message_iter_get_arg_type (&item) != DBUS_TYPE_STRING)
+            goto group_fail;
+
+        dbus_message_iter_get_basic (&item, &event);
+        dbus_message_iter_next (&item);
+
+        /* every event of the group takes a token from its class */
+        if (!client_rate_take (client, event)) {
+            error = "Rate limit exceeded.";
+            goto group_limits;
+        }
+
+        if (!msg_get_properties (&item, n_input_interface_get_core (iface), &properties))
+            goto group_fail;
+
+        requests = g_list_prepend (requests,
+            n_request_new_with_event_take_properties (event, properties));
+        ++n_requests;
+
+        if (name->len > 0)
+            g_string_append_c (name, '+');
+        g_string_append (name, event);
+
+        dbus_message_iter_next (&array);
+    }
+
+    if (!requests)
+        goto group_fail;
+
+    requests = g_list_reverse (requests);
+
+    properties = n_proplist_new ();
+    n_proplist_set_pointer (properties, NGF_DBUS_PROPERTY_NAME, client);
+    group = n_request_new_with_event_take_properties (name->str, properties);
+    g_string_free (name, TRUE);
+
     client_ref (client);
-    client_request_new (client);
+    client_request_new (idata, client, group);
+
+    N_INFO (LOG_CAT ">> play group received for events '%s' with id '%u' (client %s : %u active request(s))",
+                    n_request_get_name (group), n_request_get_id (group),
+                    client->name, client->active_requests);
+
+    g_rec_mutex_unlock (&idata->lock);
+
+    dbusif_ack (connection, msg, n_request_get_id (group));
+
+    dbusif_queue_push (idata, group, requests, NULL);
+
+    return DBUS_HANDLER_RESULT_HANDLED;
+
+group_limits:
+    g_list_free_full (requests, (GDestroyNotify) n_request_free);
+    g_string_free (name, TRUE);
+
+limits:
+    if (created)
+        client_list_discard (idata, client);
+    g_rec_mutex_unlock (&idata->lock);
+    dbusif_reply_error (connection, msg, DBUS_ERROR_LIMITS_EXCEEDED, error);
+    return DBUS_HANDLER_RESULT_HANDLED;
+
+group_fail:
+    g_list_free_full (requests, (GDestroyNotify) n_request_free);
+    g_string_free (name, TRUE);
+
+fail:
+    if (created)
+        client_list_discard (idata, client);
+    g_rec_mutex_unlock (&idata->lock);
+    dbusif_reply_error (connection, msg, DBUS_ERROR_INVALID_ARGS, "Malformed method call.");
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+static DBusHandlerResult
+dbusif_prepare_handler (DBusConnection *connection, DBusMessage *msg,
+                        NInputInterface *iface)
+{
+    DBusInterfaceData   *idata      = NULL;
+    const char          *event      = NULL;
+    NProplist           *properties = NULL;
+    NRequest            *request    = NULL;
+    NPreparedRequest    *prepared   = NULL;
+    DBusPrepared        *p          = NULL;
+    DBusMessageIter      iter;
+    const char          *sender     = NULL;
+    DBusInterfaceClient *client     = NULL;
+    gboolean             created    = FALSE;
+    const char          *error      = NULL;
+    uint32_t             handle     = 0;
+
+    idata = n_input_interface_get_userdata (iface);
+
+    g_rec_mutex_lock (&idata->lock);
+
+    if ((sender = dbus_message_get_sender (msg)) == NULL)
+        goto fail;
+
+    if (!(client = client_list_find(idata, sender))) {
+        if (g_hash_table_size (idata->clients) >= dbusif_max_clients) {
+            error = "Too many simultaneous clients.";
+            goto limits;
+        }
+        client = client_new (sender);
+        client_list_add (idata, client);
+        created = TRUE;
+    } else if (g_list_length (client->handles) >= dbusif_max_prepared) {
+        error = "Too many prepared requests.";
+        goto limits;
+    }
+
+    dbus_message_iter_init (msg, &iter);
+    if (dbus_message_iter_get_arg_type (&iter) != DBUS_TYPE_STRING)
+        goto fail;
+
+    dbus_message_iter_get_basic (&iter, &event);
+    dbus_message_iter_next (&iter);
+
+    if (!msg_get_properties (&iter, n_input_interface_get_core (iface), &properties))
+        goto fail;
+
+    /* the owner is known for every request played from the handle, so the
+       client is part of the prepared properties. */
 
     n_proplist_set_pointer (properties, NGF_DBUS_PROPERTY_NAME, client);
-    request = n_request_new_with_event_and_properties (event, properties);
-    n_proplist_free (properties);
+    request = n_request_new_with_event_take_properties (event, properties);
 
-    N_INFO (LOG_CAT ">> play received for event '%s' with id '%u' (client %s : %u active request(s))",
-                    event, n_request_get_id (request), client->name, client->active_requests);
+    /* resolving runs the hooks and queries the sinks, so it is done
+       without the lock to keep the dispatch thread playing. */
 
-    // Reply internal event_id immediately
-    dbusif_ack (connection, msg, n_request_get_id (request));
+    client_ref (client);
+    g_rec_mutex_unlock (&idata->lock);
 
-    n_input_interface_play_request (iface, request);
+    prepared = n_input_interface_prepare_request (iface, request);
+
+    g_rec_mutex_lock (&idata->lock);
+
+    if (client_list_find (idata, sender) != client) {
+        N_DEBUG (LOG_CAT "client %s left while preparing '%s'", sender, event);
+        if (prepared)
+            n_input_interface_release_prepared (iface, prepared);
+        client_unref (client);
+        g_rec_mutex_unlock (&idata->lock);
+        dbusif_reply_error (connection, msg, DBUS_ERROR_FAILED,
+                            "Client disconnected.");
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+    client_unref (client);
+
+    if (!prepared) {
+        if (created)
+            client_list_discard (idata, client);
+        g_rec_mutex_unlock (&idata->lock);
+        dbusif_reply_error (connection, msg, DBUS_ERROR_INVALID_ARGS,
+                            "Event cannot be resolved.");
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+    /* skip 0 */
+    handle = ++idata->handle_counter ? idata->handle_counter : ++idata->handle_counter;
+
+    p = g_new0 (DBusPrepared, 1);
+    p->iface    = iface;
+    p->client   = client;
+    p->prepared = prepared;
+    p->event    = g_strdup (event);
+    g_hash_table_insert (idata->prepared, GUINT_TO_POINTER (handle), p);
+    client->handles = g_list_prepend (client->handles, GUINT_TO_POINTER (handle));
+
+    N_INFO (LOG_CAT ">> prepare received for event '%s' with handle '%u' (client %s)",
+                    event, handle, client->name);
+
+    g_rec_mutex_unlock (&idata->lock);
+
+    dbusif_ack (connection, msg, handle);
 
     return DBUS_HANDLER_RESULT_HANDLED;
 
 limits:
+    if (created)
+        client_list_discard (idata, client);
+    g_rec_mutex_unlock (&idata->lock);
     dbusif_reply_error (connection, msg, DBUS_ERROR_LIMITS_EXCEEDED, error);
     return DBUS_HANDLER_RESULT_HANDLED;
 
 fail:
+    if (created)
+        client_list_discard (idata, client);
+    g_rec_mutex_unlock (&idata->lock);
     dbusif_reply_error (connection, msg, DBUS_ERROR_INVALID_ARGS, "Malformed method call.");
     return DBUS_HANDLER_RESULT_HANDLED;
 }
 
+static DBusPrepared*
+dbusif_lookup_prepared (DBusInterfaceData *idata, DBusMessage *msg,
+                        DBusInterfaceClient **client, uint32_t *handle,
+                        const char **error)
+{
+    const char    *sender = NULL;
+    dbus_uint32_t  value  = 0;
+    DBusPrepared  *p      = NULL;
+
+    if ((sender = dbus_message_get_sender (msg)) == NULL ||
+        !(*client = client_list_find (idata, sender))) {
+        *error = "Unknown client.";
+        return NULL;
+    }
+
+    if (!dbus_message_get_args (msg, NULL,
+                                DBUS_TYPE_UINT32, &value,
+                                DBUS_TYPE_INVALID) ||
+        !(p = g_hash_table_lookup (idata->prepared, GUINT_TO_POINTER (value))) ||
+        p->client != *client) {
+        *error = "No prepared request with given handle found.";
+        return NULL;
+    }
+
+    *handle = value;
+
+    return p;
+}
+
+static DBusHandlerResult
+dbusif_play_prepared_handler (DBusConnection *connection, DBusMessage *msg,
+                              NInputInterface *iface)
+{
+    DBusInterfaceData   *idata   = NULL;
+    DBusInterfaceClient *client  = NULL;
+    DBusPrepared        *p       = NULL;
+    NRequest            *request = NULL;
+    const char          *error   = NULL;
+    uint32_t             handle  = 0;
+
+    idata = n_input_interface_get_userdata (iface);
+
+    g_rec_mutex_lock (&idata->lock);
+
+    if (!(p = dbusif_lookup_prepared (idata, msg, &client, &handle, &error))) {
+        g_rec_mutex_unlock (&idata->lock);
+        dbusif_reply_error (connection, msg,
+                            client ? DBUS_ERROR_INVALID_ARGS : DBUS_ERROR_ACCESS_DENIED,
+                            error);
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+    if (client->active_requests >= dbusif_max_requests) {
+        error = "Too many simultaneous requests.";
+        goto limits;
+    }
+
+    if (!client_rate_take (client, p->event)) {
+        error = "Rate limit exceeded.";
+        goto limits;
+    }
+
+    request = n_input_interface_new_prepared_request (iface, p->prepared);
+
+    client_ref (client);
+    client_request_new (idata, client, request);
+
+    N_INFO (LOG_CAT ">> play prepared received for event '%s' with id '%u' (client %s : %u active request(s))",
+                    p->event, n_request_get_id (request),
+                    client->name, client->active_requests);
+
+    g_rec_mutex_unlock (&idata->lock);
+
+    dbusif_ack (connection, msg, n_request_get_id (request));
+
+    n_input_interface_play_request (iface, request);
+
+    return DBUS_HANDLER_RESULT_HANDLED;
+
+limits:
+    g_rec_mutex_unlock (&idata->lock);
+    dbusif_reply_error (connection, msg, DBUS_ERROR_LIMITS_EXCEEDED, error);
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+static DBusHandlerResult
+dbusif_release_handler (DBusConnection *connection, DBusMessage *msg,
+                        NInputInterface *iface)
+{
+    DBusInterfaceData   *idata  = NULL;
+    DBusInterfaceClient *client = NULL;
+    DBusPrepared        *p      = NULL;
+    DBusMessage         *reply  = NULL;
+    const char          *error  = NULL;
+    uint32_t             handle = 0;
+
+    idata = n_input_interface_get_userdata (iface);
+
+    g_rec_mutex_lock (&idata->lock);
+
+    if (!(p = dbusif_lookup_prepared (idata, msg, &client, &handle, &error))) {
+        g_rec_mutex_unlock (&idata->lock);
+        dbusif_reply_error (connection, msg,
+                            client ? DBUS_ERROR_INVALID_ARGS : DBUS_ERROR_ACCESS_DENIED,
+                            error);
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+    N_INFO (LOG_CAT ">> release received for handle '%u' (client %s)",
+                    handle, client->name);
+
+    /* requests already started from the handle keep playing. */
+
+    client->handles = g_list_remove (client->handles, GUINT_TO_POINTER (handle));
+    g_hash_table_remove (idata->prepared, GUINT_TO_POINTER (handle));
+
+    g_rec_mutex_unlock (&idata->lock);
+
+    if (!dbus_message_get_no_reply (msg)) {
+        reply = dbus_message_new_method_return (msg);
+        if (reply) {
+            dbus_connection_send (connection, reply, NULL);
+            dbus_message_unref (reply);
+        }
+    }
+
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
 static NRequest*
 dbusif_lookup_request (NInputInterface *iface, uint32_t event_id)
 {
     g_assert (iface != NULL);
 
-    NCore     *core            = NULL;
-    NRequest  *request         = NULL;
-    GList     *active_requests = NULL;
-    GList     *iter            = NULL;
+    DBusInterfaceData *idata           = NULL;
+    NCore             *core            = NULL;
+    NRequest          *request         = NULL;
+    GList             *active_requests = NULL;
+    GList             *iter            = NULL;
 
     if (event_id == 0)
         return NULL;
 
+    idata = n_input_interface_get_userdata (iface);
+
+    g_rec_mutex_lock (&idata->lock);
+    request = g_hash_table_lookup (idata->requests, GUINT_TO_POINTER (event_id));
+    g_rec_mutex_unlock (&idata->lock);
+
+    if (request)
+        return request;
+
+    /* not started over D-Bus, look from all active requests */
+
     core = n_input_interface_get_core (iface);
     active_requests = n_core_get_requests (core);
 
@@ -436,27 +1111,20 @@ dbusif_stop_by_client (DBusInterfaceData *idata, DBusInterfaceClient *by_client)
     g_assert (idata != NULL);
     g_assert (by_client);
 
-    NCore               *core               = NULL;
-    NRequest            *request            = NULL;
-    GList               *active_requests    = NULL;
-    GList               *iter               = NULL;
-    NProplist           *properties         = NULL;
-    DBusInterfaceClient *client             = NULL;
+    NRequest *request  = NULL;
+    GList    *requests = NULL;
+    GList    *iter     = NULL;
 
-    core = n_input_interface_get_core (idata->iface);
-    active_requests = n_core_get_requests (core);
-
-    for (iter = g_list_first (active_requests); iter; iter = g_list_next (iter)) {
-        request = (NRequest*) iter->data;
+    /* stopping may complete the request and remove it from the client */
+    requests = g_list_copy (by_client->requests);
 
-        properties = (NProplist*) n_request_get_properties (request);
-        if (!properties)
-            continue;
-
-        client = n_proplist_get_pointer (properties, NGF_DBUS_PROPERTY_NAME);
-        if (client == by_client)
+    for (iter = requests; iter; iter = g_list_next (iter)) {
+        request = g_hash_table_lookup (idata->requests, iter->data);
+        if (request)
             n_input_interface_stop_request (idata->iface, request, 0);
     }
+
+    g_list_free (requests);
 }
 
 static DBusHandlerResult
@@ -476,7 +1144,7 @@ dbusif_stop_handler (DBusConnection *connection, DBusMessage *msg,
         goto access;
     }
 
-    if (!client_list_find(idata, sender)) {
+    if (!client_list_has (idata, sender)) {
         error = "Unknown client.";
         goto access;
     }
@@ -512,6 +1180,68 @@ args:
     return DBUS_HANDLER_RESULT_HANDLED;
 }
 
+/* rate classes with the requests throttled in each, and the requests of
+   the caller throttled so far. runs in the dispatch thread. */
+static DBusHandlerResult
+dbusif_rate_limit_stats_handler (DBusConnection *connection, DBusMessage *msg,
+                                 NInputInterface *iface)
+{
+    DBusInterfaceData   *idata     = NULL;
+    DBusInterfaceClient *client    = NULL;
+    DBusMessage         *reply     = NULL;
+    const DBusRateClass *cls       = NULL;
+    const char          *pattern   = NULL;
+    dbus_uint32_t        rate      = 0;
+    dbus_uint32_t        burst     = 0;
+    dbus_uint64_t        throttled = 0;
+    dbus_uint32_t        own       = 0;
+    DBusMessageIter      iter;
+    DBusMessageIter      array;
+    DBusMessageIter      entry;
+    guint                i;
+
+    if (dbus_message_get_no_reply (msg))
+        return DBUS_HANDLER_RESULT_HANDLED;
+
+    idata = n_input_interface_get_userdata (iface);
+
+    if (!(reply = dbus_message_new_method_return (msg)))
+        return DBUS_HANDLER_RESULT_HANDLED;
+
+    g_rec_mutex_lock (&idata->lock);
+
+    dbus_message_iter_init_append (reply, &iter);
+    dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY, "(suut)", &array);
+
+    for (i = 0; i < rate_limit_num_classes (dbusif_rate_limit); i++) {
+        cls       = rate_limit_get_class (dbusif_rate_limit, i);
+        pattern   = cls->pattern ? cls->pattern : "";
+        rate      = cls->rate;
+        burst     = cls->burst;
+        throttled = cls->throttled;
+
+        dbus_message_iter_open_container (&array, DBUS_TYPE_STRUCT, NULL, &entry);
+        dbus_message_iter_append_basic (&entry, DBUS_TYPE_STRING, &pattern);
+        dbus_message_iter_append_basic (&entry, DBUS_TYPE_UINT32, &rate);
+        dbus_message_iter_append_basic (&entry, DBUS_TYPE_UINT32, &burst);
+        dbus_message_iter_append_basic (&entry, DBUS_TYPE_UINT64, &throttled);
+        dbus_message_iter_close_container (&array, &entry);
+    }
+
+    dbus_message_iter_close_container (&iter, &array);
+
+    if ((client = client_list_find (idata, dbus_message_get_sender (msg))))
+        own = client->throttled;
+
+    g_rec_mutex_unlock (&idata->lock);
+
+    dbus_message_iter_append_basic (&iter, DBUS_TYPE_UINT32, &own);
+
+    dbus_connection_send (connection, reply, NULL);
+    dbus_message_unref (reply);
+
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
 
 static DBusHandlerResult
 dbusif_debug_handler (DBusConnection *connection, DBusMessage *msg,
@@ -519,20 +1249,26 @@ dbusif_debug_handler (DBusConnection *connection, DBusMessage *msg,
 {
     DBusMessage         *reply          = NULL;
     DBusInterfaceData   *idata          = NULL;
-    GSList              *search         = NULL;
+    GHashTableIter       search;
     DBusInterfaceClient *client         = NULL;
+    const DBusRateClass *cls            = NULL;
     uint32_t             total_clients  = 0;
     uint32_t             total_requests = 0;
+    guint                i;
 
     idata = n_input_interface_get_userdata (iface);
 
     N_INFO (LOG_CAT "==== DUMP STATS ====");
 
-    for (search = idata->clients; search; search = g_slist_next(search)) {
-        client = (DBusInterfaceClient *) search->data;
-        N_INFO (LOG_CAT "client %s  ref %d, active_requests %u/%u",
+    g_rec_mutex_lock (&idata->lock);
+
+    g_hash_table_iter_init (&search, idata->clients);
+    while (g_hash_table_iter_next (&search, NULL, (gpointer*) &client)) {
+        N_INFO (LOG_CAT "client %s  ref %d, active_requests %u/%u, prepared %u/%u, throttled %u",
                         client->name, client->ref,
-                        client->active_requests, dbusif_max_requests);
+                        client->active_requests, dbusif_max_requests,
+                        g_list_length (client->handles), dbusif_max_prepared,
+                        client->throttled);
         total_requests += client->active_requests;
         total_clients++;
     }
@@ -540,6 +1276,16 @@ dbusif_debug_handler (DBusConnection *connection, DBusMessage *msg,
     N_INFO (LOG_CAT "total clients %u/%u, per-client max requests %u , active requests %u",
                     total_clients, dbusif_max_clients,
                     dbusif_max_requests, total_requests);
+
+    for (i = 0; i < rate_limit_num_classes (dbusif_rate_limit); i++) {
+        cls = rate_limit_get_class (dbusif_rate_limit, i);
+        N_INFO (LOG_CAT "rate class '%s' %u/s burst %u, throttled %" G_GUINT64_FORMAT,
+                        cls->pattern ? cls->pattern : "default",
+                        cls->rate, cls->burst, cls->throttled);
+    }
+
+    g_rec_mutex_unlock (&idata->lock);
+
     N_INFO (LOG_CAT "====================");
 
     if (!dbus_message_get_no_reply (msg)) {
@@ -553,6 +1299,73 @@ dbusif_debug_handler (DBusConnection *connection, DBusMessage *msg,
     return DBUS_HANDLER_RESULT_HANDLED;
 }
 
+/* only root and the user the daemon runs as may reload plugins. */
+static gboolean
+dbusif_sender_may_reload (DBusConnection *connection, DBusMessage *msg)
+{
+    DBusError      error;
+    const char    *sender = NULL;
+    unsigned long  uid    = 0;
+
+    dbus_error_init (&error);
+    sender = dbus_message_get_sender (msg);
+
+    if (!sender)
+        return FALSE;
+
+    uid = dbus_bus_get_unix_user (connection, sender, &error);
+    if (dbus_error_is_set (&error)) {
+        N_WARNING (LOG_CAT "cannot get user of %s: %s", sender, error.message);
+        dbus_error_free (&error);
+        return FALSE;
+    }
+
+    return uid == 0 || uid == (unsigned long) getuid ();
+}
+
+static DBusHandlerResult
+dbusif_reload_plugin_handler (DBusConnection *connection, DBusMessage *msg,
+                              NInputInterface *iface)
+{
+    DBusMessage *reply  = NULL;
+    const char  *plugin = NULL;
+
+    if (!dbus_message_get_args (msg, NULL,
+                                DBUS_TYPE_STRING, &plugin,
+                                DBUS_TYPE_INVALID)) {
+        dbusif_reply_error (connection, msg, DBUS_ERROR_INVALID_ARGS,
+                            "plugin name expected");
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+    if (!dbusif_sender_may_reload (connection, msg)) {
+        N_WARNING (LOG_CAT "plugin '%s' reload by %s denied", plugin,
+                           dbus_message_get_sender (msg));
+        dbusif_reply_error (connection, msg, DBUS_ERROR_ACCESS_DENIED,
+                            "not allowed to reload plugins");
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+    N_INFO (LOG_CAT "plugin '%s' reload requested by %s", plugin,
+                    dbus_message_get_sender (msg));
+
+    if (!n_core_reload_plugin (n_input_interface_get_core (iface), plugin)) {
+        dbusif_reply_error (connection, msg, DBUS_ERROR_FAILED,
+                            "plugin cannot be reloaded");
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+    if (!dbus_message_get_no_reply (msg)) {
+        reply = dbus_message_new_method_return (msg);
+        if (reply) {
+            dbus_connection_send (connection, reply, NULL);
+            dbus_message_unref (reply);
+        }
+    }
+
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
 static DBusHandlerResult
 dbusif_pause_handler (DBusConnection *connection, DBusMessage *msg,
                       NInputInterface *iface)
@@ -571,7 +1384,7 @@ dbusif_pause_handler (DBusConnection *connection, DBusMessage *msg,
         goto access;
     }
 
-    if (!client_list_find(idata, sender)) {
+    if (!client_list_has (idata, sender)) {
         error = "Unknown client.";
         goto access;
     }
@@ -624,12 +1437,17 @@ dbusif_disconnect_handler (NInputInterface *iface, const gchar *client_name)
 
     idata = n_input_interface_get_userdata (iface);
 
+    g_rec_mutex_lock (&idata->lock);
+
     if ((client = client_list_find (idata, client_name))) {
         N_INFO (LOG_CAT ">> client disconnect (%s)", client->name);
         dbusif_stop_by_client (idata, client);
+        client_release_prepared (idata, client);
         client_list_remove (idata, client);
         client_unref (client);
     }
+
+    g_rec_mutex_unlock (&idata->lock);
 }
 
 static DBusHandlerResult
@@ -650,12 +1468,61 @@ dbusif_introspect_handler (DBusConnection *connection, DBusMessage *msg)
     return DBUS_HANDLER_RESULT_HANDLED;
 }
 
+/* runs in the dispatch thread */
 static DBusHandlerResult
 dbusif_message_function (DBusConnection *connection, DBusMessage *msg,
                          void *userdata)
 {
     NInputInterface *iface  = (NInputInterface*) userdata;
     const char      *member = dbus_message_get_member (msg);
+
+    if (dbus_message_is_signal (msg, "org.freedesktop.DBus", "NameOwnerChanged")) {
+        (void) dbusif_queue_message (iface, msg);
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    }
+
+    if (member == NULL)
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+    if (dbus_message_has_interface (msg, "org.freedesktop.DBus.Introspectable"))
+        return dbusif_introspect_handler (connection, msg);
+
+    if (!dbus_message_has_interface (msg, NGF_DBUS_IFACE))
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+    if (g_str_equal (member, NGF_DBUS_METHOD_PLAY))
+        return dbusif_play_handler (connection, msg, iface, FALSE);
+
+    else if (g_str_equal (member, NGF_DBUS_METHOD_PLAY_NO_REPLY))
+        return dbusif_play_handler (connection, msg, iface, TRUE);
+
+    else if (g_str_equal (member, NGF_DBUS_METHOD_PLAY_GROUP))
+        return dbusif_play_group_handler (connection, msg, iface);
+
+    else if (g_str_equal (member, NGF_DBUS_METHOD_RATE_LIMIT_STATS))
+        return dbusif_rate_limit_stats_handler (connection, msg, iface);
+
+    /* the rest needs the core, handled by dbusif_handle_message */
+
+    else if (g_str_equal (member, NGF_DBUS_METHOD_PREPARE) ||
+             g_str_equal (member, NGF_DBUS_METHOD_PLAY_PREPARED) ||
+             g_str_equal (member, NGF_DBUS_METHOD_RELEASE) ||
+             g_str_equal (member, NGF_DBUS_METHOD_STOP) ||
+             g_str_equal (member, NGF_DBUS_METHOD_PAUSE) ||
+             g_str_equal (member, NGF_DBUS_METHOD_DEBUG) ||
+             g_str_equal (member, NGF_DBUS_METHOD_RELOAD_PLUGIN))
+        return dbusif_queue_message (iface, msg);
+
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+/* runs in the main loop for messages queued by the dispatch thread */
+static void
+dbusif_handle_message (NInputInterface *iface, DBusMessage *msg)
+{
+    DBusInterfaceData *idata      = n_input_interface_get_userdata (iface);
+    DBusConnection    *connection = idata->connection;
+    const char        *member     = dbus_message_get_member (msg);
     DBusError error = DBUS_ERROR_INIT;
     gchar *component = NULL;
     gchar *s1 = NULL;
@@ -683,31 +1550,104 @@ dbusif_message_function (DBusConnection *connection, DBusMessage *msg,
                 dbusif_disconnect_handler (iface, component);
         }
 
-        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+        return;
     }
 
-    if (member == NULL)
-        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    if (g_str_equal (member, NGF_DBUS_METHOD_PREPARE))
+        (void) dbusif_prepare_handler (connection, msg, iface);
 
-    if (dbus_message_has_interface (msg, "org.freedesktop.DBus.Introspectable"))
-        return dbusif_introspect_handler (connection, msg);
+    else if (g_str_equal (member, NGF_DBUS_METHOD_PLAY_PREPARED))
+        (void) dbusif_play_prepared_handler (connection, msg, iface);
 
-    if (!dbus_message_has_interface (msg, NGF_DBUS_IFACE))
-        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
-
-    if (g_str_equal (member, NGF_DBUS_METHOD_PLAY))
-        return dbusif_play_handler (connection, msg, iface);
+    else if (g_str_equal (member, NGF_DBUS_METHOD_RELEASE))
+        (void) dbusif_release_handler (connection, msg, iface);
 
     else if (g_str_equal (member, NGF_DBUS_METHOD_STOP))
-        return dbusif_stop_handler (connection, msg, iface);
+        (void) dbusif_stop_handler (connection, msg, iface);
 
     else if (g_str_equal (member, NGF_DBUS_METHOD_PAUSE))
-        return dbusif_pause_handler (connection, msg, iface);
+        (void) dbusif_pause_handler (connection, msg, iface);
 
     else if (g_str_equal (member, NGF_DBUS_METHOD_DEBUG))
-        return dbusif_debug_handler (connection, msg, iface);
+        (void) dbusif_debug_handler (connection, msg, iface);
 
-    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    else if (g_str_equal (member, NGF_DBUS_METHOD_RELOAD_PLUGIN))
+        (void) dbusif_reload_plugin_handler (connection, msg, iface);
+}
+
+static gpointer
+dbusif_dispatch_thread (gpointer userdata)
+{
+    DBusInterfaceData *idata = (DBusInterfaceData*) userdata;
+
+    g_main_context_push_thread_default (idata->context);
+    g_main_loop_run (idata->loop);
+    g_main_context_pop_thread_default (idata->context);
+
+    return NULL;
+}
+
+static gboolean
+dbusif_dispatch_quit_cb (gpointer userdata)
+{
+    g_main_loop_quit ((GMainLoop*) userdata);
+    return FALSE;
+}
+
+static void
+dbusif_dispatch_stop (DBusInterfaceData *idata)
+{
+    GSource *source = NULL;
+
+    if (!idata->thread)
+        return;
+
+    /* quit from within the loop, it may not be running yet */
+    source = g_idle_source_new ();
+    g_source_set_callback (source, dbusif_dispatch_quit_cb, idata->loop, NULL);
+    g_source_attach (source, idata->context);
+    g_source_unref (source);
+
+    g_thread_join (idata->thread);
+    idata->thread = NULL;
+}
+
+static void
+dbusif_data_free (DBusInterfaceData *idata)
+{
+    GHashTableIter       iter;
+    DBusInterfaceClient *client = NULL;
+    DBusQueued          *item   = NULL;
+
+    if (idata->queue_source) {
+        g_source_destroy (idata->queue_source);
+        g_source_unref (idata->queue_source);
+    }
+
+    /* queued requests and prepared requests refer to the clients */
+    while ((item = g_async_queue_try_pop (idata->queue)))
+        queued_free (idata, item);
+    g_async_queue_unref (idata->queue);
+
+    g_hash_table_destroy (idata->prepared);
+
+    g_hash_table_iter_init (&iter, idata->clients);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer*) &client))
+        client_unref (client);
+
+    g_hash_table_destroy (idata->clients);
+    g_hash_table_destroy (idata->requests);
+
+    /* private connection, closed before the context goes away */
+    if (idata->connection) {
+        dbus_connection_close (idata->connection);
+        dbus_connection_unref (idata->connection);
+    }
+
+    g_main_loop_unref (idata->loop);
+    g_main_context_unref (idata->context);
+    g_rec_mutex_clear (&idata->lock);
+    g_free (idata);
 }
 
 static int
@@ -723,16 +1663,32 @@ dbusif_initialize (NInputInterface *iface)
 
     idata = g_new0 (DBusInterfaceData, 1);
     idata->iface = iface;
+    idata->clients = g_hash_table_new (g_str_hash, g_str_equal);
+    idata->requests = g_hash_table_new (g_direct_hash, g_direct_equal);
+    idata->prepared = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                             NULL, (GDestroyNotify) prepared_free);
+    g_rec_mutex_init (&idata->lock);
+    idata->context = g_main_context_new ();
+    idata->loop = g_main_loop_new (idata->context, FALSE);
+    idata->queue = g_async_queue_new ();
     n_input_interface_set_userdata (iface, idata);
 
+    /* the queue is drained with the same priority D-Bus was dispatched */
+    idata->queue_source = g_source_new (&queue_source_funcs, sizeof (GSource));
+    g_source_set_priority (idata->queue_source, G_PRIORITY_DEFAULT);
+    g_source_set_callback (idata->queue_source, dbusif_queue_drain_cb, idata, NULL);
+    g_source_attach (idata->queue_source, NULL);
+
+    /* own connection, the shared one is dispatched in the main loop */
+    dbus_threads_init_default ();
     dbus_error_init (&error);
-    idata->connection = dbus_bus_get (DBUS_BUS_SYSTEM, &error);
+    idata->connection = dbus_bus_get_private (DBUS_BUS_SYSTEM, &error);
     if (!idata->connection) {
         N_ERROR (LOG_CAT "failed to get system bus: %s", error.message);
         goto error;
     }
 
-    dbus_gmain_set_up_connection (idata->connection, NULL);
+    dbus_gmain_set_up_connection (idata->connection, idata->context);
 
     ret = dbus_bus_request_name (idata->connection, NGF_DBUS_NAME,
         DBUS_NAME_FLAG_REPLACE_EXISTING, &error);
@@ -751,10 +1707,13 @@ dbusif_initialize (NInputInterface *iface)
     dbus_bus_add_match (idata->connection, DBUS_CLIENT_MATCH, NULL);
     dbus_connection_add_filter (idata->connection, dbusif_message_function, iface, NULL);
 
+    idata->thread = g_thread_new ("ngfd-dbus", dbusif_dispatch_thread, idata);
+
     return TRUE;
 
 error:
-    g_free (idata);
+    n_input_interface_set_userdata (iface, NULL);
+    dbusif_data_free (idata);
     if (dbus_error_is_set (&error))
         dbus_error_free (&error);
     return FALSE;
@@ -766,11 +1725,11 @@ dbusif_shutdown (NInputInterface *iface)
     DBusInterfaceData *idata;
 
     idata = n_input_interface_get_userdata (iface);
+    if (!idata)
+        return;
 
-    if (idata && idata->connection)
-        dbus_connection_unref (idata->connection);
-
-    g_free (idata);
+    dbusif_dispatch_stop (idata);
+    dbusif_data_free (idata);
 }
 
 static void
@@ -802,8 +1761,17 @@ dbusif_send_reply (NInputInterface *iface, NRequest *request, int code)
     if (event_id == 0)
         return;
 
-    N_DEBUG (LOG_CAT "sending reply for request '%s' (event.id=%d) with code %d",
-        n_request_get_name (request), event_id, code);
+    client = n_proplist_get_pointer (props, NGF_DBUS_PROPERTY_NAME);
+
+    if (n_proplist_get_bool (props, NGF_DBUS_PROPERTY_NO_REPLY))
+        goto end;
+
+    if ((code == N_DBUS_EVENT_PLAYING || code == N_DBUS_EVENT_PAUSED) &&
+        n_proplist_get_bool (props, NGF_DBUS_PROPERTY_FINAL_STATUS))
+        goto end;
+
+    N_DEBUG (LOG_CAT "sending reply for request '%s' (event.id=%d) to %s with code %d",
+        n_request_get_name (request), event_id, client->name, code);
 
     if ((msg = dbus_message_new_signal (NGF_DBUS_PATH,
                                         NGF_DBUS_IFACE,
@@ -812,6 +1780,10 @@ dbusif_send_reply (NInputInterface *iface, NRequest *request, int code)
         goto end;
     }
 
+    /* Status concerns only the client who started the request, so deliver
+     * it as unicast signal instead of waking up every listener on the bus. */
+    dbus_message_set_destination (msg, client->name);
+
     dbus_message_append_args (msg,
         DBUS_TYPE_UINT32, &event_id,
         DBUS_TYPE_UINT32, &status,
@@ -822,10 +1794,41 @@ dbusif_send_reply (NInputInterface *iface, NRequest *request, int code)
 
 end:
     if (code == N_DBUS_EVENT_FAILED || code == N_DBUS_EVENT_COMPLETED) {
-        client = n_proplist_get_pointer (props, NGF_DBUS_PROPERTY_NAME);
-        client_request_done (client);
+        g_rec_mutex_lock (&idata->lock);
+        client_request_done (idata, client, request);
         client_unref (client);
+        g_rec_mutex_unlock (&idata->lock);
+    }
+}
+
+static void
+rate_class_parse_cb (const char *key, const NValue *value, gpointer userdata)
+{
+    const DBusRateClass *cls       = NULL;
+    const char          *pattern   = NULL;
+    const char          *value_str = NULL;
+
+    (void) userdata;
+
+    if (g_str_equal (key, DBUSIF_RATE_LIMIT))
+        pattern = NULL;
+    else if (g_str_has_prefix (key, DBUSIF_RATE_LIMIT_PREFIX) &&
+             strlen (key) > strlen (DBUSIF_RATE_LIMIT_PREFIX))
+        pattern = key + strlen (DBUSIF_RATE_LIMIT_PREFIX);
+    else
+        return;
+
+    value_str = n_value_get_string (value);
+
+    if (!rate_limit_add_class (dbusif_rate_limit, pattern, value_str)) {
+        N_WARNING (LOG_CAT "invalid %s value '%s'", key, value_str ? value_str : "");
+        return;
     }
+
+    cls = rate_limit_get_class (dbusif_rate_limit,
+                                rate_limit_num_classes (dbusif_rate_limit) - 1);
+    N_DEBUG (LOG_CAT "rate class '%s' %u/s burst %u",
+                     pattern ? pattern : "default", cls->rate, cls->burst);
 }
 
 int
@@ -844,6 +1847,7 @@ n_plugin__load (NPlugin *plugin)
 
     dbusif_max_requests = DEFAULT_REQUEST_LIMIT;
     dbusif_max_clients = DEFAULT_CLIENT_LIMIT;
+    dbusif_max_prepared = DEFAULT_PREPARED_LIMIT;
 
     props = n_plugin_get_params (plugin);
 
@@ -857,6 +1861,14 @@ n_plugin__load (NPlugin *plugin)
         dbusif_max_clients = atoi (value);
     }
 
+    if (n_proplist_has_key (props, DBUSIF_PREPARED_LIMIT) &&
+        (value = n_proplist_get_string (props, DBUSIF_PREPARED_LIMIT))) {
+        dbusif_max_prepared = atoi (value);
+    }
+
+    dbusif_rate_limit = rate_limit_new ();
+    n_proplist_foreach (props, rate_class_parse_cb, NULL);
+
     /* register the DBus interface as the NInputInterface */
     n_plugin_register_input (plugin, &iface);
 
@@ -867,4 +1879,7 @@ void
 n_plugin__unload (NPlugin *plugin)
 {
     (void) plugin;
+
+    rate_limit_free (dbusif_rate_limit);
+    dbusif_rate_limit = NULL;
 }
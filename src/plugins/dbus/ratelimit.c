@@ -0,0 +1,171 @@
+/*
+ * ngfd - Non-graphic feedback daemon
+ *
+ * Token bucket rate limit of requests started by D-Bus clients.
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ratelimit.h"
+
+struct _DBusRateLimit
+{
+    GPtrArray *classes;         /* DBusRateClass* */
+};
+
+static void
+rate_class_free (gpointer data)
+{
+    DBusRateClass *cls = data;
+
+    g_free (cls->pattern);
+    g_free (cls);
+}
+
+DBusRateLimit*
+rate_limit_new (void)
+{
+    DBusRateLimit *limit;
+
+    limit = g_new0 (DBusRateLimit, 1);
+    limit->classes = g_ptr_array_new_with_free_func (rate_class_free);
+
+    return limit;
+}
+
+void
+rate_limit_free (DBusRateLimit *limit)
+{
+    if (!limit)
+        return;
+
+    g_ptr_array_free (limit->classes, TRUE);
+    g_free (limit);
+}
+
+gboolean
+rate_limit_add_class (DBusRateLimit *limit, const char *pattern,
+                      const char *spec)
+{
+    DBusRateClass *cls   = NULL;
+    unsigned int   rate  = 0;
+    unsigned int   burst = 0;
+    int            count;
+
+    g_assert (limit != NULL);
+
+    if (!spec || (count = sscanf (spec, "%u/%u", &rate, &burst)) < 1)
+        return FALSE;
+
+    if (count < 2 || burst == 0)
+        burst = rate;
+
+    cls = g_new0 (DBusRateClass, 1);
+    cls->pattern     = g_strdup (pattern);
+    cls->pattern_len = pattern ? strlen (pattern) : 0;
+    cls->rate        = rate;
+    cls->burst       = burst;
+    g_ptr_array_add (limit->classes, cls);
+
+    return TRUE;
+}
+
+guint
+rate_limit_num_classes (const DBusRateLimit *limit)
+{
+    return limit ? limit->classes->len : 0;
+}
+
+const DBusRateClass*
+rate_limit_get_class (const DBusRateLimit *limit, guint index)
+{
+    g_assert (limit != NULL);
+    g_assert (index < limit->classes->len);
+
+    return g_ptr_array_index (limit->classes, index);
+}
+
+/* most specific class matching the event, the default class otherwise */
+int
+rate_limit_class_for_event (const DBusRateLimit *limit, const char *event)
+{
+    DBusRateClass *cls       = NULL;
+    int            found     = -1;
+    int            fallback  = -1;
+    size_t         found_len = 0;
+    guint          i;
+
+    if (!limit)
+        return -1;
+
+    for (i = 0; i < limit->classes->len; i++) {
+        cls = g_ptr_array_index (limit->classes, i);
+
+        if (!cls->pattern)
+            fallback = i;
+        else if (cls->pattern_len >= found_len &&
+                 g_pattern_match_simple (cls->pattern, event)) {
+            found = i;
+            found_len = cls->pattern_len;
+        }
+    }
+
+    return found >= 0 ? found : fallback;
+}
+
+gboolean
+rate_limit_take (DBusRateLimit *limit, DBusRateBucket *buckets,
+                 const char *event, gint64 now)
+{
+    DBusRateClass  *cls    = NULL;
+    DBusRateBucket *bucket = NULL;
+    gint64          full   = 0;
+    gint64          elapsed;
+    int             index;
+
+    if ((index = rate_limit_class_for_event (limit, event)) < 0)
+        return TRUE;
+
+    cls = g_ptr_array_index (limit->classes, index);
+    if (cls->rate == 0)
+        return TRUE;
+
+    bucket = &buckets[index];
+    full = (gint64) cls->burst * G_USEC_PER_SEC;
+
+    if (bucket->updated == 0) {
+        bucket->tokens = full;
+    } else {
+        /* refill, time needed to fill the bucket caps the multiplication */
+        elapsed = now - bucket->updated;
+        if (elapsed >= full / cls->rate)
+            bucket->tokens = full;
+        else
+            bucket->tokens = MIN (full, bucket->tokens + elapsed * cls->rate);
+    }
+    bucket->updated = now;
+
+    if (bucket->tokens < G_USEC_PER_SEC) {
+        cls->throttled++;
+        return FALSE;
+    }
+
+    bucket->tokens -= G_USEC_PER_SEC;
+
+    return TRUE;
+}
@@ -0,0 +1,79 @@
+/*
+ * ngfd - Non-graphic feedback daemon
+ *
+ * Token bucket rate limit of requests started by D-Bus clients.
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef NGF_DBUS_RATE_LIMIT_H
+#define NGF_DBUS_RATE_LIMIT_H
+
+#include <stdint.h>
+#include <glib.h>
+
+/*
+ * Requests are limited per class of events. A class has a glob pattern
+ * matched against the event name, the class without a pattern applies
+ * to events not matching any other class. Of the matching classes the
+ * one with the longest pattern is used.
+ *
+ * Every client has a bucket for each class. A bucket holds up to BURST
+ * tokens and is refilled with RATE tokens per second, starting a request
+ * takes one token.
+ */
+
+typedef struct _DBusRateClass
+{
+    char       *pattern;        /* event name glob, NULL for the default class */
+    size_t      pattern_len;
+    uint32_t    rate;           /* tokens per second, 0 disables the limit */
+    uint32_t    burst;          /* bucket size */
+    uint64_t    throttled;      /* rejected requests of all clients */
+} DBusRateClass;
+
+typedef struct _DBusRateBucket
+{
+    gint64      tokens;         /* in millionths of a token */
+    gint64      updated;        /* monotonic time of the latest refill */
+} DBusRateBucket;
+
+typedef struct _DBusRateLimit DBusRateLimit;
+
+DBusRateLimit*       rate_limit_new            (void);
+void                 rate_limit_free           (DBusRateLimit *limit);
+
+/* spec is RATE[/BURST], BURST defaults to RATE. FALSE if spec is invalid. */
+gboolean             rate_limit_add_class      (DBusRateLimit *limit,
+                                                const char *pattern,
+                                                const char *spec);
+
+guint                rate_limit_num_classes    (const DBusRateLimit *limit);
+const DBusRateClass* rate_limit_get_class      (const DBusRateLimit *limit,
+                                                guint index);
+
+/* index of the class of the event, -1 if the event is not limited. */
+int                  rate_limit_class_for_event (const DBusRateLimit *limit,
+                                                 const char *event);
+
+/* Take a token for the event from buckets, which has a bucket for each
+ * class. now is monotonic time in microseconds. Returns FALSE and counts
+ * the request as throttled if the bucket is empty. */
+gboolean             rate_limit_take           (DBusRateLimit *limit,
+                                                DBusRateBucket *buckets,
+                                                const char *event,
+                                                gint64 now);
+
+#endif /* NGF_DBUS_RATE_LIMIT_H */
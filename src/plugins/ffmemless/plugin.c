@@ -26,6 +26,7 @@
 #include <stdint.h>
 #include <ngf/plugin.h>
 #include <ngf/haptic.h>
+#include <ngf/worker.h>
 #include <linux/input.h>
 
 #include "ffmemless.h"
@@ -62,6 +63,7 @@ struct ffm_effect_data {
 	int repeat;
 	guint playback_time;
 	int poll_id;
+	guint work_id;		/* pending device operation */
 #ifdef CACHE_EFFECTS
 	struct ff_effect cached_effect;
 #endif
@@ -535,7 +537,7 @@ static int ffm_setup_effects(const NProplist *props, GHashTable *effects)
 
 	return 0;
 ffm_eff_error1:
-	g_hash_table_destroy(ffm.effects);
+	/* effect list is released by the caller */
 	return -1;
 }
 
@@ -550,22 +552,9 @@ gboolean ffm_playback_done(gpointer userdata)
 	return FALSE;
 }
 
+/* Device access, run in a worker thread */
 static int ffm_play(struct ffm_effect_data *data, int play)
 {
-	data->poll_id = 0;
-
-	/* if there is playback time set, this is single shot effect */
-	if (play) {
-		if (data->playback_time) {
-			N_DEBUG (LOG_CAT "setting up completion timer");
-			data->poll_id = g_timeout_add(data->playback_time + 20,
-						ffm_playback_done, data);
-		}
-		N_DEBUG (LOG_CAT "Starting playback");
-	} else {
-		N_DEBUG (LOG_CAT "Stopping playback");
-	}
-
 #ifdef CACHE_EFFECTS
 	int result = TRUE;
 
@@ -597,9 +586,72 @@ static int ffm_play(struct ffm_effect_data *data, int play)
 #endif
 }
 
-static int ffm_sink_initialize(NSinkInterface *iface)
+struct ffm_play_op {
+	struct ffm_effect_data *data;
+	int play;
+};
+
+static gboolean ffm_play_work(gpointer userdata)
 {
-	(void) iface;
+	struct ffm_play_op *op = userdata;
+
+	return ffm_play(op->data, op->play);
+}
+
+static void ffm_play_done(gboolean result, gpointer userdata)
+{
+	struct ffm_effect_data *data = ((struct ffm_play_op *) userdata)->data;
+
+	data->work_id = 0;
+
+	if (!result) {
+		N_WARNING (LOG_CAT "effect id %d playback failed", data->id);
+		n_sink_interface_fail(data->iface, data->request);
+		return;
+	}
+
+	/* if there is playback time set, this is single shot effect */
+	if (data->playback_time) {
+		N_DEBUG (LOG_CAT "setting up completion timer");
+		data->poll_id = g_timeout_add(data->playback_time + 20,
+					ffm_playback_done, data);
+	}
+}
+
+/*
+ * Effect upload and playback go through the worker threads so that a slow
+ * device does not block the main loop. All device operations use the same
+ * queue to keep them in order.
+ */
+static void ffm_play_async(struct ffm_effect_data *data, int play)
+{
+	NCore *core = n_sink_interface_get_core(data->iface);
+	struct ffm_play_op *op = NULL;
+
+	if (data->poll_id) {
+		g_source_remove (data->poll_id);
+		data->poll_id = 0;
+	}
+
+	N_DEBUG (LOG_CAT "%s playback", play ? "Starting" : "Stopping");
+
+	n_core_cancel_work(core, data->work_id);
+
+	op = g_new0(struct ffm_play_op, 1);
+	op->data = data;
+	op->play = play;
+	data->work_id = n_core_push_work(core, &ffm, ffm_play_work,
+					play ? ffm_play_done : NULL, op, g_free);
+}
+
+static gboolean ffm_stop_work(gpointer userdata)
+{
+	return ffm_play((struct ffm_effect_data *) userdata, 0);
+}
+
+static gboolean ffm_init_work(gpointer userdata)
+{
+	(void) userdata;
 
 	if (ffm_setup_device(ffm.ngfd_props, &ffm.dev_file)) {
 		N_ERROR (LOG_CAT "Could not find a device file");
@@ -630,14 +682,37 @@ static int ffm_sink_initialize(NSinkInterface *iface)
 
 ffm_init_error2:
 	g_hash_table_destroy(ffm.effects);
+	ffm.effects = NULL;
 	ffm_close_device(ffm.dev_file);
 ffm_init_error1:
 	return FALSE;
 }
+
+static void ffm_init_done(gboolean result, gpointer userdata)
+{
+	n_sink_interface_initialized((NSinkInterface *) userdata, result);
+}
+
+static int ffm_sink_initialize(NSinkInterface *iface)
+{
+	/* Opening the device and uploading the effects may block, so it is
+	 * done in the same work queue as playback. */
+	n_core_push_work(n_sink_interface_get_core(iface), &ffm, ffm_init_work,
+			 ffm_init_done, iface, NULL);
+
+	return N_SINK_INTERFACE_INIT_PENDING;
+}
+
 static void ffm_sink_shutdown(NSinkInterface *iface)
 {
 	(void) iface;
+
+	/* initialization failed or never completed */
+	if (!ffm.effects)
+		return;
+
 	g_hash_table_destroy(ffm.effects);
+	ffm.effects = NULL;
 	ffm_close_device(ffm.dev_file);
 }
 
@@ -682,6 +757,11 @@ static int ffm_sink_prepare(NSinkInterface *iface, NRequest *request)
 		copy->playback_time = playback_time;
 	}
 
+	copy->request = request;
+	copy->iface = iface;
+	copy->poll_id = 0;
+	copy->work_id = 0;
+
 	N_DEBUG (LOG_CAT "prep effect %s, repeat %d times, duration of %d ms",
 			key, copy->repeat, copy->playback_time);
 
@@ -703,7 +783,8 @@ static int ffm_sink_play(NSinkInterface *iface, NRequest *request)
 			 "req 0x%x data 0x%x", data->id, data->repeat,
 			data->iface, data->request, data);
 
-	return ffm_play(data, data->repeat);
+	ffm_play_async(data, data->repeat);
+	return TRUE;
 }
 static int ffm_sink_pause(NSinkInterface *iface, NRequest *request)
 {
@@ -714,18 +795,13 @@ static int ffm_sink_pause(NSinkInterface *iface, NRequest *request)
 
 	data = (struct ffm_effect_data *)n_request_get_data (request, FFM_KEY);
 
-	if (data->poll_id) {
-		g_source_remove (data->poll_id);
-		data->poll_id = 0;
-	}
-
 	/* no pause possible for vibra effects, just stop */
-	return ffm_play(data, 0);
+	ffm_play_async(data, 0);
+	return TRUE;
 }
 static void ffm_sink_stop(NSinkInterface *iface, NRequest *request)
 {
 	struct ffm_effect_data *data;
-	(void) iface;
 	N_DEBUG (LOG_CAT "stop");
 
 	data = (struct ffm_effect_data *)n_request_get_data (request, FFM_KEY);
@@ -735,8 +811,11 @@ static void ffm_sink_stop(NSinkInterface *iface, NRequest *request)
 		data->poll_id = 0;
 	}
 
-	ffm_play(data, 0);
-	g_free(data);
+	/* pending playback must not complete anymore, data is released
+	 * once the queued stop has been done. */
+	n_core_cancel_work(n_sink_interface_get_core(iface), data->work_id);
+	n_core_push_work(n_sink_interface_get_core(iface), &ffm, ffm_stop_work,
+			 NULL, data, g_free);
 }
 
 N_PLUGIN_LOAD(plugin)
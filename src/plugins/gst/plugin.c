@@ -46,6 +46,7 @@
 #define SOUND_FADE_PAUSE      "sound.fade-pause"
 #define SOUND_FADE_RESUME     "sound.fade-resume"
 #define SOUND_FADE_STOP       "sound.fade-stop"
+#define SOUND_OUTPUT_LATENCY  "sound.output-latency"
 #define SYSTEM_SOUND_PATH     "/usr/share/sounds/"
 #define NO_SOUND_DELAY_MS     (20)
 
@@ -90,6 +91,7 @@ struct _StreamData
 
     guint delay_startup;
     guint delay_stop;
+    guint output_latency;
     guint fade_pause;
     guint fade_resume;
     guint fade_stop;
@@ -508,6 +510,18 @@ start_stream_fade (StreamData *stream,
                      position, length, volume_start, volume_end);
 }
 
+/* the file of the request is missing, unreadable or cannot be decoded */
+static gboolean
+error_caused_by_request (const GError *error)
+{
+    if (error->domain == GST_RESOURCE_ERROR)
+        return error->code == GST_RESOURCE_ERROR_NOT_FOUND ||
+               error->code == GST_RESOURCE_ERROR_OPEN_READ ||
+               error->code == GST_RESOURCE_ERROR_READ;
+
+    return error->domain == GST_STREAM_ERROR;
+}
+
 static gboolean
 bus_cb (GstBus *bus, GstMessage *msg, gpointer userdata)
 {
@@ -517,12 +531,18 @@ bus_cb (GstBus *bus, GstMessage *msg, gpointer userdata)
 
     switch (GST_MESSAGE_TYPE (msg)) {
         case GST_MESSAGE_ERROR: {
-            GError *error = NULL;
+            GError   *error       = NULL;
+            gboolean  request_err = FALSE;
             gst_message_parse_error (msg, &error, NULL);
             N_WARNING (LOG_CAT "error: %s", error->message);
+            request_err = error_caused_by_request (error);
             g_error_free (error);
-            n_sink_interface_fail (stream->iface, stream->request);
             stream->bus_watch_id = 0;
+            /* a bad file of one client must not disable the sink for all */
+            if (request_err)
+                n_sink_interface_fail_request (stream->iface, stream->request);
+            else
+                n_sink_interface_fail (stream->iface, stream->request);
             return G_SOURCE_REMOVE;
         }
 
@@ -1037,6 +1057,7 @@ gst_sink_prepare (NSinkInterface *iface, NRequest *request)
     stream->fade_pause = n_proplist_get_int (props, SOUND_FADE_PAUSE);
     stream->fade_resume = n_proplist_get_int (props, SOUND_FADE_RESUME);
     stream->fade_stop = n_proplist_get_int (props, SOUND_FADE_STOP);
+    stream->output_latency = n_proplist_get_int (props, SOUND_OUTPUT_LATENCY);
 
     fade_only_custom = n_proplist_get_bool (props, FADE_ONLY_CUSTOM_KEY);
     custom_sound = is_custom_sound_filename (stream->filename);
@@ -1126,6 +1147,62 @@ gst_sink_play (NSinkInterface *iface, NRequest *request)
     return TRUE;
 }
 
+static guint
+gst_sink_latency (NSinkInterface *iface, NRequest *request)
+{
+    StreamData   *stream      = NULL;
+    GstQuery     *query       = NULL;
+    gboolean      live        = FALSE;
+    GstClockTime  min_latency = 0;
+    guint         latency     = 0;
+
+    (void) iface;
+
+    stream = (StreamData*) n_request_get_data (request, GST_KEY);
+    g_assert (stream != NULL);
+
+    if (!stream->sound_enabled || !stream->pipeline)
+        return 0;
+
+    /* pipeline latency reported by the elements, plus the configured output
+     * latency of the audio path after pulsesink (server and hardware). */
+
+    query = gst_query_new_latency ();
+    if (gst_element_query (stream->pipeline, query)) {
+        gst_query_parse_latency (query, &live, &min_latency, NULL);
+        if (GST_CLOCK_TIME_IS_VALID (min_latency))
+            latency = GST_TIME_AS_MSECONDS (min_latency);
+    }
+    gst_query_unref (query);
+
+    latency += stream->output_latency;
+
+    N_DEBUG (LOG_CAT "output latency %u ms", latency);
+
+    return latency;
+}
+
+/* audio output is usable again when a pulsesink can connect to the server */
+static int
+gst_sink_probe (NSinkInterface *iface)
+{
+    (void) iface;
+
+    GstElement           *sink   = NULL;
+    GstStateChangeReturn  result = GST_STATE_CHANGE_FAILURE;
+
+    if (!(sink = gst_element_factory_make ("pulsesink", NULL)))
+        return FALSE;
+
+    result = gst_element_set_state (sink, GST_STATE_READY);
+    gst_element_set_state (sink, GST_STATE_NULL);
+    gst_object_unref (sink);
+
+    N_DEBUG (LOG_CAT "probe %s", result == GST_STATE_CHANGE_FAILURE ? "failed" : "succeeded");
+
+    return result != GST_STATE_CHANGE_FAILURE;
+}
+
 static void
 stream_pause (StreamData *stream)
 {
@@ -1277,7 +1354,9 @@ N_PLUGIN_LOAD (plugin)
         .prepare    = gst_sink_prepare,
         .play       = gst_sink_play,
         .pause      = gst_sink_pause,
-        .stop       = gst_sink_stop
+        .stop       = gst_sink_stop,
+        .latency    = gst_sink_latency,
+        .probe      = gst_sink_probe
     };
 
     n_plugin_register_sink (plugin, &decl);
@@ -1285,8 +1364,12 @@ N_PLUGIN_LOAD (plugin)
     core = n_plugin_get_core (plugin);
     context = n_core_get_context (core);
 
-    if (!n_core_connect (core, N_CORE_HOOK_INIT_DONE, 0,
-                         init_done_cb, context))
+    /* init done has been fired already when the plugin is reloaded. */
+
+    if (n_core_is_init_done (core))
+        init_done_cb (NULL, NULL, context);
+    else if (!n_core_connect (core, N_CORE_HOOK_INIT_DONE, 0,
+                              init_done_cb, context))
     {
         N_ERROR (LOG_CAT "failed to setup init done hook.");
     }
@@ -1306,6 +1389,9 @@ N_PLUGIN_UNLOAD (plugin)
         "profile.current.system.sound.level",
         system_sound_level_changed);
 
+    n_context_unsubscribe_value_change (context, "call_state.mode",
+        call_state_changed);
+
     n_core_disconnect (core, N_CORE_HOOK_INIT_DONE,
         init_done_cb, context);
 }
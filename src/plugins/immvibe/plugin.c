@@ -20,6 +20,7 @@
  */
 
 #include <ngf/plugin.h>
+#include <ngf/worker.h>
 #include <ImmVibe.h>
 #include <ImmVibeCore.h>
 #include <stdio.h>
@@ -46,8 +47,19 @@ typedef struct _ImmvibeData
     guint           poll_id;
     gboolean        repeat_pattern;
     guint           idle_complete_id;
+    guint           load_id;
 } ImmvibeData;
 
+typedef struct _ImmvibeLoad
+{
+    ImmvibeData    *data;
+    GPtrArray      *candidates;     /* pattern files to try, in order */
+    guint           repeat_from;    /* candidates from this index follow sound.repeat */
+    gboolean        sound_repeat;
+    gpointer        pattern;        /* loaded pattern */
+    guint           loaded;         /* index of the loaded candidate */
+} ImmvibeLoad;
+
 static VibeInt32    device      = VIBE_INVALID_DEVICE_HANDLE_VALUE;
 static const gchar *search_path = NULL;
 NContext* context = NULL;
@@ -280,10 +292,9 @@ immvibe_sink_can_handle (NSinkInterface *iface, NRequest *request)
     const NProplist *props = n_request_get_properties (request);
 
     NCore    *core    = n_sink_interface_get_core     (iface);
-    NContext *context = n_core_get_context            (core);
     NValue   *enabled = NULL;
 
-    enabled = (NValue*) n_context_get_value (context,
+    enabled = (NValue*) n_core_get_request_context_value (core, request,
         "profile.current.vibrating.alert.enabled");
 
     if (!enabled || !n_value_get_bool (enabled)) {
@@ -321,12 +332,62 @@ lookup_sound_from_context (NContext *context, const char *key)
     return n_value_get_string (v);
 }
 
+static gboolean
+immvibe_load_work (gpointer userdata)
+{
+    ImmvibeLoad *load = (ImmvibeLoad*) userdata;
+    guint i;
+
+    for (i = 0; i < load->candidates->len; ++i) {
+        if ((load->pattern = vibrator_load (g_ptr_array_index (load->candidates, i)))) {
+            load->loaded = i;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static void
+immvibe_load_done (gboolean result, gpointer userdata)
+{
+    ImmvibeLoad *load = (ImmvibeLoad*) userdata;
+    ImmvibeData *data = load->data;
+
+    data->load_id = 0;
+
+    if (result) {
+        N_DEBUG (LOG_CAT "loaded pattern from %s",
+            (const char*) g_ptr_array_index (load->candidates, load->loaded));
+
+        data->pattern = load->pattern;
+        load->pattern = NULL;
+
+        /* if repeat is set, then we need to repeat the pattern too */
+        if (load->loaded >= load->repeat_from)
+            data->repeat_pattern = load->sound_repeat;
+    }
+
+    n_sink_interface_synchronize (data->iface, data->request);
+}
+
+static void
+immvibe_load_free (gpointer userdata)
+{
+    ImmvibeLoad *load = (ImmvibeLoad*) userdata;
+
+    g_ptr_array_free (load->candidates, TRUE);
+    g_free (load->pattern);
+    g_slice_free (ImmvibeLoad, load);
+}
+
 static int
 immvibe_sink_prepare (NSinkInterface *iface, NRequest *request)
 {
     const NProplist *props = n_request_get_properties (request);
     ImmvibeData *data = g_slice_new0 (ImmvibeData);
 
+    ImmvibeLoad *load = NULL;
     char *filename;
     const char *sound_filename, *immvibe_filename, *lookup_key,
         *custom_file, *factory_sound = NULL;
@@ -374,32 +435,35 @@ immvibe_sink_prepare (NSinkInterface *iface, NRequest *request)
     /* all the cases apply to "factory sounds", which are files with custom
        vibration patterns. */
 
+    load = g_slice_new0 (ImmvibeLoad);
+    load->data         = data;
+    load->candidates   = g_ptr_array_new_with_free_func (g_free);
+    load->sound_repeat = sound_repeat;
+
     if (factory_sound_filename (factory_sound)) {
         filename = build_vibration_filename (search_path, factory_sound);
         N_DEBUG (LOG_CAT "sound is factory sound, loading pattern from: %s", filename);
-        data->pattern = vibrator_load (filename);
-        g_free (filename);
+        if (filename)
+            g_ptr_array_add (load->candidates, filename);
     }
 
     /* default case: if no pattern yet, then use immvibe.filename to load either
        absolute path or a filename that is to be searched from the vibration path. */
 
-    if (!data->pattern && immvibe_filename) {
-
-        /* if repeat is set, then we need to repeat the pattern too */
-        data->repeat_pattern = sound_repeat;
+    load->repeat_from = load->candidates->len;
 
-        if (!(data->pattern = vibrator_load (immvibe_filename))) {
-            filename = build_vibration_filename (search_path, immvibe_filename);
-            data->pattern = vibrator_load (filename);
-            g_free (filename);
-        }
+    if (immvibe_filename) {
+        g_ptr_array_add (load->candidates, g_strdup (immvibe_filename));
+        if ((filename = build_vibration_filename (search_path, immvibe_filename)))
+            g_ptr_array_add (load->candidates, filename);
     }
 
-    /* succeed even if no data. */
+    /* pattern files are read in a worker thread, request is synchronized once
+       loading is done. succeed even if no data. */
 
     n_request_store_data (request, IMMVIBE_KEY, data);
-    n_sink_interface_synchronize (iface, request);
+    data->load_id = n_core_push_work (n_sink_interface_get_core (iface), NULL,
+        immvibe_load_work, immvibe_load_done, load, immvibe_load_free);
 
     return TRUE;
 }
@@ -476,11 +540,14 @@ immvibe_sink_stop (NSinkInterface *iface, NRequest *request)
 {
     N_DEBUG (LOG_CAT "sink stop");
 
-    (void) iface;
-
     ImmvibeData *data = (ImmvibeData*) n_request_get_data (request, IMMVIBE_KEY);
     g_assert (data != NULL);
 
+    if (data->load_id > 0) {
+        n_core_cancel_work (n_sink_interface_get_core (iface), data->load_id);
+        data->load_id = 0;
+    }
+
     if (data->id > 0) {
         ImmVibeStopPlayingEffect (device, data->id);
     }
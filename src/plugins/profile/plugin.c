@@ -31,6 +31,7 @@
 #include <ngf/plugin.h>
 #include <ngf/event.h>
 #include <ngf/context.h>
+#include <ngf/worker.h>
 
 #define LOG_CAT                 "profile: "
 #define PROFILE_KEY_PATTERN     ".profile"
@@ -58,6 +59,14 @@ typedef struct _ProfileEntry
     gchar  *target;
 } ProfileEntry;
 
+typedef struct _ToneLookup
+{
+    NContext *context;
+    gchar    *context_key;
+    gchar    *value;        /* tone as given by profile */
+    gchar    *path;         /* resolved absolute path */
+} ToneLookup;
+
 typedef struct _SoundLevelEntry
 {
     gchar  *key;
@@ -70,6 +79,7 @@ static GList      *sound_levels            = NULL; /* contains SoundLevelEntry e
 static GList      *request_keys            = NULL;
 static GHashTable *profile_entries         = NULL;
 static gchar      *file_search_path        = NULL;
+static GHashTable *pending_lookups         = NULL; /* context key -> tone being searched */
 
 static void          transform_properties_cb      (NHook *hook,
                                                    void *data,
@@ -97,7 +107,7 @@ static gchar*        find_file_from_path          (const char *start_path,
 static gchar*        get_absolute_tone_path       (const char *value);
 static gchar*        construct_context_key        (const char *profile,
                                                    const char *key);
-static void          update_context_value         (NContext *context,
+static void          update_context_value         (NCore *core,
                                                    const char *profile,
                                                    const char *key,
                                                    const char *value);
@@ -112,7 +122,6 @@ transform_properties_cb (NHook *hook, void *data, void *userdata)
     (void) userdata;
 
     NCore        *core        = (NCore*) userdata;
-    NContext     *context     = n_core_get_context (core);
     NProplist    *new_props   = NULL;
     NProplist    *props       = NULL;
     GList        *iter        = NULL;
@@ -145,7 +154,8 @@ transform_properties_cb (NHook *hook, void *data, void *userdata)
             continue;
 
         context_key = construct_context_key (entry->profile, entry->key);
-        value = (NValue*) n_context_get_value (context, context_key);
+        value = (NValue*) n_core_get_request_context_value (core,
+            transform->request, context_key);
 
         if (value) {
             N_DEBUG (LOG_CAT "+ transforming profile key '%s' to target '%s'",
@@ -342,6 +352,50 @@ get_absolute_tone_path (const char *value)
     return find_file_from_path (file_search_path, value, 0);
 }
 
+static gboolean
+tone_lookup_work (gpointer userdata)
+{
+    ToneLookup *lookup = (ToneLookup*) userdata;
+
+    lookup->path = get_absolute_tone_path (lookup->value);
+    return lookup->path != NULL;
+}
+
+static void
+tone_lookup_done (gboolean result, gpointer userdata)
+{
+    ToneLookup *lookup  = (ToneLookup*) userdata;
+    const char *pending = NULL;
+    NValue     *value   = NULL;
+
+    /* value may have changed again while the path was searched for, the
+       latest lookup of the key publishes it. */
+
+    pending = g_hash_table_lookup (pending_lookups, lookup->context_key);
+    if (!pending || !g_str_equal (pending, lookup->value))
+        return;
+
+    g_hash_table_remove (pending_lookups, lookup->context_key);
+
+    if (!result)
+        N_DEBUG (LOG_CAT "tone '%s' not found from search path", lookup->value);
+
+    value = n_value_new ();
+    n_value_set_string (value, result ? lookup->path : lookup->value);
+    n_context_set_value (lookup->context, lookup->context_key, value);
+}
+
+static void
+tone_lookup_free (gpointer userdata)
+{
+    ToneLookup *lookup = (ToneLookup*) userdata;
+
+    g_free       (lookup->context_key);
+    g_free       (lookup->value);
+    g_free       (lookup->path);
+    g_slice_free (ToneLookup, lookup);
+}
+
 static gchar*
 construct_context_key (const char *profile, const char *key)
 {
@@ -351,25 +405,43 @@ construct_context_key (const char *profile, const char *key)
 }
 
 static void
-update_context_value (NContext *context, const char *profile, const char *key,
+update_context_value (NCore *core, const char *profile, const char *key,
                       const char *value)
 {
-    gchar  *context_key = NULL;
-    NValue *context_val = NULL;
-    gint    level       = 0;
-    gchar  *new_val     = NULL;
-    GList  *iter        = NULL;
-    SoundLevelEntry *e  = NULL;
+    NContext   *context     = n_core_get_context (core);
+    gchar      *context_key = NULL;
+    NValue     *context_val = NULL;
+    gint        level       = 0;
+    GList      *iter        = NULL;
+    ToneLookup *lookup      = NULL;
+    SoundLevelEntry *e      = NULL;
 
     context_key = construct_context_key (profile, key);
     context_val = n_value_new ();
 
     if (g_str_has_suffix (key, TONE_SUFFIX) ||
         g_str_has_suffix (key, PATTERN_SUFFIX)) {
-        new_val = get_absolute_tone_path (value);
-        new_val = new_val != NULL ? new_val : g_strdup (value);
-        n_value_set_string (context_val, new_val);
-        g_free (new_val);
+        /* searching the tone from the file system may block, so the value
+           is published only once the absolute path has been resolved. */
+
+        if (file_search_path && value) {
+            lookup = g_slice_new0 (ToneLookup);
+            lookup->context     = context;
+            lookup->context_key = g_strdup (context_key);
+            lookup->value       = g_strdup (value);
+
+            g_hash_table_replace (pending_lookups, g_strdup (context_key),
+                g_strdup (value));
+            g_free (context_key);
+            n_value_free (context_val);
+
+            (void) n_core_push_work (core, NULL, tone_lookup_work,
+                tone_lookup_done, lookup, tone_lookup_free);
+            return;
+        }
+
+        g_hash_table_remove (pending_lookups, context_key);
+        n_value_set_string (context_val, value);
     }
     else if (g_str_has_suffix (key, VOLUME_SUFFIX)) {
         n_value_set_int (context_val, profile_parse_int (value));
@@ -409,14 +481,18 @@ value_changed_cb (const char *profile,
     NContext   *context   = n_core_get_context (core);
     const char *current   = NULL;
 
-    update_context_value (context, profile, key, value);
+    n_context_begin (context);
+
+    update_context_value (core, profile, key, value);
 
     /* update current profile value if necessary */
 
     current = n_value_get_string ((NValue*) n_context_get_value (context,
         CURRENT_PROFILE_KEY));
     if (current && g_str_equal (current, profile))
-        update_context_value (context, NULL, key, value);
+        update_context_value (core, NULL, key, value);
+
+    n_context_commit (context);
 }
 
 static void
@@ -472,13 +548,18 @@ query_current_values (NCore *core)
     current  = n_value_get_string ((NValue*) n_context_get_value (context,
         "profile.current_profile"));
 
+    /* all profile values are set in one go, subscribers are notified
+       once everything is in place. */
+
+    n_context_begin (context);
+
     for (p = profiles; *p; ++p) {
         is_current = current && g_str_equal (current, *p);
         values = profile_get_values (*p);
         for (v = values; v->pv_key; ++v) {
-            update_context_value (context, *p, v->pv_key, v->pv_val);
+            update_context_value (core, *p, v->pv_key, v->pv_val);
             if (is_current)
-                update_context_value (context, NULL, v->pv_key, v->pv_val);
+                update_context_value (core, NULL, v->pv_key, v->pv_val);
         }
         profile_free_values (values);
     }
@@ -490,9 +571,11 @@ query_current_values (NCore *core)
      * fallback profile contents. */
     values = profile_get_values ("fallback");
     for (v = values; v->pv_key; ++v)
-        update_context_value (context, "fallback", v->pv_key, v->pv_val);
+        update_context_value (core, "fallback", v->pv_key, v->pv_val);
     profile_free_values (values);
 
+    n_context_commit (context);
+
     profile_free_profiles (profiles);
 }
 
@@ -579,21 +662,36 @@ setup_session_bus_connection (NCore *core)
 
 N_PLUGIN_LOAD (plugin)
 {
-    NCore     *core   = NULL;
-    NProplist *params = NULL;
+    NCore           *core   = NULL;
+    NProplist       *params = NULL;
+    NCoreHookFilter  filter;
+    const char     **keys   = NULL;
+    GList           *iter   = NULL;
+    guint            i      = 0;
 
     profile_entries = g_hash_table_new_full (g_str_hash, g_str_equal,
         g_free, (GDestroyNotify) free_entry);
+    pending_lookups = g_hash_table_new_full (g_str_hash, g_str_equal,
+        g_free, g_free);
 
     /* find all profile key entries within events. */
 
     core = n_plugin_get_core (plugin);
     find_profile_entries (core);
 
-    /* connect to the transform properties hook. */
+    /* connect to the transform properties hook, only requests with
+       profile keys need to be transformed. */
+
+    keys = g_new0 (const char*, g_list_length (request_keys) + 1);
+    for (iter = g_list_first (request_keys), i = 0; iter; iter = g_list_next (iter), ++i)
+        keys[i] = (const char*) iter->data;
+
+    filter.events = NULL;
+    filter.keys   = keys;
 
-    (void) n_core_connect (core, N_CORE_HOOK_TRANSFORM_PROPERTIES,
-        0, transform_properties_cb, core);
+    (void) n_core_connect_filtered (core, N_CORE_HOOK_TRANSFORM_PROPERTIES,
+        0, &filter, transform_properties_cb, core);
+    g_free (keys);
 
     /* query the system sound volume levels and file search
        path. */
@@ -640,6 +738,7 @@ N_PLUGIN_UNLOAD (plugin)
     g_free               (file_search_path);
     g_list_free_full     (sound_levels, sound_levels_free_cb);
     g_hash_table_destroy (profile_entries);
+    g_hash_table_destroy (pending_lookups);
     g_list_free_full     (request_keys, g_free);
 
     (void) plugin;
@@ -161,8 +161,14 @@ filter_sinks_cb (NHook *hook, void *data, void *userdata)
 
 N_PLUGIN_LOAD (plugin)
 {
-    NCore           *core;
-    const NProplist *params;
+    NCore               *core;
+    const NProplist     *params;
+    NCoreHookFilter      filter;
+    const char         **keys;
+    GSList              *i;
+    struct resource_def *resdef;
+    guint                n;
+    gboolean             all_enabled;
     def_list = NULL;
 
     core    = n_plugin_get_core (plugin);
@@ -176,10 +182,29 @@ N_PLUGIN_LOAD (plugin)
         return FALSE;
     }
 
-    /* connect to filter sinks hook. */
+    /* connect to filter sinks hook. if all resources are enabled by default,
+       only requests that set a resource key can filter anything. */
+
+    all_enabled = TRUE;
+    keys = g_new0 (const char*, g_slist_length (def_list) + 1);
+    for (i = def_list, n = 0; i; i = g_slist_next (i), ++n) {
+        resdef = i->data;
+        keys[n] = resdef->key;
+        if (!resdef->enabled_default)
+            all_enabled = FALSE;
+    }
+
+    filter.events = NULL;
+    filter.keys   = keys;
+
+    if (all_enabled)
+        (void) n_core_connect_filtered (core, N_CORE_HOOK_FILTER_SINKS, 0,
+            &filter, filter_sinks_cb, core);
+    else
+        (void) n_core_connect (core, N_CORE_HOOK_FILTER_SINKS, 0,
+            filter_sinks_cb, core);
 
-    (void) n_core_connect (core, N_CORE_HOOK_FILTER_SINKS, 0,
-        filter_sinks_cb, core);
+    g_free (keys);
 
     return TRUE;
 }
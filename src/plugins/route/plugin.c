@@ -36,6 +36,8 @@ update_context (NContext *context, guint output_type)
 {
     NValue *v;
 
+    n_context_begin (context);
+
     v = n_value_new ();
     n_value_set_uint (v, output_type);
     n_context_set_value (context, CONTEXT_ROUTE_OUTPUT_TYPE_KEY, v);
@@ -43,6 +45,8 @@ update_context (NContext *context, guint output_type)
     v = n_value_new ();
     n_value_set_string (v, output_type & OHM_EXT_ROUTE_TYPE_BUILTIN ? "builtin" : "external");
     n_context_set_value (context, CONTEXT_ROUTE_OUTPUT_CLASS_KEY, v);
+
+    n_context_commit (context);
 }
 
 static void
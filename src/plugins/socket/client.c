@@ -0,0 +1,321 @@
+/*
+ * ngfd - Non-graphic feedback daemon
+ *
+ * Client library for the local socket interface.
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "ngf-socket.h"
+#include "protocol.h"
+
+struct _NgfSocketClient
+{
+    int                      fd;
+    NgfSocketStatusCallback  callback;
+    void                    *userdata;
+    char                   **events;        /* event names by index */
+    uint32_t                 num_events;
+    uint32_t                 next_id;
+    int                      batch;
+    NgfSocketWriter          writer;
+    uint8_t                  buffer[NGF_SOCKET_MAX_PACKET];
+};
+
+static int      client_send        (NgfSocketClient *client);
+static int      client_frame_done  (NgfSocketClient *client, int *retry);
+static int      client_commit      (NgfSocketClient *client);
+static int      client_event_index (NgfSocketClient *client, const char *event,
+                                    uint32_t *index);
+
+static int
+client_send (NgfSocketClient *client)
+{
+    ssize_t sent = 0;
+
+    if (client->writer.len == 0)
+        return 0;
+
+    do {
+        sent = send (client->fd, client->buffer, client->writer.len, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+
+    client->writer.len = 0;
+
+    return sent < 0 ? -1 : 0;
+}
+
+/* finish frame, if it did not fit write out the earlier frames and let the
+ * caller encode it again into the empty buffer. */
+static int
+client_frame_done (NgfSocketClient *client, int *retry)
+{
+    if (ngf_socket_writer_end (&client->writer) == 0) {
+        *retry = 0;
+        return 0;
+    }
+
+    if (*retry || client->writer.len == 0) {
+        /* does not fit even in an empty packet */
+        *retry = 0;
+        return -1;
+    }
+
+    *retry = 1;
+    return client_send (client);
+}
+
+static int
+client_commit (NgfSocketClient *client)
+{
+    if (client->batch)
+        return 0;
+
+    return client_send (client);
+}
+
+static int
+client_event_index (NgfSocketClient *client, const char *event, uint32_t *index)
+{
+    char   **events = NULL;
+    uint32_t i      = 0;
+    int      retry  = 0;
+
+    for (i = 0; i < client->num_events; i++) {
+        if (strcmp (client->events[i], event) == 0) {
+            *index = i;
+            return 0;
+        }
+    }
+
+    events = realloc (client->events, (client->num_events + 1) * sizeof (char*));
+    if (!events)
+        return -1;
+
+    client->events = events;
+    if (!(client->events[client->num_events] = strdup (event)))
+        return -1;
+
+    do {
+        ngf_socket_writer_begin (&client->writer, NGF_SOCKET_MSG_EVENT,
+                                 client->num_events);
+        ngf_socket_writer_bytes (&client->writer, event, strlen (event));
+        if (client_frame_done (client, &retry) < 0) {
+            free (client->events[client->num_events]);
+            return -1;
+        }
+    } while (retry);
+
+    *index = client->num_events++;
+
+    return 0;
+}
+
+NgfSocketClient*
+ngf_socket_client_new (const char *path)
+{
+    NgfSocketClient    *client      = NULL;
+    const char         *runtime_dir = NULL;
+    struct sockaddr_un  addr;
+    int                 len         = 0;
+
+    memset (&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+
+    if (path) {
+        len = snprintf (addr.sun_path, sizeof (addr.sun_path), "%s", path);
+    } else {
+        if (!(runtime_dir = getenv ("XDG_RUNTIME_DIR")))
+            return NULL;
+        len = snprintf (addr.sun_path, sizeof (addr.sun_path), "%s/%s",
+                        runtime_dir, NGF_SOCKET_NAME);
+    }
+
+    if (len < 0 || (size_t) len >= sizeof (addr.sun_path))
+        return NULL;
+
+    if (!(client = calloc (1, sizeof (*client))))
+        return NULL;
+
+    client->next_id = 1;
+    ngf_socket_writer_init (&client->writer, client->buffer, sizeof (client->buffer));
+
+    client->fd = socket (AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (client->fd < 0)
+        goto fail;
+
+    if (connect (client->fd, (struct sockaddr*) &addr, sizeof (addr)) < 0)
+        goto fail;
+
+    return client;
+
+fail:
+    if (client->fd >= 0)
+        close (client->fd);
+    free (client);
+    return NULL;
+}
+
+void
+ngf_socket_client_free (NgfSocketClient *client)
+{
+    uint32_t i = 0;
+
+    if (!client)
+        return;
+
+    close (client->fd);
+
+    for (i = 0; i < client->num_events; i++)
+        free (client->events[i]);
+    free (client->events);
+    free (client);
+}
+
+int
+ngf_socket_client_get_fd (NgfSocketClient *client)
+{
+    return client->fd;
+}
+
+void
+ngf_socket_client_set_callback (NgfSocketClient *client,
+                                NgfSocketStatusCallback callback,
+                                void *userdata)
+{
+    client->callback = callback;
+    client->userdata = userdata;
+}
+
+void
+ngf_socket_client_begin (NgfSocketClient *client)
+{
+    client->batch = 1;
+}
+
+int
+ngf_socket_client_flush (NgfSocketClient *client)
+{
+    client->batch = 0;
+
+    return client_send (client);
+}
+
+uint32_t
+ngf_socket_client_play (NgfSocketClient *client, const char *event,
+                        const NgfSocketProperty *properties, unsigned int count)
+{
+    uint32_t     index = 0;
+    uint32_t     id    = 0;
+    unsigned int i     = 0;
+    int          retry = 0;
+
+    if (!event || count > UINT16_MAX || (count > 0 && !properties))
+        return 0;
+
+    if (client_event_index (client, event, &index) < 0)
+        return 0;
+
+    id = client->next_id++;
+    if (client->next_id == 0)
+        client->next_id = 1;
+
+    do {
+        ngf_socket_writer_begin (&client->writer, NGF_SOCKET_MSG_PLAY, id);
+        ngf_socket_writer_u32 (&client->writer, index);
+        ngf_socket_writer_u16 (&client->writer, (uint16_t) count);
+        for (i = 0; i < count; i++)
+            ngf_socket_writer_property (&client->writer, &properties[i]);
+        if (client_frame_done (client, &retry) < 0)
+            return 0;
+    } while (retry);
+
+    if (client_commit (client) < 0)
+        return 0;
+
+    return id;
+}
+
+int
+ngf_socket_client_stop (NgfSocketClient *client, uint32_t id)
+{
+    int retry = 0;
+
+    do {
+        ngf_socket_writer_begin (&client->writer, NGF_SOCKET_MSG_STOP, id);
+        if (client_frame_done (client, &retry) < 0)
+            return -1;
+    } while (retry);
+
+    return client_commit (client);
+}
+
+int
+ngf_socket_client_pause (NgfSocketClient *client, uint32_t id, int pause)
+{
+    int retry = 0;
+
+    do {
+        ngf_socket_writer_begin (&client->writer, NGF_SOCKET_MSG_PAUSE, id);
+        ngf_socket_writer_u8 (&client->writer, pause ? 1 : 0);
+        if (client_frame_done (client, &retry) < 0)
+            return -1;
+    } while (retry);
+
+    return client_commit (client);
+}
+
+int
+ngf_socket_client_dispatch (NgfSocketClient *client)
+{
+    uint8_t         buffer[NGF_SOCKET_MAX_PACKET];
+    NgfSocketReader reader;
+    NgfSocketFrame  frame;
+    ssize_t         len    = 0;
+    uint32_t        status = 0;
+
+    for (;;) {
+        len = recv (client->fd, buffer, sizeof (buffer), MSG_DONTWAIT);
+
+        if (len == 0)
+            return -1;
+
+        if (len < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            return -1;
+        }
+
+        ngf_socket_reader_init (&reader, buffer, (size_t) len);
+        while (ngf_socket_reader_frame (&reader, &frame)) {
+            if (frame.type != NGF_SOCKET_MSG_STATUS)
+                continue;
+
+            status = ngf_socket_reader_u32 (&frame.payload);
+            if (!frame.payload.error && client->callback)
+                client->callback (client, frame.id, status, client->userdata);
+        }
+    }
+}
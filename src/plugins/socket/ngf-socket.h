@@ -0,0 +1,178 @@
+/*
+ * ngfd - Non-graphic feedback daemon
+ *
+ * Client library for the local socket interface.
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef NGF_SOCKET_H
+#define NGF_SOCKET_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Socket file name in $XDG_RUNTIME_DIR. */
+#define NGF_SOCKET_NAME             "ngfd.socket"
+
+/** Request failed. */
+#define NGF_SOCKET_STATUS_FAILED    (0)
+/** Request completed. */
+#define NGF_SOCKET_STATUS_COMPLETED (1)
+/** Request started playing. */
+#define NGF_SOCKET_STATUS_PLAYING   (2)
+/** Request was paused. */
+#define NGF_SOCKET_STATUS_PAUSED    (3)
+
+/** Internal client structure. */
+typedef struct _NgfSocketClient NgfSocketClient;
+
+/** Type of a request property. */
+typedef enum _NgfSocketPropertyType
+{
+    NGF_SOCKET_PROPERTY_STRING = 1,
+    NGF_SOCKET_PROPERTY_INT,
+    NGF_SOCKET_PROPERTY_UINT,
+    NGF_SOCKET_PROPERTY_BOOL
+} NgfSocketPropertyType;
+
+/** Request property. */
+typedef struct _NgfSocketProperty
+{
+    /** Property key, at most 255 bytes. */
+    const char            *key;
+    /** Type of the value. */
+    NgfSocketPropertyType  type;
+    /** Value, member matching the type is used. */
+    union {
+        const char *s;
+        int32_t     i;
+        uint32_t    u;
+        int         b;
+    } value;
+} NgfSocketProperty;
+
+/**
+ * Status callback.
+ *
+ * @param client Client.
+ * @param id Request id returned by ngf_socket_client_play.
+ * @param status One of NGF_SOCKET_STATUS_*.
+ * @param userdata Userdata.
+ */
+typedef void (*NgfSocketStatusCallback) (NgfSocketClient *client, uint32_t id,
+                                         uint32_t status, void *userdata);
+
+/**
+ * Connect to ngfd.
+ *
+ * @param path Socket path, NULL for NGF_SOCKET_NAME in $XDG_RUNTIME_DIR.
+ * @return New client or NULL if connecting failed.
+ */
+NgfSocketClient* ngf_socket_client_new          (const char *path);
+
+/**
+ * Disconnect and free the client. Active requests of the client are stopped.
+ *
+ * @param client Client.
+ */
+void             ngf_socket_client_free         (NgfSocketClient *client);
+
+/**
+ * Get file descriptor of the connection, to be polled for input. Call
+ * ngf_socket_client_dispatch when it is readable.
+ *
+ * @param client Client.
+ * @return File descriptor.
+ */
+int              ngf_socket_client_get_fd       (NgfSocketClient *client);
+
+/**
+ * Set callback for request status.
+ *
+ * @param client Client.
+ * @param callback Callback, NULL to ignore status.
+ * @param userdata Userdata.
+ */
+void             ngf_socket_client_set_callback (NgfSocketClient *client,
+                                                 NgfSocketStatusCallback callback,
+                                                 void *userdata);
+
+/**
+ * Start batching. Operations are written only by ngf_socket_client_flush,
+ * or when the batch does not fit in one packet.
+ *
+ * @param client Client.
+ */
+void             ngf_socket_client_begin        (NgfSocketClient *client);
+
+/**
+ * Write batched operations and stop batching.
+ *
+ * @param client Client.
+ * @return 0 if successful, -1 on error.
+ */
+int              ngf_socket_client_flush        (NgfSocketClient *client);
+
+/**
+ * Play event.
+ *
+ * @param client Client.
+ * @param event Event name.
+ * @param properties Request properties, may be NULL if count is 0.
+ * @param count Number of properties.
+ * @return Request id, 0 on error.
+ */
+uint32_t         ngf_socket_client_play         (NgfSocketClient *client,
+                                                 const char *event,
+                                                 const NgfSocketProperty *properties,
+                                                 unsigned int count);
+
+/**
+ * Stop request.
+ *
+ * @param client Client.
+ * @param id Request id.
+ * @return 0 if successful, -1 on error.
+ */
+int              ngf_socket_client_stop         (NgfSocketClient *client, uint32_t id);
+
+/**
+ * Pause or resume request.
+ *
+ * @param client Client.
+ * @param id Request id.
+ * @param pause Non-zero to pause, zero to resume.
+ * @return 0 if successful, -1 on error.
+ */
+int              ngf_socket_client_pause        (NgfSocketClient *client, uint32_t id, int pause);
+
+/**
+ * Read status received from ngfd and call the status callback. Does
+ * not block.
+ *
+ * @param client Client.
+ * @return 0 if successful, -1 if connection was closed or failed.
+ */
+int              ngf_socket_client_dispatch     (NgfSocketClient *client);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NGF_SOCKET_H */
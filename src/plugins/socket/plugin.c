@@ -0,0 +1,600 @@
+/*
+ * ngfd - Non-graphic feedback daemon
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <glib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <ngf/log.h>
+#include <ngf/proplist.h>
+#include <ngf/plugin.h>
+#include <ngf/request.h>
+#include <ngf/inputinterface.h>
+
+#include "protocol.h"
+
+N_PLUGIN_NAME        ("socket")
+N_PLUGIN_VERSION     ("0.1")
+N_PLUGIN_DESCRIPTION ("Local socket interface")
+
+#define LOG_CAT "socket: "
+
+#define SOCKET_PROPERTY_CLIENT  "socket.client"
+#define SOCKET_PROPERTY_ID      "socket.request.id"
+
+#define SOCKET_PATH             "path"
+#define SOCKET_REQUEST_LIMIT    "request_limit"
+#define SOCKET_CLIENT_LIMIT     "client_limit"
+#define DEFAULT_REQUEST_LIMIT   (16)
+#define DEFAULT_CLIENT_LIMIT    (16)
+#define SOCKET_EVENT_LIMIT      (256)
+#define SOCKET_BACKLOG          (8)
+
+typedef struct _SocketData
+{
+    NInputInterface *iface;
+    gchar           *path;
+    int              fd;
+    guint            watch;
+    GList           *clients;       /* SocketClient* */
+    guint            num_clients;
+} SocketData;
+
+typedef struct _SocketClient
+{
+    SocketData      *data;
+    guint            ref;
+    int              fd;            /* -1 once disconnected */
+    guint            watch;
+    GPtrArray       *events;        /* event names by index */
+    GHashTable      *requests;      /* client request id -> NRequest* */
+} SocketClient;
+
+static guint  socket_max_requests;
+static guint  socket_max_clients;
+static gchar *socket_path;
+
+static gboolean socket_accept_cb    (GIOChannel *source, GIOCondition condition,
+                                     gpointer userdata);
+static gboolean socket_client_cb    (GIOChannel *source, GIOCondition condition,
+                                     gpointer userdata);
+static void     socket_client_close (SocketClient *client);
+static void     socket_send_status  (SocketClient *client, guint32 id, guint32 status);
+
+static guint
+socket_add_watch (int fd, GIOFunc callback, gpointer userdata)
+{
+    GIOChannel *channel = NULL;
+    guint       watch   = 0;
+
+    channel = g_io_channel_unix_new (fd);
+    watch = g_io_add_watch (channel, G_IO_IN | G_IO_HUP | G_IO_ERR,
+                            callback, userdata);
+    g_io_channel_unref (channel);
+
+    return watch;
+}
+
+static SocketClient*
+socket_client_new (SocketData *data, int fd)
+{
+    SocketClient *client = NULL;
+
+    client = g_slice_new0 (SocketClient);
+    client->data     = data;
+    client->ref      = 1;
+    client->fd       = fd;
+    client->events   = g_ptr_array_new_with_free_func (g_free);
+    client->requests = g_hash_table_new (g_direct_hash, g_direct_equal);
+    client->watch    = socket_add_watch (fd, socket_client_cb, client);
+
+    return client;
+}
+
+static void
+socket_client_unref (SocketClient *client)
+{
+    g_assert (client->ref > 0);
+
+    if (--client->ref > 0)
+        return;
+
+    g_ptr_array_free (client->events, TRUE);
+    g_hash_table_destroy (client->requests);
+    g_slice_free (SocketClient, client);
+}
+
+static void
+socket_client_close (SocketClient *client)
+{
+    SocketData *data     = client->data;
+    GList      *requests = NULL;
+    GList      *iter     = NULL;
+
+    if (client->fd < 0)
+        return;
+
+    N_DEBUG (LOG_CAT "client %d disconnected", client->fd);
+
+    if (client->watch > 0)
+        g_source_remove (client->watch);
+    client->watch = 0;
+    close (client->fd);
+    client->fd = -1;
+
+    data->clients = g_list_remove (data->clients, client);
+    data->num_clients--;
+
+    /* stopping may complete the request and remove it from the table */
+    requests = g_hash_table_get_values (client->requests);
+    for (iter = requests; iter; iter = g_list_next (iter))
+        n_input_interface_stop_request (data->iface, (NRequest*) iter->data, 0);
+    g_list_free (requests);
+
+    socket_client_unref (client);
+}
+
+static void
+socket_send_status (SocketClient *client, guint32 id, guint32 status)
+{
+    uint8_t         buffer[NGF_SOCKET_FRAME_HEADER + sizeof (guint32)];
+    NgfSocketWriter writer;
+
+    if (client->fd < 0)
+        return;
+
+    ngf_socket_writer_init (&writer, buffer, sizeof (buffer));
+    ngf_socket_writer_begin (&writer, NGF_SOCKET_MSG_STATUS, id);
+    ngf_socket_writer_u32 (&writer, status);
+    (void) ngf_socket_writer_end (&writer);
+
+    if (send (client->fd, buffer, writer.len, MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+        N_WARNING (LOG_CAT "failed to send status %u for request %u: %s",
+            status, id, strerror (errno));
+}
+
+static gboolean
+socket_parse_properties (NgfSocketReader *r, NProplist *props)
+{
+    const uint8_t *key_data   = NULL;
+    const uint8_t *value_data = NULL;
+    gchar         *key        = NULL;
+    gchar         *value      = NULL;
+    guint16        count      = 0;
+    guint8         type       = 0;
+    guint8         key_len    = 0;
+    guint16        value_len  = 0;
+
+    count = ngf_socket_reader_u16 (r);
+
+    while (count-- > 0 && !r->error) {
+        type     = ngf_socket_reader_u8 (r);
+        key_len  = ngf_socket_reader_u8 (r);
+        key_data = ngf_socket_reader_bytes (r, key_len);
+        if (!key_data || key_len == 0)
+            return FALSE;
+
+        key = g_strndup ((const gchar*) key_data, key_len);
+
+        switch (type) {
+            case NGF_SOCKET_PROPERTY_STRING:
+                value_len  = ngf_socket_reader_u16 (r);
+                value_data = ngf_socket_reader_bytes (r, value_len);
+                if (value_data) {
+                    value = g_strndup ((const gchar*) value_data, value_len);
+                    n_proplist_set_string (props, key, value);
+                    g_free (value);
+                }
+                break;
+
+            case NGF_SOCKET_PROPERTY_INT:
+                n_proplist_set_int (props, key, (gint) ngf_socket_reader_u32 (r));
+                break;
+
+            case NGF_SOCKET_PROPERTY_UINT:
+                n_proplist_set_uint (props, key, ngf_socket_reader_u32 (r));
+                break;
+
+            case NGF_SOCKET_PROPERTY_BOOL:
+                n_proplist_set_bool (props, key, ngf_socket_reader_u8 (r) ? TRUE : FALSE);
+                break;
+
+            default:
+                r->error = 1;
+                break;
+        }
+
+        g_free (key);
+    }
+
+    return r->error ? FALSE : TRUE;
+}
+
+static void
+socket_handle_event (SocketClient *client, NgfSocketFrame *frame)
+{
+    const uint8_t *name = NULL;
+
+    /* events are defined in order, index is the next free slot */
+    if (frame->id != client->events->len || frame->id >= SOCKET_EVENT_LIMIT) {
+        N_WARNING (LOG_CAT "client %d defined invalid event index %u",
+            client->fd, frame->id);
+        return;
+    }
+
+    name = ngf_socket_reader_bytes (&frame->payload, frame->payload.len);
+    if (!name || frame->payload.len == 0)
+        return;
+
+    g_ptr_array_add (client->events,
+        g_strndup ((const gchar*) name, frame->payload.len));
+}
+
+static void
+socket_handle_play (SocketClient *client, NgfSocketFrame *frame)
+{
+    SocketData *data    = client->data;
+    NProplist  *props   = NULL;
+    NRequest   *request = NULL;
+    guint32     index   = 0;
+
+    index = ngf_socket_reader_u32 (&frame->payload);
+
+    if (frame->payload.error || index >= client->events->len) {
+        N_WARNING (LOG_CAT "client %d played unknown event", client->fd);
+        goto fail;
+    }
+
+    if (frame->id == 0 ||
+        g_hash_table_contains (client->requests, GUINT_TO_POINTER (frame->id))) {
+        N_WARNING (LOG_CAT "client %d used invalid request id %u",
+            client->fd, frame->id);
+        goto fail;
+    }
+
+    if (g_hash_table_size (client->requests) >= socket_max_requests) {
+        N_WARNING (LOG_CAT "client %d has too many simultaneous requests",
+            client->fd);
+        goto fail;
+    }
+
+    props = n_proplist_new ();
+    if (!socket_parse_properties (&frame->payload, props)) {
+        N_WARNING (LOG_CAT "client %d sent malformed properties", client->fd);
+        n_proplist_free (props);
+        goto fail;
+    }
+
+    n_proplist_set_pointer (props, SOCKET_PROPERTY_CLIENT, client);
+    n_proplist_set_uint (props, SOCKET_PROPERTY_ID, frame->id);
+    request = n_request_new_with_event_and_properties (
+        g_ptr_array_index (client->events, index), props);
+    n_proplist_free (props);
+
+    client->ref++;
+    g_hash_table_insert (client->requests, GUINT_TO_POINTER (frame->id), request);
+
+    N_DEBUG (LOG_CAT ">> play received for event '%s' with id '%u' (client %d request %u)",
+        n_request_get_name (request), n_request_get_id (request),
+        client->fd, frame->id);
+
+    n_input_interface_play_request (data->iface, request);
+    return;
+
+fail:
+    socket_send_status (client, frame->id, NGF_SOCKET_STATUS_FAILED);
+}
+
+static void
+socket_handle_control (SocketClient *client, NgfSocketFrame *frame)
+{
+    SocketData *data    = client->data;
+    NRequest   *request = NULL;
+    guint8      pause   = 0;
+
+    request = g_hash_table_lookup (client->requests, GUINT_TO_POINTER (frame->id));
+    if (!request) {
+        N_DEBUG (LOG_CAT "client %d has no request %u", client->fd, frame->id);
+        return;
+    }
+
+    if (frame->type == NGF_SOCKET_MSG_STOP) {
+        N_DEBUG (LOG_CAT ">> stop received for request %u", frame->id);
+        n_input_interface_stop_request (data->iface, request, 0);
+        return;
+    }
+
+    pause = ngf_socket_reader_u8 (&frame->payload);
+    if (frame->payload.error)
+        return;
+
+    N_DEBUG (LOG_CAT ">> %s received for request %u", pause ? "pause" : "resume",
+        frame->id);
+
+    if (pause)
+        (void) n_input_interface_pause_request (data->iface, request);
+    else
+        (void) n_input_interface_play_request (data->iface, request);
+}
+
+static void
+socket_handle_packet (SocketClient *client, const uint8_t *packet, size_t len)
+{
+    NgfSocketReader reader;
+    NgfSocketFrame  frame;
+
+    ngf_socket_reader_init (&reader, packet, len);
+
+    /* request callbacks may close the client */
+    while (client->fd >= 0 && ngf_socket_reader_frame (&reader, &frame)) {
+        switch (frame.type) {
+            case NGF_SOCKET_MSG_EVENT:
+                socket_handle_event (client, &frame);
+                break;
+            case NGF_SOCKET_MSG_PLAY:
+                socket_handle_play (client, &frame);
+                break;
+            case NGF_SOCKET_MSG_STOP:
+            case NGF_SOCKET_MSG_PAUSE:
+                socket_handle_control (client, &frame);
+                break;
+            default:
+                N_DEBUG (LOG_CAT "client %d sent unknown frame %u",
+                    client->fd, frame.type);
+                break;
+        }
+    }
+
+    if (reader.error)
+        N_WARNING (LOG_CAT "client %d sent truncated frame", client->fd);
+}
+
+static gboolean
+socket_client_cb (GIOChannel *source, GIOCondition condition, gpointer userdata)
+{
+    SocketClient *client = userdata;
+    uint8_t       packet[NGF_SOCKET_MAX_PACKET];
+    ssize_t       len    = 0;
+    gboolean      keep   = TRUE;
+
+    (void) source;
+
+    /* request callbacks may close the client, keep it alive until done */
+    client->ref++;
+
+    if (condition & G_IO_IN) {
+        for (;;) {
+            len = recv (client->fd, packet, sizeof (packet), MSG_DONTWAIT);
+
+            if (len < 0 && errno == EINTR)
+                continue;
+
+            if (len <= 0)
+                break;
+
+            socket_handle_packet (client, packet, (size_t) len);
+            if (client->fd < 0)
+                break;
+        }
+    }
+
+    if (client->fd >= 0 &&
+        (!(condition & G_IO_IN) || len == 0 ||
+         (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK))) {
+        /* source is removed by returning FALSE */
+        client->watch = 0;
+        socket_client_close (client);
+    }
+
+    keep = client->fd >= 0;
+    socket_client_unref (client);
+
+    return keep;
+}
+
+static gboolean
+socket_accept_cb (GIOChannel *source, GIOCondition condition, gpointer userdata)
+{
+    SocketData   *data   = userdata;
+    SocketClient *client = NULL;
+    int           fd     = -1;
+
+    (void) source;
+
+    if (!(condition & G_IO_IN)) {
+        N_ERROR (LOG_CAT "listening socket failed");
+        data->watch = 0;
+        return FALSE;
+    }
+
+    fd = accept (data->fd, NULL, NULL);
+    if (fd < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            N_WARNING (LOG_CAT "accept failed: %s", strerror (errno));
+        return TRUE;
+    }
+
+    (void) fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK);
+    (void) fcntl (fd, F_SETFD, FD_CLOEXEC);
+
+    if (data->num_clients >= socket_max_clients) {
+        N_WARNING (LOG_CAT "too many simultaneous clients");
+        close (fd);
+        return TRUE;
+    }
+
+    client = socket_client_new (data, fd);
+    data->clients = g_list_prepend (data->clients, client);
+    data->num_clients++;
+
+    N_DEBUG (LOG_CAT "client %d connected", fd);
+
+    return TRUE;
+}
+
+static int
+socket_initialize (NInputInterface *iface)
+{
+    SocketData         *data = NULL;
+    struct sockaddr_un  addr;
+
+    if (strlen (socket_path) >= sizeof (addr.sun_path)) {
+        N_ERROR (LOG_CAT "socket path '%s' is too long", socket_path);
+        return FALSE;
+    }
+
+    data = g_new0 (SocketData, 1);
+    data->iface = iface;
+    data->path  = socket_path;
+
+    memset (&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    strcpy (addr.sun_path, data->path);
+
+    data->fd = socket (AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (data->fd < 0) {
+        N_ERROR (LOG_CAT "failed to create socket: %s", strerror (errno));
+        g_free (data);
+        return FALSE;
+    }
+
+    (void) unlink (data->path);
+
+    if (bind (data->fd, (struct sockaddr*) &addr, sizeof (addr)) < 0 ||
+        listen (data->fd, SOCKET_BACKLOG) < 0) {
+        N_ERROR (LOG_CAT "failed to listen on '%s': %s", data->path, strerror (errno));
+        close (data->fd);
+        g_free (data);
+        return FALSE;
+    }
+
+    data->watch = socket_add_watch (data->fd, socket_accept_cb, data);
+    n_input_interface_set_userdata (iface, data);
+
+    N_INFO (LOG_CAT "listening on '%s'", data->path);
+
+    return TRUE;
+}
+
+static void
+socket_shutdown (NInputInterface *iface)
+{
+    SocketData *data = n_input_interface_get_userdata (iface);
+
+    if (!data)
+        return;
+
+    while (data->clients)
+        socket_client_close (data->clients->data);
+
+    if (data->watch > 0)
+        g_source_remove (data->watch);
+    data->watch = 0;
+
+    close (data->fd);
+    (void) unlink (data->path);
+
+    n_input_interface_set_userdata (iface, NULL);
+    g_free (data);
+}
+
+static void
+socket_send_reply (NInputInterface *iface, NRequest *request, int code)
+{
+    const NProplist *props  = NULL;
+    SocketClient    *client = NULL;
+    guint32          id     = 0;
+
+    (void) iface;
+
+    props  = n_request_get_properties (request);
+    client = n_proplist_get_pointer (props, SOCKET_PROPERTY_CLIENT);
+    id     = n_proplist_get_uint (props, SOCKET_PROPERTY_ID);
+
+    if (!client)
+        return;
+
+    socket_send_status (client, id, (guint32) code);
+
+    if (code == NGF_SOCKET_STATUS_FAILED || code == NGF_SOCKET_STATUS_COMPLETED) {
+        g_hash_table_remove (client->requests, GUINT_TO_POINTER (id));
+        socket_client_unref (client);
+    }
+}
+
+static void
+socket_send_error (NInputInterface *iface, NRequest *request, const char *err_msg)
+{
+    N_DEBUG (LOG_CAT "error occurred for request '%s': %s",
+        n_request_get_name (request), err_msg);
+
+    socket_send_reply (iface, request, NGF_SOCKET_STATUS_FAILED);
+}
+
+static guint
+socket_get_limit (const NProplist *params, const char *key, guint default_value)
+{
+    const char *value = NULL;
+
+    if ((value = n_proplist_get_string (params, key)))
+        return (guint) atoi (value);
+
+    return default_value;
+}
+
+N_PLUGIN_LOAD (plugin)
+{
+    static const NInputInterfaceDecl decl = {
+        .name       = "socket",
+        .initialize = socket_initialize,
+        .shutdown   = socket_shutdown,
+        .send_error = socket_send_error,
+        .send_reply = socket_send_reply
+    };
+
+    const NProplist *params = NULL;
+    const char      *path   = NULL;
+
+    params = n_plugin_get_params (plugin);
+
+    socket_max_requests = socket_get_limit (params, SOCKET_REQUEST_LIMIT, DEFAULT_REQUEST_LIMIT);
+    socket_max_clients  = socket_get_limit (params, SOCKET_CLIENT_LIMIT, DEFAULT_CLIENT_LIMIT);
+
+    if ((path = n_proplist_get_string (params, SOCKET_PATH)))
+        socket_path = g_strdup (path);
+    else
+        socket_path = g_build_filename (g_get_user_runtime_dir (), NGF_SOCKET_NAME, NULL);
+
+    n_plugin_register_input (plugin, &decl);
+
+    return TRUE;
+}
+
+N_PLUGIN_UNLOAD (plugin)
+{
+    (void) plugin;
+
+    g_free (socket_path);
+    socket_path = NULL;
+}
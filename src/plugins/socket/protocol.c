@@ -0,0 +1,220 @@
+/*
+ * ngfd - Non-graphic feedback daemon
+ *
+ * Binary framing of the local socket interface.
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "protocol.h"
+
+void
+ngf_socket_writer_init (NgfSocketWriter *w, uint8_t *data, size_t size)
+{
+    w->data  = data;
+    w->size  = size;
+    w->len   = 0;
+    w->frame = 0;
+    w->error = 0;
+}
+
+void
+ngf_socket_writer_begin (NgfSocketWriter *w, uint16_t type, uint32_t id)
+{
+    w->frame = w->len;
+    w->error = 0;
+
+    ngf_socket_writer_u16 (w, type);
+    ngf_socket_writer_u16 (w, 0);
+    ngf_socket_writer_u32 (w, id);
+}
+
+int
+ngf_socket_writer_end (NgfSocketWriter *w)
+{
+    size_t   length = 0;
+    uint16_t value  = 0;
+
+    length = w->len - w->frame - NGF_SOCKET_FRAME_HEADER;
+
+    if (w->error || length > UINT16_MAX) {
+        /* drop the partial frame, earlier frames are kept */
+        w->len = w->frame;
+        return -1;
+    }
+
+    value = (uint16_t) length;
+    memcpy (w->data + w->frame + 2, &value, sizeof (value));
+
+    return 0;
+}
+
+void
+ngf_socket_writer_bytes (NgfSocketWriter *w, const void *data, size_t len)
+{
+    if (w->error || w->size - w->len < len) {
+        w->error = 1;
+        return;
+    }
+
+    memcpy (w->data + w->len, data, len);
+    w->len += len;
+}
+
+void
+ngf_socket_writer_u8 (NgfSocketWriter *w, uint8_t value)
+{
+    ngf_socket_writer_bytes (w, &value, sizeof (value));
+}
+
+void
+ngf_socket_writer_u16 (NgfSocketWriter *w, uint16_t value)
+{
+    ngf_socket_writer_bytes (w, &value, sizeof (value));
+}
+
+void
+ngf_socket_writer_u32 (NgfSocketWriter *w, uint32_t value)
+{
+    ngf_socket_writer_bytes (w, &value, sizeof (value));
+}
+
+void
+ngf_socket_writer_property (NgfSocketWriter *w, const NgfSocketProperty *property)
+{
+    size_t key_len   = 0;
+    size_t value_len = 0;
+
+    key_len = strlen (property->key);
+    if (key_len == 0 || key_len > UINT8_MAX) {
+        w->error = 1;
+        return;
+    }
+
+    ngf_socket_writer_u8 (w, (uint8_t) property->type);
+    ngf_socket_writer_u8 (w, (uint8_t) key_len);
+    ngf_socket_writer_bytes (w, property->key, key_len);
+
+    switch (property->type) {
+        case NGF_SOCKET_PROPERTY_STRING:
+            value_len = property->value.s ? strlen (property->value.s) : 0;
+            if (value_len > UINT16_MAX) {
+                w->error = 1;
+                return;
+            }
+            ngf_socket_writer_u16 (w, (uint16_t) value_len);
+            ngf_socket_writer_bytes (w, property->value.s, value_len);
+            break;
+
+        case NGF_SOCKET_PROPERTY_INT:
+            ngf_socket_writer_u32 (w, (uint32_t) property->value.i);
+            break;
+
+        case NGF_SOCKET_PROPERTY_UINT:
+            ngf_socket_writer_u32 (w, property->value.u);
+            break;
+
+        case NGF_SOCKET_PROPERTY_BOOL:
+            ngf_socket_writer_u8 (w, property->value.b ? 1 : 0);
+            break;
+
+        default:
+            w->error = 1;
+            break;
+    }
+}
+
+void
+ngf_socket_reader_init (NgfSocketReader *r, const uint8_t *data, size_t len)
+{
+    r->data  = data;
+    r->len   = len;
+    r->pos   = 0;
+    r->error = 0;
+}
+
+const uint8_t*
+ngf_socket_reader_bytes (NgfSocketReader *r, size_t len)
+{
+    const uint8_t *data = NULL;
+
+    if (r->error || r->len - r->pos < len) {
+        r->error = 1;
+        return NULL;
+    }
+
+    data = r->data + r->pos;
+    r->pos += len;
+
+    return data;
+}
+
+uint8_t
+ngf_socket_reader_u8 (NgfSocketReader *r)
+{
+    const uint8_t *data = ngf_socket_reader_bytes (r, sizeof (uint8_t));
+
+    return data ? *data : 0;
+}
+
+uint16_t
+ngf_socket_reader_u16 (NgfSocketReader *r)
+{
+    const uint8_t *data  = NULL;
+    uint16_t       value = 0;
+
+    if ((data = ngf_socket_reader_bytes (r, sizeof (value))))
+        memcpy (&value, data, sizeof (value));
+
+    return value;
+}
+
+uint32_t
+ngf_socket_reader_u32 (NgfSocketReader *r)
+{
+    const uint8_t *data  = NULL;
+    uint32_t       value = 0;
+
+    if ((data = ngf_socket_reader_bytes (r, sizeof (value))))
+        memcpy (&value, data, sizeof (value));
+
+    return value;
+}
+
+int
+ngf_socket_reader_frame (NgfSocketReader *r, NgfSocketFrame *frame)
+{
+    const uint8_t *payload = NULL;
+    uint16_t       length  = 0;
+
+    if (r->error || r->pos >= r->len)
+        return 0;
+
+    frame->type = ngf_socket_reader_u16 (r);
+    length      = ngf_socket_reader_u16 (r);
+    frame->id   = ngf_socket_reader_u32 (r);
+
+    if (!(payload = ngf_socket_reader_bytes (r, length)) && length > 0)
+        return 0;
+
+    if (r->error)
+        return 0;
+
+    ngf_socket_reader_init (&frame->payload, payload, length);
+
+    return 1;
+}
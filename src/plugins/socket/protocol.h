@@ -0,0 +1,98 @@
+/*
+ * ngfd - Non-graphic feedback daemon
+ *
+ * Binary framing of the local socket interface.
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef NGF_SOCKET_PROTOCOL_H
+#define NGF_SOCKET_PROTOCOL_H
+
+/*
+ * Every SOCK_SEQPACKET packet carries one or more frames, so a client can
+ * batch several operations into one write. All integers are in host byte
+ * order, both ends are on the same machine.
+ *
+ *   frame      := type:u16 length:u16 id:u32 payload[length]
+ *
+ *   EVENT      client  id = event index   payload = name bytes
+ *   PLAY       client  id = request id    payload = event:u32 count:u16 property*
+ *   STOP       client  id = request id    payload = (empty)
+ *   PAUSE      client  id = request id    payload = pause:u8
+ *   STATUS     server  id = request id    payload = status:u32
+ *
+ *   property   := type:u8 keylen:u8 key[keylen] value
+ *   value      := STRING len:u16 bytes[len] | INT i32 | UINT u32 | BOOL u8
+ *
+ * Request ids are chosen by the client and are unique per connection.
+ * Events are referred to by index, defined once per connection with EVENT.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ngf-socket.h"
+
+#define NGF_SOCKET_MAX_PACKET       (4096)
+#define NGF_SOCKET_FRAME_HEADER     (8)
+
+#define NGF_SOCKET_MSG_EVENT        (1)
+#define NGF_SOCKET_MSG_PLAY         (2)
+#define NGF_SOCKET_MSG_STOP         (3)
+#define NGF_SOCKET_MSG_PAUSE        (4)
+#define NGF_SOCKET_MSG_STATUS       (5)
+
+typedef struct _NgfSocketWriter
+{
+    uint8_t        *data;
+    size_t          size;
+    size_t          len;
+    size_t          frame;          /* offset of the frame being written */
+    int             error;          /* frame did not fit */
+} NgfSocketWriter;
+
+typedef struct _NgfSocketReader
+{
+    const uint8_t  *data;
+    size_t          len;
+    size_t          pos;
+    int             error;          /* read past the end */
+} NgfSocketReader;
+
+typedef struct _NgfSocketFrame
+{
+    uint16_t        type;
+    uint32_t        id;
+    NgfSocketReader payload;
+} NgfSocketFrame;
+
+void ngf_socket_writer_init    (NgfSocketWriter *w, uint8_t *data, size_t size);
+void ngf_socket_writer_begin   (NgfSocketWriter *w, uint16_t type, uint32_t id);
+int  ngf_socket_writer_end     (NgfSocketWriter *w);
+void ngf_socket_writer_u8      (NgfSocketWriter *w, uint8_t value);
+void ngf_socket_writer_u16     (NgfSocketWriter *w, uint16_t value);
+void ngf_socket_writer_u32     (NgfSocketWriter *w, uint32_t value);
+void ngf_socket_writer_bytes   (NgfSocketWriter *w, const void *data, size_t len);
+void ngf_socket_writer_property (NgfSocketWriter *w, const NgfSocketProperty *property);
+
+void ngf_socket_reader_init    (NgfSocketReader *r, const uint8_t *data, size_t len);
+int  ngf_socket_reader_frame   (NgfSocketReader *r, NgfSocketFrame *frame);
+uint8_t  ngf_socket_reader_u8  (NgfSocketReader *r);
+uint16_t ngf_socket_reader_u16 (NgfSocketReader *r);
+uint32_t ngf_socket_reader_u32 (NgfSocketReader *r);
+const uint8_t* ngf_socket_reader_bytes (NgfSocketReader *r, size_t len);
+
+#endif /* NGF_SOCKET_PROTOCOL_H */
@@ -74,6 +74,7 @@ typedef struct role_entry {
 } role_entry;
 
 static GHashTable *stream_restore_role_map = NULL; /* contains GSLists of role_entry structs */
+static GHashTable *role_key_patterns       = NULL; /* subscribed context key patterns */
 static GList      *transform_entries       = NULL; /* contains transform_entry entries */
 static guint       output_route_type_val   = 0;
 static NContext   *context                 = NULL;
@@ -445,6 +446,41 @@ error:
     transform_entry_free (entry);
 }
 
+static void
+subscribe_role_key (const char *key)
+{
+    const char *dot     = NULL;
+    gchar      *pattern = NULL;
+
+    /* listen to the context value changes of the whole namespace of the
+       key, e.g. "profile.**", instead of every role key one by one. keys
+       without a role are skipped in the callback. */
+
+    if ((dot = strchr (key, '.')) != NULL && dot != key)
+        pattern = g_strdup_printf ("%.*s.**", (int) (dot - key), key);
+    else
+        pattern = g_strdup (key);
+
+    if (g_hash_table_contains (role_key_patterns, pattern)) {
+        g_free (pattern);
+        return;
+    }
+
+    N_DEBUG (LOG_CAT "subscribing to context keys '%s'", pattern);
+    n_context_subscribe_value_change (context, pattern, context_value_changed_cb, NULL);
+    g_hash_table_add (role_key_patterns, pattern);
+}
+
+static void
+unsubscribe_role_key_cb (gpointer key, gpointer value, gpointer userdata)
+{
+    (void) value;
+    (void) userdata;
+
+    n_context_unsubscribe_value_change (context, (const char*) key,
+                                        context_value_changed_cb);
+}
+
 static void
 hash_table_add_cb (gpointer data, gpointer user_data)
 {
@@ -459,9 +495,7 @@ hash_table_add_cb (gpointer data, gpointer user_data)
         g_hash_table_insert (stream_restore_role_map,
                              g_strdup (c->key),
                              entries);
-
-        /* listen to the context value changes */
-        n_context_subscribe_value_change (context, c->key, context_value_changed_cb, NULL);
+        subscribe_role_key (c->key);
     }
 }
 
@@ -562,13 +596,6 @@ entry_list_free (gpointer data)
     g_slist_free_full (entries, (GDestroyNotify) role_entry_unref);
 }
 
-static void
-role_map_key_free (gpointer key)
-{
-    n_context_unsubscribe_value_change (context, key, context_value_changed_cb);
-    g_free (key);
-}
-
 N_PLUGIN_LOAD (plugin)
 {
     NCore           *core    = NULL;
@@ -578,7 +605,9 @@ N_PLUGIN_LOAD (plugin)
     context = n_core_get_context (core);
 
     stream_restore_role_map = g_hash_table_new_full (g_str_hash, g_str_equal,
-                                                     role_map_key_free, entry_list_free);
+                                                     g_free, entry_list_free);
+    role_key_patterns = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                               g_free, NULL);
 
     volume_controller_initialize ();
 
@@ -588,9 +617,12 @@ N_PLUGIN_LOAD (plugin)
     n_proplist_foreach (params, volume_add_role_key_cb, NULL);
 
     /* connect to the init done hook to query the initial values for
-       roles. */
+       roles, or query them now if the plugin is reloaded. */
 
-    n_core_connect (core, N_CORE_HOOK_INIT_DONE, 0, init_done_cb, plugin);
+    if (n_core_is_init_done (core))
+        init_done_cb (NULL, NULL, plugin);
+    else
+        n_core_connect (core, N_CORE_HOOK_INIT_DONE, 0, init_done_cb, plugin);
 
     /* listen to the context value changes */
 
@@ -619,6 +651,11 @@ N_PLUGIN_UNLOAD (plugin)
     n_context_unsubscribe_value_change (context, CONTEXT_ROUTE_OUTPUT_TYPE_KEY,
                                         context_value_changed_cb);
 
+    if (role_key_patterns) {
+        g_hash_table_foreach (role_key_patterns, unsubscribe_role_key_cb, NULL);
+        g_hash_table_destroy (role_key_patterns);
+        role_key_patterns = NULL;
+    }
     if (stream_restore_role_map) {
         g_hash_table_destroy (stream_restore_role_map);
         stream_restore_role_map = NULL;
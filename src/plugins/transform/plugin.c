@@ -70,7 +70,6 @@ new_request_cb (NHook *hook, void *data, void *userdata)
     NValue *value = NULL;
     NValue *original_value = NULL;
     gboolean allow_custom = FALSE;
-    NContext* context = NULL;
     const gchar *keyname = NULL;
     gboolean overwrite_audio = FALSE;
     const NValue *context_audio = NULL;
@@ -79,10 +78,10 @@ new_request_cb (NHook *hook, void *data, void *userdata)
     NCoreHookTransformPropertiesData *transform = (NCoreHookTransformPropertiesData*) data;
     props = (NProplist*) n_request_get_properties (transform->request);
 
-    context = n_core_get_context ((NCore*) userdata);
     keyname = query_lookup_key (transform->request);
     if (keyname) {
-        context_audio = n_context_get_value (context, keyname);
+        context_audio = n_core_get_request_context_value ((NCore*) userdata,
+            transform->request, keyname);
 
         if (context_audio && g_str_has_suffix (n_value_get_string (context_audio), NO_SOUND))
             overwrite_audio = TRUE;
@@ -174,6 +173,29 @@ parse_allowed_keys (NProplist *params)
     return TRUE;
 }
 
+/* input interfaces can skip keys that would be dropped here while parsing */
+static void
+set_request_keys (NCore *core)
+{
+    GPtrArray *keys = NULL;
+    GList     *iter = NULL;
+
+    if (transform_allow_all)
+        return;
+
+    keys = g_ptr_array_new ();
+    for (iter = g_list_first (transform_allowed_keys); iter; iter = g_list_next (iter))
+        g_ptr_array_add (keys, iter->data);
+
+    /* allowed for events with custom filenames */
+    g_ptr_array_add (keys, SOUND_FILENAME);
+    g_ptr_array_add (keys, SOUND_ENABLED);
+    g_ptr_array_add (keys, NULL);
+
+    n_core_set_request_keys (core, (const char *const *) keys->pdata);
+    g_ptr_array_free (keys, TRUE);
+}
+
 static void
 parse_transform_key_cb (const char *key, const NValue *value,
                         gpointer userdata)
@@ -238,6 +260,8 @@ N_PLUGIN_LOAD (plugin)
         return FALSE;
     }
 
+    set_request_keys (core);
+
     return TRUE;
 }
 
@@ -246,6 +270,7 @@ N_PLUGIN_UNLOAD (plugin)
     NCore *core = n_plugin_get_core (plugin);
 
     n_core_disconnect (core, N_CORE_HOOK_NEW_REQUEST, new_request_cb, core);
+    n_core_set_request_keys (core, NULL);
 
     g_list_free_full (transform_allowed_keys, g_free);
     transform_allowed_keys = NULL;
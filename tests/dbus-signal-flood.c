@@ -0,0 +1,182 @@
+/*
+ * Measure the cost of the core D-Bus signal filter under a flood of
+ * signals. A match rule that has no registered callback makes the bus
+ * deliver the flood to the filter, only every WANTED_EVERY:th signal is
+ * routed to a callback. Needs a session bus.
+ *
+ * usage: dbus-signal-flood [SIGNALS]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <glib.h>
+#include <dbus/dbus.h>
+
+#include "ngf/core.h"
+#include "ngf/core-dbus.h"
+#include "src/ngf/core-internal.h"
+
+#define FLOOD_PATH      "/org/sailfishos/ngfd/Flood"
+#define FLOOD_IFACE     "org.sailfishos.ngfd.Flood"
+#define NOISE_IFACE     "org.sailfishos.ngfd.Noise"
+#define WANTED_EVERY    (100)
+#define TIMEOUT_S       (30)
+
+static GMainLoop *loop;
+static int        wanted_count;
+
+static double
+cpu_time_us (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+}
+
+static DBusHandlerResult
+wanted_cb (NCore *core, DBusConnection *connection, DBusMessage *msg, void *userdata)
+{
+    (void) core;
+    (void) connection;
+    (void) msg;
+    (void) userdata;
+
+    wanted_count++;
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+static DBusHandlerResult
+done_cb (NCore *core, DBusConnection *connection, DBusMessage *msg, void *userdata)
+{
+    (void) core;
+    (void) connection;
+    (void) msg;
+    (void) userdata;
+
+    g_main_loop_quit (loop);
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+static gboolean
+timeout_cb (gpointer userdata)
+{
+    (void) userdata;
+
+    fprintf (stderr, "timed out waiting for signals\n");
+    g_main_loop_quit (loop);
+    return FALSE;
+}
+
+static int
+send_flood (DBusConnection *sender, int count)
+{
+    DBusMessage *msg = NULL;
+    int          i   = 0;
+
+    for (i = 0; i < count; i++) {
+        if (i % WANTED_EVERY == 0)
+            msg = dbus_message_new_signal (FLOOD_PATH, FLOOD_IFACE, "Wanted");
+        else
+            msg = dbus_message_new_signal (FLOOD_PATH, NOISE_IFACE, "Noise");
+
+        if (!msg || !dbus_connection_send (sender, msg, NULL))
+            return 0;
+        dbus_message_unref (msg);
+    }
+
+    if (!(msg = dbus_message_new_signal (FLOOD_PATH, FLOOD_IFACE, "Done")))
+        return 0;
+    dbus_connection_send (sender, msg, NULL);
+    dbus_message_unref (msg);
+    dbus_connection_flush (sender);
+
+    return 1;
+}
+
+int
+main (int argc, char *argv[])
+{
+    NCore          *core     = NULL;
+    DBusConnection *receiver = NULL;
+    DBusConnection *sender   = NULL;
+    DBusError       error;
+    guint           wanted   = 0;
+    guint           done     = 0;
+    double          start    = 0;
+    double          elapsed  = 0;
+    int             count    = 100000;
+    int             ret      = EXIT_FAILURE;
+
+    if (argc > 1)
+        count = atoi (argv[1]);
+
+    if (count <= 0) {
+        fprintf (stderr, "usage: %s [SIGNALS]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    loop = g_main_loop_new (NULL, FALSE);
+    core = n_core_new (NULL, NULL);
+
+    wanted = n_dbus_add_match (core, wanted_cb, NULL, DBUS_BUS_SESSION,
+                               FLOOD_IFACE, FLOOD_PATH, "Wanted");
+    done = n_dbus_add_match (core, done_cb, NULL, DBUS_BUS_SESSION,
+                             FLOOD_IFACE, FLOOD_PATH, "Done");
+    if (!wanted || !done) {
+        fprintf (stderr, "failed to add matches\n");
+        goto done;
+    }
+
+    /* same shared connection the core filter is installed on, blocking on
+     * the reply makes sure the earlier rules are in place as well */
+    dbus_error_init (&error);
+    receiver = dbus_bus_get (DBUS_BUS_SESSION, NULL);
+    dbus_bus_add_match (receiver, "type='signal',interface='" NOISE_IFACE "'", &error);
+    if (dbus_error_is_set (&error)) {
+        fprintf (stderr, "failed to add noise match: %s\n", error.message);
+        dbus_error_free (&error);
+        goto done;
+    }
+
+    if (!(sender = dbus_bus_get_private (DBUS_BUS_SESSION, NULL))) {
+        fprintf (stderr, "failed to connect sender\n");
+        goto done;
+    }
+
+    if (!send_flood (sender, count)) {
+        fprintf (stderr, "failed to send signals\n");
+        goto done;
+    }
+
+    g_timeout_add_seconds (TIMEOUT_S, timeout_cb, NULL);
+
+    start = cpu_time_us ();
+    g_main_loop_run (loop);
+    elapsed = cpu_time_us () - start;
+
+    printf ("%d signals, %d routed, cpu %.0f us, %.3f us per signal\n",
+            count, wanted_count, elapsed, elapsed / count);
+
+    if (wanted_count == (count + WANTED_EVERY - 1) / WANTED_EVERY)
+        ret = EXIT_SUCCESS;
+
+done:
+    if (sender) {
+        dbus_connection_close (sender);
+        dbus_connection_unref (sender);
+    }
+    if (receiver) {
+        dbus_bus_remove_match (receiver, "type='signal',interface='" NOISE_IFACE "'", NULL);
+        dbus_connection_unref (receiver);
+    }
+    if (wanted)
+        n_dbus_remove_match_by_id (core, wanted);
+    if (done)
+        n_dbus_remove_match_by_id (core, done);
+    n_core_free (core);
+    g_main_loop_unref (loop);
+
+    return ret;
+}
@@ -0,0 +1,387 @@
+/*
+ * Count Status signals delivered to D-Bus clients of ngfd. Starts a
+ * private dbus-daemon and ngfd on it, has every client play the event,
+ * and counts the Status signals each client and an idle listener receive.
+ * A round is run with all Status notifications and one with only the
+ * final ones requested. Fails if a client receives Status of requests
+ * of other clients, or notifications it has opted out of.
+ *
+ * usage: dbus-status-delivery NGFD EVENT [CLIENTS]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <glib.h>
+#include <dbus/dbus.h>
+
+#define NGF_DBUS_NAME       "com.nokia.NonGraphicFeedback1.Backend"
+#define NGF_DBUS_PATH       "/com/nokia/NonGraphicFeedback1"
+#define NGF_DBUS_IFACE      "com.nokia.NonGraphicFeedback1"
+#define NGF_FINAL_STATUS    "dbus.status.final_only"
+#define STATUS_MATCH        "type='signal',interface='" NGF_DBUS_IFACE "',member='Status'"
+
+#define STATUS_FAILED       (0)
+#define STATUS_COMPLETED    (1)
+#define STATUS_PLAYING      (2)
+#define STATUS_PAUSED       (3)
+
+#define CALL_TIMEOUT_MS     (2000)
+#define START_TIMEOUT_S     (10)
+#define PLAY_TIMEOUT_S      (5)
+#define STOP_TIMEOUT_S      (2)
+
+typedef struct _Client
+{
+    DBusConnection *connection;
+    dbus_uint32_t   id;             /* own request, 0 if none */
+    gboolean        done;           /* final status received */
+    guint           received;       /* Status signals received */
+    guint           foreign;        /* Status of requests of other clients */
+    guint           unwanted;       /* PLAYING or PAUSED after opting out */
+} Client;
+
+static GPid bus_pid;
+static GPid ngfd_pid;
+
+static void
+stop_process (GPid *pid)
+{
+    if (*pid <= 0)
+        return;
+
+    kill (*pid, SIGTERM);
+    waitpid (*pid, NULL, 0);
+    g_spawn_close_pid (*pid);
+    *pid = 0;
+}
+
+static gchar*
+start_bus (void)
+{
+    gchar   *argv[] = { "dbus-daemon", "--session", "--nofork", "--print-address", NULL };
+    GError  *error  = NULL;
+    gint     out    = -1;
+    gchar    buf[512];
+    ssize_t  len    = 0;
+    ssize_t  n      = 0;
+
+    if (!g_spawn_async_with_pipes (NULL, argv, NULL, G_SPAWN_SEARCH_PATH |
+                                   G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL,
+                                   &bus_pid, NULL, &out, NULL, &error)) {
+        fprintf (stderr, "failed to start dbus-daemon: %s\n", error->message);
+        g_error_free (error);
+        return NULL;
+    }
+
+    /* address is printed on a line of its own once the bus is ready */
+
+    while (len < (ssize_t) sizeof (buf) - 1 && !memchr (buf, '\n', len)) {
+        if ((n = read (out, buf + len, sizeof (buf) - 1 - len)) <= 0)
+            break;
+        len += n;
+    }
+
+    close (out);
+    buf[len] = '\0';
+
+    if (!memchr (buf, '\n', len)) {
+        fprintf (stderr, "failed to read bus address\n");
+        return NULL;
+    }
+
+    return g_strstrip (g_strdup (buf));
+}
+
+static gboolean
+start_ngfd (const char *ngfd, const char *address)
+{
+    gchar   *argv[] = { (gchar*) ngfd, NULL };
+    gchar  **envp   = NULL;
+    GError  *error  = NULL;
+    gboolean ret    = FALSE;
+
+    envp = g_environ_setenv (g_get_environ (), "DBUS_SYSTEM_BUS_ADDRESS",
+                             address, TRUE);
+
+    ret = g_spawn_async (NULL, argv, envp, G_SPAWN_SEARCH_PATH |
+                         G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL,
+                         &ngfd_pid, &error);
+    if (!ret) {
+        fprintf (stderr, "failed to start %s: %s\n", ngfd, error->message);
+        g_error_free (error);
+    }
+
+    g_strfreev (envp);
+
+    return ret;
+}
+
+static DBusConnection*
+connect_client (const char *address)
+{
+    DBusConnection *connection = NULL;
+    DBusError       error;
+
+    dbus_error_init (&error);
+
+    if (!(connection = dbus_connection_open_private (address, &error)))
+        goto failed;
+
+    if (!dbus_bus_register (connection, &error))
+        goto failed;
+
+    /* listen to Status the way clients did when it was broadcast */
+    dbus_bus_add_match (connection, STATUS_MATCH, &error);
+    if (dbus_error_is_set (&error))
+        goto failed;
+
+    return connection;
+
+failed:
+    fprintf (stderr, "failed to connect client: %s\n", error.message);
+    dbus_error_free (&error);
+    if (connection) {
+        dbus_connection_close (connection);
+        dbus_connection_unref (connection);
+    }
+    return NULL;
+}
+
+static gboolean
+wait_for_service (DBusConnection *connection)
+{
+    gint64 end = g_get_monotonic_time () + START_TIMEOUT_S * G_USEC_PER_SEC;
+
+    while (g_get_monotonic_time () < end) {
+        if (dbus_bus_name_has_owner (connection, NGF_DBUS_NAME, NULL))
+            return TRUE;
+        g_usleep (100000);
+    }
+
+    fprintf (stderr, "%s did not appear on the bus\n", NGF_DBUS_NAME);
+    return FALSE;
+}
+
+static dbus_uint32_t
+play (DBusConnection *connection, const char *event, gboolean final_only)
+{
+    DBusMessage     *msg   = NULL;
+    DBusMessage     *reply = NULL;
+    DBusMessageIter  iter;
+    DBusMessageIter  array;
+    DBusMessageIter  entry;
+    DBusMessageIter  variant;
+    const char      *key   = NGF_FINAL_STATUS;
+    dbus_bool_t      value = TRUE;
+    dbus_uint32_t    id    = 0;
+
+    msg = dbus_message_new_method_call (NGF_DBUS_NAME, NGF_DBUS_PATH,
+                                        NGF_DBUS_IFACE, "Play");
+    dbus_message_iter_init_append (msg, &iter);
+    dbus_message_iter_append_basic (&iter, DBUS_TYPE_STRING, &event);
+    dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY, "{sv}", &array);
+    if (final_only) {
+        dbus_message_iter_open_container (&array, DBUS_TYPE_DICT_ENTRY, NULL, &entry);
+        dbus_message_iter_append_basic (&entry, DBUS_TYPE_STRING, &key);
+        dbus_message_iter_open_container (&entry, DBUS_TYPE_VARIANT, "b", &variant);
+        dbus_message_iter_append_basic (&variant, DBUS_TYPE_BOOLEAN, &value);
+        dbus_message_iter_close_container (&entry, &variant);
+        dbus_message_iter_close_container (&array, &entry);
+    }
+    dbus_message_iter_close_container (&iter, &array);
+
+    reply = dbus_connection_send_with_reply_and_block (connection, msg,
+                                                       CALL_TIMEOUT_MS, NULL);
+    dbus_message_unref (msg);
+
+    if (!reply)
+        return 0;
+
+    (void) dbus_message_get_args (reply, NULL, DBUS_TYPE_UINT32, &id,
+                                  DBUS_TYPE_INVALID);
+    dbus_message_unref (reply);
+
+    return id;
+}
+
+static void
+stop (DBusConnection *connection, dbus_uint32_t id)
+{
+    DBusMessage *msg = NULL;
+
+    msg = dbus_message_new_method_call (NGF_DBUS_NAME, NGF_DBUS_PATH,
+                                        NGF_DBUS_IFACE, "Stop");
+    dbus_message_append_args (msg, DBUS_TYPE_UINT32, &id, DBUS_TYPE_INVALID);
+    dbus_message_set_no_reply (msg, TRUE);
+    dbus_connection_send (connection, msg, NULL);
+    dbus_connection_flush (connection);
+    dbus_message_unref (msg);
+}
+
+static void
+receive (Client *client, gboolean final_only)
+{
+    DBusMessage   *msg    = NULL;
+    dbus_uint32_t  id     = 0;
+    dbus_uint32_t  status = 0;
+
+    (void) dbus_connection_read_write (client->connection, 0);
+
+    while ((msg = dbus_connection_pop_message (client->connection))) {
+        if (dbus_message_is_signal (msg, NGF_DBUS_IFACE, "Status") &&
+            dbus_message_get_args (msg, NULL,
+                                   DBUS_TYPE_UINT32, &id,
+                                   DBUS_TYPE_UINT32, &status,
+                                   DBUS_TYPE_INVALID)) {
+            client->received++;
+
+            if (client->id == 0 || id != client->id)
+                client->foreign++;
+            else if (status == STATUS_FAILED || status == STATUS_COMPLETED)
+                client->done = TRUE;
+            else if (final_only)
+                client->unwanted++;
+        }
+        dbus_message_unref (msg);
+    }
+}
+
+static gboolean
+all_done (Client *clients, int count)
+{
+    int i = 0;
+
+    for (i = 0; i < count; i++) {
+        if (clients[i].id && !clients[i].done)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* clients[count] is the listener that does not play anything. */
+static gboolean
+run_round (Client *clients, int count, const char *event, gboolean final_only)
+{
+    gint64   end      = 0;
+    gboolean stopped  = FALSE;
+    guint    received = 0;
+    guint    foreign  = 0;
+    guint    unwanted = 0;
+    int      i        = 0;
+
+    for (i = 0; i <= count; i++) {
+        clients[i].id       = 0;
+        clients[i].done     = FALSE;
+        clients[i].received = 0;
+        clients[i].foreign  = 0;
+        clients[i].unwanted = 0;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (!(clients[i].id = play (clients[i].connection, event, final_only))) {
+            fprintf (stderr, "client %d: Play failed\n", i);
+            return FALSE;
+        }
+    }
+
+    /* long events are stopped, so that every request completes. */
+
+    end = g_get_monotonic_time () + PLAY_TIMEOUT_S * G_USEC_PER_SEC;
+    while (!all_done (clients, count)) {
+        if (g_get_monotonic_time () > end) {
+            if (stopped) {
+                fprintf (stderr, "requests did not complete\n");
+                return FALSE;
+            }
+
+            for (i = 0; i < count; i++) {
+                if (!clients[i].done)
+                    stop (clients[i].connection, clients[i].id);
+            }
+
+            stopped = TRUE;
+            end = g_get_monotonic_time () + STOP_TIMEOUT_S * G_USEC_PER_SEC;
+        }
+
+        for (i = 0; i <= count; i++)
+            receive (&clients[i], final_only);
+
+        g_usleep (1000);
+    }
+
+    /* late deliveries to the wrong client */
+
+    g_usleep (200000);
+    for (i = 0; i <= count; i++) {
+        receive (&clients[i], final_only);
+        received += clients[i].received;
+        foreign  += clients[i].foreign;
+        unwanted += clients[i].unwanted;
+    }
+
+    printf ("%-10s %d clients  %u Status received  %u by listener  %u foreign  %u opted out\n",
+            final_only ? "final only" : "all", count, received,
+            clients[count].received, foreign, unwanted);
+
+    return foreign == 0 && unwanted == 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+    Client *clients = NULL;
+    gchar  *address = NULL;
+    int     count   = 8;
+    int     ret     = EXIT_FAILURE;
+    int     i       = 0;
+
+    if (argc > 3)
+        count = atoi (argv[3]);
+
+    if (argc < 3 || count <= 0) {
+        fprintf (stderr, "usage: %s NGFD EVENT [CLIENTS]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (!(address = start_bus ()))
+        goto done;
+
+    if (!start_ngfd (argv[1], address))
+        goto done;
+
+    clients = g_new0 (Client, count + 1);
+    for (i = 0; i <= count; i++) {
+        if (!(clients[i].connection = connect_client (address)))
+            goto done;
+    }
+
+    if (!wait_for_service (clients[0].connection))
+        goto done;
+
+    if (run_round (clients, count, argv[2], FALSE) &&
+        run_round (clients, count, argv[2], TRUE))
+        ret = EXIT_SUCCESS;
+
+done:
+    if (clients) {
+        for (i = 0; i <= count; i++) {
+            if (!clients[i].connection)
+                continue;
+            dbus_connection_close (clients[i].connection);
+            dbus_connection_unref (clients[i].connection);
+        }
+        g_free (clients);
+    }
+
+    stop_process (&ngfd_pid);
+    stop_process (&bus_pid);
+    g_free (address);
+
+    return ret;
+}
@@ -0,0 +1,219 @@
+/*
+ * Compare request latency of the socket and D-Bus interfaces of a running
+ * ngfd. Measures time from sending Play to receiving PLAYING status.
+ *
+ * usage: socket-latency EVENT [ROUNDS]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <dbus/dbus.h>
+
+#include "src/plugins/socket/ngf-socket.h"
+
+#define NGF_DBUS_NAME   "com.nokia.NonGraphicFeedback1.Backend"
+#define NGF_DBUS_PATH   "/com/nokia/NonGraphicFeedback1"
+#define NGF_DBUS_IFACE  "com.nokia.NonGraphicFeedback1"
+#define POLL_TIMEOUT_MS (2000)
+
+typedef struct _Result
+{
+    double min;
+    double max;
+    double total;
+    int    count;
+} Result;
+
+static uint32_t wait_id;
+static int      wait_done;
+
+static double
+now_us (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+}
+
+static void
+result_add (Result *result, double value)
+{
+    if (result->count == 0 || value < result->min)
+        result->min = value;
+    if (value > result->max)
+        result->max = value;
+    result->total += value;
+    result->count++;
+}
+
+static void
+result_print (const char *name, const Result *result)
+{
+    if (result->count == 0) {
+        printf ("%-8s no replies\n", name);
+        return;
+    }
+
+    printf ("%-8s %4d rounds  avg %8.1f us  min %8.1f us  max %8.1f us\n", name,
+            result->count, result->total / result->count, result->min, result->max);
+}
+
+static void
+socket_status_cb (NgfSocketClient *client, uint32_t id, uint32_t status, void *userdata)
+{
+    (void) client;
+    (void) userdata;
+
+    if (id == wait_id && status != NGF_SOCKET_STATUS_PAUSED)
+        wait_done = 1;
+}
+
+static void
+measure_socket (const char *event, int rounds, Result *result)
+{
+    NgfSocketClient *client = NULL;
+    struct pollfd    pfd;
+    double           start  = 0;
+    int              i      = 0;
+
+    if (!(client = ngf_socket_client_new (NULL))) {
+        fprintf (stderr, "socket: failed to connect\n");
+        return;
+    }
+
+    ngf_socket_client_set_callback (client, socket_status_cb, NULL);
+    pfd.fd = ngf_socket_client_get_fd (client);
+    pfd.events = POLLIN;
+
+    for (i = 0; i < rounds; i++) {
+        wait_done = 0;
+        start = now_us ();
+        if (!(wait_id = ngf_socket_client_play (client, event, NULL, 0)))
+            break;
+
+        while (!wait_done) {
+            if (poll (&pfd, 1, POLL_TIMEOUT_MS) <= 0 ||
+                ngf_socket_client_dispatch (client) < 0)
+                goto done;
+        }
+
+        result_add (result, now_us () - start);
+        (void) ngf_socket_client_stop (client, wait_id);
+    }
+
+done:
+    ngf_socket_client_free (client);
+}
+
+static int
+dbus_wait_status (DBusConnection *connection, uint32_t id)
+{
+    DBusMessage   *msg    = NULL;
+    dbus_uint32_t  msg_id = 0;
+    dbus_uint32_t  status = 0;
+    int            done   = 0;
+
+    while (!done) {
+        if (!dbus_connection_read_write (connection, POLL_TIMEOUT_MS))
+            return 0;
+
+        while (!done && (msg = dbus_connection_pop_message (connection))) {
+            if (dbus_message_is_signal (msg, NGF_DBUS_IFACE, "Status") &&
+                dbus_message_get_args (msg, NULL,
+                                       DBUS_TYPE_UINT32, &msg_id,
+                                       DBUS_TYPE_UINT32, &status,
+                                       DBUS_TYPE_INVALID) &&
+                msg_id == id)
+                done = 1;
+            dbus_message_unref (msg);
+        }
+    }
+
+    return 1;
+}
+
+static void
+measure_dbus (const char *event, int rounds, Result *result)
+{
+    DBusConnection  *connection = NULL;
+    DBusMessage     *msg        = NULL;
+    DBusMessage     *reply      = NULL;
+    DBusMessageIter  iter;
+    DBusMessageIter  array;
+    dbus_uint32_t    id         = 0;
+    double           start      = 0;
+    int              i          = 0;
+
+    if (!(connection = dbus_bus_get (DBUS_BUS_SYSTEM, NULL))) {
+        fprintf (stderr, "dbus: failed to connect\n");
+        return;
+    }
+
+    for (i = 0; i < rounds; i++) {
+        start = now_us ();
+
+        msg = dbus_message_new_method_call (NGF_DBUS_NAME, NGF_DBUS_PATH,
+                                            NGF_DBUS_IFACE, "Play");
+        dbus_message_iter_init_append (msg, &iter);
+        dbus_message_iter_append_basic (&iter, DBUS_TYPE_STRING, &event);
+        dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY, "{sv}", &array);
+        dbus_message_iter_close_container (&iter, &array);
+
+        reply = dbus_connection_send_with_reply_and_block (connection, msg,
+                                                           POLL_TIMEOUT_MS, NULL);
+        dbus_message_unref (msg);
+        if (!reply)
+            break;
+
+        id = 0;
+        (void) dbus_message_get_args (reply, NULL, DBUS_TYPE_UINT32, &id,
+                                      DBUS_TYPE_INVALID);
+        dbus_message_unref (reply);
+
+        if (id == 0 || !dbus_wait_status (connection, id))
+            break;
+
+        result_add (result, now_us () - start);
+
+        msg = dbus_message_new_method_call (NGF_DBUS_NAME, NGF_DBUS_PATH,
+                                            NGF_DBUS_IFACE, "Stop");
+        dbus_message_append_args (msg, DBUS_TYPE_UINT32, &id, DBUS_TYPE_INVALID);
+        dbus_message_set_no_reply (msg, TRUE);
+        dbus_connection_send (connection, msg, NULL);
+        dbus_connection_flush (connection);
+        dbus_message_unref (msg);
+    }
+
+    dbus_connection_unref (connection);
+}
+
+int
+main (int argc, char *argv[])
+{
+    Result socket_result;
+    Result dbus_result;
+    int    rounds = 100;
+
+    if (argc < 2) {
+        fprintf (stderr, "usage: %s EVENT [ROUNDS]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (argc > 2)
+        rounds = atoi (argv[2]);
+
+    memset (&socket_result, 0, sizeof (socket_result));
+    memset (&dbus_result, 0, sizeof (dbus_result));
+
+    measure_socket (argv[1], rounds, &socket_result);
+    measure_dbus (argv[1], rounds, &dbus_result);
+
+    result_print ("socket", &socket_result);
+    result_print ("dbus", &dbus_result);
+
+    return socket_result.count > 0 && dbus_result.count > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
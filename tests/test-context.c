@@ -101,6 +101,174 @@ START_TEST (test_subscribe_unsubscribe_value_change)
 }
 END_TEST
 
+static int transaction_notify_count = 0;
+
+static void
+transaction_callback (NContext *context, const char *key, const NValue *old_value,
+                      const NValue *new_value, void *userdata)
+{
+    (void) context;
+    (void) key;
+    (void) old_value;
+    (void) userdata;
+
+    fail_unless (new_value != NULL);
+    fail_unless (n_value_get_int (new_value) == 3);
+    transaction_notify_count++;
+}
+
+START_TEST (test_transaction)
+{
+    NContext *context = NULL;
+    NValue *value = NULL;
+    int i;
+
+    context = n_context_new ();
+    fail_unless (context != NULL);
+    n_context_subscribe_value_change (context, "key", transaction_callback, NULL);
+
+    n_context_begin (context);
+    n_context_begin (context);
+    for (i = 1; i <= 3; i++) {
+        value = n_value_new ();
+        n_value_set_int (value, i);
+        n_context_set_value (context, "key", value);
+    }
+    n_context_commit (context);
+
+    /* value is visible, but notification waits for outermost commit */
+    fail_unless (n_value_get_int (n_context_get_value (context, "key")) == 3);
+    fail_unless (transaction_notify_count == 0);
+
+    n_context_commit (context);
+    fail_unless (transaction_notify_count == 1);
+
+    /* setting the same value again is not notified */
+    n_context_begin (context);
+    value = n_value_new ();
+    n_value_set_int (value, 3);
+    n_context_set_value (context, "key", value);
+    n_context_commit (context);
+    fail_unless (transaction_notify_count == 1);
+
+    /* extra commit is ignored */
+    n_context_commit (context);
+
+    n_context_free (context);
+}
+END_TEST
+
+static void
+pattern_callback (NContext *context, const char *key, const NValue *old_value,
+                  const NValue *new_value, void *userdata)
+{
+    (void) context;
+    (void) key;
+    (void) old_value;
+    (void) new_value;
+
+    (*(int*) userdata)++;
+}
+
+static void
+set_int (NContext *context, const char *key, int i)
+{
+    NValue *value = n_value_new ();
+    n_value_set_int (value, i);
+    n_context_set_value (context, key, value);
+}
+
+START_TEST (test_pattern_subscription)
+{
+    NContext *context = NULL;
+    int segment_count = 0;
+    int rest_count = 0;
+
+    context = n_context_new ();
+    fail_unless (context != NULL);
+
+    fail_unless (n_context_subscribe_value_change (context, "profile.*.volume",
+        pattern_callback, &segment_count) == TRUE);
+    fail_unless (n_context_subscribe_value_change (context, "media.**",
+        pattern_callback, &rest_count) == TRUE);
+    fail_unless (g_hash_table_size (context->keys) == 0);
+
+    set_int (context, "profile.general.volume", 1);
+    set_int (context, "profile.current.volume", 2);
+    set_int (context, "profile.general.tone", 3);
+    set_int (context, "profile.volume", 4);
+    fail_unless (segment_count == 2);
+
+    set_int (context, "media.state", 5);
+    set_int (context, "media.music.state", 6);
+    set_int (context, "media", 7);
+    fail_unless (rest_count == 2);
+
+    fail_unless (n_context_is_subscribed (context, "profile.general.volume", pattern_callback) == TRUE);
+    fail_unless (n_context_is_subscribed (context, "media.music.state", pattern_callback) == TRUE);
+    fail_unless (n_context_is_subscribed (context, "profile.volume", pattern_callback) == FALSE);
+    fail_unless (n_context_is_subscribed (context, "media", pattern_callback) == FALSE);
+
+    n_context_unsubscribe_value_change (context, "profile.*.volume", pattern_callback);
+    n_context_unsubscribe_value_change (context, "media.**", pattern_callback);
+    fail_unless (g_hash_table_size (context->patterns->children) == 0);
+
+    set_int (context, "profile.general.volume", 8);
+    fail_unless (segment_count == 2);
+
+    n_context_free (context);
+}
+END_TEST
+
+START_TEST (test_snapshot)
+{
+    NContext *context = NULL;
+    NContextSnapshot *before = NULL;
+    NContextSnapshot *during = NULL;
+    NContextSnapshot *after = NULL;
+    guint generation = 0;
+
+    context = n_context_new ();
+    fail_unless (context != NULL);
+
+    set_int (context, "a", 1);
+    set_int (context, "b", 1);
+    generation = n_context_get_generation (context);
+    fail_unless (generation == 2);
+
+    before = n_context_snapshot (context);
+    fail_unless (n_context_snapshot_get_generation (before) == generation);
+
+    n_context_begin (context);
+    set_int (context, "a", 2);
+    during = n_context_snapshot (context);
+    set_int (context, "b", 2);
+    n_context_commit (context);
+
+    /* snapshots are not affected by later changes, and one taken during
+       a transaction does not see the partial transaction. */
+    fail_unless (n_value_get_int (n_context_snapshot_get_value (before, "a")) == 1);
+    fail_unless (n_value_get_int (n_context_snapshot_get_value (during, "a")) == 1);
+    fail_unless (n_value_get_int (n_context_snapshot_get_value (during, "b")) == 1);
+    fail_unless (n_context_snapshot_get_generation (during) == generation);
+
+    /* transaction is committed as one generation */
+    fail_unless (n_context_get_generation (context) == generation + 1);
+    after = n_context_snapshot (context);
+    fail_unless (n_context_snapshot_get_generation (after) == generation + 1);
+    fail_unless (n_value_get_int (n_context_snapshot_get_value (after, "a")) == 2);
+    fail_unless (n_value_get_int (n_context_snapshot_get_value (after, "b")) == 2);
+
+    n_context_snapshot_unref (before);
+    n_context_snapshot_unref (during);
+    n_context_free (context);
+
+    /* snapshot outlives the context */
+    fail_unless (n_value_get_int (n_context_snapshot_get_value (after, "b")) == 2);
+    n_context_snapshot_unref (after);
+}
+END_TEST
+
 int
 main (int argc, char *argv[])
 {
@@ -122,6 +290,18 @@ main (int argc, char *argv[])
     tcase_add_test (tc, test_subscribe_unsubscribe_value_change);
     suite_add_tcase (s, tc);
 
+    tc = tcase_create ("transaction");
+    tcase_add_test (tc, test_transaction);
+    suite_add_tcase (s, tc);
+
+    tc = tcase_create ("pattern subscription");
+    tcase_add_test (tc, test_pattern_subscription);
+    suite_add_tcase (s, tc);
+
+    tc = tcase_create ("snapshot");
+    tcase_add_test (tc, test_snapshot);
+    suite_add_tcase (s, tc);
+
     sr = srunner_create (s);
     srunner_run_all (sr, CK_NORMAL);
     num_failed = srunner_ntests_failed (sr);
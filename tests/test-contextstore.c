@@ -0,0 +1,189 @@
+#include <stdlib.h>
+#include <check.h>
+#include <glib/gstdio.h>
+
+#include "ngf/core.h"
+#include "ngf/context.h"
+#include "src/ngf/core-internal.h"
+#include "src/ngf/contextstore-internal.h"
+
+static gchar *const persist_keys[] = { "profile.current.**", "call_state.mode", NULL };
+
+static gchar*
+state_path ()
+{
+    static gchar *path = NULL;
+
+    if (!path)
+        path = g_build_filename (g_get_tmp_dir (), "test-contextstore.state", NULL);
+
+    return path;
+}
+
+static void
+set_string (NContext *context, const char *key, const char *str)
+{
+    NValue *value = n_value_new ();
+    n_value_set_string (value, str);
+    n_context_set_value (context, key, value);
+}
+
+static void
+write_stored_state ()
+{
+    NCore         *core  = NULL;
+    NContextStore *store = NULL;
+    NContext      *context = NULL;
+
+    (void) g_unlink (state_path ());
+
+    core  = n_core_new (NULL, NULL);
+    store = n_context_store_new (core);
+    n_context_store_configure (store, state_path (), (gchar**) persist_keys, 1000, 0);
+    n_context_store_restore (store);
+
+    context = n_core_get_context (core);
+    set_string (context, "profile.current.ringing.alert.tone", "ring.wav");
+    set_string (context, "call_state.mode", "active");
+    set_string (context, "media.state", "inactive");
+
+    /* freeing flushes the pending write */
+    n_context_store_free (store);
+    n_core_free (core);
+
+    fail_unless (g_file_test (state_path (), G_FILE_TEST_EXISTS));
+}
+
+static NCore*
+restore_stored_state (guint max_age)
+{
+    NCore         *core  = NULL;
+    NContextStore *store = NULL;
+
+    core  = n_core_new (NULL, NULL);
+    store = n_context_store_new (core);
+    n_context_store_configure (store, state_path (), (gchar**) persist_keys, 1000, max_age);
+    n_context_store_restore (store);
+    n_context_store_free (store);
+
+    return core;
+}
+
+static void
+edit_stored_state (const char *key, gint64 saved, const char *boot_id)
+{
+    GKeyFile *keyfile = g_key_file_new ();
+    gchar    *data    = NULL;
+    gsize     length  = 0;
+
+    fail_unless (g_key_file_load_from_file (keyfile, state_path (), G_KEY_FILE_NONE, NULL));
+
+    if (key)
+        g_key_file_set_int64 (keyfile, "state", key, saved);
+    if (boot_id)
+        g_key_file_set_string (keyfile, "state", "boot-id", boot_id);
+
+    data = g_key_file_to_data (keyfile, &length, NULL);
+    fail_unless (g_file_set_contents (state_path (), data, length, NULL));
+
+    g_free (data);
+    g_key_file_free (keyfile);
+}
+
+START_TEST (test_restore)
+{
+    NCore    *core    = NULL;
+    NContext *context = NULL;
+
+    write_stored_state ();
+
+    core = restore_stored_state (0);
+    context = n_core_get_context (core);
+    fail_unless (g_strcmp0 (n_value_get_string ((NValue*) n_context_get_value (context,
+        "profile.current.ringing.alert.tone")), "ring.wav") == 0);
+    fail_unless (g_strcmp0 (n_value_get_string ((NValue*) n_context_get_value (context,
+        "call_state.mode")), "active") == 0);
+    fail_unless (n_context_get_value (context, "media.state") == NULL);
+    n_core_free (core);
+
+    (void) g_unlink (state_path ());
+}
+END_TEST
+
+START_TEST (test_restore_expired)
+{
+    NCore    *core    = NULL;
+    NContext *context = NULL;
+
+    write_stored_state ();
+
+    /* saved two hours ago, valid for an hour */
+    edit_stored_state ("saved", g_get_real_time () / G_USEC_PER_SEC - 7200, NULL);
+
+    core = restore_stored_state (3600);
+    context = n_core_get_context (core);
+    fail_unless (n_context_get_value (context, "call_state.mode") == NULL);
+    n_core_free (core);
+
+    /* no limit */
+    core = restore_stored_state (0);
+    context = n_core_get_context (core);
+    fail_unless (n_context_get_value (context, "call_state.mode") != NULL);
+    n_core_free (core);
+
+    (void) g_unlink (state_path ());
+}
+END_TEST
+
+START_TEST (test_restore_other_boot)
+{
+    NCore    *core    = NULL;
+    NContext *context = NULL;
+
+    if (!g_file_test ("/proc/sys/kernel/random/boot_id", G_FILE_TEST_EXISTS))
+        return;
+
+    write_stored_state ();
+    edit_stored_state (NULL, 0, "00000000-0000-0000-0000-000000000000");
+
+    core = restore_stored_state (0);
+    context = n_core_get_context (core);
+    fail_unless (n_context_get_value (context, "call_state.mode") == NULL);
+    n_core_free (core);
+
+    (void) g_unlink (state_path ());
+}
+END_TEST
+
+int
+main (int argc, char *argv[])
+{
+    (void) argc;
+    (void) argv;
+
+    int num_failed = 0;
+    Suite *s = NULL;
+    TCase *tc = NULL;
+    SRunner *sr = NULL;
+
+    s = suite_create ("\tContext store tests");
+
+    tc = tcase_create ("restore");
+    tcase_add_test (tc, test_restore);
+    suite_add_tcase (s, tc);
+
+    tc = tcase_create ("restore expired");
+    tcase_add_test (tc, test_restore_expired);
+    suite_add_tcase (s, tc);
+
+    tc = tcase_create ("restore from other boot");
+    tcase_add_test (tc, test_restore_other_boot);
+    suite_add_tcase (s, tc);
+
+    sr = srunner_create (s);
+    srunner_run_all (sr, CK_NORMAL);
+    num_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+
+    return num_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,9 +1,14 @@
 #include <stdlib.h>
 #include <check.h>
+#include <string.h>
+#include <glib/gstdio.h>
 
 #include "ngf/core.h"
 #include "src/ngf/core-internal.h"
+#include "src/ngf/plugin-internal.h"
+#include "src/ngf/core-player.h"
 #include "ngf/event.h"
+#include "ngf/worker.h"
 
 START_TEST (test_create)
 {
@@ -167,6 +172,488 @@ START_TEST (test_connect)
 }
 END_TEST
 
+static void
+count_callback (NHook *hook, void *data, void *userdata)
+{
+    (void) hook;
+    (void) data;
+
+    (*(int*) userdata)++;
+}
+
+START_TEST (test_connect_filtered)
+{
+    static const char *const events[] = { "ringtone", NULL };
+    static const char *const keys[]   = { "sound.filename", NULL };
+    NCore *core = NULL;
+    NCoreHookFilter event_filter = { events, NULL };
+    NCoreHookFilter key_filter   = { NULL, keys };
+    NCoreHookNewRequestData data;
+    NRequest *request = NULL;
+    NProplist *props = NULL;
+    int event_count = 0;
+    int key_count = 0;
+
+    core = n_core_new (NULL, NULL);
+    fail_unless (core != NULL);
+
+    /* init done carries no request */
+    fail_unless (n_core_connect_filtered (core, N_CORE_HOOK_INIT_DONE, 0,
+        &event_filter, count_callback, &event_count) == FALSE);
+
+    fail_unless (n_core_connect_filtered (core, N_CORE_HOOK_NEW_REQUEST, 0,
+        &event_filter, count_callback, &event_count) == TRUE);
+    fail_unless (n_core_connect_filtered (core, N_CORE_HOOK_NEW_REQUEST, 0,
+        &key_filter, count_callback, &key_count) == TRUE);
+
+    request = n_request_new_with_event ("ringtone");
+    data.request = request;
+    n_core_fire_hook (core, N_CORE_HOOK_NEW_REQUEST, &data);
+    n_request_free (request);
+    fail_unless (event_count == 1);
+    fail_unless (key_count == 0);
+
+    props = n_proplist_new ();
+    n_proplist_set_string (props, "sound.filename", "tone.wav");
+    request = n_request_new_with_event_and_properties ("sms", props);
+    data.request = request;
+    n_core_fire_hook (core, N_CORE_HOOK_NEW_REQUEST, &data);
+    n_request_free (request);
+    n_proplist_free (props);
+    fail_unless (event_count == 1);
+    fail_unless (key_count == 1);
+
+    n_core_disconnect (core, N_CORE_HOOK_NEW_REQUEST, count_callback, &event_count);
+    n_core_disconnect (core, N_CORE_HOOK_NEW_REQUEST, count_callback, &key_count);
+    fail_unless (core->hooks[N_CORE_HOOK_NEW_REQUEST].slots == NULL);
+
+    n_core_free (core);
+}
+END_TEST
+
+typedef struct _WorkRecord
+{
+    GThread   *main_thread;
+    GThread   *work_thread;
+    GMainLoop *loop;
+    GString   *order;
+    guint      pending;
+    gboolean   done_in_main;
+} WorkRecord;
+
+static gboolean
+record_work (gpointer userdata)
+{
+    WorkRecord *record = (WorkRecord*) userdata;
+    record->work_thread = g_thread_self ();
+    return TRUE;
+}
+
+static void
+record_done (gboolean result, gpointer userdata)
+{
+    WorkRecord *record = (WorkRecord*) userdata;
+    fail_unless (result == TRUE);
+    record->done_in_main = (g_thread_self () == record->main_thread);
+    if (--record->pending == 0)
+        g_main_loop_quit (record->loop);
+}
+
+typedef struct _OrderItem
+{
+    WorkRecord *record;
+    char        tag;
+} OrderItem;
+
+static gboolean
+order_work (gpointer userdata)
+{
+    (void) userdata;
+    g_usleep (1000);
+    return TRUE;
+}
+
+static void
+order_done (gboolean result, gpointer userdata)
+{
+    OrderItem *item = (OrderItem*) userdata;
+    (void) result;
+    g_string_append_c (item->record->order, item->tag);
+    if (--item->record->pending == 0)
+        g_main_loop_quit (item->record->loop);
+}
+
+START_TEST (test_push_work)
+{
+    static const char *queue = "queue";
+    NCore      *core   = NULL;
+    WorkRecord  record;
+    OrderItem   items[3] = { { &record, 'a' }, { &record, 'b' }, { &record, 'c' } };
+    guint       i      = 0;
+
+    core = n_core_new (NULL, NULL);
+    fail_unless (core != NULL);
+
+    memset (&record, 0, sizeof (record));
+    record.main_thread = g_thread_self ();
+    record.loop        = g_main_loop_new (NULL, FALSE);
+    record.order       = g_string_new (NULL);
+
+    /* work runs in a worker thread, completion in the main loop */
+    record.pending = 1;
+    fail_unless (n_core_push_work (core, NULL, record_work, record_done,
+        &record, NULL) > 0);
+    fail_unless (record.done_in_main == FALSE);
+    g_main_loop_run (record.loop);
+    fail_unless (record.work_thread != NULL);
+    fail_unless (record.work_thread != record.main_thread);
+    fail_unless (record.done_in_main == TRUE);
+
+    /* work of the same queue completes in the order it was pushed */
+    record.pending = 3;
+    for (i = 0; i < 3; ++i)
+        fail_unless (n_core_push_work (core, queue, order_work, order_done,
+            &items[i], NULL) > 0);
+    g_main_loop_run (record.loop);
+    fail_unless (g_str_equal (record.order->str, "abc"));
+
+    g_string_free (record.order, TRUE);
+    g_main_loop_unref (record.loop);
+    n_core_free (core);
+}
+END_TEST
+
+static void
+write_plugin_conf (const char *filename, const char *value)
+{
+    gchar *data = g_strdup_printf ("[lazytest]\nvalue = %s\n", value);
+    fail_unless (g_file_set_contents (filename, data, -1, NULL));
+    g_free (data);
+}
+
+START_TEST (test_plugin_conf_released)
+{
+    NCore       *core     = NULL;
+    NLazyPlugin *lazy     = NULL;
+    gchar       *conf_dir = NULL;
+    gchar       *plugin_d = NULL;
+    gchar       *filename = NULL;
+
+    core = n_core_new (NULL, NULL);
+    fail_unless (core != NULL);
+
+    conf_dir = g_dir_make_tmp ("test-core-XXXXXX", NULL);
+    fail_unless (conf_dir != NULL);
+    plugin_d = g_build_filename (conf_dir, "plugins.d", NULL);
+    fail_unless (g_mkdir (plugin_d, 0700) == 0);
+    filename = g_build_filename (plugin_d, "50-lazytest.ini", NULL);
+    write_plugin_conf (filename, "1");
+
+    g_free (core->conf_path);
+    core->conf_path = g_strdup (conf_dir);
+
+    lazy = g_new0 (NLazyPlugin, 1);
+    lazy->name = g_strdup ("lazytest");
+    core->lazy_plugins = g_list_append (NULL, lazy);
+
+    /* parameters are read from the files of the plugin, the index of
+       all plugins is not kept around */
+    fail_unless (n_core_reload_plugin (core, "lazytest") == TRUE);
+    fail_unless (lazy->params != NULL);
+    fail_unless (g_strcmp0 (n_proplist_get_string (lazy->params, "value"), "1") == 0);
+    fail_unless (core->plugin_conf == NULL);
+
+    /* and reloading all of them releases it once done */
+    write_plugin_conf (filename, "2");
+    n_core_reload_changed_plugins (core);
+    fail_unless (g_strcmp0 (n_proplist_get_string (lazy->params, "value"), "2") == 0);
+    fail_unless (core->plugin_conf == NULL);
+
+    (void) g_unlink (filename);
+    (void) g_rmdir (plugin_d);
+    (void) g_rmdir (conf_dir);
+    g_free (filename);
+    g_free (plugin_d);
+    g_free (conf_dir);
+    n_core_free (core);
+}
+END_TEST
+
+START_TEST (test_request_keys)
+{
+    NCore    *core    = NULL;
+    GKeyFile *keyfile = NULL;
+    int       type    = -1;
+    static const char *const keys[] = { "sound.filename", NULL };
+
+    core = n_core_new (NULL, NULL);
+    fail_unless (core != NULL);
+
+    /* all keys are accepted until told otherwise */
+    fail_unless (n_core_lookup_request_key (core, "any.key", &type) == TRUE);
+    fail_unless (type == 0);
+
+    keyfile = g_key_file_new ();
+    g_key_file_set_value (keyfile, "sms => play.mode=short,context@profile.current_profile=meeting",
+        "sink.null", "true");
+    n_event_list_parse_keyfile (core->eventlist, keyfile);
+    g_key_file_free (keyfile);
+
+    /* keys event rules match requests with are accepted, context keys
+       are not request keys */
+    n_core_set_request_keys (core, keys);
+    fail_unless (n_core_lookup_request_key (core, "sound.filename", &type) == TRUE);
+    fail_unless (n_core_lookup_request_key (core, "play.mode", &type) == TRUE);
+    fail_unless (n_core_lookup_request_key (core, "profile.current_profile", &type) == FALSE);
+    fail_unless (n_core_lookup_request_key (core, "any.key", &type) == FALSE);
+
+    n_core_set_request_keys (core, NULL);
+    fail_unless (n_core_lookup_request_key (core, "any.key", &type) == TRUE);
+
+    n_core_free (core);
+}
+END_TEST
+
+typedef struct _LookupThread
+{
+    NCore    *core;
+    gint      stop;
+    gint      lookups;
+    gboolean  failed;
+} LookupThread;
+
+/* parses keys the way the D-Bus dispatch thread does for Play */
+static gpointer
+lookup_thread_func (gpointer userdata)
+{
+    LookupThread *data = userdata;
+    int           type = 0;
+
+    while (!g_atomic_int_get (&data->stop)) {
+        /* the configured key is accepted whatever the table is */
+        if (!n_core_lookup_request_key (data->core, "sound.filename", &type))
+            data->failed = TRUE;
+        (void) n_core_lookup_request_key (data->core, "any.key", &type);
+        g_atomic_int_inc (&data->lookups);
+    }
+
+    return NULL;
+}
+
+START_TEST (test_request_keys_threaded)
+{
+    LookupThread  data;
+    GThread      *thread = NULL;
+    int           i;
+    static const char *const keys[] = { "sound.filename", NULL };
+
+    memset (&data, 0, sizeof (data));
+    data.core = n_core_new (NULL, NULL);
+    fail_unless (data.core != NULL);
+
+    thread = g_thread_new ("lookup", lookup_thread_func, &data);
+
+    /* the transform plugin sets and clears the keys when it is loaded and
+       unloaded, reloading it swaps the table under the lookups */
+    for (i = 0; i < 2000 || g_atomic_int_get (&data.lookups) == 0; i++) {
+        n_core_set_request_keys (data.core, keys);
+        n_core_set_request_keys (data.core, NULL);
+    }
+
+    g_atomic_int_set (&data.stop, 1);
+    g_thread_join (thread);
+
+    fail_unless (data.failed == FALSE);
+    fail_unless (data.lookups > 0);
+
+    n_core_free (data.core);
+}
+END_TEST
+
+static void
+set_context_string (NCore *core, const char *key, const char *str)
+{
+    NValue *value = n_value_new ();
+
+    n_value_set_string (value, str);
+    n_context_set_value (n_core_get_context (core), key, value);
+}
+
+/* copies a context value into the properties like the profile plugin */
+static void
+prepared_transform_cb (NHook *hook, void *data, void *userdata)
+{
+    NCoreHookTransformPropertiesData *transform = data;
+    const NValue                     *value     = NULL;
+
+    (void) hook;
+
+    value = n_core_get_request_context_value ((NCore*) userdata,
+        transform->request, "profile.current.sms.tone");
+    if (value)
+        n_proplist_set (transform->request->properties, "sound.filename",
+            n_value_copy (value));
+}
+
+START_TEST (test_prepared_context_keys)
+{
+    NCore            *core     = NULL;
+    GKeyFile         *keyfile  = NULL;
+    NPreparedRequest *prepared = NULL;
+    NEvent           *event    = NULL;
+    guint             serial   = 0;
+
+    core = n_core_new (NULL, NULL);
+    fail_unless (core != NULL);
+    core->sinks = g_new0 (NSinkInterface*, 1);
+
+    keyfile = g_key_file_new ();
+    g_key_file_set_value (keyfile, "sms", "sound.filename", "default.wav");
+    g_key_file_set_value (keyfile, "sms => context@profile.current_profile=meeting",
+        "sound.filename", "meeting.wav");
+    n_event_list_parse_keyfile (core->eventlist, keyfile);
+    g_key_file_free (keyfile);
+
+    fail_unless (n_core_connect (core, N_CORE_HOOK_TRANSFORM_PROPERTIES, 0,
+        prepared_transform_cb, core) == TRUE);
+
+    set_context_string (core, "profile.current_profile", "general");
+    set_context_string (core, "profile.current.sms.tone", "first.wav");
+
+    prepared = n_prepared_request_new (n_request_new_with_event ("sms"));
+    fail_unless (n_core_update_prepared (core, prepared) == TRUE);
+    fail_unless (prepared->context_keys != NULL);
+    fail_unless (g_strv_length (prepared->context_keys) == 2);
+    fail_unless (g_strcmp0 (n_proplist_get_string (prepared->properties,
+        "sound.filename"), "first.wav") == 0);
+    event  = prepared->event;
+    serial = prepared->context_serial;
+
+    /* keys neither rules nor hooks read keep the prepared request */
+    set_context_string (core, "battery.level", "low");
+    fail_unless (n_core_update_prepared (core, prepared) == TRUE);
+    fail_unless (prepared->event == event);
+    fail_unless (prepared->context_serial == serial);
+
+    /* a key a hook reads transforms the properties again */
+    set_context_string (core, "profile.current.sms.tone", "second.wav");
+    fail_unless (n_core_update_prepared (core, prepared) == TRUE);
+    fail_unless (prepared->context_serial != serial);
+    fail_unless (g_strcmp0 (n_proplist_get_string (prepared->properties,
+        "sound.filename"), "second.wav") == 0);
+    serial = prepared->context_serial;
+
+    /* setting the same value is not a change */
+    set_context_string (core, "profile.current_profile", "general");
+    fail_unless (n_core_update_prepared (core, prepared) == TRUE);
+    fail_unless (prepared->context_serial == serial);
+
+    /* a key of a rule resolves the request again */
+    set_context_string (core, "profile.current_profile", "meeting");
+    fail_unless (n_core_update_prepared (core, prepared) == TRUE);
+    fail_unless (prepared->event != event);
+    fail_unless (prepared->context_serial != serial);
+
+    n_prepared_request_unref (prepared);
+    n_core_free (core);
+}
+END_TEST
+
+typedef struct _ReloadRecord
+{
+    GMainLoop *loop;
+    NCore     *core;
+    gboolean   work_done;
+    gboolean   unloaded;
+    gboolean   done_before_unload;
+} ReloadRecord;
+
+static ReloadRecord reload_record;
+
+static const char*
+reload_plugin_name ()
+{
+    return "TEST_RELOAD";
+}
+
+static void
+reload_plugin_unload (NPlugin *plugin)
+{
+    (void) plugin;
+    reload_record.unloaded           = TRUE;
+    reload_record.done_before_unload = reload_record.work_done;
+}
+
+static gboolean
+reload_work (gpointer userdata)
+{
+    (void) userdata;
+    g_usleep (200000);
+    return TRUE;
+}
+
+static void
+reload_work_done (gboolean result, gpointer userdata)
+{
+    (void) result;
+    (void) userdata;
+    reload_record.work_done = TRUE;
+}
+
+static gboolean
+reload_check_cb (gpointer userdata)
+{
+    (void) userdata;
+
+    if (reload_record.core->reloads)
+        return TRUE;
+
+    g_main_loop_quit (reload_record.loop);
+    return FALSE;
+}
+
+START_TEST (test_reload_waits_for_work)
+{
+    NCore   *core   = NULL;
+    NPlugin *plugin = NULL;
+
+    core = n_core_new (NULL, NULL);
+    fail_unless (core != NULL);
+    g_free (core->plugin_path);
+    core->plugin_path = g_strdup ("/nonexistent");
+
+    plugin = g_new0 (NPlugin, 1);
+    plugin->core     = core;
+    plugin->get_name = reload_plugin_name;
+    plugin->unload   = reload_plugin_unload;
+    core->plugins    = g_list_append (NULL, plugin);
+
+    memset (&reload_record, 0, sizeof (reload_record));
+    reload_record.loop = g_main_loop_new (NULL, FALSE);
+    reload_record.core = core;
+
+    /* completion of pending work may use the plugin, so the plugin is
+       unloaded only after it */
+    fail_unless (n_core_push_work (core, NULL, reload_work, reload_work_done,
+        NULL, NULL) > 0);
+    fail_unless (n_core_reload_plugin (core, "TEST_RELOAD") == TRUE);
+    fail_unless (reload_record.unloaded == FALSE);
+
+    g_timeout_add (10, reload_check_cb, NULL);
+    g_main_loop_run (reload_record.loop);
+
+    fail_unless (reload_record.work_done == TRUE);
+    fail_unless (reload_record.unloaded == TRUE);
+    fail_unless (reload_record.done_before_unload == TRUE);
+
+    /* plugin is not available from the path anymore */
+    fail_unless (core->plugins == NULL);
+
+    g_main_loop_unref (reload_record.loop);
+    n_core_free (core);
+}
+END_TEST
+
 int
 main (int argc, char *argv[])
 {
@@ -199,6 +686,34 @@ main (int argc, char *argv[])
     tc = tcase_create ("connect/disconnect callback to/from hook");
     tcase_add_test (tc, test_connect);
     suite_add_tcase (s, tc);
+
+    tc = tcase_create ("connect filtered callback to hook");
+    tcase_add_test (tc, test_connect_filtered);
+    suite_add_tcase (s, tc);
+
+    tc = tcase_create ("push work to worker threads");
+    tcase_add_test (tc, test_push_work);
+    suite_add_tcase (s, tc);
+
+    tc = tcase_create ("request keys");
+    tcase_add_test (tc, test_request_keys);
+    suite_add_tcase (s, tc);
+
+    tc = tcase_create ("request keys looked up from another thread");
+    tcase_add_test (tc, test_request_keys_threaded);
+    suite_add_tcase (s, tc);
+
+    tc = tcase_create ("prepared request context keys");
+    tcase_add_test (tc, test_prepared_context_keys);
+    suite_add_tcase (s, tc);
+
+    tc = tcase_create ("plugin reload waits for work");
+    tcase_add_test (tc, test_reload_waits_for_work);
+    suite_add_tcase (s, tc);
+
+    tc = tcase_create ("plugin configuration released");
+    tcase_add_test (tc, test_plugin_conf_released);
+    suite_add_tcase (s, tc);
     
     sr = srunner_create (s);
     srunner_run_all (sr, CK_NORMAL);
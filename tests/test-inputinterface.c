@@ -143,6 +143,87 @@ START_TEST (test_play_pause_request)
 }
 END_TEST
 
+static int can_handle_count;
+
+static int
+plugin_can_handle (NSinkInterface *iface, NRequest *request)
+{
+    (void) iface;
+    (void) request;
+
+    can_handle_count++;
+    return TRUE;
+}
+
+START_TEST (test_prepared_request)
+{
+    static const NSinkInterfaceDecl decl = {
+        .name       = "unit_test_prepared_SINK",
+        .initialize = NULL,
+        .shutdown   = NULL,
+        .can_handle = plugin_can_handle,
+        .prepare    = plugin_prepare,
+        .play       = plugin_play,
+        .pause      = plugin_pause,
+        .stop       = plugin_stop
+    };
+
+    NInputInterface *iface = NULL;
+    iface = g_new0 (NInputInterface, 1);
+    fail_unless (iface != NULL);
+    NCore *core = n_core_new (NULL, NULL);
+    const char *event_name = "testing_event";
+
+    GKeyFile *keyfile = NULL;
+    keyfile = g_key_file_new ();
+    g_key_file_set_value (keyfile, event_name, "sink.null", "true");
+    n_event_list_parse_keyfile (core->eventlist, keyfile);
+    g_key_file_free (keyfile);
+
+    NPlugin *plugin = g_new0 (NPlugin, 1);
+    fail_unless (plugin != NULL);
+    plugin->core = core;
+    n_plugin_register_sink (plugin, &decl);
+    core->sinks[0]->init_state = N_SINK_INIT_READY;
+    iface->core = core;
+
+    NPreparedRequest *prepared = NULL;
+    NRequest *first = NULL;
+    NRequest *second = NULL;
+    Data *data = NULL;
+    can_handle_count = 0;
+    /* prepare resolves the event and sinks once */
+    fail_unless (n_input_interface_prepare_request (NULL, NULL) == NULL);
+    fail_unless (n_input_interface_prepare_request (iface,
+        n_request_new_with_event ("no_such_event")) == NULL);
+    prepared = n_input_interface_prepare_request (iface,
+        n_request_new_with_event (event_name));
+    fail_unless (prepared != NULL);
+    fail_unless (can_handle_count == 1);
+    /* requests from the same handle reuse the result */
+    first = n_input_interface_new_prepared_request (iface, prepared);
+    second = n_input_interface_new_prepared_request (iface, prepared);
+    fail_unless (first != NULL && second != NULL);
+    fail_unless (n_request_get_id (first) != n_request_get_id (second));
+    fail_unless (n_input_interface_play_request (iface, first) == TRUE);
+    fail_unless (n_input_interface_play_request (iface, second) == TRUE);
+    fail_unless (can_handle_count == 1);
+    data = (Data*) n_request_get_data (first, DATA_KEY);
+    fail_unless (data->state == PREPARED);
+    /* context change resolves the handle again on next play */
+    NValue *value = n_value_new ();
+    n_value_set_int (value, 1);
+    n_context_set_value (core->context, "unit_test.key", value);
+    fail_unless (n_input_interface_play_request (iface,
+        n_input_interface_new_prepared_request (iface, prepared)) == TRUE);
+    fail_unless (can_handle_count == 2);
+
+    n_input_interface_release_prepared (iface, prepared);
+    g_free (iface);
+    iface = NULL;
+}
+END_TEST
+
 int
 main (int argc, char *argv[])
 {
@@ -164,6 +245,10 @@ main (int argc, char *argv[])
     tcase_add_test (tc, test_play_pause_request);
     suite_add_tcase (s, tc);
 
+    tc = tcase_create ("prepared request");
+    tcase_add_test (tc, test_prepared_request);
+    suite_add_tcase (s, tc);
+
     sr = srunner_create (s);
     srunner_run_all (sr, CK_NORMAL);
     num_failed = srunner_ntests_failed (sr);
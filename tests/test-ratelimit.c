@@ -0,0 +1,186 @@
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+#include <glib.h>
+
+#include "src/plugins/dbus/ratelimit.h"
+
+/* first take of a bucket, 0 marks a bucket never used */
+#define START (G_USEC_PER_SEC)
+
+START_TEST (test_burst)
+{
+    DBusRateLimit  *limit = NULL;
+    DBusRateBucket  buckets[1] = { { 0, 0 } };
+    int             i;
+
+    limit = rate_limit_new ();
+    fail_unless (rate_limit_add_class (limit, NULL, "10/5"));
+
+    /* a new bucket is full, burst takes succeed at once */
+    for (i = 0; i < 5; i++)
+        fail_unless (rate_limit_take (limit, buckets, "ringtone", START));
+
+    fail_unless (!rate_limit_take (limit, buckets, "ringtone", START));
+    fail_unless (rate_limit_get_class (limit, 0)->throttled == 1);
+
+    rate_limit_free (limit);
+}
+END_TEST
+
+START_TEST (test_refill)
+{
+    DBusRateLimit  *limit = NULL;
+    DBusRateBucket  buckets[1] = { { 0, 0 } };
+    gint64          step  = G_USEC_PER_SEC / 10;
+    gint64          now   = START;
+    int             i;
+
+    limit = rate_limit_new ();
+    fail_unless (rate_limit_add_class (limit, NULL, "10/2"));
+
+    fail_unless (rate_limit_take (limit, buckets, "sms", now));
+    fail_unless (rate_limit_take (limit, buckets, "sms", now));
+    fail_unless (!rate_limit_take (limit, buckets, "sms", now));
+
+    /* less than a token refilled */
+    now += step / 2;
+    fail_unless (!rate_limit_take (limit, buckets, "sms", now));
+
+    /* one token per 1/RATE seconds */
+    now += step / 2;
+    fail_unless (rate_limit_take (limit, buckets, "sms", now));
+    fail_unless (!rate_limit_take (limit, buckets, "sms", now));
+
+    /* refill is capped at burst however long the bucket is idle */
+    now += 60 * G_USEC_PER_SEC;
+    for (i = 0; i < 2; i++)
+        fail_unless (rate_limit_take (limit, buckets, "sms", now));
+    fail_unless (!rate_limit_take (limit, buckets, "sms", now));
+
+    fail_unless (rate_limit_get_class (limit, 0)->throttled == 4);
+
+    rate_limit_free (limit);
+}
+END_TEST
+
+START_TEST (test_classes)
+{
+    DBusRateLimit  *limit = NULL;
+    DBusRateBucket  buckets[4];
+    int             i;
+
+    memset (buckets, 0, sizeof (buckets));
+
+    limit = rate_limit_new ();
+    fail_unless (rate_limit_add_class (limit, NULL, "1"));
+    fail_unless (rate_limit_add_class (limit, "*tacticon", "3/3"));
+    fail_unless (rate_limit_add_class (limit, "strong_tacticon", "0"));
+    fail_unless (rate_limit_add_class (limit, "*", "2"));
+    fail_unless (rate_limit_num_classes (limit) == 4);
+
+    /* BURST defaults to RATE */
+    fail_unless (rate_limit_get_class (limit, 0)->burst == 1);
+    fail_unless (rate_limit_get_class (limit, 3)->burst == 2);
+
+    /* longest matching pattern wins over shorter ones and the default */
+    fail_unless (rate_limit_class_for_event (limit, "feedback_tacticon") == 1);
+    fail_unless (rate_limit_class_for_event (limit, "strong_tacticon") == 2);
+    fail_unless (rate_limit_class_for_event (limit, "ringtone") == 3);
+
+    /* classes have buckets of their own */
+    for (i = 0; i < 3; i++)
+        fail_unless (rate_limit_take (limit, buckets, "feedback_tacticon", START));
+    fail_unless (!rate_limit_take (limit, buckets, "feedback_tacticon", START));
+    fail_unless (rate_limit_take (limit, buckets, "ringtone", START));
+    fail_unless (rate_limit_take (limit, buckets, "ringtone", START));
+    fail_unless (!rate_limit_take (limit, buckets, "ringtone", START));
+
+    /* rate 0 is not limited */
+    for (i = 0; i < 100; i++)
+        fail_unless (rate_limit_take (limit, buckets, "strong_tacticon", START));
+
+    fail_unless (rate_limit_get_class (limit, 0)->throttled == 0);
+    fail_unless (rate_limit_get_class (limit, 1)->throttled == 1);
+    fail_unless (rate_limit_get_class (limit, 2)->throttled == 0);
+    fail_unless (rate_limit_get_class (limit, 3)->throttled == 1);
+
+    rate_limit_free (limit);
+}
+END_TEST
+
+START_TEST (test_default_class)
+{
+    DBusRateLimit  *limit = NULL;
+    DBusRateBucket  buckets[2];
+
+    memset (buckets, 0, sizeof (buckets));
+
+    /* no classes, nothing is limited */
+    limit = rate_limit_new ();
+    fail_unless (rate_limit_class_for_event (limit, "ringtone") == -1);
+    fail_unless (rate_limit_take (limit, buckets, "ringtone", START));
+
+    /* events not matching a pattern fall back to the default class */
+    fail_unless (rate_limit_add_class (limit, "*tacticon", "5"));
+    fail_unless (rate_limit_class_for_event (limit, "ringtone") == -1);
+    fail_unless (rate_limit_add_class (limit, NULL, "1"));
+    fail_unless (rate_limit_class_for_event (limit, "ringtone") == 1);
+
+    fail_unless (rate_limit_take (limit, buckets, "ringtone", START));
+    fail_unless (!rate_limit_take (limit, buckets, "ringtone", START));
+    fail_unless (rate_limit_take (limit, buckets, "tacticon", START));
+
+    rate_limit_free (limit);
+}
+END_TEST
+
+START_TEST (test_invalid_spec)
+{
+    DBusRateLimit *limit = NULL;
+
+    limit = rate_limit_new ();
+    fail_unless (!rate_limit_add_class (limit, NULL, NULL));
+    fail_unless (!rate_limit_add_class (limit, NULL, ""));
+    fail_unless (!rate_limit_add_class (limit, "*", "fast"));
+    fail_unless (rate_limit_num_classes (limit) == 0);
+
+    /* burst of 0 falls back to rate */
+    fail_unless (rate_limit_add_class (limit, NULL, "4/0"));
+    fail_unless (rate_limit_get_class (limit, 0)->burst == 4);
+
+    rate_limit_free (limit);
+}
+END_TEST
+
+int
+main (int argc, char *argv[])
+{
+    (void) argc;
+    (void) argv;
+
+    int num_failed = 0;
+    Suite *s = NULL;
+    TCase *tc = NULL;
+    SRunner *sr = NULL;
+
+    s = suite_create ("\tD-Bus rate limit tests");
+
+    tc = tcase_create ("tokens");
+    tcase_add_test (tc, test_burst);
+    tcase_add_test (tc, test_refill);
+    suite_add_tcase (s, tc);
+
+    tc = tcase_create ("classes");
+    tcase_add_test (tc, test_classes);
+    tcase_add_test (tc, test_default_class);
+    tcase_add_test (tc, test_invalid_spec);
+    suite_add_tcase (s, tc);
+
+    sr = srunner_create (s);
+    srunner_run_all (sr, CK_NORMAL);
+    num_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+
+    return num_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -47,6 +47,18 @@ START_TEST (test_create)
     proplist = NULL;
     n_request_free (request);
     request = NULL;
+
+    /* request takes ownership of proplist */
+    proplist = n_proplist_new ();
+    n_proplist_set_int (proplist, key, value);
+    request = n_request_new_with_event_take_properties (event, proplist);
+    fail_unless (request != NULL);
+    fail_unless (n_request_get_properties (request) == proplist);
+    n_request_free (request);
+    request = NULL;
+    proplist = NULL;
+
+    fail_unless (n_request_new_with_event_take_properties (NULL, n_proplist_new ()) == NULL);
 }
 END_TEST
 
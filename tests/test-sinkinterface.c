@@ -5,6 +5,8 @@
 #include "ngf/sinkinterface.h"
 //#include "src/ngf/sinkinterface-internal.h"
 #include "src/ngf/request-internal.h"
+#include "src/ngf/inputinterface-internal.h"
+#include "src/ngf/plugin-internal.h"
 #include "src/ngf/core-player.c"
 
 
@@ -399,6 +401,907 @@ START_TEST (test_fail)
 }
 END_TEST
 
+#define SYNC_AUDIO_LATENCY_MS   (60)
+#define SYNC_VIBRA_LATENCY_MS   (10)
+#define SYNC_TOLERANCE_US       (10000)
+
+static GMainLoop *sync_loop  = NULL;
+static guint      sync_plays = 0;
+
+static int
+sync_prepare (NSinkInterface *iface, NRequest *request)
+{
+    (void) iface;
+    (void) request;
+    return TRUE;
+}
+
+static int
+sync_play (NSinkInterface *iface, NRequest *request)
+{
+    (void) request;
+    gint64 *played = (gint64*) iface->userdata;
+    *played = g_get_monotonic_time ();
+    if (++sync_plays == 2)
+        g_main_loop_quit (sync_loop);
+    return TRUE;
+}
+
+static void
+sync_stop (NSinkInterface *iface, NRequest *request)
+{
+    (void) iface;
+    (void) request;
+}
+
+static guint
+sync_audio_latency (NSinkInterface *iface, NRequest *request)
+{
+    (void) iface;
+    (void) request;
+    return SYNC_AUDIO_LATENCY_MS;
+}
+
+static guint
+sync_vibra_latency (NSinkInterface *iface, NRequest *request)
+{
+    (void) iface;
+    (void) request;
+    return SYNC_VIBRA_LATENCY_MS;
+}
+
+static gboolean
+sync_guard_cb (gpointer userdata)
+{
+    (void) userdata;
+    g_main_loop_quit (sync_loop);
+    return FALSE;
+}
+
+START_TEST (test_synchronized_start)
+{
+    static const NSinkInterfaceDecl audio_decl = {
+        .name       = "TEST_SYNC_audio",
+        .prepare    = sync_prepare,
+        .play       = sync_play,
+        .stop       = sync_stop,
+        .latency    = sync_audio_latency
+    };
+    static const NSinkInterfaceDecl vibra_decl = {
+        .name       = "TEST_SYNC_vibra",
+        .prepare    = sync_prepare,
+        .play       = sync_play,
+        .stop       = sync_stop,
+        .latency    = sync_vibra_latency
+    };
+
+    gint64 audio_played = 0;
+    gint64 vibra_played = 0;
+    gint64 audio_output = 0;
+    gint64 vibra_output = 0;
+    guint  guard_id     = 0;
+
+    NCore *core = n_core_new (NULL, NULL);
+    fail_unless (core != NULL);
+
+    NSinkInterface *audio = g_new0 (NSinkInterface, 1);
+    audio->name     = audio_decl.name;
+    audio->core     = core;
+    audio->funcs    = audio_decl;
+    audio->userdata = &audio_played;
+
+    NSinkInterface *vibra = g_new0 (NSinkInterface, 1);
+    vibra->name     = vibra_decl.name;
+    vibra->core     = core;
+    vibra->funcs    = vibra_decl;
+    vibra->userdata = &vibra_played;
+
+    NRequest *request = n_request_new ();
+    request->name = g_strdup ("TEST_SYNC_REQUEST_name");
+    request->core = core;
+
+    /* vibra is first in the list, but it must not start before audio. */
+    request->sinks_prepared = g_list_append (request->sinks_prepared, vibra);
+    request->sinks_prepared = g_list_append (request->sinks_prepared, audio);
+
+    sync_loop  = g_main_loop_new (NULL, FALSE);
+    sync_plays = 0;
+
+    n_core_sink_synchronize_done_cb (request);
+
+    /* highest latency sink is played immediately, the other one is delayed */
+    fail_unless (sync_plays == 1);
+    fail_unless (audio_played > 0);
+    fail_unless (vibra_played == 0);
+    fail_unless (request->sinks_prepared == NULL);
+    fail_unless (g_list_length (request->sinks_playing) == 2);
+    fail_unless (g_list_length (request->play_delays) == 1);
+
+    guard_id = g_timeout_add (1000, sync_guard_cb, NULL);
+    g_main_loop_run (sync_loop);
+    g_source_remove (guard_id);
+
+    fail_unless (sync_plays == 2);
+    fail_unless (request->play_delays == NULL);
+
+    /* output of both sinks starts at the same target time */
+    audio_output = audio_played + SYNC_AUDIO_LATENCY_MS * 1000;
+    vibra_output = vibra_played + SYNC_VIBRA_LATENCY_MS * 1000;
+    fail_unless (vibra_played > audio_played);
+    fail_unless (ABS (audio_output - vibra_output) < SYNC_TOLERANCE_US);
+
+    /* stopping the request cancels pending delayed plays */
+    g_list_free (request->sinks_playing);
+    request->sinks_playing  = NULL;
+    request->sinks_prepared = g_list_append (request->sinks_prepared, vibra);
+    request->sinks_prepared = g_list_append (request->sinks_prepared, audio);
+    sync_plays = 0;
+
+    n_core_sink_synchronize_done_cb (request);
+    fail_unless (g_list_length (request->play_delays) == 1);
+    n_core_stop_request (core, request, 0);
+    fail_unless (request->play_delays == NULL);
+    g_source_remove (request->stop_source_id);
+    request->stop_source_id = 0;
+
+    g_list_free (request->sinks_playing);
+    request->sinks_playing = NULL;
+    g_main_loop_unref (sync_loop);
+    sync_loop = NULL;
+    n_core_free (core);
+    core = NULL;
+    n_request_free (request);
+    request = NULL;
+    g_free (audio);
+    audio = NULL;
+    g_free (vibra);
+    vibra = NULL;
+}
+END_TEST
+
+typedef struct _PauseCount
+{
+    guint plays;
+    guint pauses;
+} PauseCount;
+
+static int
+pause_count_play (NSinkInterface *iface, NRequest *request)
+{
+    (void) request;
+    ((PauseCount*) iface->userdata)->plays++;
+    return TRUE;
+}
+
+static int
+pause_count_pause (NSinkInterface *iface, NRequest *request)
+{
+    (void) request;
+    ((PauseCount*) iface->userdata)->pauses++;
+    return TRUE;
+}
+
+START_TEST (test_pause_delayed_play)
+{
+    static const NSinkInterfaceDecl audio_decl = {
+        .name       = "TEST_PAUSE_audio",
+        .prepare    = sync_prepare,
+        .play       = pause_count_play,
+        .pause      = pause_count_pause,
+        .stop       = sync_stop,
+        .latency    = sync_audio_latency
+    };
+    static const NSinkInterfaceDecl vibra_decl = {
+        .name       = "TEST_PAUSE_vibra",
+        .prepare    = sync_prepare,
+        .play       = pause_count_play,
+        .pause      = pause_count_pause,
+        .stop       = sync_stop,
+        .latency    = sync_vibra_latency
+    };
+
+    PauseCount audio_count = { 0, 0 };
+    PauseCount vibra_count = { 0, 0 };
+
+    NCore *core = n_core_new (NULL, NULL);
+    fail_unless (core != NULL);
+
+    NInputInterface *input = g_new0 (NInputInterface, 1);
+
+    NSinkInterface *audio = g_new0 (NSinkInterface, 1);
+    audio->name     = audio_decl.name;
+    audio->core     = core;
+    audio->funcs    = audio_decl;
+    audio->userdata = &audio_count;
+
+    NSinkInterface *vibra = g_new0 (NSinkInterface, 1);
+    vibra->name     = vibra_decl.name;
+    vibra->core     = core;
+    vibra->funcs    = vibra_decl;
+    vibra->userdata = &vibra_count;
+
+    NRequest *request = n_request_new ();
+    request->name        = g_strdup ("TEST_PAUSE_REQUEST_name");
+    request->core        = core;
+    request->input_iface = input;
+    request->all_sinks   = g_list_append (request->all_sinks, vibra);
+    request->all_sinks   = g_list_append (request->all_sinks, audio);
+    request->sinks_prepared = g_list_copy (request->all_sinks);
+
+    sync_loop = g_main_loop_new (NULL, FALSE);
+
+    n_core_sink_synchronize_done_cb (request);
+    fail_unless (audio_count.plays == 1);
+    fail_unless (vibra_count.plays == 0);
+    fail_unless (g_list_length (request->play_delays) == 1);
+
+    /* sink waiting for its delayed play is not paused and does not start
+       while the request is paused */
+    n_core_pause_request (core, request);
+    fail_unless (audio_count.pauses == 1);
+    fail_unless (vibra_count.pauses == 0);
+
+    g_timeout_add (2 * SYNC_AUDIO_LATENCY_MS, sync_guard_cb, NULL);
+    g_main_loop_run (sync_loop);
+    fail_unless (vibra_count.plays == 0);
+    fail_unless (g_list_length (request->play_delays) == 1);
+
+    /* resume plays the delayed sink once, after the time that was left */
+    n_core_resume_request (core, request);
+    fail_unless (audio_count.plays == 2);
+    fail_unless (vibra_count.plays == 0);
+
+    g_timeout_add (2 * SYNC_AUDIO_LATENCY_MS, sync_guard_cb, NULL);
+    g_main_loop_run (sync_loop);
+    fail_unless (vibra_count.plays == 1);
+    fail_unless (audio_count.plays == 2);
+    fail_unless (request->play_delays == NULL);
+
+    g_list_free (request->sinks_playing);
+    request->sinks_playing = NULL;
+    g_list_free (request->all_sinks);
+    request->all_sinks = NULL;
+    g_main_loop_unref (sync_loop);
+    sync_loop = NULL;
+    n_core_free (core);
+    core = NULL;
+    n_request_free (request);
+    request = NULL;
+    g_free (audio);
+    audio = NULL;
+    g_free (vibra);
+    vibra = NULL;
+    g_free (input);
+    input = NULL;
+}
+END_TEST
+
+static guint group_playing_replies = 0;
+
+static void
+group_send_reply (NInputInterface *iface, NRequest *request, int code)
+{
+    (void) iface;
+    (void) request;
+    if (code == N_CORE_EVENT_PLAYING)
+        group_playing_replies++;
+}
+
+START_TEST (test_group_playing)
+{
+    static const NSinkInterfaceDecl decl = {
+        .name       = "TEST_GROUP_sink",
+        .prepare    = sync_prepare,
+        .play       = pause_count_play,
+        .stop       = sync_stop
+    };
+
+    PauseCount count = { 0, 0 };
+    GList     *iter  = NULL;
+    NRequest  *member = NULL;
+    guint      i     = 0;
+
+    NCore *core = n_core_new (NULL, NULL);
+    fail_unless (core != NULL);
+
+    NInputInterface *input = g_new0 (NInputInterface, 1);
+    input->funcs.send_reply = group_send_reply;
+
+    NSinkInterface *sink = g_new0 (NSinkInterface, 1);
+    sink->name     = decl.name;
+    sink->core     = core;
+    sink->funcs    = decl;
+    sink->userdata = &count;
+
+    NRequest *group = n_request_new ();
+    group->name        = g_strdup ("TEST_GROUP_name");
+    group->core        = core;
+    group->input_iface = input;
+
+    for (i = 0; i < 2; ++i) {
+        member = n_request_new ();
+        member->name        = g_strdup ("TEST_GROUP_member");
+        member->core        = core;
+        member->input_iface = input;
+        member->group       = group;
+        member->all_sinks   = g_list_append (NULL, sink);
+        member->sinks_preparing = g_list_copy (member->all_sinks);
+        group->members = g_list_append (group->members, member);
+    }
+
+    sync_loop = g_main_loop_new (NULL, FALSE);
+    group_playing_replies = 0;
+
+    /* no PLAYING before every member has synchronized */
+    n_core_synchronize_sink (core, sink, (NRequest*) group->members->data);
+    fail_unless (group->play_source_id == 0);
+    n_core_synchronize_sink (core, sink, (NRequest*) group->members->next->data);
+    fail_unless (group->play_source_id > 0);
+    fail_unless (group_playing_replies == 0);
+    fail_unless (count.plays == 0);
+
+    /* group starts as a whole and replies PLAYING once */
+    g_timeout_add (SYNC_AUDIO_LATENCY_MS, sync_guard_cb, NULL);
+    g_main_loop_run (sync_loop);
+    fail_unless (group->members_started == TRUE);
+    fail_unless (group_playing_replies == 1);
+    fail_unless (count.plays == 2);
+
+    for (iter = g_list_first (group->members); iter; iter = g_list_next (iter)) {
+        member = (NRequest*) iter->data;
+        g_list_free (member->sinks_playing);
+        g_list_free (member->all_sinks);
+        member->sinks_playing = NULL;
+        member->all_sinks     = NULL;
+        n_request_free (member);
+    }
+    g_list_free (group->members);
+    group->members = NULL;
+
+    g_main_loop_unref (sync_loop);
+    sync_loop = NULL;
+    n_core_free (core);
+    core = NULL;
+    n_request_free (group);
+    group = NULL;
+    g_free (sink);
+    sink = NULL;
+    g_free (input);
+    input = NULL;
+}
+END_TEST
+
+static gboolean
+breaker_wait_cb (gpointer userdata)
+{
+    NSinkInterface *iface = (NSinkInterface*) userdata;
+
+    if (iface->breaker == N_SINK_BREAKER_OPEN)
+        return TRUE;
+
+    g_main_loop_quit (sync_loop);
+    return FALSE;
+}
+
+static guint deferred_errors = 0;
+
+static void
+deferred_send_error (NInputInterface *iface, NRequest *request, const char *err_msg)
+{
+    (void) iface;
+    (void) request;
+    (void) err_msg;
+    deferred_errors++;
+}
+
+START_TEST (test_deferred_requests)
+{
+    NCore *core = n_core_new (NULL, NULL);
+    fail_unless (core != NULL);
+    core->max_defer = 1000;
+
+    NInputInterface *input = g_new0 (NInputInterface, 1);
+    input->funcs.send_error = deferred_send_error;
+
+    NRequest *first = n_request_new ();
+    first->name        = g_strdup ("TEST_DEFER_first");
+    first->core        = core;
+    first->input_iface = input;
+
+    NRequest *second = n_request_new ();
+    second->name        = g_strdup ("TEST_DEFER_second");
+    second->core        = core;
+    second->input_iface = input;
+
+    deferred_errors = 0;
+    n_core_defer_request (first);
+    n_core_defer_request (second);
+    fail_unless (g_list_length (core->deferred_requests) == 2);
+    fail_unless (first->defer_source_id > 0);
+
+    /* deferred requests are failed and freed on shutdown, not leaked */
+    n_core_shutdown (core);
+    fail_unless (core->deferred_requests == NULL);
+    fail_unless (deferred_errors == 2);
+
+    n_core_free (core);
+    core = NULL;
+    g_free (input);
+    input = NULL;
+}
+END_TEST
+
+static gboolean breaker_probe_ok = FALSE;
+static guint    breaker_probes   = 0;
+
+static int
+breaker_probe (NSinkInterface *iface)
+{
+    (void) iface;
+
+    /* fail the first probe */
+    if (breaker_probes++ > 0)
+        breaker_probe_ok = TRUE;
+
+    return breaker_probe_ok;
+}
+
+static guint init_state_inputs = 0;
+
+static int
+init_state_input_initialize (NInputInterface *iface)
+{
+    (void) iface;
+    init_state_inputs++;
+    return TRUE;
+}
+
+START_TEST (test_sink_init_state)
+{
+    NSinkInterface  *sinks[3]  = { NULL, NULL, NULL };
+    NInputInterface *inputs[2] = { NULL, NULL };
+    GList           *capable   = NULL;
+
+    NCore *core = n_core_new (NULL, NULL);
+    fail_unless (core != NULL);
+
+    NSinkInterface *ready = g_new0 (NSinkInterface, 1);
+    ready->name = "TEST_INIT_ready";
+    ready->core = core;
+    sinks[0]    = ready;
+
+    NSinkInterface *failed = g_new0 (NSinkInterface, 1);
+    failed->name = "TEST_INIT_failed";
+    failed->core = core;
+    sinks[1]     = failed;
+
+    core->sinks     = sinks;
+    core->num_sinks = 2;
+
+    NInputInterface *input = g_new0 (NInputInterface, 1);
+    input->name             = "TEST_INIT_input";
+    input->core             = core;
+    input->funcs.initialize = init_state_input_initialize;
+    inputs[0]   = input;
+    core->inputs     = inputs;
+    core->num_inputs = 1;
+    core->sinks_started = TRUE;
+    init_state_inputs   = 0;
+
+    NRequest *request = n_request_new ();
+    request->name = g_strdup ("TEST_INIT_REQUEST_name");
+    request->core = core;
+
+    /* sinks are not used while their initialization is pending */
+    fail_unless (ready->init_state == N_SINK_INIT_PENDING);
+    capable = n_core_query_capable_sinks (request);
+    fail_unless (capable == NULL);
+
+    /* PENDING -> READY, input without dependencies waits for all sinks */
+    n_sink_interface_initialized (ready, TRUE);
+    fail_unless (ready->init_state == N_SINK_INIT_READY);
+    fail_unless (init_state_inputs == 0);
+    fail_unless (core->init_done == FALSE);
+
+    capable = n_core_query_capable_sinks (request);
+    fail_unless (g_list_length (capable) == 1);
+    fail_unless (capable->data == ready);
+    g_list_free (capable);
+
+    /* PENDING -> FAILED, sink is never used and late reports are ignored */
+    n_sink_interface_initialized (failed, FALSE);
+    fail_unless (failed->init_state == N_SINK_INIT_FAILED);
+    n_sink_interface_initialized (failed, TRUE);
+    fail_unless (failed->init_state == N_SINK_INIT_FAILED);
+
+    capable = n_core_query_capable_sinks (request);
+    fail_unless (g_list_length (capable) == 1);
+    g_list_free (capable);
+
+    /* all sinks have settled */
+    fail_unless (init_state_inputs == 1);
+    fail_unless (input->initialized == TRUE);
+    fail_unless (core->init_done == TRUE);
+
+    core->sinks      = NULL;
+    core->num_sinks  = 0;
+    core->inputs     = NULL;
+    core->num_inputs = 0;
+    n_core_free (core);
+    core = NULL;
+    n_request_free (request);
+    request = NULL;
+    g_free (ready);
+    g_free (failed);
+    g_free (input);
+}
+END_TEST
+
+static guint lazy_replies = 0;
+static guint lazy_errors  = 0;
+
+static const char*
+lazy_plugin_name ()
+{
+    return "TEST_LAZY_plugin";
+}
+
+static void
+lazy_send_reply (NInputInterface *iface, NRequest *request, int code)
+{
+    (void) iface;
+    (void) request;
+    if (code == N_CORE_EVENT_COMPLETED)
+        lazy_replies++;
+}
+
+static void
+lazy_send_error (NInputInterface *iface, NRequest *request, const char *err_msg)
+{
+    (void) iface;
+    (void) request;
+    (void) err_msg;
+    lazy_errors++;
+}
+
+static NLazyPlugin*
+lazy_plugin_new (const char *name, gboolean required)
+{
+    NLazyPlugin *lazy = g_new0 (NLazyPlugin, 1);
+    lazy->name     = g_strdup (name);
+    lazy->keys     = g_strsplit ("test.lazy.key", ";", -1);
+    lazy->required = required;
+    return lazy;
+}
+
+static NRequest*
+lazy_request_new (NCore *core, NInputInterface *input)
+{
+    NProplist *props   = n_proplist_new ();
+    NRequest  *request = NULL;
+
+    n_proplist_set_string (props, "test.lazy.key", "value");
+    request = n_request_new_with_event_and_properties ("TEST_LAZY_REQUEST_name", props);
+    n_proplist_free (props);
+
+    request->core        = core;
+    request->input_iface = input;
+    return request;
+}
+
+START_TEST (test_lazy_sink_wait)
+{
+    static const NSinkInterfaceDecl decl = {
+        .name       = "TEST_LAZY_sink",
+        .play       = pause_count_play,
+        .stop       = sync_stop
+    };
+
+    NSinkInterface  *sinks[2]  = { NULL, NULL };
+    NInputInterface *inputs[1] = { NULL };
+    PauseCount       count     = { 0, 0 };
+    NRequest        *request   = NULL;
+
+    NCore *core = n_core_new (NULL, NULL);
+    fail_unless (core != NULL);
+    core->inputs        = inputs;
+    core->sinks_started = TRUE;
+    core->init_done     = TRUE;
+
+    NInputInterface *input = g_new0 (NInputInterface, 1);
+    input->funcs.send_reply = lazy_send_reply;
+    input->funcs.send_error = lazy_send_error;
+
+    NPlugin *plugin = g_new0 (NPlugin, 1);
+    plugin->get_name = lazy_plugin_name;
+    core->plugins = g_list_append (NULL, plugin);
+
+    /* plugin loaded on demand, its sink is still initializing */
+    NSinkInterface *sink = g_new0 (NSinkInterface, 1);
+    sink->name     = decl.name;
+    sink->core     = core;
+    sink->funcs    = decl;
+    sink->plugin   = plugin;
+    sink->userdata = &count;
+    sinks[0]        = sink;
+    core->sinks     = sinks;
+    core->num_sinks = 1;
+
+    NLazyPlugin *lazy = lazy_plugin_new (lazy_plugin_name (), TRUE);
+    lazy->plugin = plugin;
+    core->lazy_starting = g_list_append (NULL, lazy);
+
+    lazy_replies = 0;
+    lazy_errors  = 0;
+
+    /* request with the keys of the plugin waits instead of failing */
+    request = lazy_request_new (core, input);
+    fail_unless (n_core_start_request (request) == TRUE);
+    fail_unless (request->waits_for_sinks == TRUE);
+    fail_unless (g_list_find (core->deferred_requests, request) != NULL);
+    fail_unless (request->all_sinks == NULL);
+
+    /* and starts once the sink is ready */
+    n_sink_interface_initialized (sink, TRUE);
+    fail_unless (core->lazy_starting == NULL);
+    fail_unless (core->deferred_requests == NULL);
+    fail_unless (request->waits_for_sinks == FALSE);
+    fail_unless (g_list_length (request->all_sinks) == 1);
+
+    sync_loop = g_main_loop_new (NULL, FALSE);
+    g_timeout_add (SYNC_VIBRA_LATENCY_MS, sync_guard_cb, NULL);
+    g_main_loop_run (sync_loop);
+    fail_unless (count.plays == 1);
+
+    n_core_complete_sink (core, sink, request);
+    g_timeout_add (SYNC_VIBRA_LATENCY_MS, sync_guard_cb, NULL);
+    g_main_loop_run (sync_loop);
+    fail_unless (lazy_replies == 1);
+    fail_unless (lazy_errors == 0);
+
+    /* required plugin that fails to load fails the request */
+    g_free (core->plugin_path);
+    core->plugin_path  = g_strdup ("/nonexistent");
+    core->lazy_plugins = g_list_append (NULL, lazy_plugin_new ("TEST_LAZY_missing", TRUE));
+
+    request = lazy_request_new (core, input);
+    fail_unless (n_core_start_request (request) == TRUE);
+    fail_unless (request->has_failed == TRUE);
+    fail_unless (core->lazy_plugins == NULL);
+
+    g_timeout_add (SYNC_VIBRA_LATENCY_MS, sync_guard_cb, NULL);
+    g_main_loop_run (sync_loop);
+    fail_unless (lazy_errors == 1);
+
+    g_main_loop_unref (sync_loop);
+    sync_loop = NULL;
+    g_list_free (core->plugins);
+    core->plugins   = NULL;
+    core->sinks     = NULL;
+    core->num_sinks = 0;
+    core->inputs    = NULL;
+    n_core_free (core);
+    core = NULL;
+    g_free (plugin);
+    g_free (sink);
+    g_free (input);
+}
+END_TEST
+
+typedef struct _TrimCount
+{
+    guint trims;
+    guint rewarms;
+} TrimCount;
+
+static int
+trim_count_trim (NSinkInterface *iface)
+{
+    TrimCount *count = (TrimCount*) iface->userdata;
+    count->trims++;
+    g_main_loop_quit (sync_loop);
+    return TRUE;
+}
+
+static void
+trim_count_rewarm (NSinkInterface *iface)
+{
+    TrimCount *count = (TrimCount*) iface->userdata;
+    count->rewarms++;
+    g_main_loop_quit (sync_loop);
+}
+
+#define IDLE_TRIM_PERIOD_MS (20)
+
+START_TEST (test_idle_trim)
+{
+    static const NSinkInterfaceDecl decl = {
+        .name       = "TEST_TRIM_sink",
+        .trim       = trim_count_trim,
+        .rewarm     = trim_count_rewarm
+    };
+
+    NSinkInterface *sinks[3] = { NULL, NULL, NULL };
+    TrimCount       ready    = { 0, 0 };
+    TrimCount       pending  = { 0, 0 };
+    NRequest       *request  = NULL;
+
+    NCore *core = n_core_new (NULL, NULL);
+    fail_unless (core != NULL);
+
+    NSinkInterface *sink = g_new0 (NSinkInterface, 1);
+    sink->name       = decl.name;
+    sink->core       = core;
+    sink->funcs      = decl;
+    sink->userdata   = &ready;
+    sink->init_state = N_SINK_INIT_READY;
+    sinks[0] = sink;
+
+    /* sinks still initializing are left alone */
+    NSinkInterface *initializing = g_new0 (NSinkInterface, 1);
+    initializing->name       = decl.name;
+    initializing->core       = core;
+    initializing->funcs      = decl;
+    initializing->userdata   = &pending;
+    initializing->init_state = N_SINK_INIT_PENDING;
+    sinks[1] = initializing;
+
+    core->sinks     = sinks;
+    core->num_sinks = 2;
+
+    sync_loop = g_main_loop_new (NULL, FALSE);
+
+    /* nothing is trimmed while requests are active */
+    request = n_request_new ();
+    core->requests = g_list_append (NULL, request);
+    n_idle_trim_configure (core->idle_trim, IDLE_TRIM_PERIOD_MS);
+    g_timeout_add (IDLE_TRIM_PERIOD_MS * 3, sync_guard_cb, NULL);
+    g_main_loop_run (sync_loop);
+    fail_unless (ready.trims == 0);
+    fail_unless (sink->trimmed == FALSE);
+
+    /* idle period without requests trims ready sinks */
+    g_list_free (core->requests);
+    core->requests = NULL;
+    n_request_free (request);
+    g_main_loop_run (sync_loop);
+    fail_unless (ready.trims == 1);
+    fail_unless (sink->trimmed == TRUE);
+    fail_unless (pending.trims == 0);
+    fail_unless (initializing->trimmed == FALSE);
+
+    /* next request rewarms trimmed sinks once */
+    n_idle_trim_activity (core->idle_trim);
+    n_idle_trim_activity (core->idle_trim);
+    g_main_loop_run (sync_loop);
+    fail_unless (ready.rewarms == 1);
+    fail_unless (sink->trimmed == FALSE);
+    fail_unless (pending.rewarms == 0);
+
+    /* disabled trimming does not trim again */
+    n_idle_trim_configure (core->idle_trim, 0);
+    g_timeout_add (IDLE_TRIM_PERIOD_MS * 3, sync_guard_cb, NULL);
+    g_main_loop_run (sync_loop);
+    fail_unless (ready.trims == 1);
+    fail_unless (ready.rewarms == 1);
+
+    g_main_loop_unref (sync_loop);
+    sync_loop = NULL;
+    core->sinks     = NULL;
+    core->num_sinks = 0;
+    n_core_free (core);
+    core = NULL;
+    g_free (initializing);
+    g_free (sink);
+}
+END_TEST
+
+START_TEST (test_circuit_breaker)
+{
+    NSinkInterface *sinks[2] = { NULL, NULL };
+    GList          *capable  = NULL;
+    guint           guard_id = 0;
+    guint           i        = 0;
+
+    NCore *core = n_core_new (NULL, NULL);
+    fail_unless (core != NULL);
+    core->sink_failure_limit  = 3;
+    core->sink_probe_interval = 10;
+
+    NSinkInterface *iface = g_new0 (NSinkInterface, 1);
+    iface->name       = "TEST_BREAKER_sink_name";
+    iface->core       = core;
+    iface->init_state = N_SINK_INIT_READY;
+    sinks[0]    = iface;
+    core->sinks = sinks;
+
+    NRequest *request = n_request_new ();
+    request->name = g_strdup ("TEST_BREAKER_REQUEST_name");
+    request->core = core;
+
+    capable = n_core_query_capable_sinks (request);
+    fail_unless (g_list_length (capable) == 1);
+    g_list_free (capable);
+
+    /* errors caused by the request are not counted against the sink */
+    n_core_fail_sink_request (core, iface, request);
+    g_source_remove (request->stop_source_id);
+    request->stop_source_id = 0;
+    fail_unless (iface->failures == 0);
+    fail_unless (iface->breaker == N_SINK_BREAKER_CLOSED);
+
+    /* breaker opens after the configured amount of consecutive failures */
+    for (i = 0; i < core->sink_failure_limit; ++i) {
+        fail_unless (iface->breaker == N_SINK_BREAKER_CLOSED);
+        n_core_fail_sink (core, iface, request);
+        g_source_remove (request->stop_source_id);
+        request->stop_source_id = 0;
+    }
+
+    fail_unless (iface->breaker == N_SINK_BREAKER_OPEN);
+    fail_unless (iface->failures == core->sink_failure_limit);
+    fail_unless (iface->probe_source > 0);
+
+    capable = n_core_query_capable_sinks (request);
+    fail_unless (capable == NULL);
+
+    /* sink without probe function is given a trial after probe interval */
+    sync_loop = g_main_loop_new (NULL, FALSE);
+    guard_id  = g_timeout_add (1000, sync_guard_cb, NULL);
+    g_timeout_add (5, breaker_wait_cb, iface);
+    g_main_loop_run (sync_loop);
+    g_source_remove (guard_id);
+
+    fail_unless (iface->breaker == N_SINK_BREAKER_HALF_OPEN);
+    fail_unless (iface->probe_source == 0);
+
+    capable = n_core_query_capable_sinks (request);
+    fail_unless (g_list_length (capable) == 1);
+    g_list_free (capable);
+
+    /* failing the trial opens the breaker immediately */
+    n_core_fail_sink (core, iface, request);
+    g_source_remove (request->stop_source_id);
+    request->stop_source_id = 0;
+    fail_unless (iface->breaker == N_SINK_BREAKER_OPEN);
+
+    /* successful playback closes the breaker */
+    n_core_sink_succeeded (iface);
+    fail_unless (iface->breaker == N_SINK_BREAKER_CLOSED);
+    fail_unless (iface->failures == 0);
+    fail_unless (iface->probe_source == 0);
+
+    /* sink with probe function is closed once the probe succeeds */
+    iface->funcs.probe = breaker_probe;
+    breaker_probe_ok   = FALSE;
+    for (i = 0; i < core->sink_failure_limit; ++i) {
+        n_core_fail_sink (core, iface, request);
+        g_source_remove (request->stop_source_id);
+        request->stop_source_id = 0;
+    }
+    fail_unless (iface->breaker == N_SINK_BREAKER_OPEN);
+
+    guard_id = g_timeout_add (1000, sync_guard_cb, NULL);
+    g_timeout_add (5, breaker_wait_cb, iface);
+    g_main_loop_run (sync_loop);
+    g_source_remove (guard_id);
+
+    fail_unless (breaker_probes > 1);
+    fail_unless (iface->breaker == N_SINK_BREAKER_CLOSED);
+    fail_unless (iface->failures == 0);
+
+    g_main_loop_unref (sync_loop);
+    sync_loop = NULL;
+    core->sinks = NULL;
+    n_core_free (core);
+    core = NULL;
+    n_request_free (request);
+    request = NULL;
+    g_free (iface);
+    iface = NULL;
+}
+END_TEST
+
 int
 main (int argc, char *argv[])
 {
@@ -436,6 +1339,38 @@ main (int argc, char *argv[])
     tcase_add_test (tc, test_fail);
     suite_add_tcase (s, tc);
 
+    tc = tcase_create ("synchronized start");
+    tcase_add_test (tc, test_synchronized_start);
+    suite_add_tcase (s, tc);
+
+    tc = tcase_create ("pause delayed play");
+    tcase_add_test (tc, test_pause_delayed_play);
+    suite_add_tcase (s, tc);
+
+    tc = tcase_create ("deferred requests");
+    tcase_add_test (tc, test_deferred_requests);
+    suite_add_tcase (s, tc);
+
+    tc = tcase_create ("group playing");
+    tcase_add_test (tc, test_group_playing);
+    suite_add_tcase (s, tc);
+
+    tc = tcase_create ("sink init state");
+    tcase_add_test (tc, test_sink_init_state);
+    suite_add_tcase (s, tc);
+
+    tc = tcase_create ("lazy sink wait");
+    tcase_add_test (tc, test_lazy_sink_wait);
+    suite_add_tcase (s, tc);
+
+    tc = tcase_create ("idle trim");
+    tcase_add_test (tc, test_idle_trim);
+    suite_add_tcase (s, tc);
+
+    tc = tcase_create ("circuit breaker");
+    tcase_add_test (tc, test_circuit_breaker);
+    suite_add_tcase (s, tc);
+
     sr = srunner_create (s);
     srunner_run_all (sr, CK_NORMAL);
     num_failed = srunner_ntests_failed (sr);
@@ -0,0 +1,201 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <check.h>
+
+#include "src/plugins/socket/ngf-socket.h"
+#include "src/plugins/socket/protocol.h"
+
+static uint32_t status_id;
+static uint32_t status_value;
+static int      status_count;
+
+static void
+status_cb (NgfSocketClient *client, uint32_t id, uint32_t status, void *userdata)
+{
+    (void) client;
+    (void) userdata;
+
+    status_id = id;
+    status_value = status;
+    status_count++;
+}
+
+START_TEST (test_frames)
+{
+    uint8_t           buffer[64];
+    NgfSocketWriter   writer;
+    NgfSocketReader   reader;
+    NgfSocketFrame    frame;
+    NgfSocketProperty property;
+    const uint8_t    *key = NULL;
+
+    property.key = "volume";
+    property.type = NGF_SOCKET_PROPERTY_INT;
+    property.value.i = -5;
+
+    ngf_socket_writer_init (&writer, buffer, sizeof (buffer));
+    ngf_socket_writer_begin (&writer, NGF_SOCKET_MSG_PLAY, 7);
+    ngf_socket_writer_u32 (&writer, 3);
+    ngf_socket_writer_u16 (&writer, 1);
+    ngf_socket_writer_property (&writer, &property);
+    fail_unless (ngf_socket_writer_end (&writer) == 0);
+
+    ngf_socket_reader_init (&reader, buffer, writer.len);
+    fail_unless (ngf_socket_reader_frame (&reader, &frame) == 1);
+    fail_unless (frame.type == NGF_SOCKET_MSG_PLAY);
+    fail_unless (frame.id == 7);
+    fail_unless (ngf_socket_reader_u32 (&frame.payload) == 3);
+    fail_unless (ngf_socket_reader_u16 (&frame.payload) == 1);
+    fail_unless (ngf_socket_reader_u8 (&frame.payload) == NGF_SOCKET_PROPERTY_INT);
+    fail_unless (ngf_socket_reader_u8 (&frame.payload) == 6);
+    key = ngf_socket_reader_bytes (&frame.payload, 6);
+    fail_unless (key != NULL && memcmp (key, "volume", 6) == 0);
+    fail_unless ((int32_t) ngf_socket_reader_u32 (&frame.payload) == -5);
+    fail_unless (frame.payload.error == 0);
+    fail_unless (frame.payload.pos == frame.payload.len);
+    fail_unless (ngf_socket_reader_frame (&reader, &frame) == 0);
+
+    /* truncated frame */
+    ngf_socket_reader_init (&reader, buffer, writer.len - 1);
+    fail_unless (ngf_socket_reader_frame (&reader, &frame) == 0);
+    fail_unless (reader.error != 0);
+
+    /* frame that does not fit is dropped, earlier frames are kept */
+    ngf_socket_writer_init (&writer, buffer, 12);
+    ngf_socket_writer_begin (&writer, NGF_SOCKET_MSG_STOP, 1);
+    fail_unless (ngf_socket_writer_end (&writer) == 0);
+    ngf_socket_writer_begin (&writer, NGF_SOCKET_MSG_PAUSE, 1);
+    ngf_socket_writer_u32 (&writer, 0);
+    fail_unless (ngf_socket_writer_end (&writer) == -1);
+    fail_unless (writer.len == NGF_SOCKET_FRAME_HEADER);
+}
+END_TEST
+
+START_TEST (test_client)
+{
+    char               dir[] = "/tmp/test-socket-XXXXXX";
+    char               path[sizeof (dir) + 16];
+    struct sockaddr_un addr;
+    NgfSocketClient   *client  = NULL;
+    NgfSocketProperty  property;
+    NgfSocketReader    reader;
+    NgfSocketFrame     frame;
+    NgfSocketWriter    writer;
+    uint8_t            packet[NGF_SOCKET_MAX_PACKET];
+    ssize_t            len     = 0;
+    int                listener = -1;
+    int                fd      = -1;
+    uint32_t           first   = 0;
+    uint32_t           second  = 0;
+
+    fail_unless (mkdtemp (dir) != NULL);
+    snprintf (path, sizeof (path), "%s/ngfd.socket", dir);
+
+    memset (&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    strcpy (addr.sun_path, path);
+
+    listener = socket (AF_UNIX, SOCK_SEQPACKET, 0);
+    fail_unless (listener >= 0);
+    fail_unless (bind (listener, (struct sockaddr*) &addr, sizeof (addr)) == 0);
+    fail_unless (listen (listener, 1) == 0);
+
+    client = ngf_socket_client_new (path);
+    fail_unless (client != NULL);
+    fd = accept (listener, NULL, NULL);
+    fail_unless (fd >= 0);
+
+    property.key = "sound.filename";
+    property.type = NGF_SOCKET_PROPERTY_STRING;
+    property.value.s = "click.wav";
+
+    /* batched operations arrive in one packet */
+    ngf_socket_client_begin (client);
+    first = ngf_socket_client_play (client, "tacticon", &property, 1);
+    second = ngf_socket_client_play (client, "tacticon", NULL, 0);
+    fail_unless (ngf_socket_client_stop (client, first) == 0);
+    fail_unless (first != 0 && second != 0 && first != second);
+    fail_unless (ngf_socket_client_flush (client) == 0);
+
+    len = recv (fd, packet, sizeof (packet), 0);
+    fail_unless (len > 0);
+    ngf_socket_reader_init (&reader, packet, (size_t) len);
+
+    fail_unless (ngf_socket_reader_frame (&reader, &frame) == 1);
+    fail_unless (frame.type == NGF_SOCKET_MSG_EVENT && frame.id == 0);
+    fail_unless (frame.payload.len == strlen ("tacticon"));
+
+    fail_unless (ngf_socket_reader_frame (&reader, &frame) == 1);
+    fail_unless (frame.type == NGF_SOCKET_MSG_PLAY && frame.id == first);
+    fail_unless (ngf_socket_reader_u32 (&frame.payload) == 0);
+    fail_unless (ngf_socket_reader_u16 (&frame.payload) == 1);
+
+    fail_unless (ngf_socket_reader_frame (&reader, &frame) == 1);
+    fail_unless (frame.type == NGF_SOCKET_MSG_PLAY && frame.id == second);
+    fail_unless (ngf_socket_reader_u32 (&frame.payload) == 0);
+    fail_unless (ngf_socket_reader_u16 (&frame.payload) == 0);
+
+    fail_unless (ngf_socket_reader_frame (&reader, &frame) == 1);
+    fail_unless (frame.type == NGF_SOCKET_MSG_STOP && frame.id == first);
+
+    fail_unless (ngf_socket_reader_frame (&reader, &frame) == 0);
+    fail_unless (reader.error == 0);
+
+    /* status is delivered to the callback */
+    ngf_socket_client_set_callback (client, status_cb, NULL);
+    fail_unless (ngf_socket_client_dispatch (client) == 0);
+    fail_unless (status_count == 0);
+
+    ngf_socket_writer_init (&writer, packet, sizeof (packet));
+    ngf_socket_writer_begin (&writer, NGF_SOCKET_MSG_STATUS, second);
+    ngf_socket_writer_u32 (&writer, NGF_SOCKET_STATUS_COMPLETED);
+    fail_unless (ngf_socket_writer_end (&writer) == 0);
+    fail_unless (send (fd, packet, writer.len, 0) == (ssize_t) writer.len);
+
+    fail_unless (ngf_socket_client_dispatch (client) == 0);
+    fail_unless (status_count == 1);
+    fail_unless (status_id == second);
+    fail_unless (status_value == NGF_SOCKET_STATUS_COMPLETED);
+
+    close (fd);
+    fail_unless (ngf_socket_client_dispatch (client) == -1);
+
+    ngf_socket_client_free (client);
+    close (listener);
+    unlink (path);
+    rmdir (dir);
+}
+END_TEST
+
+int
+main (int argc, char *argv[])
+{
+    (void) argc;
+    (void) argv;
+
+    int num_failed = 0;
+    Suite *s = NULL;
+    TCase *tc = NULL;
+    SRunner *sr = NULL;
+
+    s = suite_create ("\tSocket interface tests");
+
+    tc = tcase_create ("frames");
+    tcase_add_test (tc, test_frames);
+    suite_add_tcase (s, tc);
+
+    tc = tcase_create ("client");
+    tcase_add_test (tc, test_client);
+    suite_add_tcase (s, tc);
+
+    sr = srunner_create (s);
+    srunner_run_all (sr, CK_NORMAL);
+    num_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+
+    return num_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}